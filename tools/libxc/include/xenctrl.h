@@ -575,6 +575,21 @@ int xc_domain_unpause(xc_interface *xch,
 int xc_domain_destroy(xc_interface *xch,
                       uint32_t domid);
 
+typedef struct xen_domctl_teardown_progress xc_teardown_progress_t;
+
+/**
+ * This function reports how far the freeing of a domain's memory has got.
+ * It may be called from another thread while xc_domain_destroy() is in
+ * progress.
+ *
+ * @parm xch a handle to an open hypervisor interface
+ * @parm domid the domain id being destroyed
+ * @parm progress where to store the progress
+ * @return 0 on success, -1 on failure
+ */
+int xc_domain_get_teardown_progress(xc_interface *xch,
+                                    uint32_t domid,
+                                    xc_teardown_progress_t *progress);
 
 /**
  * This function resumes a suspended domain. The domain should have
@@ -937,6 +952,17 @@ int xc_vcpu_getinfo(xc_interface *xch,
                     uint32_t vcpu,
                     xc_vcpuinfo_t *info);
 
+/*
+ * Get the scheduling latency statistics of the vcpus of a domain.
+ * On entry *nr_vcpus is the number of elements in info (info can be NULL
+ * with *nr_vcpus == 0), on return it's the number of vcpus of the domain.
+ */
+typedef struct xen_sysctl_sched_vcpu_latency xc_vcpu_sched_latency_t;
+int xc_vcpu_sched_latency_get(xc_interface *xch,
+                              uint32_t domid,
+                              unsigned int *nr_vcpus,
+                              xc_vcpu_sched_latency_t *info);
+
 long long xc_domain_get_cpu_usage(xc_interface *xch,
                                   uint32_t domid,
                                   int vcpu);
@@ -974,6 +1000,18 @@ int xc_sched_credit2_params_set(xc_interface *xch,
 int xc_sched_credit2_params_get(xc_interface *xch,
                                 uint32_t cpupool_id,
                                 struct xen_sysctl_credit2_schedule *schedule);
+/*
+ * Get the load balancing statistics of the runqueues of a Credit2 cpupool.
+ * On entry *nr_runqueues is the number of elements in stats (stats can be
+ * NULL with *nr_runqueues == 0), on return it's the number of elements
+ * filled in, or with stats NULL, the number of runqueues.
+ */
+typedef struct xen_sysctl_credit2_runqueue_stats xc_credit2_runqueue_stats_t;
+int xc_sched_credit2_stats_get(xc_interface *xch,
+                               uint32_t cpupool_id,
+                               unsigned int *nr_runqueues,
+                               xc_credit2_runqueue_stats_t *stats,
+                               unsigned int *load_precision_shift);
 int xc_sched_credit2_domain_set(xc_interface *xch,
                                 uint32_t domid,
                                 struct xen_domctl_sched_credit2 *sdom);
@@ -1482,6 +1520,35 @@ int xc_lockprof_query(xc_interface *xch,
                       uint64_t *time,
                       xc_hypercall_buffer_t *data);
 
+/*
+ * Sampling lock contention profiler.  A period of 0 disables sampling, the
+ * threshold for logging long lock holds is in ns.  For the queries, on entry
+ * *nr is the number of elements in the array (which may be NULL if 0), on
+ * return the number available.
+ */
+typedef xen_sysctl_locksample_lock_t xc_locksample_lock_t;
+typedef xen_sysctl_locksample_hold_t xc_locksample_hold_t;
+int xc_locksample_enable(xc_interface *xch, uint32_t period,
+                         uint64_t threshold);
+int xc_locksample_reset(xc_interface *xch);
+int xc_locksample_locks(xc_interface *xch, uint32_t *nr,
+                        xc_locksample_lock_t *locks,
+                        uint32_t *period, uint64_t *threshold);
+int xc_locksample_holds(xc_interface *xch, uint32_t *nr,
+                        xc_locksample_hold_t *holds);
+
+/*
+ * xmalloc() heap statistics.  On entry *nr is the number of elements in the
+ * array (which may be NULL if 0), on return the number available.
+ */
+typedef xen_sysctl_xmalloc_class_t xc_xmalloc_class_t;
+typedef xen_sysctl_xmalloc_site_t xc_xmalloc_site_t;
+int xc_xmalloc_classes(xc_interface *xch, uint32_t *nr,
+                       xc_xmalloc_class_t *classes,
+                       uint64_t *used, uint64_t *total);
+int xc_xmalloc_sites(xc_interface *xch, uint32_t *nr,
+                     xc_xmalloc_site_t *sites);
+
 void *xc_memalign(xc_interface *xch, size_t alignment, size_t size);
 
 /**
@@ -107,3 +107,41 @@ xc_sched_credit2_params_get(
 
     return 0;
 }
+
+int
+xc_sched_credit2_stats_get(
+    xc_interface *xch,
+    uint32_t cpupool_id,
+    unsigned int *nr_runqueues,
+    xc_credit2_runqueue_stats_t *stats,
+    unsigned int *load_precision_shift)
+{
+    int ret;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(stats, *nr_runqueues * sizeof(*stats),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( (ret = xc_hypercall_bounce_pre(xch, stats)) )
+        goto out;
+
+    sysctl.cmd = XEN_SYSCTL_scheduler_op;
+    sysctl.u.scheduler_op.cpupool_id = cpupool_id;
+    sysctl.u.scheduler_op.sched_id = XEN_SCHEDULER_CREDIT2;
+    sysctl.u.scheduler_op.cmd = XEN_SYSCTL_SCHEDOP_getstats;
+    sysctl.u.scheduler_op.u.sched_credit2_stats.nr_runqueues = *nr_runqueues;
+    set_xen_guest_handle(sysctl.u.scheduler_op.u.sched_credit2_stats.runqueues,
+                         stats);
+
+    if ( (ret = do_sysctl(xch, &sysctl)) != 0 )
+        goto out;
+
+    *nr_runqueues = sysctl.u.scheduler_op.u.sched_credit2_stats.nr_runqueues;
+    if ( load_precision_shift )
+        *load_precision_shift =
+            sysctl.u.scheduler_op.u.sched_credit2_stats.load_precision_shift;
+
+out:
+    xc_hypercall_bounce_post(xch, stats);
+
+    return ret;
+}
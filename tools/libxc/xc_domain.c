@@ -95,6 +95,21 @@ int xc_domain_destroy(xc_interface *xch,
     return do_domctl(xch, &domctl);
 }
 
+int xc_domain_get_teardown_progress(xc_interface *xch,
+                                    uint32_t domid,
+                                    xc_teardown_progress_t *progress)
+{
+    int rc;
+    DECLARE_DOMCTL;
+
+    domctl.cmd = XEN_DOMCTL_get_teardown_progress;
+    domctl.domain = domid;
+    rc = do_domctl(xch, &domctl);
+    if ( rc == 0 )
+        *progress = domctl.u.teardown_progress;
+    return rc;
+}
+
 int xc_domain_shutdown(xc_interface *xch,
                        uint32_t domid,
                        int reason)
@@ -1332,6 +1347,35 @@ int xc_vcpu_getinfo(xc_interface *xch,
     return rc;
 }
 
+int xc_vcpu_sched_latency_get(xc_interface *xch,
+                              uint32_t domid,
+                              unsigned int *nr_vcpus,
+                              xc_vcpu_sched_latency_t *info)
+{
+    int ret;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(info, *nr_vcpus * sizeof(*info),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( (ret = xc_hypercall_bounce_pre(xch, info)) )
+        goto out;
+
+    sysctl.cmd = XEN_SYSCTL_sched_latency;
+    sysctl.u.sched_latency.domid = domid;
+    sysctl.u.sched_latency.nr_vcpus = *nr_vcpus;
+    set_xen_guest_handle(sysctl.u.sched_latency.vcpus, info);
+
+    if ( (ret = do_sysctl(xch, &sysctl)) != 0 )
+        goto out;
+
+    *nr_vcpus = sysctl.u.sched_latency.nr_vcpus;
+
+out:
+    xc_hypercall_bounce_post(xch, info);
+
+    return ret;
+}
+
 int xc_domain_ioport_permission(xc_interface *xch,
                                 uint32_t domid,
                                 uint32_t first_port,
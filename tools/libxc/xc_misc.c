@@ -537,6 +537,159 @@ int xc_lockprof_query(xc_interface *xch,
     return rc;
 }
 
+int xc_locksample_enable(xc_interface *xch, uint32_t period,
+                         uint64_t threshold)
+{
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_locksample_op;
+    sysctl.u.locksample_op.cmd = XEN_SYSCTL_LOCKSAMPLE_enable;
+    sysctl.u.locksample_op.period = period;
+    sysctl.u.locksample_op.threshold = threshold;
+    sysctl.u.locksample_op.max_elem = 0;
+    set_xen_guest_handle(sysctl.u.locksample_op.locks, HYPERCALL_BUFFER_NULL);
+    set_xen_guest_handle(sysctl.u.locksample_op.holds, HYPERCALL_BUFFER_NULL);
+
+    return do_sysctl(xch, &sysctl);
+}
+
+int xc_locksample_reset(xc_interface *xch)
+{
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_locksample_op;
+    sysctl.u.locksample_op.cmd = XEN_SYSCTL_LOCKSAMPLE_reset;
+    sysctl.u.locksample_op.max_elem = 0;
+    set_xen_guest_handle(sysctl.u.locksample_op.locks, HYPERCALL_BUFFER_NULL);
+    set_xen_guest_handle(sysctl.u.locksample_op.holds, HYPERCALL_BUFFER_NULL);
+
+    return do_sysctl(xch, &sysctl);
+}
+
+int xc_locksample_locks(xc_interface *xch, uint32_t *nr,
+                        xc_locksample_lock_t *locks,
+                        uint32_t *period, uint64_t *threshold)
+{
+    int rc;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(locks, *nr * sizeof(*locks),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( xc_hypercall_bounce_pre(xch, locks) )
+        return -1;
+
+    sysctl.cmd = XEN_SYSCTL_locksample_op;
+    sysctl.u.locksample_op.cmd = XEN_SYSCTL_LOCKSAMPLE_locks;
+    sysctl.u.locksample_op.max_elem = *nr;
+    set_xen_guest_handle(sysctl.u.locksample_op.locks, locks);
+    set_xen_guest_handle(sysctl.u.locksample_op.holds, HYPERCALL_BUFFER_NULL);
+
+    rc = do_sysctl(xch, &sysctl);
+
+    xc_hypercall_bounce_post(xch, locks);
+
+    if ( !rc )
+    {
+        *nr = sysctl.u.locksample_op.nr_elem;
+        if ( period )
+            *period = sysctl.u.locksample_op.period;
+        if ( threshold )
+            *threshold = sysctl.u.locksample_op.threshold;
+    }
+
+    return rc;
+}
+
+int xc_locksample_holds(xc_interface *xch, uint32_t *nr,
+                        xc_locksample_hold_t *holds)
+{
+    int rc;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(holds, *nr * sizeof(*holds),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( xc_hypercall_bounce_pre(xch, holds) )
+        return -1;
+
+    sysctl.cmd = XEN_SYSCTL_locksample_op;
+    sysctl.u.locksample_op.cmd = XEN_SYSCTL_LOCKSAMPLE_holds;
+    sysctl.u.locksample_op.max_elem = *nr;
+    set_xen_guest_handle(sysctl.u.locksample_op.locks, HYPERCALL_BUFFER_NULL);
+    set_xen_guest_handle(sysctl.u.locksample_op.holds, holds);
+
+    rc = do_sysctl(xch, &sysctl);
+
+    xc_hypercall_bounce_post(xch, holds);
+
+    if ( !rc )
+        *nr = sysctl.u.locksample_op.nr_elem;
+
+    return rc;
+}
+
+int xc_xmalloc_classes(xc_interface *xch, uint32_t *nr,
+                       xc_xmalloc_class_t *classes,
+                       uint64_t *used, uint64_t *total)
+{
+    int rc;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(classes, *nr * sizeof(*classes),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( xc_hypercall_bounce_pre(xch, classes) )
+        return -1;
+
+    sysctl.cmd = XEN_SYSCTL_xmalloc_op;
+    sysctl.u.xmalloc_op.cmd = XEN_SYSCTL_XMALLOC_classes;
+    sysctl.u.xmalloc_op.max_elem = *nr;
+    sysctl.u.xmalloc_op.pad = 0;
+    set_xen_guest_handle(sysctl.u.xmalloc_op.classes, classes);
+    set_xen_guest_handle(sysctl.u.xmalloc_op.sites, HYPERCALL_BUFFER_NULL);
+
+    rc = do_sysctl(xch, &sysctl);
+
+    xc_hypercall_bounce_post(xch, classes);
+
+    if ( !rc )
+    {
+        *nr = sysctl.u.xmalloc_op.nr_elem;
+        if ( used )
+            *used = sysctl.u.xmalloc_op.pool_used;
+        if ( total )
+            *total = sysctl.u.xmalloc_op.pool_total;
+    }
+
+    return rc;
+}
+
+int xc_xmalloc_sites(xc_interface *xch, uint32_t *nr,
+                     xc_xmalloc_site_t *sites)
+{
+    int rc;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(sites, *nr * sizeof(*sites),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( xc_hypercall_bounce_pre(xch, sites) )
+        return -1;
+
+    sysctl.cmd = XEN_SYSCTL_xmalloc_op;
+    sysctl.u.xmalloc_op.cmd = XEN_SYSCTL_XMALLOC_sites;
+    sysctl.u.xmalloc_op.max_elem = *nr;
+    sysctl.u.xmalloc_op.pad = 0;
+    set_xen_guest_handle(sysctl.u.xmalloc_op.classes, HYPERCALL_BUFFER_NULL);
+    set_xen_guest_handle(sysctl.u.xmalloc_op.sites, sites);
+
+    rc = do_sysctl(xch, &sysctl);
+
+    xc_hypercall_bounce_post(xch, sites);
+
+    if ( !rc )
+        *nr = sysctl.u.xmalloc_op.nr_elem;
+
+    return rc;
+}
+
 int xc_getcpuinfo(xc_interface *xch, int max_cpus,
                   xc_cpuinfo_t *info, int *nr_cpus)
 {
@@ -310,6 +310,20 @@
  */
 #define LIBXL_HAVE_SCHED_CREDIT2_PARAMS 1
 
+/*
+ * LIBXL_HAVE_SCHED_CREDIT2_STATS indicates the existance of the
+ * libxl_sched_credit2_stats_get() function, returning the load balancing
+ * statistics of the runqueues of a Credit2 cpupool.
+ */
+#define LIBXL_HAVE_SCHED_CREDIT2_STATS 1
+
+/*
+ * LIBXL_HAVE_VCPU_SCHED_LATENCY indicates the existance of the
+ * libxl_list_vcpu_sched_latency() function, returning the wake-to-run and
+ * preemption latency histograms and the steal time of each vcpu of a domain.
+ */
+#define LIBXL_HAVE_VCPU_SCHED_LATENCY 1
+
 /*
  * LIBXL_HAVE_SCHED_CREDIT_MIGR_DELAY indicates that there is a field
  * in libxl_sched_credit_params called vcpu_migr_delay_us which controls
@@ -1878,6 +1892,11 @@ void libxl_numainfo_list_free(libxl_numainfo *, int nr);
 libxl_vcpuinfo *libxl_list_vcpu(libxl_ctx *ctx, uint32_t domid,
                                 int *nb_vcpu, int *nr_cpus_out);
 void libxl_vcpuinfo_list_free(libxl_vcpuinfo *, int nr_vcpus);
+libxl_vcpu_sched_latency *libxl_list_vcpu_sched_latency(libxl_ctx *ctx,
+                                                        uint32_t domid,
+                                                        int *nb_vcpu);
+void libxl_vcpu_sched_latency_list_free(libxl_vcpu_sched_latency *,
+                                        int nr_vcpus);
 
 /*
  * Devices
@@ -2432,6 +2451,10 @@ int libxl_sched_credit2_params_get(libxl_ctx *ctx, uint32_t poolid,
                                    libxl_sched_credit2_params *scinfo);
 int libxl_sched_credit2_params_set(libxl_ctx *ctx, uint32_t poolid,
                                    libxl_sched_credit2_params *scinfo);
+libxl_sched_credit2_runqueue_stats *libxl_sched_credit2_stats_get(
+    libxl_ctx *ctx, uint32_t poolid, int *nb_runqueue_out);
+void libxl_sched_credit2_runqueue_stats_list_free(
+    libxl_sched_credit2_runqueue_stats *list, int nb_runqueue);
 
 /* Scheduler Per-domain parameters */
 
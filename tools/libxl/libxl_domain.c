@@ -1481,6 +1481,67 @@ err:
     return NULL;
 }
 
+static void sched_latency_hist_copy(libxl__gc *gc,
+                                    libxl_sched_latency_hist *dst,
+                                    const xen_sysctl_sched_lat_hist_t *src)
+{
+    int i;
+
+    dst->count = src->count;
+    dst->total_ns = src->total;
+    dst->max_ns = src->max;
+    dst->num_buckets = XEN_SYSCTL_SCHED_LAT_BUCKETS;
+    dst->buckets = libxl__calloc(NOGC, dst->num_buckets,
+                                 sizeof(*dst->buckets));
+    for (i = 0; i < dst->num_buckets; i++)
+        dst->buckets[i] = src->bucket[i];
+}
+
+libxl_vcpu_sched_latency *libxl_list_vcpu_sched_latency(libxl_ctx *ctx,
+                                                        uint32_t domid,
+                                                        int *nb_vcpu)
+{
+    GC_INIT(ctx);
+    xc_vcpu_sched_latency_t *info;
+    libxl_vcpu_sched_latency *ret = NULL;
+    unsigned int i, nr = 0;
+
+    /* Passing no buffer makes the call return the number of vcpus. */
+    if (xc_vcpu_sched_latency_get(ctx->xch, domid, &nr, NULL)) {
+        LOGED(ERROR, domid, "Unable to determine number of vcpus");
+        goto out;
+    }
+
+    info = libxl__zalloc(gc, sizeof(*info) * nr);
+
+    if (xc_vcpu_sched_latency_get(ctx->xch, domid, &nr, info)) {
+        LOGED(ERROR, domid, "Getting vcpu scheduling latency");
+        goto out;
+    }
+
+    ret = libxl__zalloc(NOGC, sizeof(*ret) * nr);
+
+    for (i = 0; i < nr; i++) {
+        libxl_vcpu_sched_latency_init(&ret[i]);
+        ret[i].vcpuid = info[i].vcpu;
+        sched_latency_hist_copy(gc, &ret[i].wake,
+                                &info[i].lat[XEN_SYSCTL_SCHED_LAT_wake]);
+        sched_latency_hist_copy(gc, &ret[i].preempt,
+                                &info[i].lat[XEN_SYSCTL_SCHED_LAT_preempt]);
+        ret[i].steal_wake_ns = info[i].steal[XEN_SYSCTL_SCHED_STEAL_wake];
+        ret[i].steal_preempt_ns =
+            info[i].steal[XEN_SYSCTL_SCHED_STEAL_preempt];
+        ret[i].steal_offline_ns =
+            info[i].steal[XEN_SYSCTL_SCHED_STEAL_offline];
+    }
+
+    *nb_vcpu = nr;
+
+ out:
+    GC_FREE;
+    return ret;
+}
+
 static int libxl__set_vcpuonline_xenstore(libxl__gc *gc, uint32_t domid,
                                           const libxl_bitmap *cpumap,
                                           const libxl_dominfo *info)
@@ -399,6 +399,55 @@ int libxl_sched_credit2_params_set(libxl_ctx *ctx, uint32_t poolid,
     return rc;
 }
 
+libxl_sched_credit2_runqueue_stats *libxl_sched_credit2_stats_get(
+    libxl_ctx *ctx, uint32_t poolid, int *nb_runqueue_out)
+{
+    GC_INIT(ctx);
+    xc_credit2_runqueue_stats_t *stats;
+    libxl_sched_credit2_runqueue_stats *ret = NULL;
+    unsigned int i, nr = 0, nr_alloc, shift;
+
+    /* Passing no buffer makes the call return the number of runqueues. */
+    if (xc_sched_credit2_stats_get(ctx->xch, poolid, &nr, NULL, NULL)) {
+        LOGE(ERROR, "Unable to determine number of Credit2 runqueues");
+        goto out;
+    }
+
+    nr_alloc = nr;
+    stats = libxl__zalloc(gc, sizeof(*stats) * nr_alloc);
+
+    /* Runqueues may have come or gone in between: only use what was filled. */
+    if (xc_sched_credit2_stats_get(ctx->xch, poolid, &nr, stats, &shift)) {
+        LOGE(ERROR, "getting Credit2 scheduler statistics");
+        goto out;
+    }
+    if (nr > nr_alloc)
+        nr = nr_alloc;
+
+    ret = libxl__zalloc(NOGC, sizeof(*ret) * nr);
+
+    for (i = 0; i < nr; i++) {
+        libxl_sched_credit2_runqueue_stats_init(&ret[i]);
+        ret[i].id = stats[i].id;
+        ret[i].nr_cpus = stats[i].nr_cpus;
+        ret[i].avgload = (stats[i].avgload * 100) >> shift;
+        ret[i].b_avgload = (stats[i].b_avgload * 100) >> shift;
+        ret[i].balance_interval_us = stats[i].balance_interval / 1000;
+        ret[i].balance_checks = stats[i].balance_checks;
+        ret[i].balance_skipped = stats[i].balance_skipped;
+        ret[i].balance_attempts = stats[i].balance_attempts;
+        ret[i].candidates = stats[i].candidates;
+        ret[i].migrations_push = stats[i].migrations_push;
+        ret[i].migrations_pull = stats[i].migrations_pull;
+    }
+
+    *nb_runqueue_out = nr;
+
+ out:
+    GC_FREE;
+    return ret;
+}
+
 static int sched_credit2_domain_get(libxl__gc *gc, uint32_t domid,
                                     libxl_domain_sched_params *scinfo)
 {
@@ -1036,6 +1036,15 @@ void libxl_cputopology_list_free(libxl_cputopology *list, int nr)
     free(list);
 }
 
+void libxl_sched_credit2_runqueue_stats_list_free(
+    libxl_sched_credit2_runqueue_stats *list, int nr)
+{
+    int i;
+    for (i = 0; i < nr; i++)
+        libxl_sched_credit2_runqueue_stats_dispose(&list[i]);
+    free(list);
+}
+
 void libxl_pcitopology_list_free(libxl_pcitopology *list, int nr)
 {
     int i;
@@ -1060,6 +1069,14 @@ void libxl_vcpuinfo_list_free(libxl_vcpuinfo *list, int nr)
     free(list);
 }
 
+void libxl_vcpu_sched_latency_list_free(libxl_vcpu_sched_latency *list, int nr)
+{
+    int i;
+    for (i = 0; i < nr; i++)
+        libxl_vcpu_sched_latency_dispose(&list[i]);
+    free(list);
+}
+
 int libxl__sendmsg_fds(libxl__gc *gc, int carrier,
                        const char data,
                        int nfds, const int fds[], const char *what) {
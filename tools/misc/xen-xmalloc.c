@@ -0,0 +1,170 @@
+/*
+ * xen-xmalloc: show statistics of the hypervisor's xmalloc() heap.
+ *
+ * Without arguments, the pool's usage and the per-CPU object caches' hit
+ * rates by size class are shown.  With -s, allocations are shown by call
+ * site instead, which requires booting Xen with "xmalloc-sites".
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <xenctrl.h>
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-s [-n count]]\n"
+            "  no args: show pool usage and object cache statistics\n"
+            "  -s     : show allocations by call site, by live bytes\n"
+            "  -n     : show only the top count call sites\n",
+            prog);
+    exit(1);
+}
+
+static int show_classes(xc_interface *xch)
+{
+    xc_xmalloc_class_t *classes = NULL;
+    uint64_t used, total;
+    uint32_t i, nr = 0;
+
+    if ( xc_xmalloc_classes(xch, &nr, NULL, &used, &total) )
+        err(1, "xc_xmalloc_classes");
+
+    if ( nr && !(classes = calloc(nr, sizeof(*classes))) )
+        err(1, "calloc");
+
+    if ( xc_xmalloc_classes(xch, &nr, classes, &used, &total) )
+        err(1, "xc_xmalloc_classes");
+
+    printf("pool: %"PRIu64" of %"PRIu64" KiB used\n",
+           used >> 10, total >> 10);
+    printf("%6s %8s %16s %16s %8s\n",
+           "size", "cached", "allocs", "frees", "hit%");
+
+    for ( i = 0; i < nr; i++ )
+    {
+        const xc_xmalloc_class_t *c = &classes[i];
+
+        printf("%6u %8u %16"PRIu64" %16"PRIu64" %8.2f\n",
+               c->size, c->cached, c->allocs, c->frees,
+               c->allocs ? c->hits * 100.0 / c->allocs : 0.0);
+    }
+
+    free(classes);
+
+    return 0;
+}
+
+static int cmp_live_bytes(const void *a, const void *b)
+{
+    const xc_xmalloc_site_t *x = a, *y = b;
+
+    if ( x->live_bytes != y->live_bytes )
+        return x->live_bytes < y->live_bytes ? 1 : -1;
+
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+static int show_sites(xc_interface *xch, unsigned long max)
+{
+    xc_xmalloc_site_t *sites = NULL;
+    uint32_t i, nr = 0, want;
+
+    if ( xc_xmalloc_sites(xch, &nr, NULL) )
+    {
+        if ( errno == EOPNOTSUPP )
+            errx(1, "call site statistics need Xen booted with xmalloc-sites");
+        err(1, "xc_xmalloc_sites");
+    }
+
+    /* Leave room for sites showing up in the meantime. */
+    want = nr + 32;
+    if ( !(sites = calloc(want, sizeof(*sites))) )
+        err(1, "calloc");
+
+    nr = want;
+    if ( xc_xmalloc_sites(xch, &nr, sites) )
+        err(1, "xc_xmalloc_sites");
+    if ( nr > want )
+        nr = want;
+
+    qsort(sites, nr, sizeof(*sites), cmp_live_bytes);
+
+    printf("%-40s %12s %14s %10s %14s\n",
+           "site", "allocs", "bytes", "live", "live bytes");
+
+    for ( i = 0; i < nr && i < max; i++ )
+    {
+        const xc_xmalloc_site_t *s = &sites[i];
+        char addr[24];
+
+        if ( !s->name[0] )
+            snprintf(addr, sizeof(addr), "%#"PRIx64, s->addr);
+
+        printf("%-40.40s %12"PRIu64" %14"PRIu64" %10"PRIu64" %14"PRIu64"\n",
+               s->name[0] ? s->name : addr,
+               s->allocs, s->bytes, s->live, s->live_bytes);
+    }
+
+    free(sites);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    xc_interface *xch;
+    unsigned long max = ~0UL;
+    int opt, rc, by_site = 0;
+
+    while ( (opt = getopt(argc, argv, "sn:h")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 's': by_site = 1; break;
+        case 'n': max = strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]);
+        }
+    }
+
+    if ( optind != argc )
+        usage(argv[0]);
+
+    xch = xc_interface_open(0, 0, 0);
+    if ( !xch )
+        err(1, "xc_interface_open");
+
+    rc = by_site ? show_sites(xch, max) : show_classes(xch);
+
+    xc_interface_close(xch);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -17,6 +17,129 @@
 #include <errno.h>
 #include <string.h>
 #include <inttypes.h>
+#include <unistd.h>
+
+static void usage(const char *prog)
+{
+    printf("%s: [-r | -s | -c | -e period [-t threshold]]\n", prog);
+    printf("no args: print lock profile data\n");
+    printf("    -r : reset profile data\n");
+    printf("    -s : print lock sampling data\n");
+    printf("    -c : clear lock sampling data\n");
+    printf("    -e : sample one in period lock acquisitions (0: stop)\n");
+    printf("    -t : log lock holds of at least threshold us (default 100)\n");
+}
+
+static void print_hist(const uint32_t *hist)
+{
+    unsigned int i, last = XEN_SYSCTL_LOCKSAMPLE_BUCKETS - 1;
+
+    while ( last && !hist[last] )
+        last--;
+
+    for ( i = 0; i <= last; i++ )
+    {
+        if ( !hist[i] )
+            continue;
+        if ( i == XEN_SYSCTL_LOCKSAMPLE_BUCKETS - 1 )
+            printf("    >= %9uns: %u\n", 64u << i, hist[i]);
+        else
+            printf("    < %10uns: %u\n", 128u << i, hist[i]);
+    }
+}
+
+static int cmp_wait(const void *a, const void *b)
+{
+    const xc_locksample_lock_t *x = a, *y = b;
+
+    return x->wait_total < y->wait_total ? 1 :
+           x->wait_total > y->wait_total ? -1 : 0;
+}
+
+static int sample_show(xc_interface *xc_handle)
+{
+    xc_locksample_lock_t *locks = NULL;
+    xc_locksample_hold_t *holds = NULL;
+    uint32_t i, n = 0, want, period;
+    uint64_t threshold;
+
+    if ( xc_locksample_locks(xc_handle, &n, NULL, &period, &threshold) != 0 )
+    {
+        fprintf(stderr, "Error getting number of sampled locks: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    want = n + 32;    /* just to be sure */
+    locks = calloc(want, sizeof(*locks));
+    holds = calloc(want, sizeof(*holds));
+    if ( locks == NULL || holds == NULL )
+    {
+        fprintf(stderr, "Could not allocate buffers: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    n = want;
+    if ( xc_locksample_locks(xc_handle, &n, locks, &period, &threshold) != 0 )
+    {
+        fprintf(stderr, "Error getting sampled locks: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+    if ( n > want )
+        n = want;
+
+    if ( period )
+        printf("sampling 1 in %u lock acquisitions, "
+               "logging holds >= %"PRIu64"us\n\n", period, threshold / 1000);
+    else
+        printf("lock sampling is off\n\n");
+
+    qsort(locks, n, sizeof(*locks), cmp_wait);
+
+    for ( i = 0; i < n; i++ )
+    {
+        const xc_locksample_lock_t *l = &locks[i];
+
+        printf("lock %#"PRIx64": sampled:%12"PRIu64" contended:%12"PRIu64"\n",
+               l->addr, l->sampled, l->contended);
+        printf("  wait: total %16"PRIu64"ns max %12"PRIu64"ns\n",
+               l->wait_total, l->wait_max);
+        printf("  hold: total %16"PRIu64"ns max %12"PRIu64"ns by %s\n",
+               l->hold_total, l->hold_max,
+               l->hold_max_site_name[0] ? l->hold_max_site_name : "?");
+        if ( l->contended )
+            print_hist(l->wait_hist);
+    }
+
+    n = want;
+    if ( xc_locksample_holds(xc_handle, &n, holds) != 0 )
+    {
+        fprintf(stderr, "Error getting long lock holds: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+    if ( n > want )
+        n = want;
+
+    if ( n )
+        printf("\nlong lock holds:\n");
+    for ( i = 0; i < n; i++ )
+    {
+        const xc_locksample_hold_t *h = &holds[i];
+
+        printf("%20.9fs cpu%-4u lock %#"PRIx64" held %12"PRIu64"ns "
+               "(waited %12"PRIu64"ns) by %s\n",
+               (double)h->when / 1E+09, h->cpu, h->lock, h->hold, h->wait,
+               h->site_name[0] ? h->site_name : "?");
+    }
+
+    free(holds);
+    free(locks);
+
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -26,12 +149,25 @@ int main(int argc, char *argv[])
     double             l, b, sl, sb;
     char               name[100];
     DECLARE_HYPERCALL_BUFFER(xc_lockprof_data_t, data);
+    int                opt, reset = 0, show = 0, clear = 0, enable = 0;
+    unsigned long      period = 0, threshold = 100;
+
+    while ( (opt = getopt(argc, argv, "rsce:t:")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'r': reset = 1; break;
+        case 's': show = 1; break;
+        case 'c': clear = 1; break;
+        case 'e': enable = 1; period = strtoul(optarg, NULL, 0); break;
+        case 't': threshold = strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
 
-    if ( (argc > 2) || ((argc == 2) && (strcmp(argv[1], "-r") != 0)) )
+    if ( optind != argc || reset + show + clear + enable > 1 )
     {
-        printf("%s: [-r]\n", argv[0]);
-        printf("no args: print lock profile data\n");
-        printf("    -r : reset profile data\n");
+        usage(argv[0]);
         return 1;
     }
 
@@ -42,7 +178,33 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    if ( argc > 1 )
+    if ( show )
+        return sample_show(xc_handle);
+
+    if ( clear )
+    {
+        if ( xc_locksample_reset(xc_handle) != 0 )
+        {
+            fprintf(stderr, "Error clearing sampling data: %d (%s)\n",
+                    errno, strerror(errno));
+            return 1;
+        }
+        return 0;
+    }
+
+    if ( enable )
+    {
+        if ( xc_locksample_enable(xc_handle, period,
+                                  threshold * 1000ULL) != 0 )
+        {
+            fprintf(stderr, "Error setting up lock sampling: %d (%s)\n",
+                    errno, strerror(errno));
+            return 1;
+        }
+        return 0;
+    }
+
+    if ( reset )
     {
         if ( xc_lockprof_reset(xc_handle) != 0 )
         {
@@ -0,0 +1,619 @@
+/*
+ * argo-bench.c
+ *
+ * Argo throughput and latency benchmark between two domains.
+ *
+ * Run one instance in each of two HVM or PVH guests, one of them receiving:
+ *
+ *   domA# argo-bench -r -d <domB>
+ *   domB# argo-bench -d <domA> -s 65536 -n 100000 [-b 16 | -g] [-l]
+ *
+ * Each side registers a ring for its peer and polls it from userspace, so no
+ * Argo driver is needed in either guest.  The guest frames of the rings are
+ * looked up in /proc/self/pagemap, which needs root and rules out PV guests.
+ * A full destination ring is handled by retrying the send.
+ *
+ * With -N, argo-bench instead times XEN_ARGO_OP_notify while registering
+ * more and more idle rings, up to the number given, to show how the cost of
+ * a notify grows with the number of rings a domain owns.
+ *
+ * Messages are sent with one XEN_ARGO_OP_sendv each, in batches with
+ * XEN_ARGO_OP_sendv_batch (-b), or by grant reference with
+ * XEN_ARGO_OP_sendv_grants (-g).  In the last case the sender grants a fixed
+ * set of pages to the receiver once and names them in every message, and Xen
+ * copies the data from these pages into the receiver's ring.  The receiver
+ * sees the same messages in all modes.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xencall.h>
+#include <xengnttab.h>
+
+#include <xen/xen.h>
+#include <xen/argo.h>
+
+#define PAGE_SIZE        4096UL
+#define DEFAULT_PORT     0x4b42
+#define ROUNDUP_MSG(x)   (((x) + XEN_ARGO_MSG_SLOT_SIZE - 1) & \
+                          ~(XEN_ARGO_MSG_SLOT_SIZE - 1))
+
+/* Message types exchanged by the two sides. */
+#define MSG_DATA         1  /* payload, no answer */
+#define MSG_PING         2  /* payload, answered with MSG_PONG */
+#define MSG_PONG         3
+#define MSG_END          4  /* end of a run, answered with MSG_PONG */
+
+struct ring {
+    xen_argo_port_t aport;
+    xen_argo_ring_t *hdr;
+    unsigned int len;
+    unsigned int npages;
+};
+
+static xencall_handle *xcall;
+static xengntshr_handle *xgs;
+
+static domid_t peer;
+static xen_argo_port_t port = DEFAULT_PORT;
+static unsigned int ring_kib = 1024;
+static unsigned int msg_size = 4096;
+static unsigned long nr_msgs = 100000;
+static unsigned int batch, notify_rings;
+static bool grants, latency, receiver;
+
+static volatile sig_atomic_t stop;
+
+/* Hypercall arguments, in memory suitable for hypercalls. */
+static xen_argo_send_addr_t *send_addr;
+static xen_argo_iov_t *iovs;
+static xen_argo_send_ent_t *ents;
+static xen_argo_grant_seg_t *segs;
+static void *payload;
+static unsigned int nr_segs;
+
+static struct ring rx_ring;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: argo-bench [options] -d <peer domid>\n"
+            "  -r          receive and answer messages from the peer\n"
+            "  -p <port>   Argo port of both rings (default %#x)\n"
+            "  -R <KiB>    ring size (default %u)\n"
+            "  -s <bytes>  message size (default %u)\n"
+            "  -n <count>  number of messages (default %lu)\n"
+            "  -b <n>      send n messages per XEN_ARGO_OP_sendv_batch\n"
+            "  -g          send by grant reference (XEN_ARGO_OP_sendv_grants)\n"
+            "  -l          measure round trip latency, not throughput\n"
+            "  -N <rings>  measure notify latency with up to this many rings\n",
+            DEFAULT_PORT, ring_kib, msg_size, nr_msgs);
+    exit(2);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int argo_op(unsigned int cmd, void *arg1, void *arg2,
+                   unsigned long arg3, unsigned long arg4)
+{
+    return xencall5(xcall, __HYPERVISOR_argo_op, cmd, (uintptr_t)arg1,
+                    (uintptr_t)arg2, arg3, arg4);
+}
+
+static int virt_to_gfn(const void *va, xen_argo_gfn_t *gfn)
+{
+    static int fd = -1;
+    uint64_t ent;
+
+    if ( fd < 0 && (fd = open("/proc/self/pagemap", O_RDONLY)) < 0 )
+        return -1;
+
+    if ( pread(fd, &ent, sizeof(ent),
+               ((uintptr_t)va / PAGE_SIZE) * sizeof(ent)) != sizeof(ent) )
+        return -1;
+
+    /* Bit 63: page present, bits 0-54: frame number, zero unless root. */
+    *gfn = ent & ((1ULL << 55) - 1);
+    if ( !(ent & (1ULL << 63)) || !*gfn )
+    {
+        errno = EPERM;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int ring_register(struct ring *r, xen_argo_port_t aport,
+                         unsigned int kib)
+{
+    xen_argo_register_ring_t *reg;
+    xen_argo_gfn_t *gfns;
+    unsigned int i;
+    int rc = -1;
+
+    r->aport = aport;
+    r->npages = (kib * 1024UL + PAGE_SIZE - 1) / PAGE_SIZE;
+    r->len = r->npages * PAGE_SIZE - sizeof(xen_argo_ring_t);
+    r->hdr = xencall_alloc_buffer_pages(xcall, r->npages);
+    reg = xencall_alloc_buffer(xcall, sizeof(*reg));
+    gfns = xencall_alloc_buffer(xcall, r->npages * sizeof(*gfns));
+    if ( !r->hdr || !reg || !gfns )
+        goto out;
+
+    memset(r->hdr, 0, r->npages * PAGE_SIZE);
+
+    for ( i = 0; i < r->npages; i++ )
+        if ( virt_to_gfn((void *)r->hdr + i * PAGE_SIZE, &gfns[i]) )
+        {
+            perror("pagemap");
+            goto out;
+        }
+
+    reg->aport = r->aport;
+    reg->partner_id = peer;
+    reg->pad = 0;
+    reg->len = r->len;
+
+    rc = argo_op(XEN_ARGO_OP_register_ring, reg, gfns, r->npages, 0);
+    if ( rc < 0 )
+        perror("XEN_ARGO_OP_register_ring");
+
+ out:
+    xencall_free_buffer(xcall, gfns);
+    xencall_free_buffer(xcall, reg);
+
+    return rc;
+}
+
+static void ring_unregister(struct ring *r)
+{
+    xen_argo_unregister_ring_t *unreg = xencall_alloc_buffer(xcall,
+                                                             sizeof(*unreg));
+
+    if ( !unreg )
+        return;
+
+    unreg->aport = r->aport;
+    unreg->partner_id = peer;
+    unreg->pad = 0;
+
+    if ( argo_op(XEN_ARGO_OP_unregister_ring, unreg, NULL, 0, 0) < 0 )
+        perror("XEN_ARGO_OP_unregister_ring");
+    else
+        xencall_free_buffer_pages(xcall, r->hdr, r->npages);
+
+    xencall_free_buffer(xcall, unreg);
+}
+
+/* Copy n bytes out of the ring starting at off, handling the wrap. */
+static void ring_copy(const struct ring *r, unsigned int off, void *dst,
+                      unsigned int n)
+{
+    unsigned int head = n < r->len - off ? n : r->len - off;
+
+    memcpy(dst, r->hdr->ring + off, head);
+    memcpy(dst + head, r->hdr->ring, n - head);
+}
+
+/*
+ * Take the next message off the ring.  Copies up to buflen bytes of its data
+ * into buf and returns the full data length, or -1 if the ring is empty.
+ */
+static int ring_recv(struct ring *r, struct xen_argo_ring_message_header *mh,
+                     void *buf, unsigned int buflen)
+{
+    uint32_t rx = r->hdr->rx_ptr;
+    uint32_t tx = __atomic_load_n(&r->hdr->tx_ptr, __ATOMIC_ACQUIRE);
+    unsigned int len;
+
+    if ( rx == tx )
+        return -1;
+
+    ring_copy(r, rx, mh, sizeof(*mh));
+    len = mh->len - sizeof(*mh);
+    ring_copy(r, (rx + sizeof(*mh)) % r->len, buf,
+              len < buflen ? len : buflen);
+
+    __atomic_store_n(&r->hdr->rx_ptr, (rx + ROUNDUP_MSG(mh->len)) % r->len,
+                     __ATOMIC_RELEASE);
+
+    return len;
+}
+
+static void wait_pong(void *buf)
+{
+    struct xen_argo_ring_message_header mh;
+
+    while ( !stop )
+        if ( ring_recv(&rx_ring, &mh, buf, PAGE_SIZE) >= 0 &&
+             mh.message_type == MSG_PONG )
+            return;
+}
+
+/* Send one message of len bytes, retrying while the peer's ring is full. */
+static int send_msg(uint32_t type, unsigned int len)
+{
+    int rc;
+
+    iovs[0].iov_hnd.p = payload;
+    iovs[0].iov_len = len;
+    iovs[0].pad = 0;
+
+    do {
+        if ( grants && (type == MSG_DATA || type == MSG_PING) )
+            rc = argo_op(XEN_ARGO_OP_sendv_grants, send_addr, segs, nr_segs,
+                         type);
+        else
+            rc = argo_op(XEN_ARGO_OP_sendv, send_addr, iovs, !!len, type);
+    } while ( rc < 0 && errno == EAGAIN && !stop && !sched_yield() );
+
+    if ( rc < 0 && !stop )
+        perror("send");
+
+    return rc;
+}
+
+/* Send up to n messages in one batch, returns the number sent. */
+static int send_batch(unsigned int n)
+{
+    unsigned int i;
+    int rc;
+
+    iovs[0].iov_hnd.p = payload;
+    iovs[0].iov_len = msg_size;
+    iovs[0].pad = 0;
+
+    for ( i = 0; i < n; i++ )
+    {
+        ents[i].addr = *send_addr;
+        ents[i].iov_idx = 0;
+        ents[i].niov = 1;
+        ents[i].message_type = MSG_DATA;
+        ents[i].status = 0;
+    }
+
+    rc = argo_op(XEN_ARGO_OP_sendv_batch, ents, iovs, n, 1);
+    if ( rc < 0 )
+        perror("XEN_ARGO_OP_sendv_batch");
+    else if ( !rc )
+        sched_yield();
+
+    return rc;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int run_sender(void)
+{
+    void *buf = malloc(PAGE_SIZE);
+    uint64_t start, ns;
+    unsigned long sent = 0;
+
+    if ( !buf )
+        return 1;
+
+    memset(payload, 0xa5, msg_size);
+
+    if ( latency )
+    {
+        uint64_t *rtt = calloc(nr_msgs, sizeof(*rtt)), sum = 0;
+
+        if ( !rtt )
+            return 1;
+
+        for ( ; sent < nr_msgs && !stop; sent++ )
+        {
+            start = now_ns();
+            if ( send_msg(MSG_PING, msg_size) < 0 )
+                break;
+            wait_pong(buf);
+            rtt[sent] = now_ns() - start;
+            sum += rtt[sent];
+        }
+
+        send_msg(MSG_END, 0);
+        wait_pong(buf);
+
+        if ( !sent )
+            return 1;
+
+        qsort(rtt, sent, sizeof(*rtt), cmp_u64);
+        printf("%u bytes, %lu round trips: min %"PRIu64" avg %"PRIu64
+               " p50 %"PRIu64" p99 %"PRIu64" max %"PRIu64" ns\n",
+               msg_size, sent, rtt[0], sum / sent, rtt[sent / 2],
+               rtt[sent * 99 / 100], rtt[sent - 1]);
+        free(rtt);
+
+        return sent == nr_msgs ? 0 : 1;
+    }
+
+    start = now_ns();
+
+    while ( sent < nr_msgs && !stop )
+    {
+        int rc;
+
+        if ( batch )
+            rc = send_batch(nr_msgs - sent < batch ? nr_msgs - sent : batch);
+        else
+            rc = send_msg(MSG_DATA, msg_size) < 0 ? -1 : 1;
+
+        if ( rc < 0 )
+            break;
+        sent += rc;
+    }
+
+    /* The answer to MSG_END tells that the peer has drained its ring. */
+    send_msg(MSG_END, 0);
+    wait_pong(buf);
+
+    ns = now_ns() - start;
+    printf("%u bytes x %lu messages in %"PRIu64" us: %.0f msg/s, %.1f MiB/s\n",
+           msg_size, sent, ns / 1000, sent * 1e9 / ns,
+           (double)sent * msg_size * 1e9 / ns / (1 << 20));
+
+    free(buf);
+
+    return sent == nr_msgs ? 0 : 1;
+}
+
+/* Time notify calls while the domain owns 1, 2, 4... notify_rings rings. */
+static int run_notify(void)
+{
+    struct ring *rings = calloc(notify_rings, sizeof(*rings));
+    unsigned int n = 0, target;
+    unsigned long i;
+    int rc = 0;
+
+    if ( !rings )
+        return 1;
+
+    for ( target = 1; !rc && n < notify_rings && !stop; target *= 2 )
+    {
+        uint64_t start;
+
+        if ( target > notify_rings )
+            target = notify_rings;
+
+        for ( ; n < target; n++ )
+            if ( ring_register(&rings[n], port + 1 + n, 4) < 0 )
+            {
+                rc = 1;
+                break;
+            }
+        if ( rc )
+            break;
+
+        start = now_ns();
+        for ( i = 0; i < nr_msgs; i++ )
+            if ( argo_op(XEN_ARGO_OP_notify, NULL, NULL, 0, 0) < 0 )
+            {
+                perror("XEN_ARGO_OP_notify");
+                rc = 1;
+                break;
+            }
+
+        if ( !rc )
+            printf("%4u rings: %"PRIu64" ns per notify\n", n,
+                   (now_ns() - start) / nr_msgs);
+    }
+
+    while ( n-- )
+        ring_unregister(&rings[n]);
+    free(rings);
+
+    return rc;
+}
+
+static int run_receiver(void)
+{
+    struct xen_argo_ring_message_header mh;
+    unsigned int buflen = rx_ring.len;
+    void *buf = malloc(buflen);
+    unsigned long msgs = 0, bytes = 0;
+    uint64_t start = 0;
+
+    if ( !buf )
+        return 1;
+
+    while ( !stop )
+    {
+        int len = ring_recv(&rx_ring, &mh, buf, buflen);
+
+        if ( len < 0 )
+            continue;
+
+        if ( !msgs++ )
+            start = now_ns();
+        bytes += len;
+
+        switch ( mh.message_type )
+        {
+        case MSG_PING:
+            send_msg(MSG_PONG, 0);
+            break;
+
+        case MSG_END:
+            send_msg(MSG_PONG, 0);
+            printf("received %lu messages, %lu bytes in %"PRIu64" us\n",
+                   msgs - 1, bytes, (now_ns() - start) / 1000);
+            msgs = bytes = 0;
+            break;
+        }
+    }
+
+    free(buf);
+
+    return 0;
+}
+
+static void sigint(int sig)
+{
+    stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int i;
+    int opt, rc = 1;
+    bool have_peer = false;
+
+    while ( (opt = getopt(argc, argv, "rd:p:R:s:n:b:glN:")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'r': receiver = true; break;
+        case 'd': peer = strtoul(optarg, NULL, 0); have_peer = true; break;
+        case 'p': port = strtoul(optarg, NULL, 0); break;
+        case 'R': ring_kib = strtoul(optarg, NULL, 0); break;
+        case 's': msg_size = strtoul(optarg, NULL, 0); break;
+        case 'n': nr_msgs = strtoul(optarg, NULL, 0); break;
+        case 'b': batch = strtoul(optarg, NULL, 0); break;
+        case 'g': grants = true; break;
+        case 'l': latency = true; break;
+        case 'N': notify_rings = strtoul(optarg, NULL, 0); break;
+        default: usage();
+        }
+    }
+
+    if ( !have_peer || !ring_kib || !msg_size ||
+         batch > XEN_ARGO_MAX_SEND_BATCH || (batch && (grants || latency)) )
+        usage();
+
+    if ( grants && msg_size > XEN_ARGO_MAX_GRANT_SEGS * PAGE_SIZE )
+    {
+        fprintf(stderr, "messages sent by grant are at most %lu bytes\n",
+                XEN_ARGO_MAX_GRANT_SEGS * PAGE_SIZE);
+        return 2;
+    }
+
+    signal(SIGINT, sigint);
+    signal(SIGTERM, sigint);
+
+    xcall = xencall_open(NULL, 0);
+    if ( !xcall )
+    {
+        perror("xencall_open");
+        return 1;
+    }
+
+    if ( grants && !(xgs = xengntshr_open(NULL, 0)) )
+    {
+        perror("xengntshr_open");
+        goto out;
+    }
+
+    if ( notify_rings )
+    {
+        rc = run_notify();
+        goto out;
+    }
+
+    send_addr = xencall_alloc_buffer(xcall, sizeof(*send_addr));
+    iovs = xencall_alloc_buffer(xcall, sizeof(*iovs));
+    ents = xencall_alloc_buffer(xcall, XEN_ARGO_MAX_SEND_BATCH *
+                                       sizeof(*ents));
+    segs = xencall_alloc_buffer(xcall, XEN_ARGO_MAX_GRANT_SEGS *
+                                       sizeof(*segs));
+    if ( !send_addr || !iovs || !ents || !segs )
+    {
+        perror("xencall_alloc_buffer");
+        goto out;
+    }
+
+    send_addr->src.aport = port;
+    send_addr->src.domain_id = XEN_ARGO_DOMID_ANY;
+    send_addr->src.pad = 0;
+    send_addr->dst.aport = port;
+    send_addr->dst.domain_id = peer;
+    send_addr->dst.pad = 0;
+
+    if ( grants )
+    {
+        uint32_t refs[XEN_ARGO_MAX_GRANT_SEGS];
+
+        nr_segs = (msg_size + PAGE_SIZE - 1) / PAGE_SIZE;
+        payload = xengntshr_share_pages(xgs, peer, nr_segs, refs, 0);
+        if ( !payload )
+        {
+            perror("xengntshr_share_pages");
+            goto out;
+        }
+
+        for ( i = 0; i < nr_segs; i++ )
+        {
+            segs[i].gref = refs[i];
+            segs[i].offset = 0;
+            segs[i].len = i + 1 < nr_segs ? PAGE_SIZE
+                                          : msg_size - i * PAGE_SIZE;
+            segs[i].pad = 0;
+        }
+    }
+    else
+    {
+        payload = xencall_alloc_buffer(xcall, msg_size);
+        if ( !payload )
+        {
+            perror("xencall_alloc_buffer");
+            goto out;
+        }
+    }
+
+    if ( ring_register(&rx_ring, port, ring_kib) < 0 )
+        goto out;
+
+    rc = receiver ? run_receiver() : run_sender();
+
+    ring_unregister(&rx_ring);
+
+ out:
+    if ( xgs )
+        xengntshr_close(xgs);
+    xencall_close(xcall);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
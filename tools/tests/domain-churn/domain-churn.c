@@ -0,0 +1,390 @@
+/*
+ * domain-churn: time domain creation and destruction at scale.
+ *
+ * Worker threads each create a share of the domains, populate their memory
+ * with populate_physmap and, once all domains exist, destroy them again, so
+ * that many pCPUs hammer the heap allocator at the same time.  The domains
+ * are never built nor run.
+ *
+ * With -p, a further thread polls the teardown progress of the domains being
+ * destroyed, to report how much of their memory was freed by the helper CPUs
+ * of the parallel teardown engine.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xenctrl.h>
+
+#define EXTENTS_PER_CALL 1024
+
+static unsigned int nr_domains = 16, nr_threads = 4, iterations = 1;
+static unsigned int extent_order;
+static unsigned long mem_mb = 64;
+static bool hvm, poll_progress;
+
+static pthread_barrier_t barrier;
+static volatile bool stop_monitor;
+
+struct worker {
+    pthread_t thread;
+    xc_interface *xch;
+    uint32_t *domids;
+    unsigned int nr;
+    int rc;
+    uint64_t create_ns, destroy_ns;     /* Per iteration, summed. */
+    uint64_t create_max_ns, destroy_max_ns;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int create_one(xc_interface *xch, uint32_t *domid, xen_pfn_t *pfns)
+{
+    struct xen_domctl_createdomain config = {
+        .max_vcpus = 1,
+        .max_evtchn_port = -1,
+        .max_grant_frames = 1,
+        .max_maptrack_frames = 0,
+    };
+    unsigned long nr_extents = (mem_mb << (20 - XC_PAGE_SHIFT)) >> extent_order;
+    unsigned long done, i;
+    int rc;
+
+    if ( hvm )
+    {
+        config.flags = XEN_DOMCTL_CDF_hvm | XEN_DOMCTL_CDF_hap;
+        config.arch.emulation_flags = XEN_X86_EMU_LAPIC;
+    }
+
+    *domid = 0;
+    rc = xc_domain_create(xch, domid, &config);
+    if ( rc )
+    {
+        perror("xc_domain_create");
+        return rc;
+    }
+
+    rc = xc_domain_max_vcpus(xch, *domid, config.max_vcpus);
+    if ( !rc )
+        rc = xc_domain_setmaxmem(xch, *domid, (mem_mb + 1) << 10);
+    if ( rc )
+    {
+        perror("domain setup");
+        return rc;
+    }
+
+    for ( done = 0; done < nr_extents; done += EXTENTS_PER_CALL )
+    {
+        unsigned long nr = nr_extents - done;
+
+        if ( nr > EXTENTS_PER_CALL )
+            nr = EXTENTS_PER_CALL;
+
+        for ( i = 0; i < nr; i++ )
+            pfns[i] = (done + i) << extent_order;
+
+        rc = xc_domain_populate_physmap_exact(xch, *domid, nr, extent_order,
+                                              0, pfns);
+        if ( rc )
+        {
+            perror("xc_domain_populate_physmap_exact");
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+static void *worker_fn(void *arg)
+{
+    struct worker *w = arg;
+    xen_pfn_t *pfns = calloc(EXTENTS_PER_CALL, sizeof(*pfns));
+    unsigned int it, i;
+    uint64_t t, t0;
+
+    if ( !pfns )
+    {
+        w->rc = -ENOMEM;
+        goto out;
+    }
+
+    for ( it = 0; it < iterations; it++ )
+    {
+        pthread_barrier_wait(&barrier);
+
+        t0 = now_ns();
+        for ( i = 0; i < w->nr && !w->rc; i++ )
+        {
+            t = now_ns();
+            w->rc = create_one(w->xch, &w->domids[i], pfns);
+            t = now_ns() - t;
+            if ( t > w->create_max_ns )
+                w->create_max_ns = t;
+        }
+        w->create_ns += now_ns() - t0;
+
+        /* Tear down concurrently with everybody else. */
+        pthread_barrier_wait(&barrier);
+
+        t0 = now_ns();
+        for ( i = 0; i < w->nr; i++ )
+        {
+            if ( !w->domids[i] )
+                continue;
+
+            t = now_ns();
+            if ( xc_domain_destroy(w->xch, w->domids[i]) )
+            {
+                perror("xc_domain_destroy");
+                w->rc = -1;
+            }
+            t = now_ns() - t;
+            if ( t > w->destroy_max_ns )
+                w->destroy_max_ns = t;
+            w->domids[i] = 0;
+        }
+        w->destroy_ns += now_ns() - t0;
+
+        pthread_barrier_wait(&barrier);
+    }
+
+ out:
+    free(pfns);
+    return NULL;
+}
+
+/* Sum up the pages freed by teardown helpers, as observed while polling. */
+static void *monitor_fn(void *arg)
+{
+    uint32_t *domids = arg;
+    uint32_t *seen_domid = calloc(nr_domains, sizeof(*seen_domid));
+    uint64_t *seen_freed = calloc(nr_domains, sizeof(*seen_freed));
+    uint64_t *total = malloc(sizeof(*total));
+    xc_interface *xch = xc_interface_open(NULL, NULL, 0);
+    xc_teardown_progress_t p;
+    unsigned int i;
+
+    if ( !seen_domid || !seen_freed || !total || !xch )
+    {
+        fprintf(stderr, "Failed to set up progress monitor\n");
+        goto out;
+    }
+
+    *total = 0;
+    while ( !stop_monitor )
+    {
+        for ( i = 0; i < nr_domains; i++ )
+        {
+            uint32_t domid = domids[i];
+
+            if ( !domid ||
+                 xc_domain_get_teardown_progress(xch, domid, &p) ||
+                 p.state == XEN_DOMCTL_TEARDOWN_none )
+                continue;
+
+            if ( seen_domid[i] != domid )
+            {
+                seen_domid[i] = domid;
+                seen_freed[i] = 0;
+            }
+            if ( p.freed_pages > seen_freed[i] )
+            {
+                *total += p.freed_pages - seen_freed[i];
+                seen_freed[i] = p.freed_pages;
+            }
+        }
+
+        usleep(1000);
+    }
+
+ out:
+    if ( xch )
+        xc_interface_close(xch);
+    free(seen_freed);
+    free(seen_domid);
+
+    return total;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n domains] [-t threads] [-m MiB] [-i iterations]"
+            " [-s|-G] [-H] [-p]\n"
+            "  -n  number of domains (default %u)\n"
+            "  -t  worker threads (default %u)\n"
+            "  -m  memory per domain in MiB (default %lu)\n"
+            "  -i  create/destroy rounds (default %u)\n"
+            "  -s  populate with 2M superpages instead of 4k pages\n"
+            "  -G  populate with 1G superpages instead of 4k pages\n"
+            "  -H  create HVM rather than PV domains\n"
+            "  -p  report memory freed in parallel during destroy\n",
+            prog, nr_domains, nr_threads, mem_mb, iterations);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct worker *workers;
+    pthread_t monitor;
+    uint64_t *helper_pages = NULL;
+    uint32_t *domids;
+    uint64_t create_ns = 0, destroy_ns = 0, create_max = 0, destroy_max = 0;
+    unsigned long total_mb;
+    unsigned int i, first = 0;
+    int opt, rc = 0;
+
+    while ( (opt = getopt(argc, argv, "n:t:m:i:sGHph")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'n': nr_domains = strtoul(optarg, NULL, 0); break;
+        case 't': nr_threads = strtoul(optarg, NULL, 0); break;
+        case 'm': mem_mb = strtoul(optarg, NULL, 0); break;
+        case 'i': iterations = strtoul(optarg, NULL, 0); break;
+        case 's': extent_order = 9; break;
+        case 'G': extent_order = 18; break;
+        case 'H': hvm = true; break;
+        case 'p': poll_progress = true; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    if ( !nr_domains || !nr_threads || !mem_mb || !iterations ||
+         ((mem_mb << (20 - XC_PAGE_SHIFT)) & ((1UL << extent_order) - 1)) )
+        usage(argv[0]);
+    if ( nr_threads > nr_domains )
+        nr_threads = nr_domains;
+
+    workers = calloc(nr_threads, sizeof(*workers));
+    domids = calloc(nr_domains, sizeof(*domids));
+    if ( !workers || !domids )
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    pthread_barrier_init(&barrier, NULL, nr_threads);
+
+    for ( i = 0; i < nr_threads; i++ )
+    {
+        struct worker *w = &workers[i];
+
+        w->nr = nr_domains / nr_threads + (i < nr_domains % nr_threads);
+        w->domids = &domids[first];
+        first += w->nr;
+
+        /* One handle each, so that hypercalls don't serialise in libxc. */
+        w->xch = xc_interface_open(NULL, NULL, 0);
+        if ( !w->xch )
+        {
+            perror("xc_interface_open");
+            return 1;
+        }
+    }
+
+    if ( poll_progress &&
+         pthread_create(&monitor, NULL, monitor_fn, domids) )
+    {
+        perror("pthread_create");
+        return 1;
+    }
+
+    for ( i = 0; i < nr_threads; i++ )
+        if ( pthread_create(&workers[i].thread, NULL, worker_fn, &workers[i]) )
+        {
+            perror("pthread_create");
+            return 1;
+        }
+
+    for ( i = 0; i < nr_threads; i++ )
+    {
+        struct worker *w = &workers[i];
+
+        pthread_join(w->thread, NULL);
+        if ( w->rc )
+            rc = 1;
+
+        /* Threads run in parallel: report the slowest one. */
+        if ( w->create_ns > create_ns )
+            create_ns = w->create_ns;
+        if ( w->destroy_ns > destroy_ns )
+            destroy_ns = w->destroy_ns;
+        if ( w->create_max_ns > create_max )
+            create_max = w->create_max_ns;
+        if ( w->destroy_max_ns > destroy_max )
+            destroy_max = w->destroy_max_ns;
+
+        xc_interface_close(w->xch);
+    }
+
+    if ( poll_progress )
+    {
+        stop_monitor = true;
+        pthread_join(monitor, (void **)&helper_pages);
+    }
+
+    total_mb = mem_mb * nr_domains;
+    create_ns /= iterations;
+    destroy_ns /= iterations;
+
+    printf("%u %s domains x %lu MiB (%s pages), %u threads, %u rounds\n",
+           nr_domains, hvm ? "HVM" : "PV", mem_mb,
+           extent_order ? (extent_order == 9 ? "2M" : "1G") : "4k",
+           nr_threads, iterations);
+    printf("  create:  %8.3f ms/round  %8.1f MiB/s  max %8.3f ms/domain\n",
+           create_ns / 1e6, total_mb / (create_ns / 1e9), create_max / 1e6);
+    printf("  destroy: %8.3f ms/round  %8.1f MiB/s  max %8.3f ms/domain\n",
+           destroy_ns / 1e6, total_mb / (destroy_ns / 1e9), destroy_max / 1e6);
+    if ( helper_pages )
+        printf("  helpers: %8.1f MiB/round freed in parallel (%.1f%%)\n",
+               ((double)*helper_pages / iterations) /
+               (1 << (20 - XC_PAGE_SHIFT)),
+               *helper_pages * 100.0 /
+               ((double)total_mb * iterations * (1 << (20 - XC_PAGE_SHIFT))));
+
+    if ( rc )
+        fprintf(stderr, "Some operations failed, results are incomplete\n");
+
+    free(helper_pages);
+    free(domids);
+    free(workers);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,210 @@
+/*
+ * Emulation of the hypervisor environment needed by common/event_fifo.c.
+ *
+ * Each emulated vCPU has a control block and the domain an event array,
+ * both backed by host memory standing in for guest frames.  vCPU kicks are
+ * only counted, the harness' guest threads poll their control block.  Locks
+ * are spinning locks, pthreads standing in for physical CPUs.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TEST_EVTCHN_FIFO_
+#define _TEST_EVTCHN_FIFO_
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xen/xen.h>
+#include <xen/event_channel.h>
+
+#define barrier()     asm volatile ( "" ::: "memory" )
+#define smp_mb()      __sync_synchronize()
+#define smp_rmb()     barrier()
+#define smp_wmb()     barrier()
+#define cpu_relax()   sched_yield()
+
+#define likely(x)     __builtin_expect(!!(x), 1)
+#define unlikely(x)   __builtin_expect(!!(x), 0)
+
+#define read_atomic(p)       __atomic_load_n(p, __ATOMIC_RELAXED)
+#define write_atomic(p, x)   __atomic_store_n(p, x, __ATOMIC_RELAXED)
+#define xchg(p, x)           __atomic_exchange_n(p, x, __ATOMIC_SEQ_CST)
+#define cmpxchg(p, o, n)     __sync_val_compare_and_swap(p, o, n)
+
+#define array_index_nospec(i, n)    (i)
+
+#define ASSERT(x)              assert(x)
+
+typedef bool bool_t;
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+#define PAGE_SHIFT       12
+#define PAGE_SIZE        (1UL << PAGE_SHIFT)
+#define PAGE_MASK        (~(PAGE_SIZE - 1))
+
+/* Logging, quiet unless enabled by the harness. */
+extern bool verbose;
+
+#define XENLOG_WARNING   ""
+#define XENLOG_G_WARNING ""
+
+#define printk(fmt, args...)  \
+    do { if ( verbose ) printf(fmt, ## args); } while ( 0 )
+#define gprintk(lvl, fmt, args...)  printk(lvl fmt, ## args)
+#define gdprintk(lvl, fmt, args...) printk(lvl fmt, ## args)
+
+/* Guest memory is only ever accessed atomically, as on x86. */
+#define guest_set_bit(d, nr, p)   \
+    ((void)(d), __atomic_fetch_or((uint32_t *)(p), 1U << (nr), \
+                                  __ATOMIC_SEQ_CST))
+#define guest_clear_bit(d, nr, p) \
+    ((void)(d), __atomic_fetch_and((uint32_t *)(p), ~(1U << (nr)), \
+                                   __ATOMIC_SEQ_CST))
+#define guest_test_bit(d, nr, p)  \
+    ((void)(d), !!(read_atomic((uint32_t *)(p)) & (1U << (nr))))
+#define guest_test_and_set_bit(d, nr, p) \
+    ((void)(d), !!(__atomic_fetch_or((uint32_t *)(p), 1U << (nr), \
+                                     __ATOMIC_SEQ_CST) & (1U << (nr))))
+
+/* Locks. */
+typedef struct {
+    int locked;
+} spinlock_t;
+
+#define spin_lock_init(l)   ((l)->locked = 0)
+
+static inline void spin_lock(spinlock_t *l)
+{
+    while ( __atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE) )
+        cpu_relax();
+}
+
+static inline void spin_unlock(spinlock_t *l)
+{
+    __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+#define spin_lock_irqsave(l, f)      ((f) = 0, spin_lock(l))
+#define spin_unlock_irqrestore(l, f) ((void)(f), spin_unlock(l))
+
+/* Memory. */
+#define xzalloc(type)    ((type *)calloc(1, sizeof(type)))
+#define xfree(p)         free(p)
+
+/*
+ * Guest frames are host pages, mapped globally at all times.  Unmapping is
+ * left to the harness, which owns the memory.
+ */
+struct page_info {
+    void *virt;
+};
+
+typedef unsigned long mfn_t;
+
+struct domain;
+
+#define P2M_ALLOC                    0
+#define PGT_writable_page            0
+
+struct page_info *get_page_from_gfn(struct domain *d, unsigned long gfn,
+                                    void *t, unsigned int q);
+
+#define get_page_type(p, t)          ((void)(p), 1)
+#define put_page(p)                  ((void)(p))
+#define put_page_and_type(p)         ((void)(p))
+#define __map_domain_page_global(p)  ((p)->virt)
+#define unmap_domain_page_global(v)  ((void)(v))
+#define domain_page_map_to_mfn(v)    ((mfn_t)0)
+#define mfn_to_page(m)               ((struct page_info *)NULL)
+
+/* Domains, vCPUs and event channels. */
+struct evtchn {
+    u8  pending:1;
+    u16 notify_vcpu_id;
+    u32 port;
+    u8 priority;
+    u8 last_priority;
+    u16 last_vcpu_id;
+    struct evtchn *fifo_next;
+};
+
+struct vcpu {
+    unsigned int vcpu_id;
+    struct domain *domain;
+    struct vcpu *next_in_list;
+    struct evtchn_fifo_vcpu *evtchn_fifo;
+    unsigned long kicks;
+};
+
+struct domain {
+    domid_t domain_id;
+    unsigned int max_vcpus;
+    struct vcpu **vcpu;
+    spinlock_t event_lock;
+    const struct evtchn_port_ops *evtchn_port_ops;
+    struct evtchn *evtchn;
+    unsigned int valid_evtchns;
+    unsigned int max_evtchns;
+    struct evtchn_fifo_domain *evtchn_fifo;
+    xen_ulong_t evtchn_pending[1];
+};
+
+struct evtchn_port_ops {
+    void (*init)(struct domain *d, struct evtchn *evtchn);
+    void (*set_pending)(struct vcpu *v, struct evtchn *evtchn);
+    void (*clear_pending)(struct domain *d, struct evtchn *evtchn);
+    void (*unmask)(struct domain *d, struct evtchn *evtchn);
+    bool (*is_pending)(const struct domain *d, evtchn_port_t port);
+    bool (*is_masked)(const struct domain *d, evtchn_port_t port);
+    bool (*is_busy)(const struct domain *d, evtchn_port_t port);
+    int (*set_priority)(struct domain *d, struct evtchn *evtchn,
+                        unsigned int priority);
+    void (*print_state)(struct domain *d, const struct evtchn *evtchn);
+};
+
+extern __thread struct vcpu *current;
+
+#define for_each_vcpu(d, v)     for ( (v) = (d)->vcpu[0]; (v); \
+                                      (v) = (v)->next_in_list )
+#define domain_vcpu(d, id)      ((id) < (d)->max_vcpus ? (d)->vcpu[id] : NULL)
+#define port_is_valid(d, p)     ((p) < read_atomic(&(d)->valid_evtchns))
+#define evtchn_from_port(d, p)  (&(d)->evtchn[p])
+#define shared_info(d, field)   ((d)->field)
+
+#define vcpu_mark_events_pending(v) \
+    __atomic_fetch_add(&(v)->kicks, 1, __ATOMIC_RELAXED)
+#define evtchn_check_pollers(d, port) ((void)(d), (void)(port))
+
+#include "event_fifo.h"
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
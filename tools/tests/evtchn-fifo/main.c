@@ -0,0 +1,497 @@
+/*
+ * Stress test and benchmark for common/event_fifo.c.
+ *
+ * Sender threads, standing in for physical CPUs running EVTCHNOP_send for
+ * other domains, raise events on ports of a domain whose ports are all
+ * bound to a few vCPUs.  A guest thread per vCPU consumes its queues the way
+ * Linux does.  The throughput of the senders is reported against their
+ * number, and once all events have been consumed every port is checked for
+ * a lost or stray event.  Ports can be moved between vCPUs and priorities
+ * while being raised, to exercise requeueing.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "event_fifo.c"
+
+bool verbose;
+__thread struct vcpu *current;
+
+static __thread uint64_t rnd_state = 0x9e3779b97f4a7c15ULL;
+
+static unsigned int get_random(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 7;
+    rnd_state ^= rnd_state << 17;
+
+    return rnd_state;
+}
+
+/* Guest frames, indexed by gfn. */
+static struct page_info *frames;
+static unsigned int nr_frames;
+
+struct page_info *get_page_from_gfn(struct domain *d, unsigned long gfn,
+                                    void *t, unsigned int q)
+{
+    return gfn < nr_frames ? &frames[gfn] : NULL;
+}
+
+static unsigned long alloc_frame(void)
+{
+    frames = realloc(frames, (nr_frames + 1) * sizeof(*frames));
+    if ( !frames ||
+         posix_memalign(&frames[nr_frames].virt, PAGE_SIZE, PAGE_SIZE) )
+    {
+        perror("alloc_frame");
+        exit(1);
+    }
+    memset(frames[nr_frames].virt, 0, PAGE_SIZE);
+
+    return nr_frames++;
+}
+
+static void free_frames(void)
+{
+    while ( nr_frames )
+        free(frames[--nr_frames].virt);
+    free(frames);
+    frames = NULL;
+}
+
+static struct {
+    unsigned int senders;
+    unsigned int vcpus;
+    unsigned int ports;
+    unsigned long iterations;
+    unsigned int yield;
+    bool move;
+    bool reprioritise;
+} bench = {
+    .senders = 4,
+    .vcpus = 1,
+    .ports = 16,
+    .iterations = 1000000,
+};
+
+static struct domain *create_domain(unsigned int nr_vcpus,
+                                    unsigned int nr_ports)
+{
+    struct domain *d = calloc(1, sizeof(*d));
+    struct vcpu *v;
+    unsigned int i;
+
+    if ( !d )
+        goto nomem;
+
+    d->domain_id = 1;
+    d->max_vcpus = nr_vcpus;
+    d->vcpu = calloc(nr_vcpus, sizeof(*d->vcpu));
+    d->evtchn = calloc(nr_ports, sizeof(*d->evtchn));
+    if ( !d->vcpu || !d->evtchn )
+        goto nomem;
+    spin_lock_init(&d->event_lock);
+
+    for ( i = nr_vcpus; i--; )
+    {
+        v = calloc(1, sizeof(*v));
+        if ( !v )
+            goto nomem;
+        v->vcpu_id = i;
+        v->domain = d;
+        v->next_in_list = i + 1 < nr_vcpus ? d->vcpu[i + 1] : NULL;
+        d->vcpu[i] = v;
+    }
+
+    for ( i = 0; i < nr_vcpus; i++ )
+    {
+        struct evtchn_init_control init = {
+            .control_gfn = alloc_frame(),
+            .vcpu = i,
+        };
+
+        current = d->vcpu[i];
+        if ( evtchn_fifo_init_control(&init) )
+        {
+            fprintf(stderr, "EVTCHNOP_init_control failed\n");
+            exit(1);
+        }
+    }
+
+    while ( d->evtchn_fifo->num_evtchns < nr_ports )
+    {
+        struct evtchn_expand_array expand = {
+            .array_gfn = alloc_frame(),
+        };
+
+        if ( evtchn_fifo_expand_array(&expand) )
+        {
+            fprintf(stderr, "EVTCHNOP_expand_array failed\n");
+            exit(1);
+        }
+    }
+
+    for ( i = 1; i < nr_ports; i++ )
+    {
+        struct evtchn *chn = evtchn_from_port(d, i);
+
+        chn->port = i;
+        chn->notify_vcpu_id = i % nr_vcpus;
+        d->evtchn_port_ops->init(d, chn);
+    }
+    write_atomic(&d->valid_evtchns, nr_ports);
+
+    return d;
+
+ nomem:
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+}
+
+static void destroy_domain(struct domain *d)
+{
+    unsigned int i;
+
+    evtchn_fifo_destroy(d);
+    for ( i = 0; i < d->max_vcpus; i++ )
+        free(d->vcpu[i]);
+    free(d->vcpu);
+    free(d->evtchn);
+    free(d);
+    free_frames();
+}
+
+static struct domain *bench_dom;
+static pthread_barrier_t bench_barrier;
+static bool senders_done;
+static unsigned long failures;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *sender_thread(void *arg)
+{
+    struct domain *d = bench_dom;
+    unsigned int first = 1 + (unsigned long)arg * bench.ports;
+    unsigned long it;
+    uint64_t *ns = malloc(sizeof(*ns));
+
+    rnd_state += (unsigned long)arg * 0x2545f4914f6cdd1dULL;
+
+    pthread_barrier_wait(&bench_barrier);
+
+    *ns = now_ns();
+    for ( it = 0; it < bench.iterations; it++ )
+    {
+        struct evtchn *chn = evtchn_from_port(d, first + it % bench.ports);
+
+        if ( bench.move && !(get_random() % 64) )
+            chn->notify_vcpu_id = get_random() % d->max_vcpus;
+        if ( bench.reprioritise && !(get_random() % 64) )
+            evtchn_fifo_set_priority(d, chn, get_random() %
+                                             (EVTCHN_FIFO_PRIORITY_MIN + 1));
+
+        d->evtchn_port_ops->set_pending(d->vcpu[chn->notify_vcpu_id], chn);
+
+        if ( bench.yield && !(it % bench.yield) )
+            sched_yield();
+    }
+    *ns = now_ns() - *ns;
+
+    return ns;
+}
+
+static event_word_t *guest_word(const struct domain *d, unsigned int port)
+{
+    return d->evtchn_fifo->event_array[port / EVTCHN_FIFO_EVENT_WORDS_PER_PAGE] +
+           port % EVTCHN_FIFO_EVENT_WORDS_PER_PAGE;
+}
+
+/* As done by Linux' FIFO event channel upcall. */
+static uint32_t guest_clear_linked(event_word_t *word)
+{
+    event_word_t new, old, w = read_atomic(word);
+
+    do {
+        old = w;
+        new = w & ~((1 << EVTCHN_FIFO_LINKED) | EVTCHN_FIFO_LINK_MASK);
+    } while ( (w = cmpxchg(word, old, new)) != old );
+
+    return w & EVTCHN_FIFO_LINK_MASK;
+}
+
+static void *guest_thread(void *arg)
+{
+    struct vcpu *v = arg;
+    struct domain *d = v->domain;
+    evtchn_fifo_control_block_t *cb = v->evtchn_fifo->control_block;
+    uint32_t head[EVTCHN_FIFO_MAX_QUEUES] = { 0 };
+    uint32_t ready = 0;
+    unsigned long *delivered = calloc(1, sizeof(*delivered));
+    unsigned long after_done = 0;
+    bool done = false;
+
+    pthread_barrier_wait(&bench_barrier);
+
+    for ( ; ; )
+    {
+        unsigned int q, port;
+        event_word_t *word;
+
+        if ( !ready )
+            ready = xchg(&cb->ready, 0);
+        if ( !ready )
+        {
+            /* Everything sent is linked once the senders are done. */
+            if ( done )
+                break;
+            done = read_atomic(&senders_done);
+            cpu_relax();
+            continue;
+        }
+
+        /*
+         * Once the senders are done, a queue can't hold more than one entry
+         * per port.
+         */
+        if ( done && ++after_done > 2UL * d->valid_evtchns )
+        {
+            printf("vCPU%u: queues don't drain, corrupted list?\n",
+                   v->vcpu_id);
+            __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        q = __builtin_ctz(ready);
+        port = head[q];
+        if ( !port )
+        {
+            smp_rmb();
+            port = read_atomic(&cb->head[q]);
+        }
+
+        word = guest_word(d, port);
+        head[q] = guest_clear_linked(word);
+        if ( !head[q] )
+            ready &= ~(1U << q);
+
+        if ( guest_test_bit(d, EVTCHN_FIFO_PENDING, word) &&
+             !guest_test_bit(d, EVTCHN_FIFO_MASKED, word) )
+        {
+            guest_clear_bit(d, EVTCHN_FIFO_PENDING, word);
+            ++*delivered;
+        }
+    }
+
+    return delivered;
+}
+
+static void check_quiesced(const struct domain *d)
+{
+    unsigned int port, i;
+
+    for ( port = 1; port < d->valid_evtchns; port++ )
+    {
+        event_word_t w = read_atomic(guest_word(d, port));
+
+        if ( w & ((1 << EVTCHN_FIFO_PENDING) | (1 << EVTCHN_FIFO_LINKED) |
+                  (1 << EVTCHN_FIFO_BUSY)) )
+        {
+            printf("port %u: event word %#x after all events consumed\n",
+                   port, w);
+            failures++;
+        }
+        if ( d->evtchn[port].fifo_next )
+        {
+            printf("port %u: still staged\n", port);
+            failures++;
+        }
+    }
+
+    for ( i = 0; i < d->max_vcpus; i++ )
+        for ( port = 0; port < EVTCHN_FIFO_MAX_QUEUES; port++ )
+            if ( d->vcpu[i]->evtchn_fifo->queue[port].staged )
+            {
+                printf("vCPU%u queue %u: staged events left\n", i, port);
+                failures++;
+            }
+}
+
+static void run_bench(unsigned int senders)
+{
+    pthread_t *threads = calloc(senders + bench.vcpus, sizeof(*threads));
+    unsigned long delivered = 0, kicks = 0;
+    uint64_t ns = 0, wall = 0;
+    unsigned int t;
+
+    if ( !threads )
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    bench_dom = create_domain(bench.vcpus, 1 + senders * bench.ports);
+    senders_done = false;
+
+    pthread_barrier_init(&bench_barrier, NULL, senders + bench.vcpus);
+    for ( t = 0; t < bench.vcpus; t++ )
+        if ( pthread_create(&threads[senders + t], NULL, guest_thread,
+                            bench_dom->vcpu[t]) )
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+    for ( t = 0; t < senders; t++ )
+        if ( pthread_create(&threads[t], NULL, sender_thread,
+                            (void *)(unsigned long)t) )
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+
+    for ( t = 0; t < senders; t++ )
+    {
+        uint64_t *res;
+
+        pthread_join(threads[t], (void **)&res);
+        ns += *res;
+        if ( *res > wall )
+            wall = *res;
+        free(res);
+    }
+
+    write_atomic(&senders_done, true);
+
+    for ( t = 0; t < bench.vcpus; t++ )
+    {
+        unsigned long *res;
+
+        pthread_join(threads[senders + t], (void **)&res);
+        delivered += *res;
+        kicks += bench_dom->vcpu[t]->kicks;
+        free(res);
+    }
+
+    pthread_barrier_destroy(&bench_barrier);
+
+    printf("%3u senders %2u vCPUs: %8.1f ns/send, %8.3f Msends/s, "
+           "%lu kicks, %lu delivered\n",
+           senders, bench.vcpus, (double)ns / (senders * bench.iterations),
+           senders * bench.iterations * 1000.0 / wall, kicks, delivered);
+
+    check_quiesced(bench_dom);
+    destroy_domain(bench_dom);
+    free(threads);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -t <n>   maximum number of sender threads (default %u)\n"
+            "  -c <n>   number of vCPUs receiving events (default %u)\n"
+            "  -P <n>   ports per sender (default %u)\n"
+            "  -n <n>   sends per sender (default %lu)\n"
+            "  -m       move ports between vCPUs while sending\n"
+            "  -p       change port priorities while sending\n"
+            "  -y <n>   yield every <n> sends, to interleave with the guests\n"
+            "           on hosts with few CPUs\n"
+            "  -s <n>   random seed\n"
+            "  -v       verbose hypervisor messages\n",
+            prog, bench.senders, bench.vcpus, bench.ports, bench.iterations);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int senders;
+    int c;
+
+    while ( (c = getopt(argc, argv, "t:c:P:n:mpy:s:v")) != -1 )
+    {
+        switch ( c )
+        {
+        case 't':
+            bench.senders = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            bench.vcpus = strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            bench.ports = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            bench.iterations = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            bench.move = true;
+            break;
+        case 'p':
+            bench.reprioritise = true;
+            break;
+        case 'y':
+            bench.yield = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            rnd_state = strtoull(optarg, NULL, 0) | 1;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if ( !bench.senders || !bench.vcpus || !bench.ports ||
+         !bench.iterations || optind < argc ||
+         bench.senders * bench.ports >= EVTCHN_FIFO_NR_CHANNELS )
+        usage(argv[0]);
+
+    /* Double the number of senders up to the maximum. */
+    for ( senders = 1; ; senders = senders * 2 < bench.senders ?
+                                   senders * 2 : bench.senders )
+    {
+        run_bench(senders);
+        if ( senders == bench.senders )
+            break;
+    }
+
+    if ( failures )
+    {
+        printf("%lu failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
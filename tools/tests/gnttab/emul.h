@@ -0,0 +1,560 @@
+/*
+ * Emulation of the hypervisor environment needed by common/grant_table.c.
+ *
+ * Guests are PV-like: they have no p2m translation of their own, grant
+ * mappings are not reflected in any page tables, and TLB flushes are only
+ * counted.  Memory is a pool of frames backed by host memory, with reference
+ * and type counts kept in a struct page_info per frame.  Locks are spinning
+ * locks, pthreads standing in for physical CPUs.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TEST_GNTTAB_
+#define _TEST_GNTTAB_
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xen/xen.h>
+#include <xen/grant_table.h>
+
+#define container_of(ptr, type, member) ({                      \
+        typeof(((type *)0)->member) *mptr = (ptr);              \
+                                                                \
+        (type *)((char *)mptr - offsetof(type, member));        \
+})
+
+#define barrier()     asm volatile ( "" ::: "memory" )
+#define smp_mb()      __sync_synchronize()
+#define smp_rmb()     barrier()
+#define smp_wmb()     barrier()
+#define cpu_relax()   sched_yield()
+#define prefetch(x)   __builtin_prefetch(x)
+
+#define likely(x)     __builtin_expect(!!(x), 1)
+#define unlikely(x)   __builtin_expect(!!(x), 0)
+
+#define ACCESS_ONCE(x)       (*(volatile typeof(x) *)&(x))
+#define read_atomic(p)       __atomic_load_n(p, __ATOMIC_RELAXED)
+#define write_atomic(p, x)   __atomic_store_n(p, x, __ATOMIC_RELAXED)
+#define cmpxchg(p, o, n)     __sync_val_compare_and_swap(p, o, n)
+#define guest_cmpxchg(d, p, o, n) cmpxchg(p, o, n)
+#define set_bit(nr, p)       __atomic_fetch_or(p, 1UL << (nr), __ATOMIC_SEQ_CST)
+
+typedef struct { int counter; } atomic_t;
+#define atomic_read(v)       read_atomic(&(v)->counter)
+#define atomic_inc(v)        __atomic_fetch_add(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+
+#define evaluate_nospec(x)          (x)
+#define block_speculation()         ((void)0)
+#define array_index_nospec(i, n)    (i)
+
+#define ASSERT(x)              assert(x)
+#define ASSERT_UNREACHABLE()   assert(0)
+#define BUG()                  assert(0)
+#define BUG_ON(x)              assert(!(x))
+#define BUILD_BUG_ON(x)        _Static_assert(!(x), #x)
+
+#define ARRAY_SIZE(a)          (sizeof(a) / sizeof((a)[0]))
+#define DIV_ROUND_UP(n, d)     (((n) + (d) - 1) / (d))
+#define BITS_PER_LONG          64
+
+#define min(x, y) ({                    \
+        const typeof(x) tx = (x);       \
+        const typeof(y) ty = (y);       \
+                                        \
+        (void) (&tx == &ty);            \
+        tx < ty ? tx : ty;              \
+})
+
+#define max(x, y) ({                    \
+        const typeof(x) tx = (x);       \
+        const typeof(y) ty = (y);       \
+                                        \
+        (void) (&tx == &ty);            \
+        tx > ty ? tx : ty;              \
+})
+
+#define min_t(type, x, y) ({ type tx = (x), ty = (y); tx < ty ? tx : ty; })
+#define fls(x)            ((x) ? 32 - __builtin_clz(x) : 0)
+#define max_t(type, x, y) ({ type tx = (x), ty = (y); tx > ty ? tx : ty; })
+
+#define __init
+#define __read_mostly
+#define __initcall(fn)
+#define custom_param(name, fn)
+#define custom_runtime_param(name, fn)
+#define integer_runtime_param(name, var)
+#define register_keyhandler(key, fn, desc, diag)
+
+#define ERESTART    85
+
+#define ERR_PTR(e)        ((void *)(long)(e))
+#define PTR_ERR(p)        ((long)(p))
+#define IS_ERR_OR_NULL(p) (!(p) || (unsigned long)(p) >= (unsigned long)-4095)
+
+#define CONFIG_X86
+
+typedef bool bool_t;
+typedef uint32_t u32;
+typedef int16_t s16;
+typedef int64_t s_time_t;
+typedef uint64_t paddr_t;
+
+#define SECONDS(s)       ((s_time_t)(s) * 1000000000)
+#define MILLISECS(ms)    ((s_time_t)(ms) * 1000000)
+#define NOW()            ((s_time_t)0)
+
+/* Logging, quiet unless enabled by the harness. */
+extern bool verbose;
+
+#define XENLOG_ERR       ""
+#define XENLOG_WARNING   ""
+#define XENLOG_INFO      ""
+#define XENLOG_G_DEBUG   ""
+#define PRI_mfn          "05lx"
+#define PRI_gfn          "05lx"
+#define PRIpaddr         "016"PRIx64
+
+#define printk(fmt, args...)  \
+    do { if ( verbose ) printf(fmt, ## args); } while ( 0 )
+#define gprintk(lvl, fmt, args...)  printk(lvl fmt, ## args)
+#define gdprintk(lvl, fmt, args...) printk(lvl fmt, ## args)
+
+#define TRACE_1D(evt, d)  ((void)(d))
+
+#include "list.h"
+
+/* Locks. */
+typedef struct {
+    int locked;
+} spinlock_t;
+
+#define spin_lock_init(l)   ((l)->locked = 0)
+#define spin_is_locked(l)   read_atomic(&(l)->locked)
+
+static inline void spin_lock(spinlock_t *l)
+{
+    while ( __atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE) )
+        cpu_relax();
+}
+
+static inline void spin_unlock(spinlock_t *l)
+{
+    __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Readers are kept out as soon as a writer is waiting, so writers don't get
+ * starved by the readers of a busy grant table.
+ */
+#define RW_WRITER  (1 << 30)
+#define RW_WAITING (1 << 29)
+
+typedef struct {
+    int cnt;
+    spinlock_t writer;
+} rwlock_t;
+
+#define rwlock_init(l)   ((l)->cnt = 0, spin_lock_init(&(l)->writer))
+#define rw_is_locked(l)  (read_atomic(&(l)->cnt) & ~RW_WAITING)
+#define rw_is_write_locked(l) (read_atomic(&(l)->cnt) & RW_WRITER)
+
+static inline void read_lock(rwlock_t *l)
+{
+    for ( ; ; )
+    {
+        int cnt = read_atomic(&l->cnt);
+
+        if ( !(cnt & (RW_WRITER | RW_WAITING)) &&
+             __atomic_compare_exchange_n(&l->cnt, &cnt, cnt + 1, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+            return;
+        cpu_relax();
+    }
+}
+
+static inline void read_unlock(rwlock_t *l)
+{
+    __atomic_fetch_sub(&l->cnt, 1, __ATOMIC_RELEASE);
+}
+
+static inline void write_lock(rwlock_t *l)
+{
+    int cnt = RW_WAITING;
+
+    spin_lock(&l->writer);
+    __atomic_fetch_or(&l->cnt, RW_WAITING, __ATOMIC_RELAXED);
+    while ( !__atomic_compare_exchange_n(&l->cnt, &cnt, RW_WRITER, false,
+                                         __ATOMIC_ACQUIRE,
+                                         __ATOMIC_RELAXED) )
+    {
+        cnt = RW_WAITING;
+        cpu_relax();
+    }
+}
+
+static inline void write_unlock(rwlock_t *l)
+{
+    __atomic_store_n(&l->cnt, 0, __ATOMIC_RELEASE);
+    spin_unlock(&l->writer);
+}
+
+typedef rwlock_t percpu_rwlock_t;
+
+#define DEFINE_PERCPU_RWLOCK_GLOBAL(name) int name __attribute__((__unused__))
+#define percpu_rwlock_resource_init(l, owner) rwlock_init(l)
+#define percpu_read_lock(percpu, l)    read_lock(l)
+#define percpu_read_unlock(percpu, l)  read_unlock(l)
+#define percpu_write_lock(percpu, l)   write_lock(l)
+#define percpu_write_unlock(percpu, l) write_unlock(l)
+#define percpu_rw_is_write_locked(l)   rw_is_write_locked(l)
+
+/* Timers never fire on their own, the harness fires armed ones explicitly. */
+struct timer {
+    void (*fn)(void *);
+    void *data;
+    bool armed;
+};
+
+#define init_timer(t, f, d, cpu) ((t)->fn = (f), (t)->data = (d), \
+                                  (t)->armed = false)
+#define set_timer(t, expires)    ((void)(expires), (t)->armed = true)
+#define kill_timer(t)            ((t)->armed = false)
+
+static inline void fire_timer(struct timer *t)
+{
+    if ( __atomic_exchange_n(&t->armed, false, __ATOMIC_SEQ_CST) )
+        t->fn(t->data);
+}
+
+/* Frames. */
+typedef unsigned long mfn_t;
+typedef unsigned long gfn_t;
+typedef unsigned long dfn_t;
+
+#define _mfn(x)          ((mfn_t)(x))
+#define mfn_x(m)         ((unsigned long)(m))
+#define mfn_eq(x, y)     ((x) == (y))
+#define _gfn(x)          ((gfn_t)(x))
+#define gfn_x(g)         ((unsigned long)(g))
+#define gfn_eq(x, y)     ((x) == (y))
+#define _dfn(x)          ((dfn_t)(x))
+#define INVALID_MFN      (~0UL)
+#define INVALID_GFN      (~0UL)
+
+#define PAGE_SHIFT       12
+#define PAGE_SIZE        (1UL << PAGE_SHIFT)
+#define PAGE_MASK        (~(PAGE_SIZE - 1))
+
+#define PGC_allocated    (1UL << 63)
+#define _PGC_allocated   63
+#define PGC_xen_heap     (1UL << 62)
+#define PGC_count_mask   ((1UL << 40) - 1)
+
+#define PGT_writable_page 1
+
+struct page_info {
+    unsigned long count_info;
+    unsigned long type_info;
+    struct domain *owner;
+    struct page_info *next_free;
+};
+
+extern struct page_info *frame_table;
+extern unsigned char *frame_mem;
+extern unsigned long nr_frames;
+
+#define mfn_valid(m)        ((m) < nr_frames)
+#define mfn_to_page(m)      (&frame_table[m])
+#define page_to_mfn(pg)     ((mfn_t)((pg) - frame_table))
+#define virt_to_mfn(v)      ((mfn_t)(((unsigned char *)(v) - frame_mem) >> \
+                                     PAGE_SHIFT))
+#define virt_to_page(v)     mfn_to_page(virt_to_mfn(v))
+#define mfn_to_maddr(m)     ((paddr_t)(m) << PAGE_SHIFT)
+#define maddr_to_mfn(ma)    ((mfn_t)((ma) >> PAGE_SHIFT))
+#define map_domain_page(m)  ((void *)(frame_mem + ((m) << PAGE_SHIFT)))
+#define unmap_domain_page(v) ((void)(v))
+#define page_get_owner(pg)  ((pg)->owner)
+#define page_set_owner(pg, d) ((pg)->owner = (d))
+#define is_iomem_page(m)    false
+
+#define clear_page(v)       memset(v, 0, PAGE_SIZE)
+#define copy_page(d, s)     memcpy(d, s, PAGE_SIZE)
+#define copy_domain_page(d, s) \
+    copy_page(map_domain_page(d), map_domain_page(s))
+
+#define MEMF_no_owner       (1U << 0)
+#define MEMF_no_refcount    (1U << 1)
+#define MEMF_bits(b)        0
+#define MEMF_node(n)        0
+
+void *alloc_xenheap_page(void);
+void free_xenheap_page(void *v);
+#define alloc_xenheap_pages(o, f) alloc_xenheap_page()
+#define vcpu_to_node(v)     0
+struct page_info *alloc_domheap_page(struct domain *d, unsigned int memflags);
+void free_domheap_page(struct page_info *pg);
+void share_xen_page_with_guest(struct page_info *pg, struct domain *d,
+                               int flags);
+#define SHARE_rw 0
+
+#define vzalloc(size)       calloc(1, size)
+#define vfree(p)            free(p)
+#define xmalloc(type)       ((type *)malloc(sizeof(type)))
+#define xzalloc(type)       ((type *)calloc(1, sizeof(type)))
+#define xmalloc_array(type, n) ((type *)malloc(sizeof(type) * (n)))
+#define xzalloc_array(type, n) ((type *)calloc(n, sizeof(type)))
+#define xfree(p)            free(p)
+#define XFREE(p)            do { free(p); (p) = NULL; } while ( 0 )
+
+/* Domains and vCPUs. */
+struct vcpu {
+    struct domain *domain;
+    unsigned int vcpu_id;
+    grant_handle_t maptrack_head;
+    grant_handle_t maptrack_tail;
+    spinlock_t maptrack_freelist_lock;
+};
+
+struct domain {
+    domid_t domain_id;
+    bool is_dying;
+    unsigned int max_vcpus;
+    struct vcpu **vcpu;
+    struct grant_table *grant_table;
+    void *dirty_cpumask;
+    spinlock_t page_alloc_lock;
+    unsigned int tot_pages, max_pages;
+    unsigned int refcnt;
+    struct domain *next_in_list;
+
+    /* Guest physical to machine frame translation. */
+    mfn_t *p2m;
+    unsigned long p2m_size;
+};
+
+extern __thread struct vcpu *current;
+extern struct domain *domain_list;
+
+/* Special domains, never used for grants in the harness. */
+extern struct domain *dom_io, *dom_cow;
+
+#define for_each_domain(d) \
+    for ( (d) = domain_list; (d); (d) = (d)->next_in_list )
+
+struct domain *rcu_lock_domain_by_id(domid_t dom);
+#define rcu_lock_domain_by_any_id(dom) \
+    ((dom) == DOMID_SELF ? current->domain : rcu_lock_domain_by_id(dom))
+#define rcu_lock_domain(d)         (d)
+#define rcu_lock_current_domain()  (current->domain)
+#define rcu_unlock_domain(d)       ((void)(d))
+#define rcu_read_lock(l)           ((void)0)
+#define rcu_read_unlock(l)         ((void)0)
+
+#define get_domain(d) (__atomic_fetch_add(&(d)->refcnt, 1, __ATOMIC_SEQ_CST), \
+                       true)
+#define get_knownalive_domain(d) ((void)get_domain(d))
+#define put_domain(d) __atomic_fetch_sub(&(d)->refcnt, 1, __ATOMIC_SEQ_CST)
+
+#define domain_crash(d) do {                                    \
+    fprintf(stderr, "%s:%d: d%d crashed\n", __FILE__, __LINE__, \
+            (d)->domain_id);                                    \
+    abort();                                                    \
+} while ( 0 )
+
+#define domain_clamp_alloc_bitsize(d, bits) (bits)
+#define domain_adjust_tot_pages(d, pages) ((d)->tot_pages += (pages))
+int assign_pages(struct domain *d, struct page_info *pg, unsigned int order,
+                 unsigned int memflags);
+int steal_page(struct domain *d, struct page_info *pg, unsigned int memflags);
+
+#define paging_mode_external(d)  false
+#define paging_mode_translate(d) false
+#define iomem_access_permitted(d, s, e) false
+
+/* Reference counting. */
+bool get_page(struct page_info *pg, const struct domain *d);
+void put_page(struct page_info *pg);
+struct domain *page_get_owner_and_reference(struct page_info *pg);
+#define put_page_alloc_ref(pg) \
+    __atomic_fetch_and(&(pg)->count_info, ~PGC_allocated, __ATOMIC_SEQ_CST)
+#define get_page_type(pg, type) \
+    (__atomic_fetch_add(&(pg)->type_info, 1, __ATOMIC_SEQ_CST), true)
+#define put_page_type(pg) \
+    __atomic_fetch_sub(&(pg)->type_info, 1, __ATOMIC_SEQ_CST)
+#define put_page_and_type(pg) do { put_page_type(pg); put_page(pg); } while ( 0 )
+
+/* p2m. */
+typedef enum {
+    p2m_ram_rw,
+    p2m_invalid,
+} p2m_type_t;
+
+#define p2m_is_foreign(t)  false
+#define p2m_is_shared(t)   false
+#define p2m_is_valid(t)    ((t) != p2m_invalid)
+
+int check_get_page_from_gfn(struct domain *d, gfn_t gfn, bool readonly,
+                            p2m_type_t *p2mt_p, struct page_info **page_p);
+mfn_t get_gfn_unshare(struct domain *d, unsigned long gfn, p2m_type_t *t);
+#define put_gfn(d, gfn) ((void)(gfn))
+#define SHARED_M2P(gfn) false
+int guest_physmap_remove_page(struct domain *d, gfn_t gfn, mfn_t mfn,
+                              unsigned int page_order);
+int guest_physmap_add_page(struct domain *d, gfn_t gfn, mfn_t mfn,
+                           unsigned int page_order);
+
+#define need_iommu_pt_sync(d)       false
+#define iommu_legacy_map(d, dfn, mfn, order, flags) 0
+#define iommu_legacy_unmap(d, dfn, order) 0
+#define IOMMUF_readable             1
+#define IOMMUF_writable             2
+
+#define clean_dcache_va_range(p, size)                 0
+#define invalidate_dcache_va_range(p, size)            0
+#define clean_and_invalidate_dcache_va_range(p, size)  0
+
+/* Architecture specific grant table handling, following x86 PV. */
+#define INITIAL_NR_GRANT_FRAMES 1U
+
+struct grant_table_arch {
+};
+
+#define create_grant_host_mapping(addr, frame, flags, cache) GNTST_okay
+#define replace_grant_host_mapping(d, addr, frame, new_addr, flags) GNTST_okay
+#define grant_host_mapping_remote(addr, flags) true
+#define gnttab_init_arch(gt) 0
+#define gnttab_destroy_arch(gt) do {} while ( 0 )
+#define gnttab_set_frame_gfn(gt, st, idx, gfn) do {} while ( 0 )
+#define gnttab_get_frame_gfn(gt, st, idx) ({                          \
+    mfn_t mfn_ = (st) ? gnttab_status_mfn(gt, idx)                    \
+                      : gnttab_shared_mfn(gt, idx);                   \
+    _gfn(mfn_x(mfn_));                                                \
+})
+#define gnttab_shared_mfn(t, i)     virt_to_mfn((t)->shared_raw[i])
+#define gnttab_shared_gfn(d, t, i)  gnttab_shared_mfn(t, i)
+#define gnttab_status_mfn(t, i)     virt_to_mfn((t)->status[i])
+#define gnttab_status_gfn(d, t, i)  gnttab_status_mfn(t, i)
+#define gnttab_mark_dirty(d, f)     ((void)(f))
+#define gnttab_clear_flags(d, mask, addr) \
+    __atomic_fetch_and(addr, (uint16_t)~(mask), __ATOMIC_SEQ_CST)
+#define gnttab_host_mapping_get_page_type(ro, ld, rd) \
+    (!(ro) && (((ld) == (rd)) || !paging_mode_external(rd)))
+#define gnttab_release_host_mappings(d) paging_mode_external(d)
+#define gnttab_need_iommu_mapping(d) false
+
+/* TLB flushes are counted only. */
+extern unsigned long nr_tlb_flushes;
+#define flush_tlb_mask(mask) \
+    __atomic_fetch_add(&nr_tlb_flushes, 1, __ATOMIC_RELAXED)
+
+/* Hypercall environment. */
+#define guest_handle_okay(hnd, nr)         true
+#define guest_handle_add_offset(hnd, nr)   ((hnd).p += (nr))
+#define guest_handle_cast(hnd, type) ({                          \
+    type *_x = (void *)(hnd).p;                                  \
+    (XEN_GUEST_HANDLE_PARAM(type)) { _x };                       \
+})
+#define copy_from_guest_offset(ptr, hnd, off, nr) \
+    (memcpy(ptr, (hnd).p + (off), sizeof(*(ptr)) * (nr)), 0)
+#define copy_to_guest_offset(hnd, off, ptr, nr) \
+    (memcpy((hnd).p + (off), ptr, sizeof(*(ptr)) * (nr)), 0)
+#define copy_from_guest(ptr, hnd, nr)  copy_from_guest_offset(ptr, hnd, 0, nr)
+#define copy_to_guest(hnd, ptr, nr)    copy_to_guest_offset(hnd, 0, ptr, nr)
+#define __copy_from_guest_offset       copy_from_guest_offset
+#define __copy_to_guest_offset         copy_to_guest_offset
+#define __copy_from_guest              copy_from_guest
+#define __copy_to_guest                copy_to_guest
+#define __copy_field_to_guest(hnd, ptr, field) \
+    ((hnd).p->field = (ptr)->field, 0)
+
+/*
+ * Every preempt_interval-th preemption check is positive, if set. The
+ * arguments of a continuation are recorded for grant_op() to re-issue it.
+ */
+extern unsigned int preempt_interval;
+extern __thread unsigned int preempt_checks;
+
+static inline bool hypercall_preempt_check(void)
+{
+    return preempt_interval && !(++preempt_checks % preempt_interval);
+}
+
+struct continuation {
+    bool pending;
+    unsigned int cmd;
+    void *uop;
+    unsigned int count;
+};
+extern __thread struct continuation continuation;
+
+#define hypercall_create_continuation(op, fmt, c, hnd, n) ({        \
+    continuation = (struct continuation){ true, c, (hnd).p, n };    \
+    0L;                                                             \
+})
+
+/* XSM permits everything. */
+#define XSM_HOOK    0
+#define XSM_TARGET  0
+#define xsm_grant_mapref(action, ld, rd, flags)  0
+#define xsm_grant_unmapref(action, ld, rd)       0
+#define xsm_grant_setup(action, ld, rd)          0
+#define xsm_grant_transfer(action, ld, rd)       0
+#define xsm_grant_copy(action, ld, rd)           0
+#define xsm_grant_query_size(action, ld, rd)     0
+
+#include <xen/memory.h>
+
+void grant_table_destroy(struct domain *d);
+
+/* Performance counters are not emulated. */
+#define perfc_incr(x) ((void)0)
+#define perfc_add(x, v) ((void)0)
+
+unsigned int get_random(void);
+int parse_boolean(const char *name, const char *s, const char *e);
+
+static inline unsigned long simple_strtoul(const char *cp, const char **endp,
+                                           unsigned int base)
+{
+    return strtoul(cp, (char **)endp, base);
+}
+
+static inline long simple_strtol(const char *cp, const char **endp,
+                                 unsigned int base)
+{
+    return strtol(cp, (char **)endp, base);
+}
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,1395 @@
+/*
+ * Benchmark and fuzz harness for common/grant_table.c.
+ *
+ * The benchmark mode sets up a frontend domain granting its pages to a
+ * backend domain, and measures the throughput of grant operations issued by
+ * the backend's vCPUs, each one run by a separate thread.  The fuzz mode
+ * checks the transitions of the v1 and v2 grant status handling against a
+ * model, also with a concurrent "guest" modifying the shared entries.  The
+ * cache mode checks hits, revocation and teardown of cached (GNTMAP_cache)
+ * mappings.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "grant_table.c"
+
+bool verbose;
+unsigned long nr_tlb_flushes;
+unsigned int preempt_interval;
+__thread unsigned int preempt_checks;
+__thread struct continuation continuation;
+
+struct page_info *frame_table;
+unsigned char *frame_mem;
+unsigned long nr_frames;
+static struct page_info *free_frames;
+static spinlock_t free_lock;
+
+__thread struct vcpu *current;
+struct domain *domain_list;
+struct domain *dom_io, *dom_cow;
+
+static __thread uint64_t rnd_state = 0x9e3779b97f4a7c15ULL;
+
+/* Emulation of hypervisor services. */
+unsigned int get_random(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 7;
+    rnd_state ^= rnd_state << 17;
+
+    return rnd_state;
+}
+
+int parse_boolean(const char *name, const char *s, const char *e)
+{
+    size_t slen, nlen;
+    int val = !!strncmp(s, "no-", 3);
+
+    if ( !val )
+        s += 3;
+
+    slen = e ? e - s : strlen(s);
+    nlen = strlen(name);
+
+    if ( slen < nlen || strncmp(s, name, nlen) )
+        return -1;
+    if ( slen == nlen )
+        return val;
+    if ( s[nlen] == '=' && slen == nlen + 2 &&
+         (s[nlen + 1] == '0' || s[nlen + 1] == '1') )
+        return s[nlen + 1] == '1';
+
+    return -1;
+}
+
+static struct page_info *alloc_frame(void)
+{
+    struct page_info *pg;
+
+    spin_lock(&free_lock);
+    pg = free_frames;
+    if ( pg )
+        free_frames = pg->next_free;
+    spin_unlock(&free_lock);
+
+    if ( !pg )
+    {
+        fprintf(stderr, "out of frames\n");
+        abort();
+    }
+
+    pg->count_info = 0;
+    pg->type_info = 0;
+    pg->owner = NULL;
+
+    return pg;
+}
+
+static void free_frame(struct page_info *pg)
+{
+    spin_lock(&free_lock);
+    pg->next_free = free_frames;
+    free_frames = pg;
+    spin_unlock(&free_lock);
+}
+
+void *alloc_xenheap_page(void)
+{
+    struct page_info *pg = alloc_frame();
+
+    pg->count_info = PGC_xen_heap;
+
+    return map_domain_page(page_to_mfn(pg));
+}
+
+void free_xenheap_page(void *v)
+{
+    if ( v )
+        free_frame(virt_to_page(v));
+}
+
+void share_xen_page_with_guest(struct page_info *pg, struct domain *d,
+                               int flags)
+{
+    page_set_owner(pg, d);
+    pg->count_info |= PGC_allocated | 1;
+}
+
+struct page_info *alloc_domheap_page(struct domain *d, unsigned int memflags)
+{
+    struct page_info *pg = alloc_frame();
+
+    if ( !(memflags & MEMF_no_owner) && assign_pages(d, pg, 0, memflags) )
+    {
+        free_frame(pg);
+        return NULL;
+    }
+
+    return pg;
+}
+
+void free_domheap_page(struct page_info *pg)
+{
+    pg->count_info = 0;
+    page_set_owner(pg, NULL);
+    free_frame(pg);
+}
+
+int assign_pages(struct domain *d, struct page_info *pg, unsigned int order,
+                 unsigned int memflags)
+{
+    spin_lock(&d->page_alloc_lock);
+
+    if ( d->is_dying )
+    {
+        spin_unlock(&d->page_alloc_lock);
+        return -EINVAL;
+    }
+
+    if ( !(memflags & MEMF_no_refcount) )
+        domain_adjust_tot_pages(d, 1);
+    page_set_owner(pg, d);
+    pg->count_info = PGC_allocated | 1;
+
+    spin_unlock(&d->page_alloc_lock);
+
+    return 0;
+}
+
+int steal_page(struct domain *d, struct page_info *pg, unsigned int memflags)
+{
+    unsigned long x = PGC_allocated | 1;
+    int rc = -EINVAL;
+
+    spin_lock(&d->page_alloc_lock);
+
+    if ( page_get_owner(pg) == d && !read_atomic(&pg->type_info) &&
+         __atomic_compare_exchange_n(&pg->count_info, &x, 0, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) )
+    {
+        page_set_owner(pg, NULL);
+        if ( !(memflags & MEMF_no_refcount) )
+            domain_adjust_tot_pages(d, -1);
+        rc = 0;
+    }
+
+    spin_unlock(&d->page_alloc_lock);
+
+    return rc;
+}
+
+bool get_page(struct page_info *pg, const struct domain *d)
+{
+    unsigned long x = read_atomic(&pg->count_info);
+
+    do {
+        if ( !(x & PGC_count_mask) || page_get_owner(pg) != d )
+            return false;
+    } while ( !__atomic_compare_exchange_n(&pg->count_info, &x, x + 1, false,
+                                           __ATOMIC_SEQ_CST,
+                                           __ATOMIC_SEQ_CST) );
+
+    return true;
+}
+
+void put_page(struct page_info *pg)
+{
+    unsigned long x = __atomic_sub_fetch(&pg->count_info, 1,
+                                         __ATOMIC_SEQ_CST);
+
+    if ( !(x & PGC_count_mask) )
+        free_domheap_page(pg);
+}
+
+struct domain *page_get_owner_and_reference(struct page_info *pg)
+{
+    unsigned long x = read_atomic(&pg->count_info);
+
+    do {
+        if ( !(x & PGC_count_mask) )
+            return NULL;
+    } while ( !__atomic_compare_exchange_n(&pg->count_info, &x, x + 1, false,
+                                           __ATOMIC_SEQ_CST,
+                                           __ATOMIC_SEQ_CST) );
+
+    return page_get_owner(pg);
+}
+
+static mfn_t p2m_lookup(struct domain *d, unsigned long gfn)
+{
+    return gfn < d->p2m_size ? read_atomic(&d->p2m[gfn]) : INVALID_MFN;
+}
+
+int check_get_page_from_gfn(struct domain *d, gfn_t gfn, bool readonly,
+                            p2m_type_t *p2mt_p, struct page_info **page_p)
+{
+    mfn_t mfn = p2m_lookup(d, gfn_x(gfn));
+
+    *p2mt_p = p2m_invalid;
+    if ( mfn_eq(mfn, INVALID_MFN) || !get_page(mfn_to_page(mfn), d) )
+        return -EINVAL;
+
+    *p2mt_p = p2m_ram_rw;
+    *page_p = mfn_to_page(mfn);
+
+    return 0;
+}
+
+mfn_t get_gfn_unshare(struct domain *d, unsigned long gfn, p2m_type_t *t)
+{
+    mfn_t mfn = p2m_lookup(d, gfn);
+
+    *t = mfn_eq(mfn, INVALID_MFN) ? p2m_invalid : p2m_ram_rw;
+
+    return mfn;
+}
+
+int guest_physmap_remove_page(struct domain *d, gfn_t gfn, mfn_t mfn,
+                              unsigned int page_order)
+{
+    if ( !mfn_eq(p2m_lookup(d, gfn_x(gfn)), mfn) )
+        return -EINVAL;
+
+    write_atomic(&d->p2m[gfn_x(gfn)], INVALID_MFN);
+
+    return 0;
+}
+
+int guest_physmap_add_page(struct domain *d, gfn_t gfn, mfn_t mfn,
+                           unsigned int page_order)
+{
+    if ( gfn_x(gfn) >= d->p2m_size )
+        return -EINVAL;
+
+    write_atomic(&d->p2m[gfn_x(gfn)], mfn);
+
+    return 0;
+}
+
+struct domain *rcu_lock_domain_by_id(domid_t dom)
+{
+    struct domain *d;
+
+    for_each_domain ( d )
+        if ( d->domain_id == dom )
+            return d;
+
+    return NULL;
+}
+
+/* Harness setup. */
+#define GREF_BASE 8
+
+static void init_frames(unsigned long nr)
+{
+    unsigned long i;
+
+    nr_frames = nr;
+    frame_table = calloc(nr, sizeof(*frame_table));
+    frame_mem = aligned_alloc(PAGE_SIZE, nr << PAGE_SHIFT);
+    if ( !frame_table || !frame_mem )
+    {
+        fprintf(stderr, "cannot allocate %lu frames\n", nr);
+        exit(1);
+    }
+
+    spin_lock_init(&free_lock);
+    for ( i = nr; i--; )
+        free_frame(&frame_table[i]);
+}
+
+/* Issue a grant table hypercall, and its continuations. */
+static long grant_op(struct domain *d, unsigned int vcpu, unsigned int cmd,
+                     void *uop, unsigned int count)
+{
+    XEN_GUEST_HANDLE_PARAM(void) hnd = { uop };
+    struct vcpu *curr = current;
+    long rc;
+
+    current = d->vcpu[vcpu];
+    for ( ; ; )
+    {
+        continuation.pending = false;
+        rc = do_grant_table_op(cmd, hnd, count);
+        if ( !continuation.pending )
+            break;
+        cmd = continuation.cmd;
+        hnd.p = continuation.uop;
+        count = continuation.count;
+    }
+    current = curr;
+
+    return rc;
+}
+
+static struct domain *create_domain(domid_t domid, unsigned int nr_vcpus,
+                                    unsigned long nr_pages,
+                                    unsigned long p2m_size,
+                                    unsigned int version,
+                                    unsigned int nr_grants)
+{
+    struct domain *d = calloc(1, sizeof(*d));
+    struct gnttab_setup_table setup = {
+        .dom = DOMID_SELF,
+    };
+    struct gnttab_set_version set_version = {
+        .version = version,
+    };
+    xen_pfn_t *frames;
+    unsigned int i;
+
+    assert(d);
+    d->domain_id = domid;
+    d->max_vcpus = nr_vcpus;
+    d->max_pages = ~0U;
+    spin_lock_init(&d->page_alloc_lock);
+
+    d->vcpu = calloc(nr_vcpus, sizeof(*d->vcpu));
+    assert(d->vcpu);
+    for ( i = 0; i < nr_vcpus; i++ )
+    {
+        d->vcpu[i] = calloc(1, sizeof(*d->vcpu[i]));
+        assert(d->vcpu[i]);
+        d->vcpu[i]->domain = d;
+        d->vcpu[i]->vcpu_id = i;
+        grant_table_init_vcpu(d->vcpu[i]);
+    }
+
+    d->p2m_size = p2m_size;
+    d->p2m = malloc(p2m_size * sizeof(*d->p2m));
+    assert(d->p2m);
+    for ( i = 0; i < p2m_size; i++ )
+        d->p2m[i] = i < nr_pages ? page_to_mfn(alloc_domheap_page(d, 0))
+                                 : INVALID_MFN;
+
+    if ( grant_table_init(d, -1, -1) )
+    {
+        fprintf(stderr, "d%u: cannot initialize grant table\n", domid);
+        exit(1);
+    }
+
+    d->next_in_list = domain_list;
+    domain_list = d;
+
+    if ( grant_op(d, 0, GNTTABOP_set_version, &set_version, 1) )
+    {
+        fprintf(stderr, "d%u: cannot set version %u\n", domid, version);
+        exit(1);
+    }
+
+    setup.nr_frames = DIV_ROUND_UP(nr_grants,
+                                   version == 1 ? SHGNT_PER_PAGE_V1
+                                                : SHGNT_PER_PAGE_V2);
+    frames = calloc(setup.nr_frames, sizeof(*frames));
+    assert(frames);
+    set_xen_guest_handle(setup.frame_list, frames);
+    if ( grant_op(d, 0, GNTTABOP_setup_table, &setup, 1) ||
+         setup.status != GNTST_okay )
+    {
+        fprintf(stderr, "d%u: cannot set up %u grant frames\n", domid,
+                setup.nr_frames);
+        exit(1);
+    }
+    free(frames);
+
+    return d;
+}
+
+/* Update a grant entry the way a guest does. */
+static void grant_entry(struct domain *d, grant_ref_t ref, uint16_t flags,
+                        domid_t domid, unsigned long gfn)
+{
+    struct grant_table *gt = d->grant_table;
+
+    if ( gt->gt_version == 1 )
+    {
+        grant_entry_v1_t *e = &shared_entry_v1(gt, ref);
+
+        e->domid = domid;
+        e->frame = gfn;
+        smp_wmb();
+        write_atomic(&e->flags, flags);
+    }
+    else
+    {
+        grant_entry_v2_t *e = &shared_entry_v2(gt, ref);
+
+        e->hdr.domid = domid;
+        e->full_page.frame = gfn;
+        smp_wmb();
+        write_atomic(&e->hdr.flags, flags);
+    }
+}
+
+/* Benchmark. */
+enum bench_op {
+    BENCH_MAP,
+    BENCH_COPY,
+    BENCH_COPY_V2,
+    BENCH_TRANSFER,
+};
+
+static const char *const bench_names[] = {
+    [BENCH_MAP]      = "map",
+    [BENCH_COPY]     = "copy",
+    [BENCH_COPY_V2]  = "copy_v2",
+    [BENCH_TRANSFER] = "transfer",
+};
+
+static struct {
+    enum bench_op op;
+    unsigned int threads;
+    unsigned int batch;
+    unsigned long iterations;
+    unsigned int version;
+} bench = {
+    .threads = 4,
+    .batch = 32,
+    .iterations = 10000,
+    .version = 1,
+};
+
+static struct domain *frontend, *backend;
+static pthread_barrier_t bench_barrier;
+
+struct bench_result {
+    uint64_t ns[2];
+    unsigned long ops[2];
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fail(const char *what, unsigned int thread, long rc, int status)
+{
+    fprintf(stderr, "thread %u: %s failed: rc %ld status %d\n",
+            thread, what, rc, status);
+    exit(1);
+}
+
+/*
+ * Layout of the frontend's grants and the domains' frames for thread t: the
+ * grants [t * batch, (t + 1) * batch) past GREF_BASE are of frontend frames
+ * with the same index, transfer grants of either domain follow, at an offset
+ * of threads * batch.  The backend uses its frames with the same index as
+ * copy destinations and for transfers, which place frames into frontend
+ * frames past threads * batch.
+ */
+static void bench_map(unsigned int t, struct bench_result *res)
+{
+    struct gnttab_map_grant_ref *map = calloc(bench.batch, sizeof(*map));
+    struct gnttab_unmap_grant_ref *unmap = calloc(bench.batch,
+                                                  sizeof(*unmap));
+    unsigned long it;
+    unsigned int i;
+    uint64_t start;
+    long rc;
+
+    assert(map && unmap);
+
+    for ( it = 0; it < bench.iterations; it++ )
+    {
+        for ( i = 0; i < bench.batch; i++ )
+        {
+            map[i].host_addr = (uint64_t)(t * bench.batch + i + 1) <<
+                               PAGE_SHIFT;
+            map[i].flags = GNTMAP_host_map;
+            map[i].ref = GREF_BASE + t * bench.batch + i;
+            map[i].dom = frontend->domain_id;
+        }
+
+        start = now_ns();
+        rc = grant_op(backend, t, GNTTABOP_map_grant_ref, map, bench.batch);
+        res->ns[0] += now_ns() - start;
+        for ( i = 0; i < bench.batch; i++ )
+            if ( rc || map[i].status != GNTST_okay )
+                fail("map", t, rc, map[i].status);
+
+        for ( i = 0; i < bench.batch; i++ )
+        {
+            unmap[i].host_addr = map[i].host_addr;
+            unmap[i].dev_bus_addr = 0;
+            unmap[i].handle = map[i].handle;
+        }
+
+        start = now_ns();
+        rc = grant_op(backend, t, GNTTABOP_unmap_grant_ref, unmap,
+                      bench.batch);
+        res->ns[1] += now_ns() - start;
+        for ( i = 0; i < bench.batch; i++ )
+            if ( rc || unmap[i].status != GNTST_okay )
+                fail("unmap", t, rc, unmap[i].status);
+
+        /* Thread 0 also stands in for the flush timer expiring. */
+        if ( !t && !(it % 8) )
+            fire_timer(&backend->grant_table->flush_timer);
+    }
+
+    res->ops[0] = res->ops[1] = bench.iterations * bench.batch;
+
+    free(map);
+    free(unmap);
+}
+
+static void bench_copy(unsigned int t, struct bench_result *res)
+{
+    struct gnttab_copy *copy = calloc(bench.batch, sizeof(*copy));
+    unsigned long it;
+    unsigned int i;
+    uint64_t start;
+    long rc;
+
+    assert(copy);
+
+    for ( it = 0; it < bench.iterations; it++ )
+    {
+        for ( i = 0; i < bench.batch; i++ )
+        {
+            copy[i].source.u.ref = GREF_BASE + t * bench.batch + i;
+            copy[i].source.domid = frontend->domain_id;
+            copy[i].dest.u.gmfn = t * bench.batch + i;
+            copy[i].dest.domid = DOMID_SELF;
+            copy[i].len = PAGE_SIZE;
+            copy[i].flags = GNTCOPY_source_gref;
+        }
+
+        start = now_ns();
+        rc = grant_op(backend, t, GNTTABOP_copy, copy, bench.batch);
+        res->ns[0] += now_ns() - start;
+        for ( i = 0; i < bench.batch; i++ )
+            if ( rc || copy[i].status != GNTST_okay )
+                fail("copy", t, rc, copy[i].status);
+    }
+
+    res->ops[0] = bench.iterations * bench.batch;
+
+    free(copy);
+}
+
+static uint8_t *gfn_to_virt(struct domain *d, unsigned long gfn)
+{
+    return map_domain_page(p2m_lookup(d, gfn));
+}
+
+/*
+ * With hypercalls getting preempted, copies not starting at a page boundary
+ * are done, and their data is checked, for checking the resumption of
+ * partially done operations.
+ */
+#define COPY_V2_SKEW 123
+
+/* Contents of the frontend's frames, by offset into the granted range. */
+static uint8_t copy_v2_byte(unsigned int pos)
+{
+    return pos ^ (pos >> 8) ^ (pos >> 16);
+}
+
+static void bench_copy_v2(unsigned int t, struct bench_result *res)
+{
+    /* One operation with a source and a destination segment. */
+    struct {
+        struct gnttab_copy_v2 op;
+        struct gnttab_copy_seg src, dst;
+    } copy;
+    unsigned int skew = preempt_interval ? COPY_V2_SKEW : 0, i;
+    unsigned long it;
+    uint64_t start;
+    long rc;
+
+    for ( it = 0; it < bench.iterations; it++ )
+    {
+        memset(&copy, 0, sizeof(copy));
+        copy.op.source_domid = frontend->domain_id;
+        copy.op.dest_domid = DOMID_SELF;
+        copy.op.nr_source_segs = 1;
+        copy.op.nr_dest_segs = 1;
+        copy.op.flags = GNTCOPY_source_gref;
+        copy.src.u.ref = GREF_BASE + t * bench.batch;
+        copy.src.offset = skew;
+        copy.src.len = bench.batch * PAGE_SIZE - skew;
+        copy.dst.u.gfn = t * bench.batch;
+        copy.dst.len = bench.batch * PAGE_SIZE - skew;
+
+        if ( skew )
+            for ( i = 0; i < bench.batch; i++ )
+                clear_page(gfn_to_virt(backend, t * bench.batch + i));
+
+        start = now_ns();
+        rc = grant_op(backend, t, GNTTABOP_copy_v2, &copy, 3);
+        res->ns[0] += now_ns() - start;
+        if ( rc || copy.op.status != GNTST_okay ||
+             copy.op.copied != copy.src.len )
+            fail("copy_v2", t, rc, copy.op.status);
+
+        for ( i = 0; skew && i < copy.dst.len; i++ )
+        {
+            unsigned int pos = t * bench.batch * PAGE_SIZE + i;
+
+            if ( gfn_to_virt(backend, pos >> PAGE_SHIFT)[pos & ~PAGE_MASK] !=
+                 copy_v2_byte(pos + skew) )
+                fail("copy_v2 data", t, i, copy.op.status);
+        }
+    }
+
+    res->ops[0] = bench.iterations * bench.batch;
+}
+
+static void bench_transfer(unsigned int t, struct bench_result *res)
+{
+    struct gnttab_transfer *xfer = calloc(bench.batch, sizeof(*xfer));
+    unsigned int base = t * bench.batch, n = bench.threads * bench.batch;
+    unsigned long it;
+    unsigned int i, dir;
+    uint64_t start;
+    long rc;
+
+    assert(xfer);
+
+    for ( it = 0; it < bench.iterations; it++ )
+    {
+        /* Backend frames to the frontend, and back. */
+        for ( dir = 0; dir < 2; dir++ )
+        {
+            struct domain *d = dir ? frontend : backend;
+            struct domain *e = dir ? backend : frontend;
+
+            for ( i = 0; i < bench.batch; i++ )
+            {
+                grant_entry(e, GREF_BASE + n + base + i, GTF_accept_transfer,
+                            d->domain_id, dir ? base + i : n + base + i);
+                xfer[i].mfn = dir ? n + base + i : base + i;
+                xfer[i].domid = e->domain_id;
+                xfer[i].ref = GREF_BASE + n + base + i;
+            }
+
+            start = now_ns();
+            rc = grant_op(d, t, GNTTABOP_transfer, xfer, bench.batch);
+            res->ns[0] += now_ns() - start;
+            for ( i = 0; i < bench.batch; i++ )
+                if ( rc || xfer[i].status != GNTST_okay )
+                    fail("transfer", t, rc, xfer[i].status);
+        }
+    }
+
+    res->ops[0] = bench.iterations * bench.batch * 2;
+
+    free(xfer);
+}
+
+static void *bench_thread(void *arg)
+{
+    unsigned int t = (unsigned long)arg;
+    struct bench_result *res = calloc(1, sizeof(*res));
+
+    assert(res);
+    rnd_state += t;
+
+    pthread_barrier_wait(&bench_barrier);
+
+    switch ( bench.op )
+    {
+    case BENCH_MAP:      bench_map(t, res); break;
+    case BENCH_COPY:     bench_copy(t, res); break;
+    case BENCH_COPY_V2:  bench_copy_v2(t, res); break;
+    case BENCH_TRANSFER: bench_transfer(t, res); break;
+    }
+
+    return res;
+}
+
+/* All grants must have been released, and all references dropped. */
+static void check_quiesced(struct domain *d)
+{
+    struct grant_table *gt = d->grant_table;
+    unsigned long gfn;
+    grant_ref_t ref;
+
+    /* Unmaps of d still waiting for a TLB flush must have the timer armed. */
+    fire_timer(&gt->flush_timer);
+
+    for ( ref = 0; ref < nr_grant_entries(gt); ref++ )
+        if ( _active_entry(gt, ref).pin )
+        {
+            fprintf(stderr, "d%u: grant %u still pinned (%#x)\n",
+                    d->domain_id, ref, _active_entry(gt, ref).pin);
+            exit(1);
+        }
+
+    for ( gfn = 0; gfn < d->p2m_size; gfn++ )
+    {
+        mfn_t mfn = d->p2m[gfn];
+        const struct page_info *pg;
+
+        if ( mfn_eq(mfn, INVALID_MFN) )
+            continue;
+        pg = mfn_to_page(mfn);
+        if ( pg->owner != d || pg->count_info != (PGC_allocated | 1) ||
+             pg->type_info )
+        {
+            fprintf(stderr,
+                    "d%u: gfn %lx: bad owner d%d or counts %#lx/%#lx\n",
+                    d->domain_id, gfn, pg->owner ? pg->owner->domain_id : -1,
+                    pg->count_info, pg->type_info);
+            exit(1);
+        }
+    }
+}
+
+static void run_bench(void)
+{
+    unsigned int n = bench.threads * bench.batch, t;
+    unsigned long flushes;
+    pthread_t *threads = calloc(bench.threads, sizeof(*threads));
+    struct bench_result total = { };
+    const char *names[2] = { bench_names[bench.op], "unmap" };
+    unsigned int i;
+
+    assert(threads);
+
+    if ( bench.op == BENCH_COPY_V2 &&
+         bench.batch * PAGE_SIZE > GNTCOPY_V2_MAX_LEN )
+    {
+        fprintf(stderr, "copy_v2 batches are limited to %lu pages\n",
+                GNTCOPY_V2_MAX_LEN / PAGE_SIZE);
+        exit(1);
+    }
+
+    init_frames(4 * n + 8 * 1024);
+    frontend = create_domain(1, bench.threads, n, 2 * n, bench.version,
+                             GREF_BASE + 2 * n);
+    backend = create_domain(2, bench.threads, n, n, bench.version,
+                            GREF_BASE + 2 * n);
+
+    for ( i = 0; i < n; i++ )
+    {
+        unsigned int j;
+
+        grant_entry(frontend, GREF_BASE + i, GTF_permit_access,
+                    backend->domain_id, i);
+        for ( j = 0; j < PAGE_SIZE; j++ )
+            gfn_to_virt(frontend, i)[j] = copy_v2_byte(i * PAGE_SIZE + j);
+    }
+
+    pthread_barrier_init(&bench_barrier, NULL, bench.threads);
+    for ( t = 0; t < bench.threads; t++ )
+        if ( pthread_create(&threads[t], NULL, bench_thread,
+                            (void *)(unsigned long)t) )
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+
+    for ( t = 0; t < bench.threads; t++ )
+    {
+        struct bench_result *res;
+
+        pthread_join(threads[t], (void **)&res);
+        for ( i = 0; i < 2; i++ )
+        {
+            total.ns[i] += res->ns[i];
+            total.ops[i] += res->ops[i];
+        }
+        free(res);
+    }
+
+    flushes = nr_tlb_flushes;
+
+    check_quiesced(backend);
+    check_quiesced(frontend);
+
+    for ( i = 0; i < 2; i++ )
+        if ( total.ops[i] )
+            printf("%-10s v%u %2u threads batch %3u: %8.1f ns/op, "
+                   "%8.3f Mops/s\n", names[i], bench.version, bench.threads,
+                   bench.batch, (double)total.ns[i] / total.ops[i],
+                   total.ops[i] * bench.threads * 1e3 / total.ns[i]);
+    printf("TLB flushes: %lu (%.3f per op)\n",
+           flushes, (double)flushes / total.ops[0]);
+
+    free(threads);
+}
+
+/* Fuzzing of _set_status_v1() and _set_status_v2(). */
+#define FUZZ_DOMID 2
+
+static uint16_t fuzz_flags(void)
+{
+    /* Mostly valid combinations, with the odd random bit. */
+    uint16_t flags = get_random() & (GTF_type_mask | GTF_readonly |
+                                     GTF_sub_page);
+
+    if ( !(get_random() & 7) )
+        flags |= get_random();
+
+    return flags;
+}
+
+static domid_t fuzz_domid(void)
+{
+    return (get_random() & 3) ? FUZZ_DOMID : get_random();
+}
+
+static unsigned long fuzz_failed;
+
+static void fuzz_check(bool cond, const char *what, unsigned int version,
+                       uint16_t flags, domid_t domid, unsigned int pin,
+                       int readonly, int mapflag)
+{
+    if ( cond )
+        return;
+
+    fprintf(stderr,
+            "v%u %s: flags %#x domid %u pin %#x readonly %d mapflag %d\n",
+            version, what, flags, domid, pin, readonly, mapflag);
+    fuzz_failed++;
+}
+
+static void fuzz_sequential(unsigned long iterations)
+{
+    static struct domain rd;
+    unsigned long it;
+
+    for ( it = 0; it < iterations; it++ )
+    {
+        unsigned int version = (get_random() & 1) + 1;
+        struct active_grant_entry act = { };
+        union grant_combo entry, orig;
+        grant_status_t status = 0, orig_status;
+        int readonly, mapflag, rc;
+        uint16_t mask = GTF_type_mask, type;
+        bool valid;
+
+        entry.flags = fuzz_flags();
+        entry.domid = fuzz_domid();
+        mapflag = get_random() & 1;
+        readonly = get_random() & 1;
+
+        /*
+         * Callers only set the status of an already pinned entry when it
+         * is to become writable.
+         */
+        if ( get_random() & 1 )
+        {
+            act.pin = GNTPIN_hstr_inc;
+            readonly = 0;
+            if ( version == 1 )
+                entry.flags |= GTF_reading;
+            else
+                status = GTF_reading;
+        }
+        orig = entry;
+        orig_status = status;
+
+        if ( mapflag )
+            mask |= GTF_sub_page;
+        type = entry.flags & mask;
+
+        valid = act.pin ||
+                ((type == GTF_permit_access ||
+                  (version == 2 && type == GTF_transitive)) &&
+                 entry.domid == FUZZ_DOMID);
+        if ( !readonly && (entry.flags & GTF_readonly) )
+            valid = false;
+
+        if ( version == 1 )
+            rc = _set_status_v1((grant_entry_header_t *)&entry, &rd, &act,
+                                readonly, mapflag, FUZZ_DOMID);
+        else
+            rc = _set_status_v2((grant_entry_header_t *)&entry, &status, &rd,
+                                &act, readonly, mapflag, FUZZ_DOMID);
+
+        fuzz_check((rc == GNTST_okay) == valid, "result", version,
+                   orig.flags, orig.domid, act.pin, readonly, mapflag);
+        fuzz_check(entry.domid == orig.domid, "domid changed", version,
+                   orig.flags, orig.domid, act.pin, readonly, mapflag);
+
+        if ( version == 1 )
+        {
+            uint16_t expected = orig.flags;
+
+            if ( valid )
+                expected |= GTF_reading | (readonly ? 0 : GTF_writing);
+            fuzz_check(entry.flags == expected, "flags", version,
+                       orig.flags, orig.domid, act.pin, readonly, mapflag);
+        }
+        else
+        {
+            grant_status_t expected = orig_status;
+
+            if ( valid )
+                expected |= GTF_reading | (readonly ? 0 : GTF_writing);
+            fuzz_check(entry.flags == orig.flags, "flags changed", version,
+                       orig.flags, orig.domid, act.pin, readonly, mapflag);
+            fuzz_check(status == expected, "status", version,
+                       orig.flags, orig.domid, act.pin, readonly, mapflag);
+        }
+    }
+}
+
+/*
+ * Concurrent fuzzing: a "guest" thread keeps modifying the shared entry
+ * while its status is being set.  Failures are fine then, but a failed first
+ * pin must not leave any status bits set, and a successful one must have set
+ * them.
+ */
+static union grant_combo fuzz_entry;
+static bool fuzz_stop;
+
+static void *fuzz_guest(void *arg)
+{
+    rnd_state += 1;
+
+    while ( !read_atomic(&fuzz_stop) )
+    {
+        if ( get_random() & 1 )
+            __atomic_fetch_xor(&fuzz_entry.flags, GTF_readonly,
+                               __ATOMIC_SEQ_CST);
+        else
+            write_atomic(&fuzz_entry.domid, fuzz_domid());
+    }
+
+    return NULL;
+}
+
+static void fuzz_concurrent(unsigned long iterations)
+{
+    static struct domain rd;
+    pthread_t guest;
+    unsigned long it, ok = 0;
+
+    fuzz_entry.flags = GTF_permit_access;
+    fuzz_entry.domid = FUZZ_DOMID;
+    fuzz_stop = false;
+    if ( pthread_create(&guest, NULL, fuzz_guest, NULL) )
+    {
+        perror("pthread_create");
+        exit(1);
+    }
+
+    for ( it = 0; it < iterations; it++ )
+    {
+        unsigned int version = (it & 1) + 1;
+        struct active_grant_entry act = { };
+        grant_status_t status = 0;
+        int readonly = get_random() & 1, rc;
+
+        if ( version == 1 )
+        {
+            /* Undo the previous pin, as the release would. */
+            __atomic_fetch_and(&fuzz_entry.flags,
+                               (uint16_t)~(GTF_reading | GTF_writing),
+                               __ATOMIC_SEQ_CST);
+            rc = _set_status_v1((grant_entry_header_t *)&fuzz_entry, &rd,
+                                &act, readonly, 1, FUZZ_DOMID);
+            if ( rc == GNTST_okay )
+                fuzz_check(read_atomic(&fuzz_entry.flags) & GTF_reading,
+                           "concurrent: not reading", version, 0, 0, 0,
+                           readonly, 1);
+        }
+        else
+        {
+            rc = _set_status_v2((grant_entry_header_t *)&fuzz_entry, &status,
+                                &rd, &act, readonly, 1, FUZZ_DOMID);
+            if ( rc == GNTST_okay )
+                fuzz_check(status == (GTF_reading |
+                                      (readonly ? 0 : GTF_writing)),
+                           "concurrent: status not set", version, 0, 0, 0,
+                           readonly, 1);
+            else
+                fuzz_check(!status, "concurrent: stale status", version,
+                           0, 0, 0, readonly, 1);
+        }
+
+        ok += rc == GNTST_okay;
+
+        /* Let the guest run also when there's a single CPU. */
+        if ( !(it & 15) )
+            sched_yield();
+    }
+
+    write_atomic(&fuzz_stop, true);
+    pthread_join(guest, NULL);
+
+    printf("concurrent: %lu of %lu status updates succeeded\n",
+           ok, iterations);
+}
+
+/*
+ * Tests of cached (GNTMAP_cache) mappings of grants of v2 frontends, and of
+ * a v1 one, by the backend.
+ */
+static unsigned long cache_failed;
+
+static void cache_check(bool cond, const char *what)
+{
+    if ( cond )
+        return;
+
+    fprintf(stderr, "cache: %s\n", what);
+    cache_failed++;
+}
+
+static struct gnttab_map_grant_ref cache_map(const struct domain *rd,
+                                             grant_ref_t ref,
+                                             unsigned long gfn)
+{
+    struct gnttab_map_grant_ref map = {
+        .host_addr = (uint64_t)gfn << PAGE_SHIFT,
+        .flags = GNTMAP_host_map | GNTMAP_cache,
+        .ref = ref,
+        .dom = rd->domain_id,
+    };
+
+    if ( grant_op(backend, 0, GNTTABOP_map_grant_ref, &map, 1) )
+        map.status = GNTST_general_error;
+
+    return map;
+}
+
+static int16_t cache_unmap(const struct gnttab_map_grant_ref *map)
+{
+    struct gnttab_unmap_grant_ref unmap = {
+        .host_addr = map->host_addr,
+        .handle = map->handle,
+    };
+
+    if ( grant_op(backend, 0, GNTTABOP_unmap_grant_ref, &unmap, 1) )
+        return GNTST_general_error;
+
+    return unmap.status;
+}
+
+static bool cache_pinned(const struct domain *rd, grant_ref_t ref)
+{
+    return read_atomic(&_active_entry(rd->grant_table, ref).pin);
+}
+
+static void run_cache_tests(void)
+{
+    struct domain *v1front, *deadfront;
+    struct gnttab_map_grant_ref map, other, lru[GNTTAB_CACHE_SCAN];
+    unsigned int i;
+
+    init_frames(1024);
+    frontend = create_domain(1, 1, 32, 32, 2, GREF_BASE + 32);
+    backend = create_domain(2, 1, 0, 64, 2, GREF_BASE);
+    v1front = create_domain(3, 1, 32, 32, 1, GREF_BASE + 32);
+    deadfront = create_domain(4, 1, 32, 32, 2, GREF_BASE + 32);
+
+    for ( i = 0; i < 32; i++ )
+    {
+        grant_entry(frontend, GREF_BASE + i, GTF_permit_access,
+                    backend->domain_id, i);
+        grant_entry(v1front, GREF_BASE + i, GTF_permit_access,
+                    backend->domain_id, i);
+        grant_entry(deadfront, GREF_BASE + i, GTF_permit_access,
+                    backend->domain_id, i);
+    }
+
+    /* A released mapping is handed back, still pinning the grant. */
+    map = cache_map(frontend, GREF_BASE, 1);
+    cache_check(map.status == GNTST_okay && (map.flags & GNTMAP_cache),
+                "map not cached");
+    cache_check(cache_unmap(&map) == GNTST_okay, "release failed");
+    cache_check(cache_pinned(frontend, GREF_BASE),
+                "released mapping not pinned");
+    other = cache_map(frontend, GREF_BASE, 1);
+    cache_check(other.status == GNTST_okay && other.handle == map.handle &&
+                other.host_addr == map.host_addr, "no hit");
+
+    /* ... but only for a map at the same address. */
+    cache_check(cache_unmap(&map) == GNTST_okay, "release failed");
+    other = cache_map(frontend, GREF_BASE, 2);
+    cache_check(other.status == GNTST_okay && other.handle != map.handle &&
+                other.host_addr == ((uint64_t)2 << PAGE_SHIFT) &&
+                !(other.flags & GNTMAP_cache), "hit at another address");
+    cache_check(cache_unmap(&other) == GNTST_okay, "unmap failed");
+
+    /* A revoked grant's released mapping is evicted when looked up... */
+    grant_entry(frontend, GREF_BASE, 0, backend->domain_id, 0);
+    other = cache_map(frontend, GREF_BASE, 1);
+    cache_check(other.status != GNTST_okay, "revoked grant mapped");
+    cache_check(!cache_pinned(frontend, GREF_BASE) &&
+                !status_entry(frontend->grant_table, GREF_BASE),
+                "revoked grant still pinned after lookup");
+
+    /* ... by the check done on map and unmap hypercalls... */
+    map = cache_map(frontend, GREF_BASE + 1, 3);
+    cache_check(cache_unmap(&map) == GNTST_okay, "release failed");
+    grant_entry(frontend, GREF_BASE + 1, 0, backend->domain_id, 1);
+    other = cache_map(frontend, GREF_BASE + 2, 4);
+    cache_check(!cache_pinned(frontend, GREF_BASE + 1),
+                "revoked grant still pinned after hypercall");
+
+    /* ... and by the periodic check while the backend is idle. */
+    map = cache_map(frontend, GREF_BASE + 4, 5);
+    cache_check(cache_unmap(&map) == GNTST_okay, "release failed");
+    grant_entry(frontend, GREF_BASE + 4, 0, backend->domain_id, 4);
+    fire_timer(&backend->grant_table->cache_timer);
+    cache_check(!cache_pinned(frontend, GREF_BASE + 4),
+                "revoked grant still pinned after periodic check");
+    cache_check(!backend->grant_table->cache_timer.armed,
+                "periodic check continued without released mappings");
+
+    /* Unmapping a released mapping again really unmaps it. */
+    cache_check(cache_unmap(&other) == GNTST_okay, "release failed");
+    cache_check(cache_unmap(&other) == GNTST_okay, "teardown failed");
+    cache_check(!cache_pinned(frontend, GREF_BASE + 2),
+                "torn down mapping still pinned");
+
+    /* v1 grants don't get cached. */
+    map = cache_map(v1front, GREF_BASE, 5);
+    cache_check(map.status == GNTST_okay && !(map.flags & GNTMAP_cache),
+                "v1 grant cached");
+    cache_check(cache_unmap(&map) == GNTST_okay, "unmap failed");
+    cache_check(!cache_pinned(v1front, GREF_BASE), "v1 grant still pinned");
+
+    /*
+     * All released mappings of a dead granter's grants are dropped when it
+     * dies, also behind more recently checked ones, without the backend
+     * issuing any hypercall.
+     */
+    for ( i = 0; i < ARRAY_SIZE(lru); i++ )
+    {
+        lru[i] = cache_map(frontend, GREF_BASE + 8 + i, 8 + i);
+        cache_check(cache_unmap(&lru[i]) == GNTST_okay, "release failed");
+    }
+    map = cache_map(deadfront, GREF_BASE, 6);
+    cache_check(cache_unmap(&map) == GNTST_okay, "release failed");
+    other = cache_map(deadfront, GREF_BASE + 1, 7);
+    cache_check(cache_unmap(&other) == GNTST_okay, "release failed");
+
+    deadfront->is_dying = true;
+    gnttab_release_mappings(deadfront);
+
+    cache_check(!cache_pinned(deadfront, GREF_BASE) &&
+                !cache_pinned(deadfront, GREF_BASE + 1),
+                "dead granter's grants still pinned");
+    for ( i = 0; i < ARRAY_SIZE(lru); i++ )
+        cache_check(cache_pinned(frontend, GREF_BASE + 8 + i),
+                    "live granter's grant evicted");
+
+    /* Unmap the remaining mappings. */
+    for ( i = 0; i < ARRAY_SIZE(lru); i++ )
+        cache_check(cache_unmap(&lru[i]) == GNTST_okay, "teardown failed");
+
+    check_quiesced(backend);
+    check_quiesced(frontend);
+    check_quiesced(v1front);
+    check_quiesced(deadfront);
+}
+
+/*
+ * Tests of gnttab_get_read_frame(), which pins a grant for Xen to read the
+ * granted frame on the grantee's behalf.
+ */
+static unsigned long read_failed;
+
+static void read_check(bool cond, const char *what)
+{
+    if ( cond )
+        return;
+
+    fprintf(stderr, "read: %s\n", what);
+    read_failed++;
+}
+
+static void run_read_tests(void)
+{
+    struct grant_table *gt;
+    mfn_t mfn;
+
+    init_frames(256);
+    frontend = create_domain(1, 1, 8, 8, 1, GREF_BASE + 8);
+    backend = create_domain(2, 1, 0, 8, 1, GREF_BASE);
+    gt = frontend->grant_table;
+
+    grant_entry(frontend, GREF_BASE, GTF_permit_access | GTF_readonly,
+                backend->domain_id, 1);
+    grant_entry(frontend, GREF_BASE + 1, GTF_permit_access,
+                backend->domain_id + 1, 2);
+
+    /* A pinned grant has the frame of its gfn and can't be revoked. */
+    read_check(!gnttab_get_read_frame(frontend, GREF_BASE, backend->domain_id,
+                                      100, 200, &mfn), "read failed");
+    read_check(mfn_eq(mfn, frontend->p2m[1]), "wrong frame");
+    read_check(_active_entry(gt, GREF_BASE).pin == GNTPIN_hstr_inc &&
+               (shared_entry_v1(gt, GREF_BASE).flags & GTF_reading),
+               "grant not pinned for reading");
+    gnttab_put_read_frame(frontend, GREF_BASE, mfn);
+    read_check(!_active_entry(gt, GREF_BASE).pin &&
+               !(shared_entry_v1(gt, GREF_BASE).flags & GTF_reading),
+               "grant still pinned");
+
+    /* Reads beyond the frame, or on behalf of another domain, are refused. */
+    read_check(gnttab_get_read_frame(frontend, GREF_BASE, backend->domain_id,
+                                     PAGE_SIZE - 8, 9, &mfn) == -EINVAL,
+               "read beyond the frame");
+    read_check(gnttab_get_read_frame(frontend, GREF_BASE + 1,
+                                     backend->domain_id, 0, 1, &mfn) == -EACCES,
+               "read of a grant to another domain");
+    read_check(gnttab_get_read_frame(frontend, GREF_BASE + 2,
+                                     backend->domain_id, 0, 1, &mfn) == -EACCES,
+               "read of an unused grant");
+    read_check(gnttab_get_read_frame(frontend, ~0U, backend->domain_id, 0, 1,
+                                     &mfn) == -ENOENT,
+               "read of a bad grant reference");
+
+    check_quiesced(frontend);
+    check_quiesced(backend);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "       [map|copy|copy_v2|transfer|fuzz|cache|read]\n"
+            "  -t <n>   number of threads (default %u)\n"
+            "  -b <n>   operations per hypercall (default %u)\n"
+            "  -n <n>   iterations (default %lu)\n"
+            "  -2       use grant table v2\n"
+            "  -g <s>   gnttab= command line option, e.g. deferred-flush\n"
+            "  -s <n>   random seed\n"
+            "  -p <n>   preempt hypercalls at every <n>th check\n"
+            "  -v       verbose hypervisor messages\n",
+            prog, bench.threads, bench.batch, bench.iterations);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    bool fuzz = false, cache = false, read = false;
+    int c;
+
+    while ( (c = getopt(argc, argv, "t:b:n:2g:s:p:v")) != -1 )
+    {
+        switch ( c )
+        {
+        case 't':
+            bench.threads = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            bench.batch = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            bench.iterations = strtoul(optarg, NULL, 0);
+            break;
+        case '2':
+            bench.version = 2;
+            break;
+        case 'g':
+            if ( parse_gnttab(optarg) )
+            {
+                fprintf(stderr, "bad gnttab option '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        case 's':
+            rnd_state = strtoull(optarg, NULL, 0) | 1;
+            break;
+        case 'p':
+            preempt_interval = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if ( !bench.threads || !bench.batch ||
+         bench.batch > GNTTAB_UNMAP_BATCH_SIZE * 32 )
+        usage(argv[0]);
+
+    if ( optind < argc )
+    {
+        if ( !strcmp(argv[optind], "fuzz") )
+            fuzz = true;
+        else if ( !strcmp(argv[optind], "cache") )
+            cache = true;
+        else if ( !strcmp(argv[optind], "read") )
+            read = true;
+        else
+        {
+            for ( bench.op = 0; bench.op < ARRAY_SIZE(bench_names);
+                  bench.op++ )
+                if ( !strcmp(argv[optind], bench_names[bench.op]) )
+                    break;
+            if ( bench.op == ARRAY_SIZE(bench_names) )
+                usage(argv[0]);
+        }
+    }
+
+    if ( fuzz )
+    {
+        fuzz_sequential(bench.iterations * 100);
+        fuzz_concurrent(bench.iterations * 10);
+        if ( fuzz_failed )
+        {
+            printf("fuzz: %lu failures\n", fuzz_failed);
+            return 1;
+        }
+        printf("fuzz: all status transitions as expected\n");
+        return 0;
+    }
+
+    if ( cache )
+    {
+        run_cache_tests();
+        if ( cache_failed )
+        {
+            printf("cache: %lu failures\n", cache_failed);
+            return 1;
+        }
+        printf("cache: all cached mapping checks passed\n");
+        return 0;
+    }
+
+    if ( read )
+    {
+        run_read_tests();
+        if ( read_failed )
+        {
+            printf("read: %lu failures\n", read_failed);
+            return 1;
+        }
+        printf("read: all grant read checks passed\n");
+        return 0;
+    }
+
+    run_bench();
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
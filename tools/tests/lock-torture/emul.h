@@ -0,0 +1,136 @@
+/*
+ * Spin lock torture test and benchmark: harness emulating the hypervisor
+ * environment, with threads standing in for CPUs.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TEST_LOCK_TORTURE_
+#define _TEST_LOCK_TORTURE_
+
+#include <assert.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_QUEUED_SPINLOCKS
+
+#define NR_CPUS         256
+#define PAGE_SIZE       4096
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int64_t s_time_t;
+typedef u8 nodeid_t;
+
+#define __init
+#define __read_mostly
+#define __maybe_unused  __attribute__((__unused__))
+#define noinline        __attribute__((__noinline__))
+#define always_inline   inline __attribute__((__always_inline__))
+#define __cacheline_aligned __attribute__((__aligned__(64)))
+#define likely(x)       __builtin_expect(!!(x), 1)
+#define unlikely(x)     __builtin_expect(!!(x), 0)
+
+#define ASSERT(x)       assert(x)
+#define BUG_ON(x)       assert(!(x))
+#define BUILD_BUG_ON(cond) ((void)sizeof(struct { int:-!!(cond); }))
+
+#define barrier()       asm volatile ( "" ::: "memory" )
+#define smp_mb()        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb()       __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb()       __atomic_thread_fence(__ATOMIC_RELEASE)
+
+/*
+ * With more threads than host CPUs, spinning for a thread which isn't running
+ * would take until the end of the time slice: yield instead.
+ */
+extern bool emul_yield;
+#if defined(__i386__) || defined(__x86_64__)
+#define arch_pause()    __builtin_ia32_pause()
+#else
+#define arch_pause()    barrier()
+#endif
+#define cpu_relax()                                                 \
+    do {                                                            \
+        if ( unlikely(emul_yield) )                                 \
+            sched_yield();                                          \
+        else                                                        \
+            arch_pause();                                           \
+    } while ( 0 )
+
+#define read_atomic(p)      __atomic_load_n(p, __ATOMIC_RELAXED)
+#define write_atomic(p, x)  __atomic_store_n(p, x, __ATOMIC_RELAXED)
+#define add_sized(p, x)     write_atomic(p, read_atomic(p) + (x))
+#define cmpxchg(p, o, n)    __sync_val_compare_and_swap(p, o, n)
+#define arch_fetch_and_add(p, x) __sync_fetch_and_add(p, x)
+
+#define arch_lock_acquire_barrier() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define arch_lock_release_barrier() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define arch_lock_relax()           cpu_relax()
+#define arch_lock_signal()
+#define arch_lock_signal_wmb()      smp_wmb()
+
+/* Each thread is a CPU, which never gets interrupted. */
+extern __thread unsigned int emul_cpu;
+#define smp_processor_id()          emul_cpu
+
+#define preempt_disable()           ((void)0)
+#define preempt_enable()            ((void)0)
+#define local_irq_disable()         ((void)0)
+#define local_irq_enable()          ((void)0)
+#define local_irq_save(x)           ((x) = 0)
+#define local_irq_restore(x)        ((void)(x))
+#define local_irq_is_enabled()      true
+
+#define NUMA_NO_NODE                0xff
+#define cpu_to_node(cpu)            ((nodeid_t)0)
+#define MEMF_node(n)                0u
+#define alloc_xenheap_pages(order, memflags) \
+    ((void)(memflags), aligned_alloc(PAGE_SIZE, PAGE_SIZE << (order)))
+#define clear_page(p)               memset(p, 0, PAGE_SIZE)
+
+struct notifier_block {
+    int (*notifier_call)(struct notifier_block *nfb, unsigned long action,
+                         void *hcpu);
+};
+#define NOTIFY_DONE                 0
+#define CPU_UP_PREPARE              1
+
+/* CPUs other than 0 are brought up by emul_cpu_up(). */
+void register_cpu_notifier(struct notifier_block *nb);
+void emul_cpu_up(unsigned int cpu);
+#define presmp_initcall(fn)                                         \
+    static void __attribute__((__constructor__)) fn ## _ctor(void)  \
+    {                                                               \
+        fn();                                                       \
+    }
+
+#include "spinlock.h"
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
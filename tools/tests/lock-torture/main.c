@@ -0,0 +1,369 @@
+/*
+ * Spin lock torture test and benchmark.
+ *
+ * The tests hammer ticket and queued locks from several threads, each
+ * standing in for a CPU, and check mutual exclusion, trylocks, recursive
+ * locks and spin_barrier().  Queued locks are also tried with some of the
+ * CPUs lacking queue nodes, for them to spin on the lock instead.
+ *
+ * The benchmark then measures, for increasing numbers of threads contending
+ * for a single lock, the throughput of lock operations, and the fairness of
+ * their distribution over the threads (the ratio of the fewest to the most
+ * acquisitions by a thread, and Jain's fairness index).
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "emul.h"
+
+#define CHECK(cond, fmt, ...)                                           \
+    do {                                                                \
+        if ( !(cond) )                                                  \
+        {                                                               \
+            fprintf(stderr, "%s:%d: " fmt "\n", __func__, __LINE__,     \
+                    ## __VA_ARGS__);                                    \
+            exit(1);                                                    \
+        }                                                               \
+    } while ( 0 )
+
+/* CPUs from here on never get queue nodes. */
+#define CPUS_UP         (NR_CPUS / 2)
+
+__thread unsigned int emul_cpu;
+bool emul_yield;
+
+static struct notifier_block *cpu_nb;
+
+void register_cpu_notifier(struct notifier_block *nb)
+{
+    cpu_nb = nb;
+}
+
+void emul_cpu_up(unsigned int cpu)
+{
+    cpu_nb->notifier_call(cpu_nb, CPU_UP_PREPARE, (void *)(long)cpu);
+}
+
+static const char *const kinds[] = { "ticket", "queued" };
+
+static void init_lock(spinlock_t *lock, unsigned int queued)
+{
+    if ( queued )
+        spin_lock_init_queued(lock);
+    else
+        spin_lock_init(lock);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void delay(unsigned int loops)
+{
+    while ( loops-- )
+        barrier();
+}
+
+static cpu_set_t host_cpus;
+
+struct worker {
+    pthread_t thread;
+    unsigned int cpu;
+    void *(*fn)(struct worker *w);
+    uint64_t count;
+} __cacheline_aligned;
+
+static void *worker_start(void *arg)
+{
+    struct worker *w = arg;
+    cpu_set_t set;
+    unsigned int i, n = w->cpu % CPU_COUNT(&host_cpus);
+
+    /* Spread the threads over the CPUs we may run on. */
+    for ( i = 0; i < CPU_SETSIZE; i++ )
+        if ( CPU_ISSET(i, &host_cpus) && !n-- )
+            break;
+    CPU_ZERO(&set);
+    CPU_SET(i, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    emul_cpu = w->cpu;
+
+    return w->fn(w);
+}
+
+static void run(struct worker *w, unsigned int nr, void *(*fn)(struct worker *),
+                const unsigned int *cpus)
+{
+    unsigned int i;
+
+    emul_yield = nr > CPU_COUNT(&host_cpus);
+
+    for ( i = 0; i < nr; i++ )
+    {
+        w[i].cpu = cpus ? cpus[i] : i;
+        w[i].fn = fn;
+        w[i].count = 0;
+        CHECK(!pthread_create(&w[i].thread, NULL, worker_start, &w[i]),
+              "pthread_create");
+    }
+    for ( i = 0; i < nr; i++ )
+        pthread_join(w[i].thread, NULL);
+}
+
+/* Tests. */
+
+#define TEST_THREADS    8
+#define TEST_ITERATIONS 200000
+
+static spinlock_t test_lock;
+static volatile int test_owner = -1;
+static volatile unsigned long test_count;
+
+static void test_cs(struct worker *w)
+{
+    CHECK(test_owner == -1, "cpu%u got the lock held by cpu%d",
+          w->cpu, test_owner);
+    test_owner = w->cpu;
+    test_count++;
+    CHECK(spin_is_locked(&test_lock), "lock not locked");
+    test_owner = -1;
+}
+
+static void *test_worker(struct worker *w)
+{
+    unsigned int i;
+
+    for ( i = 0; i < TEST_ITERATIONS; i++ )
+    {
+        switch ( i % 8 )
+        {
+        case 0:
+            while ( !spin_trylock(&test_lock) )
+                cpu_relax();
+            test_cs(w);
+            spin_unlock(&test_lock);
+            break;
+
+        case 1:
+            spin_lock_recursive(&test_lock);
+            spin_lock_recursive(&test_lock);
+            test_cs(w);
+            spin_unlock_recursive(&test_lock);
+            test_cs(w);
+            spin_unlock_recursive(&test_lock);
+            break;
+
+        default:
+            spin_lock(&test_lock);
+            test_cs(w);
+            spin_unlock(&test_lock);
+            break;
+        }
+        w->count += 1 + (i % 8 == 1);
+    }
+
+    return NULL;
+}
+
+static void test_exclusion(unsigned int queued, const unsigned int *cpus)
+{
+    struct worker w[TEST_THREADS];
+    unsigned long expected = 0;
+    unsigned int i;
+
+    init_lock(&test_lock, queued);
+    test_count = 0;
+
+    run(w, TEST_THREADS, test_worker, cpus);
+
+    for ( i = 0; i < TEST_THREADS; i++ )
+        expected += w[i].count;
+    CHECK(test_count == expected, "%s: %lu critical sections, expected %lu",
+          kinds[queued], test_count, expected);
+    CHECK(!spin_is_locked(&test_lock), "%s: lock left locked",
+          kinds[queued]);
+}
+
+static volatile bool barrier_released;
+
+static void *barrier_worker(struct worker *w)
+{
+    spin_barrier(&test_lock);
+    CHECK(barrier_released, "spin_barrier() returned while locked");
+
+    return NULL;
+}
+
+static void test_barrier(unsigned int queued)
+{
+    struct worker w;
+    struct timespec ts = { .tv_nsec = 10000000 };
+
+    init_lock(&test_lock, queued);
+    emul_cpu = 0;
+
+    barrier_released = false;
+    spin_lock(&test_lock);
+    w.cpu = 1;
+    w.fn = barrier_worker;
+    CHECK(!pthread_create(&w.thread, NULL, worker_start, &w),
+          "pthread_create");
+    nanosleep(&ts, NULL);
+    barrier_released = true;
+    spin_unlock(&test_lock);
+    pthread_join(w.thread, NULL);
+
+    /* Unlocked: no waiting. */
+    spin_barrier(&test_lock);
+}
+
+/* Benchmark. */
+
+#define BENCH_MS        200
+#define BENCH_CS        50      /* Delay loops inside the critical section */
+#define BENCH_OUTSIDE   100     /* Delay loops between critical sections */
+
+static spinlock_t bench_lock;
+static volatile bool bench_stop;
+static volatile unsigned long bench_data[8] __cacheline_aligned;
+
+static void *bench_worker(struct worker *w)
+{
+    while ( !bench_stop )
+    {
+        spin_lock(&bench_lock);
+        bench_data[0]++;
+        delay(BENCH_CS);
+        bench_data[7]++;
+        spin_unlock(&bench_lock);
+        w->count++;
+        delay(BENCH_OUTSIDE);
+    }
+
+    return NULL;
+}
+
+static void *bench_sleeper(void *arg)
+{
+    struct timespec ts = { .tv_sec = BENCH_MS / 1000,
+                           .tv_nsec = (BENCH_MS % 1000) * 1000000L };
+
+    nanosleep(&ts, NULL);
+    bench_stop = true;
+
+    return NULL;
+}
+
+static void *bench_start(struct worker *w)
+{
+    pthread_t sleeper;
+
+    /* The first worker also stops the benchmark. */
+    if ( !w->cpu )
+        CHECK(!pthread_create(&sleeper, NULL, bench_sleeper, NULL),
+              "pthread_create");
+    bench_worker(w);
+    if ( !w->cpu )
+        pthread_join(sleeper, NULL);
+
+    return NULL;
+}
+
+static void bench(unsigned int queued, unsigned int nr)
+{
+    struct worker w[CPUS_UP];
+    uint64_t total = 0, min = UINT64_MAX, max = 0;
+    double sq = 0, t;
+    unsigned int i;
+
+    init_lock(&bench_lock, queued);
+    bench_stop = false;
+
+    t = now_ns();
+    run(w, nr, bench_start, NULL);
+    t = now_ns() - t;
+
+    for ( i = 0; i < nr; i++ )
+    {
+        total += w[i].count;
+        sq += (double)w[i].count * w[i].count;
+        min = w[i].count < min ? w[i].count : min;
+        max = w[i].count > max ? w[i].count : max;
+    }
+
+    printf("%-8s %8u %12.3f %10.3f %10.3f\n", kinds[queued], nr,
+           total * 1e3 / t, max ? (double)min / max : 0,
+           sq ? (double)total * total / (nr * sq) : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int i, nr, queued, cpus[TEST_THREADS];
+
+    CHECK(!sched_getaffinity(0, sizeof(host_cpus), &host_cpus),
+          "sched_getaffinity");
+
+    for ( i = 1; i < CPUS_UP; i++ )
+        emul_cpu_up(i);
+
+    for ( queued = 0; queued < 2; queued++ )
+    {
+        test_exclusion(queued, NULL);
+        test_barrier(queued);
+    }
+
+    /* Half of the CPUs without queue nodes, falling back to spinning. */
+    for ( i = 0; i < TEST_THREADS; i++ )
+        cpus[i] = i & 1 ? CPUS_UP + i : i;
+    test_exclusion(1, cpus);
+
+    printf("lock torture tests passed\n");
+
+    printf("%-8s %8s %12s %10s %10s\n",
+           "lock", "threads", "Mlocks/s", "min/max", "fairness");
+    for ( nr = 1; ; nr *= 2 )
+    {
+        if ( nr > CPU_COUNT(&host_cpus) )
+            nr = CPU_COUNT(&host_cpus);
+        if ( nr > CPUS_UP )
+            nr = CPUS_UP;
+
+        for ( queued = 0; queued < 2; queued++ )
+            bench(queued, nr);
+
+        if ( nr == CPU_COUNT(&host_cpus) || nr == CPUS_UP )
+            break;
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
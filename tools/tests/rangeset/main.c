@@ -0,0 +1,262 @@
+/*
+ * Unit tests and benchmark for rangesets.
+ *
+ * The tests apply random additions and removals to a rangeset and to a
+ * reference bitmap, and check after each of them that the two agree, and
+ * that the rangeset's ranges are ordered, disjoint and maximal.  The
+ * benchmark then times lookups and updates on rangesets of increasing size.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include "emul.h"
+
+#define UNIVERSE    1024
+#define ITERATIONS  20000
+
+static bool ref[UNIVERSE];
+
+#define CHECK(cond, fmt, ...)                                           \
+    do {                                                                \
+        if ( !(cond) )                                                  \
+        {                                                               \
+            fprintf(stderr, "%s:%d: " fmt "\n", __func__, __LINE__,     \
+                    ## __VA_ARGS__);                                    \
+            exit(1);                                                    \
+        }                                                               \
+    } while ( 0 )
+
+struct walk {
+    unsigned long next;             /* Lowest value the next range may have */
+    unsigned int nr;
+};
+
+static int check_range(unsigned long s, unsigned long e, void *data)
+{
+    struct walk *w = data;
+    unsigned long i;
+
+    CHECK(s <= e, "inverted range [%lu, %lu]", s, e);
+    /* Adjacent ranges should have been merged. */
+    CHECK(!w->nr || s > w->next, "range [%lu, %lu] not after %lu",
+          s, e, w->next);
+    CHECK(s < UNIVERSE && e < UNIVERSE, "range [%lu, %lu] out of bounds",
+          s, e);
+
+    for ( i = w->nr ? w->next : 0; i < s; i++ )
+        CHECK(!ref[i], "%lu missing", i);
+    for ( i = s; i <= e; i++ )
+        CHECK(ref[i], "%lu unexpectedly present", i);
+
+    w->next = e + 1;
+    w->nr++;
+
+    return 0;
+}
+
+static void check(struct rangeset *r)
+{
+    struct walk w = { };
+    unsigned long i;
+
+    CHECK(!rangeset_report_ranges(r, 0, ~0UL, check_range, &w),
+          "report_ranges failed");
+    for ( i = w.nr ? w.next : 0; i < UNIVERSE; i++ )
+        CHECK(!ref[i], "%lu missing at the end", i);
+    CHECK(rangeset_is_empty(r) == !w.nr, "is_empty wrong");
+}
+
+static void test_random(void)
+{
+    struct rangeset *r = rangeset_new(NULL, "test", 0);
+    unsigned int i;
+
+    CHECK(r, "rangeset_new failed");
+
+    for ( i = 0; i < ITERATIONS; i++ )
+    {
+        unsigned long s = rand() % UNIVERSE;
+        unsigned long e = s + rand() % (rand() % 4 ? 8 : 64);
+        unsigned long j;
+        bool add = rand() % 2, contains = true, overlaps = false;
+
+        if ( e >= UNIVERSE )
+            e = UNIVERSE - 1;
+
+        for ( j = s; j <= e; j++ )
+        {
+            contains &= ref[j];
+            overlaps |= ref[j];
+        }
+        CHECK(rangeset_contains_range(r, s, e) == contains,
+              "contains_range(%lu, %lu)", s, e);
+        CHECK(rangeset_overlaps_range(r, s, e) == overlaps,
+              "overlaps_range(%lu, %lu)", s, e);
+
+        if ( add )
+            CHECK(!rangeset_add_range(r, s, e), "add_range(%lu, %lu)", s, e);
+        else
+            CHECK(!rangeset_remove_range(r, s, e),
+                  "remove_range(%lu, %lu)", s, e);
+
+        for ( j = s; j <= e; j++ )
+            ref[j] = add;
+
+        check(r);
+    }
+
+    rangeset_destroy(r);
+}
+
+static int consume(unsigned long s, unsigned long e, void *data,
+                   unsigned long *c)
+{
+    unsigned long *total = data;
+
+    /* Take one at a time, to exercise partial consumption. */
+    *c = 1;
+    ref[s] = false;
+    ++*total;
+
+    return 0;
+}
+
+static void test_claim_swap_consume(void)
+{
+    struct rangeset *a = rangeset_new(NULL, "a", 0);
+    struct rangeset *b = rangeset_new(NULL, "b", 0);
+    unsigned long s, total = 0, expected = 0, i;
+
+    CHECK(a && b, "rangeset_new failed");
+
+    memset(ref, 0, sizeof(ref));
+
+    CHECK(!rangeset_add_range(a, 10, 19), "add");
+    CHECK(!rangeset_add_range(a, 30, 39), "add");
+
+    /* The first gap large enough is right at the start. */
+    CHECK(!rangeset_claim_range(a, 5, &s) && s == 0, "claim 5 -> %lu", s);
+    CHECK(!rangeset_claim_range(a, 8, &s) && s == 20, "claim 8 -> %lu", s);
+    CHECK(!rangeset_claim_range(a, 3, &s) && s == 5, "claim 3 -> %lu", s);
+    for ( i = 0; i < 40; i++ )
+        ref[i] = i < 8 || (i >= 10 && i < 28) || i >= 30;
+    check(a);
+
+    rangeset_swap(a, b);
+    CHECK(rangeset_is_empty(a), "swap left a non-empty");
+    check(b);
+
+    CHECK(!rangeset_merge(a, b), "merge");
+    check(a);
+
+    for ( i = 0; i < UNIVERSE; i++ )
+        expected += ref[i];
+    CHECK(!rangeset_consume_ranges(a, consume, &total), "consume");
+    CHECK(rangeset_is_empty(a) && total == expected,
+          "consumed %lu of %lu", total, expected);
+    check(a);
+
+    /* A limited rangeset runs out of ranges, but can still merge them. */
+    rangeset_limit(a, 2);
+    CHECK(!rangeset_add_range(a, 0, 0) && !rangeset_add_range(a, 2, 2),
+          "add within limit");
+    CHECK(rangeset_add_range(a, 4, 4) == -ENOMEM, "add beyond limit");
+    CHECK(!rangeset_add_range(a, 1, 1), "merging add");
+    CHECK(!rangeset_add_range(a, 4, 4), "add after merge");
+
+    rangeset_destroy(a);
+    rangeset_destroy(b);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Time lookups in, and updates to, a set of @nr disjoint ranges, like the
+ * iomem permissions of a domain with many passthrough MMIO regions.
+ */
+static void bench(unsigned long nr)
+{
+    struct rangeset *r = rangeset_new(NULL, "bench", 0);
+    unsigned long i, hits = 0, lookups = 1000000, updates = 100000;
+    double t0, t_build, t_lookup, t_update;
+
+    CHECK(r, "rangeset_new failed");
+
+    /* Insert in a scattered order, i.e. not only ever at the end. */
+    t0 = now_ns();
+    for ( i = 0; i < nr; i++ )
+    {
+        unsigned long j = (i * 7919) % nr;
+
+        CHECK(!rangeset_add_range(r, j * 16, j * 16 + 7), "add");
+    }
+    t_build = now_ns() - t0;
+
+    t0 = now_ns();
+    for ( i = 0; i < lookups; i++ )
+        hits += rangeset_contains_singleton(r, rand() % (nr * 16));
+    t_lookup = now_ns() - t0;
+
+    /* Punch a hole and fill it again, as e.g. vPCI BAR remapping does. */
+    t0 = now_ns();
+    for ( i = 0; i < updates; i++ )
+    {
+        unsigned long s = (rand() % nr) * 16 + 2;
+
+        CHECK(!rangeset_remove_range(r, s, s + 2), "remove");
+        CHECK(!rangeset_add_range(r, s, s + 2), "add");
+    }
+    t_update = now_ns() - t0;
+
+    printf("%10lu %14.1f %14.1f %14.1f   (%lu%% hits)\n", nr,
+           t_build / nr, t_lookup / lookups, t_update / (2 * updates),
+           hits * 100 / lookups);
+
+    rangeset_destroy(r);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long nr;
+
+    srand(1);
+
+    test_random();
+    test_claim_swap_consume();
+    printf("rangeset tests passed\n");
+
+    printf("%10s %14s %14s %14s\n",
+           "ranges", "ns/insert", "ns/lookup", "ns/update");
+    for ( nr = 16; nr <= (1UL << 16); nr <<= 2 )
+        bench(nr);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
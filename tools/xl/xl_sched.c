@@ -246,6 +246,39 @@ static int sched_credit2_pool_output(uint32_t poolid)
     return 0;
 }
 
+static int sched_credit2_stats_output(uint32_t poolid)
+{
+    libxl_sched_credit2_runqueue_stats *stats;
+    char *poolname = libxl_cpupoolid_to_name(ctx, poolid);
+    int i, nr = 0;
+
+    stats = libxl_sched_credit2_stats_get(ctx, poolid, &nr);
+    if (!stats) {
+        fprintf(stderr, "libxl_sched_credit2_stats_get failed.\n");
+        free(poolname);
+        return 1;
+    }
+
+    printf("Cpupool %s:\n", poolname);
+    printf("%-4s %5s %7s %8s %10s %10s %10s %10s %12s %8s %8s\n",
+           "RunQ", "CPUs", "Load%", "BLoad%", "Intvl(us)", "Checks",
+           "Skipped", "Attempts", "Candidates", "Pushed", "Pulled");
+    for (i = 0; i < nr; i++)
+        printf("%-4u %5u %7u %8u %10"PRIu64" %10"PRIu64" %10"PRIu64
+               " %10"PRIu64" %12"PRIu64" %8"PRIu64" %8"PRIu64"\n",
+               stats[i].id, stats[i].nr_cpus,
+               stats[i].avgload, stats[i].b_avgload,
+               stats[i].balance_interval_us, stats[i].balance_checks,
+               stats[i].balance_skipped, stats[i].balance_attempts,
+               stats[i].candidates, stats[i].migrations_push,
+               stats[i].migrations_pull);
+
+    libxl_sched_credit2_runqueue_stats_list_free(stats, nr);
+    free(poolname);
+
+    return 0;
+}
+
 static int sched_rtds_domain_output(
     int domid)
 {
@@ -604,6 +637,7 @@ int main_sched_credit2(int argc, char **argv)
     int ratelimit = 0;
     int weight = 256, cap = 0;
     bool opt_s = false;
+    bool opt_S = false;
     bool opt_r = false;
     bool opt_w = false;
     bool opt_c = false;
@@ -613,12 +647,13 @@ int main_sched_credit2(int argc, char **argv)
         {"weight", 1, 0, 'w'},
         {"cap", 1, 0, 'c'},
         {"schedparam", 0, 0, 's'},
+        {"stats", 0, 0, 'S'},
         {"ratelimit_us", 1, 0, 'r'},
         {"cpupool", 1, 0, 'p'},
         COMMON_LONG_OPTS
     };
 
-    SWITCH_FOREACH_OPT(opt, "d:w:c:p:r:s", opts, "sched-credit2", 0) {
+    SWITCH_FOREACH_OPT(opt, "d:w:c:p:r:sS", opts, "sched-credit2", 0) {
     case 'd':
         dom = optarg;
         break;
@@ -633,6 +668,9 @@ int main_sched_credit2(int argc, char **argv)
     case 's':
         opt_s = true;
         break;
+    case 'S':
+        opt_S = true;
+        break;
     case 'r':
         ratelimit = strtol(optarg, NULL, 10);
         opt_r = true;
@@ -642,6 +680,10 @@ int main_sched_credit2(int argc, char **argv)
         break;
     }
 
+    if (opt_S && (dom || opt_w || opt_c || opt_r)) {
+        fprintf(stderr, "Statistics can only be combined with a cpupool.\n");
+        return EXIT_FAILURE;
+    }
     if (cpupool && (dom || opt_w || opt_c)) {
         fprintf(stderr, "Specifying a cpupool is not allowed with other "
                 "options.\n");
@@ -652,7 +694,7 @@ int main_sched_credit2(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    if (opt_s) {
+    if (opt_s || opt_S) {
         libxl_sched_credit2_params scparam;
         uint32_t poolid = 0;
 
@@ -665,7 +707,10 @@ int main_sched_credit2(int argc, char **argv)
             }
         }
 
-        if (!opt_r) { /* Output scheduling parameters */
+        if (opt_S) {  /* Output load balancing statistics */
+            if (sched_credit2_stats_output(poolid))
+                return EXIT_FAILURE;
+        } else if (!opt_r) { /* Output scheduling parameters */
             if (sched_credit2_pool_output(poolid))
                 return EXIT_FAILURE;
         } else {      /* Set scheduling parameters (so far, just ratelimit) */
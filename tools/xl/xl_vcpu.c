@@ -12,6 +12,7 @@
  * GNU Lesser General Public License for more details.
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <limits.h>
 
@@ -69,6 +70,88 @@ static void print_domain_vcpuinfo(uint32_t domid, uint32_t nr_cpus)
     libxl_vcpuinfo_list_free(vcpuinfo, nb_vcpu);
 }
 
+/*
+ * Upper bound (in us) of the histogram bucket containing the sample at the
+ * given percentile; for the last, unbounded, bucket use the maximum.
+ */
+static double sched_latency_percentile(const libxl_sched_latency_hist *hist,
+                                       unsigned int pct)
+{
+    uint64_t seen = 0, target = (hist->count * pct + 99) / 100;
+    int i;
+
+    if (!hist->count)
+        return 0;
+
+    for (i = 0; i < hist->num_buckets - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target)
+            return (double)(1ULL << (10 + i)) / 1e3;
+    }
+
+    return hist->max_ns / 1e3;
+}
+
+static void print_sched_latency_hist(const libxl_sched_latency_hist *hist)
+{
+    /*      CNT  AVG  P99  MAX */
+    printf(" %9"PRIu64" %8.1f %8.1f %9.1f", hist->count,
+           hist->count ? (double)hist->total_ns / hist->count / 1e3 : 0,
+           sched_latency_percentile(hist, 99), hist->max_ns / 1e3);
+}
+
+static void print_domain_vcpu_sched_latency(uint32_t domid)
+{
+    libxl_vcpu_sched_latency *lat;
+    char *domname;
+    int i, nb_vcpu;
+
+    lat = libxl_list_vcpu_sched_latency(ctx, domid, &nb_vcpu);
+    if (!lat)
+        return;
+
+    domname = libxl_domid_to_name(ctx, domid);
+    for (i = 0; i < nb_vcpu; i++) {
+        /*      NAME  ID  VCPU */
+        printf("%-32s %5u %5u", domname, domid, lat[i].vcpuid);
+        print_sched_latency_hist(&lat[i].wake);
+        print_sched_latency_hist(&lat[i].preempt);
+        /*      STEAL WAKE / PREEMPT / OFFLINE */
+        printf(" %9.1f %9.1f %9.1f\n", lat[i].steal_wake_ns / 1e9,
+               lat[i].steal_preempt_ns / 1e9, lat[i].steal_offline_ns / 1e9);
+    }
+    free(domname);
+
+    libxl_vcpu_sched_latency_list_free(lat, nb_vcpu);
+}
+
+static void vcpulist_latency(int argc, char **argv)
+{
+    libxl_dominfo *dominfo;
+    int i, nb_domain;
+
+    printf("%-32s %5s %5s %39s %39s %29s\n", "", "", "",
+           "Wake to run latency (us)", "Preemption latency (us)",
+           "Steal time (s)");
+    printf("%-32s %5s %5s %9s %8s %8s %9s %9s %8s %8s %9s %9s %9s %9s\n",
+           "Name", "ID", "VCPU", "Wakeups", "Avg", "99%", "Max",
+           "Preempts", "Avg", "99%", "Max", "Wake", "Preempt", "Offline");
+    if (!argc) {
+        if (!(dominfo = libxl_list_domain(ctx, &nb_domain))) {
+            fprintf(stderr, "libxl_list_domain failed.\n");
+            return;
+        }
+
+        for (i = 0; i < nb_domain; i++)
+            print_domain_vcpu_sched_latency(dominfo[i].domid);
+
+        libxl_dominfo_list_free(dominfo, nb_domain);
+    } else {
+        for (; argc > 0; ++argv, --argc)
+            print_domain_vcpu_sched_latency(find_domain(*argv));
+    }
+}
+
 void apply_global_affinity_masks(libxl_domain_type type,
                                  libxl_bitmap *vcpu_affinity_array,
                                  unsigned int size)
@@ -160,13 +243,23 @@ static void vcpulist(int argc, char **argv)
 
 int main_vcpulist(int argc, char **argv)
 {
+    static struct option opts[] = {
+        {"latency", 0, 0, 'l'},
+        COMMON_LONG_OPTS
+    };
     int opt;
+    bool latency = false;
 
-    SWITCH_FOREACH_OPT(opt, "", NULL, "vcpu-list", 0) {
-        /* No options */
+    SWITCH_FOREACH_OPT(opt, "l", opts, "vcpu-list", 0) {
+    case 'l':
+        latency = true;
+        break;
     }
 
-    vcpulist(argc - optind, argv + optind);
+    if (latency)
+        vcpulist_latency(argc - optind, argv + optind);
+    else
+        vcpulist(argc - optind, argv + optind);
     return EXIT_SUCCESS;
 }
 
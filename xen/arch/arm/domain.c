@@ -1038,6 +1038,14 @@ int domain_relinquish_resources(struct domain *d)
         if ( ret )
             return ret;
 
+        d->arch.relmem = RELMEM_teardown;
+        /* Fallthrough */
+
+    case RELMEM_teardown:
+        ret = domain_teardown_memory(d);
+        if ( ret )
+            return ret;
+
         d->arch.relmem = RELMEM_page;
         /* Fallthrough */
 
@@ -1161,6 +1161,17 @@ void *__init arch_vmap_virt_end(void)
     return (void *)VMAP_VIRT_END;
 }
 
+/* Past this many pages, invalidating the whole TLB is cheaper. */
+#define VMAP_FLUSH_RANGE_MAX 64
+
+void arch_vmap_flush(unsigned long start, unsigned long end)
+{
+    if ( end - start <= VMAP_FLUSH_RANGE_MAX * PAGE_SIZE )
+        flush_xen_tlb_range_va(start, end - start);
+    else
+        flush_xen_tlb();
+}
+
 /*
  * This function should only be used to remap device address ranges
  * TODO: add a check to verify this assumption
@@ -1502,9 +1513,11 @@ static int xen_pt_update(unsigned long virt,
     /*
      * Flush the TLBs even in case of failure because we may have
      * partially modified the PT. This will prevent any unexpected
-     * behavior afterwards.
+     * behavior afterwards.  With MAP_NO_FLUSH, the caller takes care of
+     * that.
      */
-    flush_xen_tlb_range_va(virt, PAGE_SIZE * nr_mfns);
+    if ( !(flags & MAP_NO_FLUSH) )
+        flush_xen_tlb_range_va(virt, PAGE_SIZE * nr_mfns);
 
     spin_unlock(&xen_pt_lock);
 
@@ -1824,7 +1837,8 @@ int create_grant_host_mapping(unsigned long addr, mfn_t frame,
     int rc;
     p2m_type_t t = p2m_grant_map_rw;
 
-    if ( cache_flags  || (flags & ~GNTMAP_readonly) != GNTMAP_host_map )
+    if ( cache_flags  ||
+         (flags & ~(GNTMAP_readonly | GNTMAP_cache)) != GNTMAP_host_map )
         return GNTST_general_error;
 
     if ( flags & GNTMAP_readonly )
@@ -1839,11 +1853,11 @@ int create_grant_host_mapping(unsigned long addr, mfn_t frame,
         return GNTST_okay;
 }
 
-int replace_grant_host_mapping(unsigned long addr, mfn_t mfn,
-                               unsigned long new_addr, unsigned int flags)
+int replace_grant_host_mapping(struct domain *d, unsigned long addr,
+                               mfn_t mfn, unsigned long new_addr,
+                               unsigned int flags)
 {
     gfn_t gfn = gaddr_to_gfn(addr);
-    struct domain *d = current->domain;
     int rc;
 
     if ( new_addr != 0 || (flags & GNTMAP_contains_pte) )
@@ -1868,6 +1882,27 @@ void clear_and_clean_page(struct page_info *page)
     unmap_domain_page(p);
 }
 
+#ifdef CONFIG_ARM_64
+/*
+ * DC ZVA allocates the zeroed lines without reading them from memory; STNP
+ * hints that they needn't be kept in the caches at all.
+ */
+const struct scrub_backend arch_scrub_backends[] = {
+    { .name = "zva", .clear = clear_page },
+    { .name = "stnp", .clear = clear_page_stnp },
+};
+#else
+static void clear_page_memset(void *va)
+{
+    clear_page(va);
+}
+
+const struct scrub_backend arch_scrub_backends[] = {
+    { .name = "memset", .clear = clear_page_memset },
+};
+#endif
+const unsigned int arch_nr_scrub_backends = ARRAY_SIZE(arch_scrub_backends);
+
 unsigned long get_upper_mfn_bound(void)
 {
     /* No memory hotplug yet, so current memory limit is the final one. */
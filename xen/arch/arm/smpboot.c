@@ -65,12 +65,19 @@ static bool cpu_is_dead;
 
 /* ID of the PCPU we're running on */
 DEFINE_PER_CPU(unsigned int, cpu_id);
-/* XXX these seem awfully x86ish... */
+/*
+ * Topology as described by the MPIDR: with MPIDR.MT set, Aff0 identifies the
+ * thread within a core and Aff1 the core within a cluster, otherwise Aff0
+ * identifies the core within a cluster.
+ */
 /* representing HT siblings of each logical CPU */
 DEFINE_PER_CPU_READ_MOSTLY(cpumask_var_t, cpu_sibling_mask);
-/* representing HT and core siblings of each logical CPU */
+/* representing HT and core siblings (i.e. the cluster) of each logical CPU */
 DEFINE_PER_CPU_READ_MOSTLY(cpumask_var_t, cpu_core_mask);
 
+/* CPUs for which sibling maps have been computed. */
+static cpumask_t cpu_sibling_setup_map;
+
 /*
  * By default non-boot CPUs not identical to the boot CPU will be
  * parked.
@@ -78,8 +85,21 @@ DEFINE_PER_CPU_READ_MOSTLY(cpumask_var_t, cpu_core_mask);
 static bool __read_mostly opt_hmp_unsafe = false;
 boolean_param("hmp-unsafe", opt_hmp_unsafe);
 
+/* Return the MPIDR of a cpu with the affinity levels below @level cleared. */
+static register_t mpidr_topology_id(unsigned int cpu, unsigned int level)
+{
+    register_t mpidr = cpu_logical_map(cpu);
+
+    if ( cpu_data[cpu].mpidr.bits & MPIDR_MT )
+        level++;
+
+    return mpidr & AFFINITY_MASK(level);
+}
+
 static void setup_cpu_sibling_map(int cpu)
 {
+    unsigned int i;
+
     if ( !zalloc_cpumask_var(&per_cpu(cpu_sibling_mask, cpu)) ||
          !zalloc_cpumask_var(&per_cpu(cpu_core_mask, cpu)) )
         panic("No memory for CPU sibling/core maps\n");
@@ -87,10 +107,37 @@ static void setup_cpu_sibling_map(int cpu)
     /* A CPU is a sibling with itself and is always on its own core. */
     cpumask_set_cpu(cpu, per_cpu(cpu_sibling_mask, cpu));
     cpumask_set_cpu(cpu, per_cpu(cpu_core_mask, cpu));
+
+    for_each_cpu ( i, &cpu_sibling_setup_map )
+    {
+        if ( mpidr_topology_id(i, 1) != mpidr_topology_id(cpu, 1) )
+            continue;
+
+        cpumask_set_cpu(i, per_cpu(cpu_core_mask, cpu));
+        cpumask_set_cpu(cpu, per_cpu(cpu_core_mask, i));
+
+        if ( mpidr_topology_id(i, 0) != mpidr_topology_id(cpu, 0) )
+            continue;
+
+        cpumask_set_cpu(i, per_cpu(cpu_sibling_mask, cpu));
+        cpumask_set_cpu(cpu, per_cpu(cpu_sibling_mask, i));
+    }
+
+    cpumask_set_cpu(cpu, &cpu_sibling_setup_map);
 }
 
 static void remove_cpu_sibling_map(int cpu)
 {
+    unsigned int i;
+
+    cpumask_clear_cpu(cpu, &cpu_sibling_setup_map);
+
+    for_each_cpu ( i, per_cpu(cpu_core_mask, cpu) )
+    {
+        cpumask_clear_cpu(cpu, per_cpu(cpu_core_mask, i));
+        cpumask_clear_cpu(cpu, per_cpu(cpu_sibling_mask, i));
+    }
+
     free_cpumask_var(per_cpu(cpu_sibling_mask, cpu));
     free_cpumask_var(per_cpu(cpu_core_mask, cpu));
 }
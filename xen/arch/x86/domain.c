@@ -2135,6 +2135,7 @@ int domain_relinquish_resources(struct domain *d)
             PROG_vcpu_pagetables,
             PROG_shared,
             PROG_xen,
+            PROG_teardown,
             PROG_l4,
             PROG_l3,
             PROG_l2,
@@ -2211,6 +2212,13 @@ int domain_relinquish_resources(struct domain *d)
         if ( ret )
             return ret;
 
+    PROGRESS(teardown):
+
+        /* Free whatever the domain alone still references, in parallel. */
+        ret = domain_teardown_memory(d);
+        if ( ret )
+            return ret;
+
     PROGRESS(l4):
 
         ret = relinquish_memory(d, &d->page_list, PGT_l4_page_table);
@@ -0,0 +1 @@
+../../../common/efi/compat.c
\ No newline at end of file
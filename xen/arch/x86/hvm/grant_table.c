@@ -48,13 +48,12 @@ int create_grant_p2m_mapping(uint64_t addr, mfn_t frame,
         return GNTST_okay;
 }
 
-int replace_grant_p2m_mapping(uint64_t addr, mfn_t frame,
+int replace_grant_p2m_mapping(struct domain *d, uint64_t addr, mfn_t frame,
                               uint64_t new_addr, unsigned int flags)
 {
     unsigned long gfn = (unsigned long)(addr >> PAGE_SHIFT);
     p2m_type_t type;
     mfn_t old_mfn;
-    struct domain *d = current->domain;
 
     if ( new_addr != 0 || (flags & GNTMAP_contains_pte) )
         return GNTST_general_error;
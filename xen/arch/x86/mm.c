@@ -2488,7 +2488,7 @@ static int mod_l4_entry(l4_pgentry_t *pl4e,
  * but not "live" (i.e., its refcount is 0), so it's safe to read the
  * count_info, owner, and type_info without synchronization.
  */
-static int cleanup_page_mappings(struct page_info *page)
+int cleanup_page_mappings(struct page_info *page)
 {
     unsigned int cacheattr =
         (page->count_info & PGC_cacheattr_mask) >> PGC_cacheattr_base;
@@ -5416,7 +5416,8 @@ int map_pages_to_xen(
             pl1e  = l2e_to_l1e(*pl2e) + l1_table_offset(virt);
             ol1e  = *pl1e;
             l1e_write_atomic(pl1e, l1e_from_mfn(mfn, flags));
-            if ( (l1e_get_flags(ol1e) & _PAGE_PRESENT) )
+            if ( (l1e_get_flags(ol1e) & _PAGE_PRESENT) &&
+                 !(flags & MAP_NO_FLUSH) )
             {
                 unsigned int flush_flags = FLUSH_TLB | FLUSH_ORDER(0);
 
@@ -5805,6 +5806,12 @@ void *__init arch_vmap_virt_end(void)
     return fix_to_virt(__end_of_fixed_addresses);
 }
 
+void arch_vmap_flush(unsigned long start, unsigned long end)
+{
+    /* vmap() mappings are global; a full flush beats a string of INVLPGs. */
+    flush_area_all(NULL, FLUSH_TLB_GLOBAL);
+}
+
 void __iomem *ioremap(paddr_t pa, size_t len)
 {
     mfn_t mfn = _mfn(PFN_DOWN(pa));
@@ -6172,6 +6179,21 @@ void write_32bit_pse_identmap(uint32_t *l2)
                  _PAGE_ACCESSED | _PAGE_DIRTY | _PAGE_PSE);
 }
 
+static bool clzero_usable(void)
+{
+    return cpu_has_clzero && boot_cpu_data.x86_clflush_size == 64;
+}
+
+/*
+ * Both bypass the caches, so that scrubbing doesn't evict the working set of
+ * whatever else runs on the scrubbing CPU's cache domain.
+ */
+const struct scrub_backend arch_scrub_backends[] = {
+    { .name = "clzero", .usable = clzero_usable, .clear = clear_page_clzero },
+    { .name = "movnti", .clear = clear_page_sse2 },
+};
+const unsigned int arch_nr_scrub_backends = ARRAY_SIZE(arch_scrub_backends);
+
 unsigned long get_upper_mfn_bound(void)
 {
     unsigned long max_mfn;
@@ -181,16 +181,42 @@ static bool steal_linear_address(unsigned long linear, l1_pgentry_t *out)
     return okay;
 }
 
+/*
+ * Machine address of the L1e mapping linear in the current domain, through
+ * which a grant mapping at linear may later be replaced in any context, with
+ * GNTMAP_contains_pte.  Returns 0 if there is none.
+ */
+uint64_t pv_grant_mapping_pte(uint64_t linear)
+{
+    l1_pgentry_t *pl1e;
+    mfn_t gl1mfn;
+    uint64_t maddr;
+
+    if ( is_pv_32bit_domain(current->domain) && linear != (uint32_t)linear )
+        return 0;
+
+    pl1e = map_guest_l1e(linear, &gl1mfn);
+    if ( !pl1e )
+        return 0;
+
+    maddr = mfn_to_maddr(gl1mfn) | ((unsigned long)pl1e & ~PAGE_MASK);
+    unmap_domain_page(pl1e);
+
+    return maddr;
+}
+
 /*
  * Passing a new_addr of zero is taken to mean destroy.  Passing a non-zero
  * new_addr has only ever been available via GNTABOP_unmap_and_replace, and
  * only when !(flags & GNTMAP_contains_pte).
+ *
+ * d is the current domain, unless the mapping is addressed by its L1e
+ * (GNTMAP_contains_pte), as is done for evicting cached mappings.
  */
-int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
+int replace_grant_pv_mapping(struct domain *d, uint64_t addr, mfn_t frame,
                              uint64_t new_addr, unsigned int flags)
 {
-    struct vcpu *curr = current;
-    struct domain *currd = curr->domain;
+    struct vcpu *v = d == current->domain ? current : d->vcpu[0];
     l1_pgentry_t nl1e = l1e_empty(), ol1e, *pl1e;
     struct page_info *page;
     mfn_t gl1mfn;
@@ -202,7 +228,7 @@ int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
      * also open-code relevant parts of adjust_guest_l1e(). Don't mirror
      * available and cachability flags, though.
      */
-    if ( !is_pv_32bit_domain(currd) )
+    if ( !is_pv_32bit_domain(d) )
         grant_pte_flags |= (grant_pte_flags & _PAGE_USER)
                            ? _PAGE_GLOBAL
                            : _PAGE_GUEST_KERNEL | _PAGE_USER;
@@ -230,7 +256,7 @@ int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
 
         gl1mfn = _mfn(addr >> PAGE_SHIFT);
 
-        page = get_page_from_mfn(gl1mfn, currd);
+        page = get_page_from_mfn(gl1mfn, d);
         if ( !page )
             goto out;
 
@@ -238,7 +264,14 @@ int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
     }
     else
     {
-        if ( is_pv_32bit_domain(currd) )
+        /* Linear addresses are those of the current domain. */
+        if ( d != current->domain )
+        {
+            ASSERT_UNREACHABLE();
+            goto out;
+        }
+
+        if ( is_pv_32bit_domain(d) )
         {
             if ( addr != (uint32_t)addr )
             {
@@ -259,7 +292,7 @@ int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
         if ( !pl1e )
             goto out;
 
-        page = get_page_from_mfn(gl1mfn, currd);
+        page = get_page_from_mfn(gl1mfn, d);
         if ( !page )
             goto out_unmap;
     }
@@ -293,7 +326,7 @@ int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
                  "PTE flags %x for %"PRIx64" don't match grant (%x)\n",
                  l1e_get_flags(ol1e), addr, grant_pte_flags);
 
-    if ( UPDATE_ENTRY(l1, pl1e, ol1e, nl1e, gl1mfn, curr, 0) )
+    if ( UPDATE_ENTRY(l1, pl1e, ol1e, nl1e, gl1mfn, v, 0) )
         rc = GNTST_okay;
 
  out_unlock:
@@ -306,7 +339,7 @@ int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
  out:
     /* If there was an error, we are still responsible for the stolen pte. */
     if ( rc )
-        put_page_from_l1e(nl1e, currd);
+        put_page_from_l1e(nl1e, d);
 
     return rc;
 }
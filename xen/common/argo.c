@@ -21,6 +21,7 @@
 #include <xen/domain_page.h>
 #include <xen/errno.h>
 #include <xen/event.h>
+#include <xen/grant_table.h>
 #include <xen/guest_access.h>
 #include <xen/lib.h>
 #include <xen/nospec.h>
@@ -44,6 +45,10 @@ CHECK_argo_ring_data;
 CHECK_argo_ring_message_header;
 CHECK_argo_unregister_ring;
 CHECK_argo_send_addr;
+#undef CHECK_argo_send_addr
+#define CHECK_argo_send_addr struct xen_argo_send_addr
+CHECK_argo_send_ent;
+CHECK_argo_grant_seg;
 #endif
 
 #define MAX_RINGS_PER_DOMAIN            128U
@@ -64,12 +69,14 @@ CHECK_argo_send_addr;
 
 DEFINE_XEN_GUEST_HANDLE(xen_argo_addr_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_gfn_t);
+DEFINE_XEN_GUEST_HANDLE(xen_argo_grant_seg_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_iov_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_register_ring_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_ring_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_ring_data_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_ring_data_ent_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_send_addr_t);
+DEFINE_XEN_GUEST_HANDLE(xen_argo_send_ent_t);
 DEFINE_XEN_GUEST_HANDLE(xen_argo_unregister_ring_t);
 #ifdef CONFIG_COMPAT
 DEFINE_COMPAT_HANDLE(compat_argo_iov_t);
@@ -132,6 +139,12 @@ struct argo_ring_info
     struct list_head pending;
     /* number of pending entries queued for this ring, protected by L3 */
     unsigned int npending;
+    /*
+     * Ring is on its domain's pending_rings list, or held by a notify that
+     * is processing it: protected by L3.  See pending_L2 for pending_node.
+     */
+    bool pending_indexed;
+    struct list_head pending_node;
 };
 
 /* Data about a single-sender ring, held by the sender (partner) domain */
@@ -143,6 +156,16 @@ struct argo_send_info
     struct argo_ring_id id;
 };
 
+/* A segment of a message sent by grant reference, pinned by sendv_grants */
+struct argo_grant_frame
+{
+    /* frame granted by the sender, read-only */
+    mfn_t mfn;
+    /* offset and length of the data within the frame */
+    unsigned int offset;
+    unsigned int len;
+};
+
 /* A space-available notification that is awaiting sufficient space */
 struct pending_ent
 {
@@ -200,6 +223,14 @@ struct argo_domain
      * rings registered by other domains. Protected by wildcard_L2.
      */
     struct list_head wildcard_pend_list;
+
+    /* pending_L2 */
+    spinlock_t pending_L2_lock;
+    /*
+     * List of this domain's rings that have senders waiting for space, so
+     * that notify does not need to visit every ring. Protected by pending_L2.
+     */
+    struct list_head pending_rings;
 };
 
 /*
@@ -263,6 +294,16 @@ static DEFINE_RWLOCK(L1_global_argo_rwlock); /* L1 */
  *
  * To take wildcard_L2, you must already have R(L1). W(L1) implies wildcard_L2.
  * No other locks are acquired after obtaining wildcard_L2.
+ *
+ * == pending_L2 : The per-domain list of rings with pending signals:
+ *                 d->argo->pending_L2_lock
+ *
+ * Protects the per-domain list d->argo->pending_rings and the pending_node
+ * field of the struct argo_ring_info on it.
+ *
+ * To take pending_L2, you must already have R(rings_L2); a ring is only added
+ * to the list with its L3 held. W(rings_L2) implies pending_L2.
+ * No other locks are acquired after obtaining pending_L2.
  */
 
 /*
@@ -762,10 +803,15 @@ iov_count(const xen_argo_iov_t *piov, unsigned int niov,
     return 0;
 }
 
+/*
+ * The message data is taken from the guest buffers described by iovs or,
+ * if frames is not NULL, from the granted frames pinned by sendv_grants.
+ */
 static int
 ringbuf_insert(const struct domain *d, struct argo_ring_info *ring_info,
                const struct argo_ring_id *src_id, xen_argo_iov_t *iovs,
-               unsigned int niov, uint32_t message_type, unsigned int len)
+               unsigned int niov, const struct argo_grant_frame *frames,
+               unsigned int nframe, uint32_t message_type, unsigned int len)
 {
     xen_argo_ring_t ring;
     struct xen_argo_ring_message_header mh = { };
@@ -852,6 +898,43 @@ ringbuf_insert(const struct domain *d, struct argo_ring_info *ring_info,
     if ( ring.tx_ptr == ring_info->len )
         ring.tx_ptr = 0;
 
+    for ( ; nframe--; frames++ )
+    {
+        /*
+         * Granted data: at most two writes per frame, the second one
+         * wrapping to the start of the ring.  Neither can overrun, as the
+         * frames' total length 'len' was checked against the free space above.
+         */
+        const uint8_t *page = map_domain_page(frames->mfn);
+        const uint8_t *src = page + frames->offset;
+        unsigned int head_len = min_t(unsigned int, frames->len,
+                                      ring_info->len - ring.tx_ptr);
+
+        ret = memcpy_to_guest_ring(d, ring_info,
+                                   ring.tx_ptr + sizeof(xen_argo_ring_t),
+                                   src, NULL_hnd, head_len);
+        if ( !ret && head_len < frames->len )
+            ret = memcpy_to_guest_ring(d, ring_info, sizeof(xen_argo_ring_t),
+                                       src + head_len, NULL_hnd,
+                                       frames->len - head_len);
+
+        unmap_domain_page(page);
+
+        if ( ret )
+        {
+            gprintk(XENLOG_ERR,
+                    "argo: failed to copy granted %"PRI_mfn" (vm%u:%x vm%u)\n",
+                    mfn_x(frames->mfn), ring_info->id.domain_id,
+                    ring_info->id.aport, ring_info->id.partner_id);
+
+            return ret;
+        }
+
+        ring.tx_ptr += frames->len;
+        if ( ring.tx_ptr >= ring_info->len )
+            ring.tx_ptr -= ring_info->len;
+    }
+
     for ( piov = iovs; niov--; piov++ )
     {
         XEN_GUEST_HANDLE(uint8) buf_hnd = piov->iov_hnd;
@@ -1017,6 +1100,34 @@ wildcard_pending_list_insert(domid_t domain_id, struct pending_ent *ent)
     put_domain(d);
 }
 
+static void
+pending_ring_index(const struct domain *d, struct argo_ring_info *ring_info)
+{
+    ASSERT(LOCKING_L3(d, ring_info));
+
+    spin_lock(&d->argo->pending_L2_lock);
+    list_add_tail(&ring_info->pending_node, &d->argo->pending_rings);
+    spin_unlock(&d->argo->pending_L2_lock);
+
+    ring_info->pending_indexed = true;
+}
+
+/*
+ * A ring's pending list is kept in ascending order of the space awaited, so
+ * that a notify can stop at the first sender that cannot be satisfied.
+ */
+static void
+pending_insert_sorted(struct argo_ring_info *ring_info, struct pending_ent *ent)
+{
+    struct pending_ent *pos;
+
+    list_for_each_entry(pos, &ring_info->pending, node)
+        if ( pos->len > ent->len )
+            break;
+
+    list_add_tail(&ent->node, &pos->node);
+}
+
 static void
 pending_remove_all(const struct domain *d, struct argo_ring_info *ring_info)
 {
@@ -1060,39 +1171,35 @@ pending_find(const struct domain *d, struct argo_ring_info *ring_info,
 {
     struct pending_ent *ent, *next;
 
-    ASSERT(LOCKING_Read_rings_L2(d));
+    ASSERT(LOCKING_L3(d, ring_info));
 
     /*
-     * TODO: Current policy here is to signal _all_ of the waiting domains
-     *       interested in sending a message of size less than payload_space.
-     *
-     * This is likely to be suboptimal, since once one of them has added
-     * their message to the ring, there may well be insufficient room
-     * available for any of the others to transmit, meaning that they were
-     * woken in vain, which created extra work just to requeue their wait.
+     * Signal the waiting domains, smallest first, only for as long as the
+     * space remaining after the messages of the domains already signalled
+     * can hold the next one.  Waking a sender whose message cannot fit once
+     * the others have sent only makes it requeue its wait.
      *
-     * Retain this simple policy for now since it at least avoids starving a
-     * domain of available space notifications because of a policy that only
-     * notified other domains instead. Improvement may be possible;
-     * investigation required.
+     * A large message is not starved by a stream of small ones: each
+     * domain has at most one entry per ring, so it is delayed by at most
+     * one message per other waiting domain.
      */
-    spin_lock(&ring_info->L3_lock);
-
-    /* Remove matching ents from the ring list, and add them to "to_notify" */
     list_for_each_entry_safe(ent, next, &ring_info->pending, node)
     {
-        if ( payload_space >= ent->len )
-        {
-            if ( ring_info->id.partner_id == XEN_ARGO_DOMID_ANY )
-                wildcard_pending_list_remove(ent->domain_id, ent);
+        unsigned int used = ROUNDUP_MESSAGE(ent->len) +
+                            sizeof(struct xen_argo_ring_message_header);
 
-            list_del(&ent->node);
-            ring_info->npending--;
-            list_add(&ent->node, to_notify);
-        }
-    }
+        if ( payload_space < ent->len )
+            break;
 
-    spin_unlock(&ring_info->L3_lock);
+        payload_space = payload_space > used ? payload_space - used : 0;
+
+        if ( ring_info->id.partner_id == XEN_ARGO_DOMID_ANY )
+            wildcard_pending_list_remove(ent->domain_id, ent);
+
+        list_del(&ent->node);
+        ring_info->npending--;
+        list_add(&ent->node, to_notify);
+    }
 }
 
 static int
@@ -1116,9 +1223,12 @@ pending_queue(const struct domain *d, struct argo_ring_info *ring_info,
 
     if ( ring_info->id.partner_id == XEN_ARGO_DOMID_ANY )
         wildcard_pending_list_insert(src_id, ent);
-    list_add(&ent->node, &ring_info->pending);
+    pending_insert_sorted(ring_info, ent);
     ring_info->npending++;
 
+    if ( !ring_info->pending_indexed )
+        pending_ring_index(d, ring_info);
+
     return 0;
 }
 
@@ -1146,7 +1256,11 @@ pending_requeue(const struct domain *d, struct argo_ring_info *ring_info,
              * for (at least) any one of the messages awaiting transmission.
              */
             if ( ent->len < len )
+            {
                 ent->len = len;
+                list_del(&ent->node);
+                pending_insert_sorted(ring_info, ent);
+            }
 
             return 0;
         }
@@ -1235,6 +1349,9 @@ ring_remove_info(const struct domain *d, struct argo_ring_info *ring_info)
     ASSERT(LOCKING_Write_rings_L2(d));
 
     pending_remove_all(d, ring_info);
+    /* No notify can be holding the ring: that needs R(rings_L2). */
+    if ( ring_info->pending_indexed )
+        list_del(&ring_info->pending_node);
     list_del(&ring_info->node);
     ring_remove_mfns(d, ring_info);
     xfree(ring_info);
@@ -1726,6 +1843,7 @@ register_ring(struct domain *currd,
 
         ring_info->id = ring_id;
         INIT_LIST_HEAD(&ring_info->pending);
+        INIT_LIST_HEAD(&ring_info->pending_node);
 
         list_add(&ring_info->node,
                  &currd->argo->ring_hash[hash_index(&ring_info->id)]);
@@ -1869,30 +1987,48 @@ notify_ring(const struct domain *d, struct argo_ring_info *ring_info,
     else
         space = 0;
 
-    spin_unlock(&ring_info->L3_lock);
-
     if ( space )
         pending_find(d, ring_info, space, to_notify);
+
+    /* Put the ring back on the index if senders are still waiting. */
+    if ( ring_info->npending )
+    {
+        spin_lock(&d->argo->pending_L2_lock);
+        list_add_tail(&ring_info->pending_node, &d->argo->pending_rings);
+        spin_unlock(&d->argo->pending_L2_lock);
+    }
+    else
+        ring_info->pending_indexed = false;
+
+    spin_unlock(&ring_info->L3_lock);
 }
 
 static void
 notify_check_pending(struct domain *d)
 {
-    unsigned int i;
+    struct argo_ring_info *ring_info;
+    LIST_HEAD(rings);
     LIST_HEAD(to_notify);
 
     ASSERT(LOCKING_Read_L1);
 
     read_lock(&d->argo->rings_L2_rwlock);
 
-    /* Walk all rings, call notify_ring on each to populate to_notify list */
-    for ( i = 0; i < ARGO_HASHTABLE_SIZE; i++ )
-    {
-        struct argo_ring_info *ring_info, *next;
-        struct list_head *bucket = &d->argo->ring_hash[i];
+    /*
+     * Only visit the rings with senders waiting for space. Take them all off
+     * the index: notify_ring puts back those that still have waiters. Until
+     * then, the rings are held on the private list and keep pending_indexed
+     * set, so senders queueing on them meanwhile do not index them again.
+     */
+    spin_lock(&d->argo->pending_L2_lock);
+    list_splice_init(&d->argo->pending_rings, &rings);
+    spin_unlock(&d->argo->pending_L2_lock);
 
-        list_for_each_entry_safe(ring_info, next, bucket, node)
-            notify_ring(d, ring_info, &to_notify);
+    while ( (ring_info = list_first_entry_or_null(&rings, struct argo_ring_info,
+                                                  pending_node)) )
+    {
+        list_del(&ring_info->pending_node);
+        notify_ring(d, ring_info, &to_notify);
     }
 
     read_unlock(&d->argo->rings_L2_rwlock);
@@ -1957,21 +2093,10 @@ notify(struct domain *currd,
     return ret;
 }
 
-static long
-sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
-      const xen_argo_addr_t *dst_addr, xen_argo_iov_t *iovs, unsigned int niov,
-      uint32_t message_type)
+static int
+sendv_check_addrs(const struct domain *src_d, xen_argo_addr_t *src_addr,
+                  const xen_argo_addr_t *dst_addr, struct argo_ring_id *src_id)
 {
-    struct domain *dst_d = NULL;
-    struct argo_ring_id src_id;
-    struct argo_ring_info *ring_info;
-    int ret = 0;
-    unsigned int len = 0;
-
-    argo_dprintk("sendv: (%u:%x)->(%u:%x) niov:%u type:%x\n",
-                 src_addr->domain_id, src_addr->aport, dst_addr->domain_id,
-                 dst_addr->aport, niov, message_type);
-
     /* Check padding is zeroed. */
     if ( unlikely(src_addr->pad || dst_addr->pad) )
         return -EINVAL;
@@ -1983,50 +2108,70 @@ sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
     if ( unlikely(src_addr->domain_id != src_d->domain_id) )
         return -EPERM;
 
-    src_id.aport = src_addr->aport;
-    src_id.domain_id = src_d->domain_id;
-    src_id.partner_id = dst_addr->domain_id;
+    src_id->aport = src_addr->aport;
+    src_id->domain_id = src_d->domain_id;
+    src_id->partner_id = dst_addr->domain_id;
+
+    return 0;
+}
 
-    dst_d = get_domain_by_id(dst_addr->domain_id);
-    if ( !dst_d )
+static int
+sendv_get_dst(struct domain *src_d, domid_t dst_id, struct domain **dst_d)
+{
+    int ret;
+
+    *dst_d = get_domain_by_id(dst_id);
+    if ( !*dst_d )
         return -ESRCH;
 
-    ret = xsm_argo_send(src_d, dst_d);
+    ret = xsm_argo_send(src_d, *dst_d);
     if ( ret )
     {
         gprintk(XENLOG_ERR, "argo: XSM REJECTED %i -> %i\n",
-                src_d->domain_id, dst_d->domain_id);
-
-        put_domain(dst_d);
+                src_d->domain_id, dst_id);
 
-        return ret;
+        put_domain(*dst_d);
+        *dst_d = NULL;
     }
 
-    read_lock(&L1_global_argo_rwlock);
+    return ret;
+}
+
+/*
+ * Deliver one message to the ring of dst_d matching dst_aport.  The data is
+ * either the guest buffers in iovs, in which case their total length is
+ * returned in len, or the granted frames, of total length len.
+ */
+static int
+sendv_locked(const struct domain *src_d, struct domain *dst_d,
+             const struct argo_ring_id *src_id, xen_argo_port_t dst_aport,
+             xen_argo_iov_t *iovs, unsigned int niov,
+             const struct argo_grant_frame *frames, unsigned int nframe,
+             unsigned int *len, uint32_t message_type)
+{
+    struct argo_ring_info *ring_info;
+    int ret;
+
+    ASSERT(LOCKING_Read_L1);
 
     if ( !src_d->argo )
-    {
-        ret = -ENODEV;
-        goto out_unlock;
-    }
+        return -ENODEV;
 
     if ( !dst_d->argo )
     {
         argo_dprintk("!dst_d->argo, ECONNREFUSED\n");
-        ret = -ECONNREFUSED;
-        goto out_unlock;
+        return -ECONNREFUSED;
     }
 
     read_lock(&dst_d->argo->rings_L2_rwlock);
 
-    ring_info = find_ring_info_by_match(dst_d, dst_addr->aport,
-                                        src_id.domain_id);
+    ring_info = find_ring_info_by_match(dst_d, dst_aport, src_id->domain_id);
     if ( !ring_info )
     {
         gprintk(XENLOG_ERR,
                 "argo: vm%u connection refused, src (vm%u:%x) dst (vm%u:%x)\n",
-                current->domain->domain_id, src_id.domain_id, src_id.aport,
-                dst_addr->domain_id, dst_addr->aport);
+                current->domain->domain_id, src_id->domain_id, src_id->aport,
+                dst_d->domain_id, dst_aport);
 
         ret = -ECONNREFUSED;
     }
@@ -2038,18 +2183,23 @@ sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
          * Obtain the total size of data to transmit -- sets the 'len' variable
          * -- and sanity check that the iovs conform to size and number limits.
          */
-        ret = iov_count(iovs, niov, &len);
+        if ( !frames )
+            ret = iov_count(iovs, niov, len);
+        else
+            ret = 0;
+
         if ( !ret )
         {
-            ret = ringbuf_insert(dst_d, ring_info, &src_id, iovs, niov,
-                                 message_type, len);
+            ret = ringbuf_insert(dst_d, ring_info, src_id, iovs, niov, frames,
+                                 nframe, message_type, *len);
             if ( ret == -EAGAIN )
             {
                 int rc;
 
                 argo_dprintk("argo_ringbuf_sendv failed, EAGAIN\n");
                 /* requeue to issue a notification when space is there */
-                rc = pending_requeue(dst_d, ring_info, src_id.domain_id, len);
+                rc = pending_requeue(dst_d, ring_info, src_id->domain_id,
+                                     *len);
                 if ( rc )
                     ret = rc;
             }
@@ -2060,14 +2210,257 @@ sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
 
     read_unlock(&dst_d->argo->rings_L2_rwlock);
 
- out_unlock:
+    return ret;
+}
+
+static long
+sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
+      const xen_argo_addr_t *dst_addr, xen_argo_iov_t *iovs, unsigned int niov,
+      uint32_t message_type)
+{
+    struct domain *dst_d;
+    struct argo_ring_id src_id;
+    int ret;
+    unsigned int len = 0;
+
+    argo_dprintk("sendv: (%u:%x)->(%u:%x) niov:%u type:%x\n",
+                 src_addr->domain_id, src_addr->aport, dst_addr->domain_id,
+                 dst_addr->aport, niov, message_type);
+
+    ret = sendv_check_addrs(src_d, src_addr, dst_addr, &src_id);
+    if ( ret )
+        return ret;
+
+    ret = sendv_get_dst(src_d, dst_addr->domain_id, &dst_d);
+    if ( ret )
+        return ret;
+
+    read_lock(&L1_global_argo_rwlock);
+
+    ret = sendv_locked(src_d, dst_d, &src_id, dst_addr->aport, iovs, niov,
+                       NULL, 0, &len, message_type);
+
     read_unlock(&L1_global_argo_rwlock);
 
     if ( ret >= 0 )
         signal_domain(dst_d);
 
+    put_domain(dst_d);
+
+    return ( ret < 0 ) ? ret : len;
+}
+
+static int
+sendv_copy_iovs(XEN_GUEST_HANDLE_PARAM(void) iovs_hnd, unsigned int idx,
+                xen_argo_iov_t *iovs, unsigned int niov, bool compat)
+{
+#ifdef CONFIG_COMPAT
+    if ( compat )
+    {
+        compat_argo_iov_t compat_iovs[XEN_ARGO_MAXIOV];
+        unsigned int i;
+
+        if ( copy_from_guest_offset(compat_iovs, iovs_hnd, idx, niov) )
+            return -EFAULT;
+
+        for ( i = 0; i < niov; i++ )
+        {
+#define XLAT_argo_iov_HNDL_iov_hnd(_d_, _s_) \
+    guest_from_compat_handle((_d_)->iov_hnd, (_s_)->iov_hnd)
+
+            XLAT_argo_iov(&iovs[i], &compat_iovs[i]);
+
+#undef XLAT_argo_iov_HNDL_iov_hnd
+        }
+
+        return 0;
+    }
+#endif
+
+    return copy_from_guest_offset(iovs, iovs_hnd, idx, niov) ? -EFAULT : 0;
+}
+
+/*
+ * Send a batch of messages.  Consecutive messages to the same destination
+ * domain are sent under a single acquisition of R(L1), with one domain
+ * lookup, one XSM check and one signal between them.
+ */
+static long
+sendv_batch(struct domain *src_d,
+            XEN_GUEST_HANDLE_PARAM(xen_argo_send_ent_t) ents_hnd,
+            XEN_GUEST_HANDLE_PARAM(void) iovs_hnd, unsigned int nent,
+            unsigned int niov_total, bool compat)
+{
+    struct domain *dst_d = NULL;
+    bool signal = false;
+    unsigned int i;
+    long ret = 0;
+
+    /* XEN_ARGO_MAXIOV value determines size of iov arrays on stack */
+    BUILD_BUG_ON(XEN_ARGO_MAXIOV > 8);
+
+    if ( unlikely(nent > XEN_ARGO_MAX_SEND_BATCH) )
+        return -EINVAL;
+
+    /* Check array to allow use of the faster __copy operations later */
+    if ( unlikely(!guest_handle_okay(ents_hnd, nent)) )
+        return -EFAULT;
+
+    for ( i = 0; i < nent; i++ )
+    {
+        xen_argo_send_ent_t ent;
+        xen_argo_iov_t iovs[XEN_ARGO_MAXIOV];
+        struct argo_ring_id src_id;
+        unsigned int niov = 0, len = 0;
+        int rc;
+
+        if ( __copy_from_guest(&ent, ents_hnd, 1) )
+        {
+            ret = -EFAULT;
+            break;
+        }
+
+        /* Finish with the previous destination: R(L1) is held while set. */
+        if ( dst_d && dst_d->domain_id != ent.addr.dst.domain_id )
+        {
+            read_unlock(&L1_global_argo_rwlock);
+
+            if ( signal )
+                signal_domain(dst_d);
+
+            put_domain(dst_d);
+            dst_d = NULL;
+            signal = false;
+        }
+
+        rc = sendv_check_addrs(src_d, &ent.addr.src, &ent.addr.dst, &src_id);
+
+        if ( !rc && (ent.niov > XEN_ARGO_MAXIOV ||
+                     ent.iov_idx > niov_total ||
+                     ent.niov > niov_total - ent.iov_idx) )
+            rc = -EINVAL;
+
+        if ( !rc && !dst_d )
+        {
+            rc = sendv_get_dst(src_d, ent.addr.dst.domain_id, &dst_d);
+            if ( !rc )
+                read_lock(&L1_global_argo_rwlock);
+        }
+
+        if ( !rc )
+        {
+            niov = array_index_nospec(ent.niov, XEN_ARGO_MAXIOV + 1);
+            rc = sendv_copy_iovs(iovs_hnd, ent.iov_idx, iovs, niov, compat);
+        }
+
+        if ( !rc )
+        {
+            rc = sendv_locked(src_d, dst_d, &src_id, ent.addr.dst.aport, iovs,
+                              niov, NULL, 0, &len, ent.message_type);
+            if ( rc >= 0 )
+            {
+                signal = true;
+                ret++;
+            }
+        }
+
+        ent.status = rc < 0 ? rc : len;
+        if ( __copy_field_to_guest(ents_hnd, &ent, status) )
+        {
+            ret = -EFAULT;
+            break;
+        }
+
+        guest_handle_add_offset(ents_hnd, 1);
+    }
+
     if ( dst_d )
+    {
+        read_unlock(&L1_global_argo_rwlock);
+
+        if ( signal )
+            signal_domain(dst_d);
+
         put_domain(dst_d);
+    }
+
+    return ret;
+}
+
+/*
+ * Send a message by grant reference: the data is copied into the destination
+ * ring straight from the frames that the sender has granted to the destination
+ * domain, which are pinned for the duration of the send.
+ */
+static long
+sendv_grants(struct domain *src_d, xen_argo_addr_t *src_addr,
+             const xen_argo_addr_t *dst_addr,
+             const xen_argo_grant_seg_t *segs, unsigned int nseg,
+             uint32_t message_type)
+{
+    struct argo_grant_frame frames[XEN_ARGO_MAX_GRANT_SEGS];
+    struct domain *dst_d;
+    struct argo_ring_id src_id;
+    unsigned int i, len = 0;
+    int ret;
+
+    argo_dprintk("sendv_grants: (%u:%x)->(%u:%x) nseg:%u type:%x\n",
+                 src_addr->domain_id, src_addr->aport, dst_addr->domain_id,
+                 dst_addr->aport, nseg, message_type);
+
+    ret = sendv_check_addrs(src_d, src_addr, dst_addr, &src_id);
+    if ( ret )
+        return ret;
+
+    if ( unlikely(!nseg || nseg > XEN_ARGO_MAX_GRANT_SEGS) )
+        return -EINVAL;
+
+    for ( i = 0; i < nseg; i++ )
+        if ( segs[i].pad || !segs[i].len )
+            return -EINVAL;
+
+    ret = sendv_get_dst(src_d, dst_addr->domain_id, &dst_d);
+    if ( ret )
+        return ret;
+
+    /*
+     * Pin the grants before taking L1: the grant table locks are never
+     * taken with Argo locks held.
+     */
+    for ( i = 0; i < nseg; i++ )
+    {
+        ret = gnttab_get_read_frame(src_d, segs[i].gref, dst_d->domain_id,
+                                    segs[i].offset, segs[i].len,
+                                    &frames[i].mfn);
+        if ( ret )
+        {
+            argo_dprintk("gref %u not granted to vm%u: %d\n",
+                         segs[i].gref, dst_d->domain_id, ret);
+            break;
+        }
+
+        frames[i].offset = segs[i].offset;
+        frames[i].len = segs[i].len;
+        len += segs[i].len;
+    }
+
+    if ( !ret )
+    {
+        read_lock(&L1_global_argo_rwlock);
+
+        ret = sendv_locked(src_d, dst_d, &src_id, dst_addr->aport, NULL, 0,
+                           frames, nseg, &len, message_type);
+
+        read_unlock(&L1_global_argo_rwlock);
+    }
+
+    while ( i-- )
+        gnttab_put_read_frame(src_d, segs[i].gref, frames[i].mfn);
+
+    if ( ret >= 0 )
+        signal_domain(dst_d);
+
+    put_domain(dst_d);
 
     return ( ret < 0 ) ? ret : len;
 }
@@ -2199,6 +2592,67 @@ do_argo_op(unsigned int cmd, XEN_GUEST_HANDLE_PARAM(void) arg1,
         break;
     }
 
+    case XEN_ARGO_OP_sendv_batch:
+    {
+        XEN_GUEST_HANDLE_PARAM(xen_argo_send_ent_t) ents_hnd =
+            guest_handle_cast(arg1, xen_argo_send_ent_t);
+        /* arg2 is iovs, arg3 is the number of messages, arg4 is niov */
+
+        /* Reject counts that are outside 32 bit range. */
+        if ( unlikely((arg3 != (uint32_t)arg3) || (arg4 != (uint32_t)arg4)) )
+        {
+            rc = -EINVAL;
+            break;
+        }
+
+        rc = sendv_batch(currd, ents_hnd, arg2, arg3, arg4, false);
+        break;
+    }
+
+    case XEN_ARGO_OP_sendv_grants:
+    {
+        xen_argo_send_addr_t send_addr;
+        xen_argo_grant_seg_t segs[XEN_ARGO_MAX_GRANT_SEGS];
+        unsigned int nseg;
+
+        XEN_GUEST_HANDLE_PARAM(xen_argo_send_addr_t) send_addr_hnd =
+            guest_handle_cast(arg1, xen_argo_send_addr_t);
+        XEN_GUEST_HANDLE_PARAM(xen_argo_grant_seg_t) segs_hnd =
+            guest_handle_cast(arg2, xen_argo_grant_seg_t);
+        /* arg3 is nseg, arg4 is message_type */
+
+        /* XEN_ARGO_MAX_GRANT_SEGS determines size of segment array on stack */
+        BUILD_BUG_ON(XEN_ARGO_MAX_GRANT_SEGS > 16);
+
+        if ( copy_from_guest(&send_addr, send_addr_hnd, 1) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+
+        /*
+         * Reject nseg above maximum limit or message_types that are outside
+         * 32 bit range.
+         */
+        if ( unlikely((arg3 > XEN_ARGO_MAX_GRANT_SEGS) ||
+                      (arg4 != (uint32_t)arg4)) )
+        {
+            rc = -EINVAL;
+            break;
+        }
+        nseg = array_index_nospec(arg3, XEN_ARGO_MAX_GRANT_SEGS + 1);
+
+        if ( copy_from_guest(segs, segs_hnd, nseg) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+
+        rc = sendv_grants(currd, &send_addr.src, &send_addr.dst, segs, nseg,
+                          arg4);
+        break;
+    }
+
     default:
         rc = -EOPNOTSUPP;
         break;
@@ -2219,15 +2673,14 @@ compat_argo_op(unsigned int cmd, XEN_GUEST_HANDLE_PARAM(void) arg1,
     long rc;
     xen_argo_send_addr_t send_addr;
     xen_argo_iov_t iovs[XEN_ARGO_MAXIOV];
-    compat_argo_iov_t compat_iovs[XEN_ARGO_MAXIOV];
-    unsigned int i, niov;
+    unsigned int niov;
     XEN_GUEST_HANDLE_PARAM(xen_argo_send_addr_t) send_addr_hnd;
 
-    /* check XEN_ARGO_MAXIOV as it sizes stack arrays: iovs, compat_iovs */
+    /* check XEN_ARGO_MAXIOV as it sizes the iovs stack array */
     BUILD_BUG_ON(XEN_ARGO_MAXIOV > 8);
 
-    /* Forward all ops besides sendv to the native handler. */
-    if ( cmd != XEN_ARGO_OP_sendv )
+    /* Forward all ops besides sendv and sendv_batch to the native handler. */
+    if ( cmd != XEN_ARGO_OP_sendv && cmd != XEN_ARGO_OP_sendv_batch )
         return do_argo_op(cmd, arg1, arg2, arg3, arg4);
 
     if ( unlikely(!opt_argo) )
@@ -2240,6 +2693,13 @@ compat_argo_op(unsigned int cmd, XEN_GUEST_HANDLE_PARAM(void) arg1,
     argo_dprintk("->compat_argo_op(%u,%p,%p,%lu,0x%lx)\n", cmd,
                  (void *)arg1.p, (void *)arg2.p, arg3, arg4);
 
+    if ( cmd == XEN_ARGO_OP_sendv_batch )
+    {
+        rc = sendv_batch(currd, guest_handle_cast(arg1, xen_argo_send_ent_t),
+                         arg2, arg3, arg4, true);
+        goto out;
+    }
+
     send_addr_hnd = guest_handle_cast(arg1, xen_argo_send_addr_t);
     /* arg2: iovs, arg3: niov, arg4: message_type */
 
@@ -2254,20 +2714,10 @@ compat_argo_op(unsigned int cmd, XEN_GUEST_HANDLE_PARAM(void) arg1,
     }
     niov = array_index_nospec(arg3, XEN_ARGO_MAXIOV + 1);
 
-    rc = copy_from_guest(compat_iovs, arg2, niov) ? -EFAULT : 0;
+    rc = sendv_copy_iovs(arg2, 0, iovs, niov, true);
     if ( rc )
         goto out;
 
-    for ( i = 0; i < niov; i++ )
-    {
-#define XLAT_argo_iov_HNDL_iov_hnd(_d_, _s_) \
-    guest_from_compat_handle((_d_)->iov_hnd, (_s_)->iov_hnd)
-
-        XLAT_argo_iov(&iovs[i], &compat_iovs[i]);
-
-#undef XLAT_argo_iov_HNDL_iov_hnd
-    }
-
     rc = sendv(currd, &send_addr.src, &send_addr.dst, iovs, niov, arg4);
  out:
     argo_dprintk("<-compat_argo_op(%u)=%ld\n", cmd, rc);
@@ -2291,6 +2741,9 @@ argo_domain_init(struct argo_domain *argo)
         INIT_LIST_HEAD(&argo->send_hash[i]);
     }
     INIT_LIST_HEAD(&argo->wildcard_pend_list);
+
+    spin_lock_init(&argo->pending_L2_lock);
+    INIT_LIST_HEAD(&argo->pending_rings);
 }
 
 int
@@ -55,6 +55,14 @@ CHECK_gnttab_swap_grant_ref;
 CHECK_gnttab_cache_flush;
 #undef xen_gnttab_cache_flush
 
+#define xen_gnttab_copy_seg gnttab_copy_seg
+CHECK_gnttab_copy_seg;
+#undef xen_gnttab_copy_seg
+
+#define xen_gnttab_copy_v2 gnttab_copy_v2
+CHECK_gnttab_copy_v2;
+#undef xen_gnttab_copy_v2
+
 int compat_grant_table_op(unsigned int cmd,
                           XEN_GUEST_HANDLE_PARAM(void) cmp_uop,
                           unsigned int count)
@@ -47,6 +47,11 @@ static int __init sched_select_granularity(const char *str)
         opt_sched_granularity = SCHED_GRAN_core;
     else if ( strcmp("socket", str) == 0 )
         opt_sched_granularity = SCHED_GRAN_socket;
+#ifdef CONFIG_ARM
+    /* On Arm the core mask of a cpu covers all cpus of its cluster. */
+    else if ( strcmp("cluster", str) == 0 )
+        opt_sched_granularity = SCHED_GRAN_socket;
+#endif
     else
         return -EINVAL;
 
@@ -323,6 +328,10 @@ static int cpupool_move_domain_locked(struct domain *d, struct cpupool *c)
     else
         c->n_dom++;
 
+    debugtrace_printk("cpupool_move_domain(dom=%d,pool=%d) rc %d pause %"
+                      PRI_stime"ns\n", d->domain_id, c->cpupool_id, ret,
+                      ret ? 0 : c->move_pause_last);
+
     return ret;
 }
 int cpupool_move_domain(struct domain *d, struct cpupool *c)
@@ -900,6 +909,11 @@ void dump_runq(unsigned char key)
     {
         printk("Cpupool %d:\n", (*c)->cpupool_id);
         printk("Cpus: %*pbl\n", CPUMASK_PR((*c)->cpu_valid));
+        if ( (*c)->n_moves )
+            printk("Domains moved in: %u, pause last %"PRI_stime"us max %"
+                   PRI_stime"us\n", (*c)->n_moves,
+                   (*c)->move_pause_last / MICROSECS(1),
+                   (*c)->move_pause_max / MICROSECS(1));
         schedule_dump(*c);
     }
 
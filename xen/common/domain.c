@@ -386,7 +386,7 @@ struct domain *domain_create(domid_t domid,
 
     atomic_set(&d->refcnt, 1);
     spin_lock_init_prof(d, domain_lock);
-    spin_lock_init_prof(d, page_alloc_lock);
+    spin_lock_init_prof_queued(d, page_alloc_lock);
     spin_lock_init(&d->hypercall_deadlock_mutex);
     INIT_PAGE_LIST_HEAD(&d->page_list);
     INIT_PAGE_LIST_HEAD(&d->xenpage_list);
@@ -955,6 +955,8 @@ static void complete_domain_destroy(struct rcu_head *head)
 
     grant_table_destroy(d);
 
+    domain_teardown_free(d);
+
     arch_domain_destroy(d);
 
     watchdog_domain_destroy(d);
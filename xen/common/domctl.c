@@ -591,6 +591,13 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
                 __HYPERVISOR_domctl, "h", u_domctl);
         goto domctl_out_unlock_domonly;
 
+    case XEN_DOMCTL_get_teardown_progress:
+        /* Polled while a destroy is in progress: don't hold up others. */
+        domctl_lock_release();
+        domain_teardown_progress(d, &op->u.teardown_progress);
+        copyback = 1;
+        goto domctl_out_unlock_domonly;
+
     case XEN_DOMCTL_setnodeaffinity:
     {
         nodemask_t new_affinity;
@@ -24,6 +24,7 @@
 #include <xen/compat.h>
 #include <xen/guest_access.h>
 #include <xen/keyhandler.h>
+#include <xen/softirq.h>
 #include <xen/event_fifo.h>
 #include <asm/current.h>
 
@@ -204,11 +205,207 @@ static int get_free_port(struct domain *d)
     return -ENOSPC;
 }
 
+struct evtchn_coalesce {
+    spinlock_t lock;
+    unsigned int max_events; /* Raise an event once this many were sent, */
+    s_time_t interval;       /* or this long after the first one held. */
+    unsigned int held;       /* Events held back since the last one raised. */
+    struct timer timer;
+    struct domain *d;
+    struct evtchn *chn;      /* NULL once freed. */
+    struct rcu_head rcu;
+};
+
+/* Caller must hold the channel's lock. */
+static void evtchn_coalesce_raise(struct evtchn_coalesce *co)
+{
+    struct evtchn *chn = co->chn;
+
+    ASSERT(spin_is_locked(&chn->lock));
+    co->d->evtchn_port_ops->set_pending(co->d->vcpu[chn->notify_vcpu_id], chn);
+}
+
+static void evtchn_coalesce_timer_fn(void *data)
+{
+    struct evtchn_coalesce *co = data;
+    struct evtchn *chn;
+    unsigned long flags;
+    unsigned int held;
+
+    spin_lock_irqsave(&co->lock, flags);
+    chn = co->chn;
+    held = co->held;
+    co->held = 0;
+    spin_unlock_irqrestore(&co->lock, flags);
+
+    if ( !chn || !held )
+        return;
+
+    spin_lock(&chn->lock);
+
+    /* The policy may have been freed meanwhile. */
+    if ( ACCESS_ONCE(chn->coalesce) == co )
+        evtchn_coalesce_raise(co);
+
+    spin_unlock(&chn->lock);
+}
+
+bool evtchn_coalesce_event(struct evtchn *chn)
+{
+    struct evtchn_coalesce *co = ACCESS_ONCE(chn->coalesce);
+    unsigned long flags;
+    bool held = false;
+
+    if ( !co )
+        return false;
+
+    spin_lock_irqsave(&co->lock, flags);
+
+    if ( co->interval &&
+         (!co->max_events || co->held + 1 < co->max_events) )
+    {
+        if ( !co->held++ )
+            set_timer(&co->timer, NOW() + co->interval);
+        held = true;
+    }
+    else if ( co->held )
+    {
+        /* Enough events sent: raise this one, restarting the count. */
+        co->held = 0;
+        stop_timer(&co->timer);
+    }
+
+    spin_unlock_irqrestore(&co->lock, flags);
+
+    return held;
+}
+
+static void evtchn_coalesce_free_rcu(struct rcu_head *head)
+{
+    struct evtchn_coalesce *co = container_of(head, struct evtchn_coalesce,
+                                              rcu);
+
+    kill_timer(&co->timer);
+    xfree(co);
+}
+
+/*
+ * Caller must hold the channel's lock(s). Senders not holding any of them
+ * (e.g. of PIRQs) may still be looking at the policy, and possibly arm its
+ * timer, so free it only after an RCU grace period. The timer, whose handler
+ * takes the channel's lock, is killed then too; until then it finds the
+ * policy detached from the channel.
+ */
+static void evtchn_coalesce_free(struct evtchn *chn)
+{
+    struct evtchn_coalesce *co = chn->coalesce;
+    unsigned long flags;
+
+    if ( !co )
+        return;
+
+    ASSERT(spin_is_locked(&chn->lock));
+
+    ACCESS_ONCE(chn->coalesce) = NULL;
+
+    spin_lock_irqsave(&co->lock, flags);
+    co->chn = NULL;
+    co->held = 0;
+    stop_timer(&co->timer);
+    spin_unlock_irqrestore(&co->lock, flags);
+
+    call_rcu(&co->rcu, evtchn_coalesce_free_rcu);
+}
+
+static long evtchn_set_coalesce(const struct evtchn_set_coalesce *set)
+{
+    struct domain *d = current->domain;
+    struct evtchn_coalesce *co;
+    struct evtchn *chn;
+    unsigned long flags;
+    unsigned int held;
+    long rc = 0;
+
+    if ( set->interval_us > EVTCHN_COALESCE_MAX_INTERVAL_US )
+        return -EINVAL;
+
+    spin_lock(&d->event_lock);
+
+    if ( !port_is_valid(d, set->port) )
+    {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    chn = evtchn_from_port(d, set->port);
+    if ( chn->state == ECS_FREE || chn->state == ECS_RESERVED ||
+         consumer_is_xen(chn) )
+    {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    co = chn->coalesce;
+    if ( !co )
+    {
+        if ( !set->interval_us )
+            goto out;
+
+        co = xzalloc(struct evtchn_coalesce);
+        if ( !co )
+        {
+            rc = -ENOMEM;
+            goto out;
+        }
+
+        spin_lock_init(&co->lock);
+        init_timer(&co->timer, evtchn_coalesce_timer_fn, co,
+                   d->vcpu[chn->notify_vcpu_id]->processor);
+        co->d = d;
+        co->chn = chn;
+    }
+
+    spin_lock_irqsave(&co->lock, flags);
+    co->max_events = set->max_events;
+    co->interval = MICROSECS(set->interval_us);
+    held = co->held;
+    if ( !co->interval || (co->max_events && held >= co->max_events) )
+    {
+        co->held = 0;
+        stop_timer(&co->timer);
+    }
+    else
+        held = 0;
+    spin_unlock_irqrestore(&co->lock, flags);
+
+    /* Publish the policy once it is initialized. */
+    if ( !chn->coalesce )
+    {
+        smp_wmb();
+        ACCESS_ONCE(chn->coalesce) = co;
+    }
+
+    if ( held )
+    {
+        spin_lock(&chn->lock);
+        evtchn_coalesce_raise(co);
+        spin_unlock(&chn->lock);
+    }
+
+ out:
+    spin_unlock(&d->event_lock);
+
+    return rc;
+}
+
 void evtchn_free(struct domain *d, struct evtchn *chn)
 {
     /* Clear pending event to avoid unexpected behavior on re-bind. */
     evtchn_port_clear_pending(d, chn);
 
+    /* Events held back are dropped along with the policy. */
+    evtchn_coalesce_free(chn);
+
     /* Reset binding to vcpu0 when the channel is freed. */
     chn->state          = ECS_FREE;
     chn->notify_vcpu_id = 0;
@@ -724,6 +921,66 @@ out:
     return ret;
 }
 
+static long evtchn_send_batch(struct domain *ld,
+                              XEN_GUEST_HANDLE_PARAM(void) arg)
+{
+    XEN_GUEST_HANDLE_PARAM(evtchn_send_batch_t) uop =
+        guest_handle_cast(arg, evtchn_send_batch_t);
+    XEN_GUEST_HANDLE_PARAM(evtchn_port_t) ports =
+        guest_handle_cast(arg, evtchn_port_t);
+    struct evtchn_send_batch batch;
+    evtchn_port_t buf[16];
+    unsigned int i, j, nr;
+    long rc = 0;
+
+    BUILD_BUG_ON(offsetof(struct evtchn_send_batch, ports) %
+                 sizeof(evtchn_port_t));
+
+    if ( copy_from_guest(&batch, uop, 1) )
+        return -EFAULT;
+
+    if ( batch.nr_ports > EVTCHN_SEND_BATCH_MAX )
+        return -EINVAL;
+
+    /*
+     * Defer the IPIs kicking the target vCPUs until the whole batch has been
+     * processed, so that each physical CPU gets at most one of them however
+     * many of the ports notify vCPUs running there.
+     */
+    cpu_raise_softirq_batch_begin();
+
+    for ( i = 0; !rc && i < batch.nr_ports; i += nr )
+    {
+        nr = min_t(unsigned int, batch.nr_ports - i, ARRAY_SIZE(buf));
+
+        if ( copy_from_guest_offset(buf, ports,
+                                    offsetof(struct evtchn_send_batch, ports) /
+                                    sizeof(evtchn_port_t) + i, nr) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+
+        for ( j = 0; j < nr; j++ )
+        {
+            rc = evtchn_send(ld, buf[j]);
+            if ( rc )
+            {
+                nr = j;
+                break;
+            }
+        }
+    }
+
+    cpu_raise_softirq_batch_finish();
+
+    batch.nr_sent = i;
+    if ( __copy_field_to_guest(uop, &batch, nr_sent) )
+        rc = -EFAULT;
+
+    return rc;
+}
+
 int guest_enabled_event(struct vcpu *v, uint32_t virq)
 {
     return ((v != NULL) && (v->virq_to_evtchn[virq] != 0));
@@ -983,6 +1240,10 @@ long evtchn_bind_vcpu(unsigned int port, unsigned int vcpu_id)
         break;
     }
 
+    /* Fire the coalescing timer where the events are delivered. */
+    if ( !rc && chn->coalesce )
+        migrate_timer(&chn->coalesce->timer, v->processor);
+
  out:
     spin_unlock(&d->event_lock);
 
@@ -1123,6 +1384,10 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case EVTCHNOP_send_batch:
+        rc = evtchn_send_batch(current->domain, arg);
+        break;
+
     case EVTCHNOP_status: {
         struct evtchn_status status;
         if ( copy_from_guest(&status, arg, 1) != 0 )
@@ -1186,6 +1451,14 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case EVTCHNOP_set_coalesce: {
+        struct evtchn_set_coalesce set_coalesce;
+        if ( copy_from_guest(&set_coalesce, arg, 1) != 0 )
+            return -EFAULT;
+        rc = evtchn_set_coalesce(&set_coalesce);
+        break;
+    }
+
     case EVTCHNOP_set_priority: {
         struct evtchn_set_priority set_priority;
         if ( copy_from_guest(&set_priority, arg, 1) != 0 )
@@ -152,12 +152,214 @@ static bool_t evtchn_fifo_set_link(struct domain *d, event_word_t *word,
     return 1;
 }
 
+/*
+ * Terminates a queue's list of staged events, so that a NULL fifo_next
+ * always means the event is not staged.
+ */
+#define EVTCHN_FIFO_STAGED_END ((struct evtchn *)1)
+
+static inline struct evtchn *staged_next(const struct evtchn *evtchn)
+{
+    return evtchn->fifo_next == EVTCHN_FIFO_STAGED_END ? NULL
+                                                       : evtchn->fifo_next;
+}
+
+/*
+ * Add an event to the list of events waiting to be linked to a queue.
+ *
+ * Returns true if the list was empty, in which case the caller must drain
+ * it.  An event which is already staged (possibly for another queue) is
+ * left alone, as the drain that will pick it up has yet to link it.
+ */
+static bool evtchn_fifo_stage(struct evtchn_fifo_queue *q,
+                              struct evtchn *evtchn)
+{
+    struct evtchn *head, *old;
+
+    if ( cmpxchg(&evtchn->fifo_next, NULL, EVTCHN_FIFO_STAGED_END) )
+        return false;
+
+    head = ACCESS_ONCE(q->staged);
+    for ( ; ; )
+    {
+        ACCESS_ONCE(evtchn->fifo_next) = head ?: EVTCHN_FIFO_STAGED_END;
+        old = cmpxchg(&q->staged, head, evtchn);
+        if ( old == head )
+            return !head;
+        head = old;
+    }
+}
+
+/*
+ * Clear the staged state before linking, so that an event raised again
+ * once the guest has consumed it gets staged anew rather than dropped.
+ */
+static void evtchn_fifo_unstage(struct evtchn *evtchn)
+{
+    ACCESS_ONCE(evtchn->fifo_next) = NULL;
+    smp_mb();
+}
+
+/*
+ * Link an event, which the caller has just marked LINKED, to the tail of q.
+ * q must be locked.  Returns true if the queue was empty.
+ */
+static bool evtchn_fifo_link_tail(struct domain *d,
+                                  struct evtchn_fifo_queue *q,
+                                  unsigned int port)
+{
+    bool_t linked = 0;
+
+    /*
+     * If this event was the tail, the queue is empty but q->tail
+     * would appear linked as we just set LINKED, so forget it.
+     */
+    if ( q->tail == port )
+        q->tail = 0;
+
+    /*
+     * Atomically link the tail to port iff the tail is linked.
+     * If the tail is unlinked the queue is empty.
+     *
+     * If the queue is empty (i.e., we haven't linked to the new
+     * event), head must be updated.
+     */
+    if ( q->tail )
+        linked = evtchn_fifo_set_link(d, evtchn_fifo_word_from_port(d, q->tail),
+                                      port);
+    if ( !linked )
+        write_atomic(q->head, port);
+    q->tail = port;
+
+    return !linked;
+}
+
+/*
+ * Link an event to the tail of q, moving it off the queue it was last on.
+ * Returns true if q was empty.
+ */
+static bool evtchn_fifo_link(struct vcpu *v, struct evtchn_fifo_queue *q,
+                             struct evtchn *evtchn)
+{
+    struct domain *d = v->domain;
+    struct evtchn_fifo_queue *old_q;
+    event_word_t *word = evtchn_fifo_word_from_port(d, evtchn->port);
+    unsigned long flags;
+    bool empty;
+
+    old_q = lock_old_queue(d, evtchn, &flags);
+    if ( !old_q )
+        return false;
+
+    if ( guest_test_and_set_bit(d, EVTCHN_FIFO_LINKED, word) )
+    {
+        spin_unlock_irqrestore(&old_q->lock, flags);
+        return false;
+    }
+
+    /* Moved to a different queue? */
+    if ( old_q != q )
+    {
+        /*
+         * If this event was a tail, the old queue is now empty and
+         * its tail must be invalidated to prevent adding an event to
+         * the old queue from corrupting the new queue.
+         */
+        if ( old_q->tail == evtchn->port )
+            old_q->tail = 0;
+
+        evtchn->last_vcpu_id = v->vcpu_id;
+        evtchn->last_priority = q->priority;
+
+        spin_unlock_irqrestore(&old_q->lock, flags);
+        spin_lock_irqsave(&q->lock, flags);
+    }
+
+    empty = evtchn_fifo_link_tail(d, q, evtchn->port);
+
+    spin_unlock_irqrestore(&q->lock, flags);
+
+    return empty;
+}
+
+static void evtchn_fifo_kick(struct vcpu *v, struct evtchn_fifo_queue *q)
+{
+    /*
+     * Only the first event making the queue ready kicks the vCPU.  When
+     * called from EVTCHNOP_send_batch the IPI this may raise is deferred
+     * and coalesced with those for other vCPUs on the same pCPU.
+     */
+    if ( !guest_test_and_set_bit(v->domain, q->priority,
+                                 &v->evtchn_fifo->control_block->ready) )
+        vcpu_mark_events_pending(v);
+}
+
+/*
+ * Link the events staged for q.
+ *
+ * Senders only stage events, which is lock-free, and the one finding the
+ * list empty drains it, so at most a couple of CPUs contend for the queue
+ * lock however many are sending to the queue.  Events last on another
+ * queue need that queue's lock as well, and are linked once q's lock has
+ * been dropped.
+ */
+static void evtchn_fifo_drain(struct vcpu *v, struct evtchn_fifo_queue *q)
+{
+    struct domain *d = v->domain;
+    struct evtchn *evtchn, *next, *list = NULL;
+    struct evtchn *moving = NULL, **moving_tail = &moving;
+    unsigned long flags;
+    bool empty = false;
+
+    spin_lock_irqsave(&q->lock, flags);
+
+    /* Events were staged in LIFO order; link them in the order sent. */
+    for ( evtchn = xchg(&q->staged, NULL); evtchn; evtchn = next )
+    {
+        next = staged_next(evtchn);
+        evtchn->fifo_next = list ?: EVTCHN_FIFO_STAGED_END;
+        list = evtchn;
+    }
+
+    for ( evtchn = list; evtchn; evtchn = next )
+    {
+        next = staged_next(evtchn);
+
+        if ( &d->vcpu[evtchn->last_vcpu_id]->evtchn_fifo->queue[
+                  evtchn->last_priority] != q )
+        {
+            evtchn->fifo_next = EVTCHN_FIFO_STAGED_END;
+            *moving_tail = evtchn;
+            moving_tail = &evtchn->fifo_next;
+            continue;
+        }
+
+        evtchn_fifo_unstage(evtchn);
+
+        if ( !guest_test_and_set_bit(d, EVTCHN_FIFO_LINKED,
+                                     evtchn_fifo_word_from_port(d,
+                                                                evtchn->port)) )
+            empty |= evtchn_fifo_link_tail(d, q, evtchn->port);
+    }
+
+    spin_unlock_irqrestore(&q->lock, flags);
+
+    for ( evtchn = moving; evtchn; evtchn = next )
+    {
+        next = staged_next(evtchn);
+        evtchn_fifo_unstage(evtchn);
+        empty |= evtchn_fifo_link(v, q, evtchn);
+    }
+
+    if ( empty )
+        evtchn_fifo_kick(v, q);
+}
+
 static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
 {
     struct domain *d = v->domain;
     unsigned int port;
     event_word_t *word;
-    unsigned long flags;
     bool_t was_pending;
 
     port = evtchn->port;
@@ -181,9 +383,7 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
     if ( !guest_test_bit(d, EVTCHN_FIFO_MASKED, word) &&
          !guest_test_bit(d, EVTCHN_FIFO_LINKED, word) )
     {
-        struct evtchn_fifo_queue *q, *old_q;
-        event_word_t *tail_word;
-        bool_t linked = 0;
+        struct evtchn_fifo_queue *q;
 
         /*
          * Control block not mapped.  The guest must not unmask an
@@ -204,59 +404,8 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
          */
         q = &v->evtchn_fifo->queue[evtchn->priority];
 
-        old_q = lock_old_queue(d, evtchn, &flags);
-        if ( !old_q )
-            goto done;
-
-        if ( guest_test_and_set_bit(d, EVTCHN_FIFO_LINKED, word) )
-        {
-            spin_unlock_irqrestore(&old_q->lock, flags);
-            goto done;
-        }
-
-        /*
-         * If this event was a tail, the old queue is now empty and
-         * its tail must be invalidated to prevent adding an event to
-         * the old queue from corrupting the new queue.
-         */
-        if ( old_q->tail == port )
-            old_q->tail = 0;
-
-        /* Moved to a different queue? */
-        if ( old_q != q )
-        {
-            evtchn->last_vcpu_id = evtchn->notify_vcpu_id;
-            evtchn->last_priority = evtchn->priority;
-
-            spin_unlock_irqrestore(&old_q->lock, flags);
-            spin_lock_irqsave(&q->lock, flags);
-        }
-
-        /*
-         * Atomically link the tail to port iff the tail is linked.
-         * If the tail is unlinked the queue is empty.
-         *
-         * If port is the same as tail, the queue is empty but q->tail
-         * will appear linked as we just set LINKED above.
-         *
-         * If the queue is empty (i.e., we haven't linked to the new
-         * event), head must be updated.
-         */
-        if ( q->tail )
-        {
-            tail_word = evtchn_fifo_word_from_port(d, q->tail);
-            linked = evtchn_fifo_set_link(d, tail_word, port);
-        }
-        if ( !linked )
-            write_atomic(q->head, port);
-        q->tail = port;
-
-        spin_unlock_irqrestore(&q->lock, flags);
-
-        if ( !linked
-             && !guest_test_and_set_bit(d, q->priority,
-                                        &v->evtchn_fifo->control_block->ready) )
-            vcpu_mark_events_pending(v);
+        if ( evtchn_fifo_stage(q, evtchn) )
+            evtchn_fifo_drain(v, q);
     }
  done:
     if ( !was_pending )
@@ -42,6 +42,8 @@
 #include <asm/flushtlb.h>
 #include <asm/guest_atomics.h>
 
+#define MAPTRACK_STEAL_BUCKETS 7
+
 /* Per-domain grant information. */
 struct grant_table {
     /*
@@ -77,6 +79,31 @@ struct grant_table {
     struct active_grant_entry **active;
     /* Mapping tracking table per vcpu. */
     struct grant_mapping **maptrack;
+    /*
+     * Maptrack entry steals from other vCPUs, by number of vCPUs probed
+     * (1, 2, 3-4, ..., 33+), the last bucket counting failures.  Updated
+     * without locking, for statistics only.
+     */
+    unsigned long         maptrack_steals[MAPTRACK_STEAL_BUCKETS + 1];
+    /*
+     * Cached (GNTMAP_cache) mappings of other domains' grants, hashed by
+     * (domid, ref), and the released ones in LRU order.
+     */
+    spinlock_t            cache_lock;
+    struct list_head     *cache_hash;
+    struct list_head      cache_idle;
+    unsigned int          cache_nr_idle;
+    struct timer          cache_timer;    /* Checks the released mappings. */
+    /*
+     * Unmaps whose completion (i.e. dropping of the page references and
+     * pins) waits for a TLB flush in deferred flush mode, and the number of
+     * such flushes started (see gnttab_flush_unmaps()).
+     */
+    spinlock_t            flush_lock;
+    struct gnttab_unmap_common *flush_pending;
+    unsigned int          flush_nr_pending;
+    unsigned int          flush_gen;
+    struct timer          flush_timer;
 
     /* Domain to which this struct grant_table belongs. */
     const struct domain *domain;
@@ -113,6 +140,8 @@ custom_runtime_param("gnttab_max_frames", parse_gnttab_max_frames);
 
 static unsigned int __read_mostly opt_max_maptrack_frames = 1024;
 
+#define MAPTRACK_GROW_MAX      16
+
 static int parse_gnttab_max_maptrack_frames(const char *arg)
 {
     return parse_gnttab_limit("gnttab_max_maptrack_frames", arg,
@@ -121,12 +150,23 @@ static int parse_gnttab_max_maptrack_frames(const char *arg)
 custom_runtime_param("gnttab_max_maptrack_frames",
                      parse_gnttab_max_maptrack_frames);
 
+/* Number of maptrack frames added at once when a vCPU runs out of handles. */
+static unsigned int __read_mostly opt_maptrack_grow = 4;
+integer_runtime_param("gnttab_maptrack_grow", opt_maptrack_grow);
+
+/* Maximum number of released cached mappings kept per domain. */
+unsigned int __read_mostly opt_gnttab_max_cached = 1024;
+integer_runtime_param("gnttab_max_cached", opt_gnttab_max_cached);
+
+/* Bumped when a domain dies, for its grants' cached mappings to be dropped. */
+
 #ifndef GNTTAB_MAX_VERSION
 #define GNTTAB_MAX_VERSION 2
 #endif
 
 static unsigned int __read_mostly opt_gnttab_max_version = GNTTAB_MAX_VERSION;
 static bool __read_mostly opt_transitive_grants = true;
+static bool __read_mostly opt_gnttab_deferred_flush;
 
 static int __init parse_gnttab(const char *s)
 {
@@ -150,6 +190,8 @@ static int __init parse_gnttab(const char *s)
         }
         else if ( (val = parse_boolean("transitive", s, ss)) >= 0 )
             opt_transitive_grants = val;
+        else if ( (val = parse_boolean("deferred-flush", s, ss)) >= 0 )
+            opt_gnttab_deferred_flush = val;
         else
             rc = -EINVAL;
 
@@ -189,6 +231,12 @@ struct gnttab_unmap_common {
     uint64_t dev_bus_addr;
     uint64_t new_addr;
     grant_handle_t handle;
+    struct domain *ld;
+
+    /* May a cached mapping be released rather than unmapped? */
+    bool cache_release;
+    /* Flags added to the mapping's ones when removing the host mapping. */
+    unsigned int host_flags;
 
     /* Return */
     int16_t status;
@@ -198,11 +246,23 @@ struct gnttab_unmap_common {
     mfn_t mfn;
     struct domain *rd;
     grant_ref_t ref;
+
+    /* Deferred flush mode: flush generation when the unmap was done. */
+    unsigned int flush_gen;
 };
 
 /* Number of unmap operations that are done between each tlb flush */
 #define GNTTAB_UNMAP_BATCH_SIZE 32
 
+/*
+ * Deferred flush mode: maximum number of unmaps waiting for a TLB flush,
+ * maximum time they wait, and number of them taken off for completion (not
+ * holding the flush lock) at once.
+ */
+#define GNTTAB_DEFERRED_MAX     128
+#define GNTTAB_DEFERRED_TIMEOUT MILLISECS(1)
+#define GNTTAB_DEFERRED_BATCH   8
+
 
 #define PIN_FAIL(_lbl, _rc, _f, _a...)          \
     do {                                        \
@@ -217,7 +277,7 @@ struct gnttab_unmap_common {
  */
 struct grant_mapping {
     grant_ref_t ref;        /* grant ref */
-    uint16_t flags;         /* 0-4: GNTMAP_* ; 5-15: unused */
+    uint16_t flags;         /* 0-6: GNTMAP_* ; 7-15: unused */
     domid_t  domid;         /* granting domain */
     uint32_t vcpu;          /* vcpu which created the grant mapping */
     uint32_t pad;           /* round size to a power of 2 */
@@ -534,7 +594,9 @@ static grant_handle_t steal_maptrack_handle(struct grant_table *t,
                                             const struct vcpu *curr)
 {
     const struct domain *currd = curr->domain;
-    unsigned int first, i;
+    unsigned int first, i, probes = 0;
+
+    perfc_incr(gnttab_maptrack_steal);
 
     /* Find an initial victim. */
     first = i = get_random() % currd->max_vcpus;
@@ -545,9 +607,12 @@ static grant_handle_t steal_maptrack_handle(struct grant_table *t,
             grant_handle_t handle;
 
             handle = _get_maptrack_handle(t, currd->vcpu[i]);
+            ++probes;
             if ( handle != INVALID_MAPTRACK_HANDLE )
             {
                 maptrack_entry(t, handle).vcpu = curr->vcpu_id;
+                t->maptrack_steals[min_t(unsigned int, fls(probes - 1),
+                                         MAPTRACK_STEAL_BUCKETS - 1)]++;
                 return handle;
             }
         }
@@ -558,6 +623,8 @@ static grant_handle_t steal_maptrack_handle(struct grant_table *t,
     } while ( i != first );
 
     /* No free handles on any VCPU. */
+    t->maptrack_steals[MAPTRACK_STEAL_BUCKETS]++;
+
     return INVALID_MAPTRACK_HANDLE;
 }
 
@@ -565,7 +632,7 @@ static inline void
 put_maptrack_handle(
     struct grant_table *t, grant_handle_t handle)
 {
-    struct domain *currd = current->domain;
+    const struct domain *d = t->domain;
     struct vcpu *v;
     unsigned int prev_tail, cur_tail;
 
@@ -573,7 +640,7 @@ put_maptrack_handle(
     maptrack_entry(t, handle).ref = MAPTRACK_TAIL;
 
     /* 2. Add entry to the tail of the list on the original VCPU. */
-    v = currd->vcpu[maptrack_entry(t, handle).vcpu];
+    v = d->vcpu[maptrack_entry(t, handle).vcpu];
 
     spin_lock(&v->maptrack_freelist_lock);
 
@@ -594,26 +661,44 @@ get_maptrack_handle(
     struct grant_table *lgt)
 {
     struct vcpu          *curr = current;
-    unsigned int          i, head;
+    unsigned int          i, f, nr, head, headroom;
     grant_handle_t        handle;
-    struct grant_mapping *new_mt = NULL;
+    struct grant_mapping *new_mt[MAPTRACK_GROW_MAX], *last;
 
     handle = _get_maptrack_handle(lgt, curr);
     if ( likely(handle != INVALID_MAPTRACK_HANDLE) )
         return handle;
 
-    spin_lock(&lgt->maptrack_lock);
-
     /*
      * If we've run out of handles and still have frame headroom, try
-     * allocating a new maptrack frame.  If there is no headroom, or we're
-     * out of memory, try stealing an entry from another VCPU (in case the
-     * guest isn't mapping across its VCPUs evenly).
+     * allocating new maptrack frames.  Several frames are added at once,
+     * allocated on the vCPU's node and initialized before taking the
+     * maptrack lock, to keep vCPUs ramping up in parallel from contending on
+     * it.  If there is no headroom, or we're out of memory, try stealing an
+     * entry from another VCPU (in case the guest isn't mapping across its
+     * VCPUs evenly).
      */
-    if ( nr_maptrack_frames(lgt) < lgt->max_maptrack_frames )
-        new_mt = alloc_xenheap_page();
+    headroom = lgt->max_maptrack_frames -
+               read_atomic(&lgt->maptrack_limit) / MAPTRACK_PER_PAGE;
+    nr = ACCESS_ONCE(opt_maptrack_grow);
+    nr = min_t(unsigned int, max(nr, 1U), MAPTRACK_GROW_MAX);
+    nr = min(nr, headroom);
+    for ( f = 0; f < nr; f++ )
+    {
+        new_mt[f] = alloc_xenheap_pages(0, MEMF_node(vcpu_to_node(curr)));
+        if ( !new_mt[f] )
+            break;
+        clear_page(new_mt[f]);
+    }
+    nr = f;
 
-    if ( !new_mt )
+    spin_lock(&lgt->maptrack_lock);
+
+    headroom = lgt->max_maptrack_frames - nr_maptrack_frames(lgt);
+    while ( nr > headroom )
+        free_xenheap_page(new_mt[--nr]);
+
+    if ( !nr )
     {
         spin_unlock(&lgt->maptrack_lock);
 
@@ -636,36 +721,40 @@ get_maptrack_handle(
         return steal_maptrack_handle(lgt, curr);
     }
 
-    clear_page(new_mt);
-
     /*
      * Use the first new entry and add the remaining entries to the
      * head of the free list.
      */
     handle = lgt->maptrack_limit;
 
-    for ( i = 0; i < MAPTRACK_PER_PAGE; i++ )
-    {
-        BUILD_BUG_ON(sizeof(new_mt->ref) < sizeof(handle));
-        new_mt[i].ref = handle + i + 1;
-        new_mt[i].vcpu = curr->vcpu_id;
-    }
+    for ( f = 0; f < nr; f++ )
+        for ( i = 0; i < MAPTRACK_PER_PAGE; i++ )
+        {
+            BUILD_BUG_ON(sizeof(new_mt[f]->ref) < sizeof(handle));
+            new_mt[f][i].ref = handle + f * MAPTRACK_PER_PAGE + i + 1;
+            new_mt[f][i].vcpu = curr->vcpu_id;
+        }
+    last = &new_mt[nr - 1][MAPTRACK_PER_PAGE - 1];
 
-    /* Set tail directly if this is the first page for this VCPU. */
+    /* Set tail directly if these are the first pages for this VCPU. */
     if ( curr->maptrack_tail == MAPTRACK_TAIL )
-        curr->maptrack_tail = handle + MAPTRACK_PER_PAGE - 1;
+        curr->maptrack_tail = handle + nr * MAPTRACK_PER_PAGE - 1;
 
-    lgt->maptrack[nr_maptrack_frames(lgt)] = new_mt;
+    for ( f = 0; f < nr; f++ )
+        lgt->maptrack[nr_maptrack_frames(lgt) + f] = new_mt[f];
     smp_wmb();
-    lgt->maptrack_limit += MAPTRACK_PER_PAGE;
+    lgt->maptrack_limit += nr * MAPTRACK_PER_PAGE;
 
     spin_unlock(&lgt->maptrack_lock);
+
+    perfc_add(gnttab_maptrack_grow, nr);
+
     spin_lock(&curr->maptrack_freelist_lock);
 
     do {
-        new_mt[i - 1].ref = read_atomic(&curr->maptrack_head);
-        head = cmpxchg(&curr->maptrack_head, new_mt[i - 1].ref, handle + 1);
-    } while ( head != new_mt[i - 1].ref );
+        last->ref = read_atomic(&curr->maptrack_head);
+        head = cmpxchg(&curr->maptrack_head, last->ref, handle + 1);
+    } while ( head != last->ref );
 
     spin_unlock(&curr->maptrack_freelist_lock);
 
@@ -936,6 +1025,508 @@ static unsigned int mapkind(
     return kind;
 }
 
+/*
+ * Grant mapping cache.
+ *
+ * A mapping established with GNTMAP_cache is entered into a per-domain cache
+ * keyed by (domid, ref). Unmapping it only releases it: the mapping, its
+ * maptrack handle and the pin of the grant stay in place, and neither page
+ * tables nor TLBs are touched. A later GNTMAP_cache map of the same grant
+ * with the same flags and address gets the released mapping back after
+ * checking that the grant is still valid, again without touching page
+ * tables. Only v2 grants are cached, their revocation being visible in the
+ * entry's flags while the status still has them in use.
+ *
+ * Released mappings are evicted (really unmapped) when found to have been
+ * revoked by the granting domain - either when being looked up, while
+ * lazily scanning the released mappings on map and unmap hypercalls, or by
+ * a periodic scan of all of them while there are any - when the granting
+ * domain dies, when unmapped a second time, and when more than
+ * opt_gnttab_max_cached of them accumulate. As all but the first and the
+ * last two may happen in the context of another domain, the address to
+ * unmap a released mapping by is made independent of the mapping domain's
+ * context when releasing it (see grant_host_mapping_remote()).
+ *
+ * The cache lock nests inside the granting domain's grant table lock.
+ */
+struct gnttab_cache_entry {
+    struct list_head hash;
+    struct list_head idle;      /* On cache_idle if released. */
+    uint64_t host_addr;
+    uint64_t dev_bus_addr;
+    uint64_t evict_addr;        /* host_addr, in any context, if released. */
+    unsigned int evict_flags;   /* Flags to be used with evict_addr. */
+    grant_handle_t handle;
+    grant_ref_t ref;
+    domid_t domid;
+    uint16_t flags;
+    bool released;
+};
+
+#define GNTTAB_CACHE_HASH_SIZE 256
+/* Number of released mappings checked for revocation per hypercall. */
+#define GNTTAB_CACHE_SCAN      8
+/* Interval of the checks of all released mappings. */
+#define GNTTAB_CACHE_INTERVAL  SECONDS(1)
+
+static void unmap_common(struct gnttab_unmap_common *op);
+static void unmap_common_complete(struct gnttab_unmap_common *op);
+static void gnttab_flush_unmaps(struct domain *ld);
+
+static struct list_head *gnttab_cache_bucket(const struct grant_table *gt,
+                                             domid_t domid, grant_ref_t ref)
+{
+    return &gt->cache_hash[(ref ^ (domid * 0x9e37U)) %
+                           GNTTAB_CACHE_HASH_SIZE];
+}
+
+/* Caller must hold gt's cache lock. */
+static struct gnttab_cache_entry *gnttab_cache_find(
+    const struct grant_table *gt, domid_t domid, grant_ref_t ref)
+{
+    struct gnttab_cache_entry *e;
+
+    if ( !gt->cache_hash )
+        return NULL;
+
+    list_for_each_entry ( e, gnttab_cache_bucket(gt, domid, ref), hash )
+        if ( e->domid == domid && e->ref == ref )
+            return e;
+
+    return NULL;
+}
+
+/* Caller must hold gt's cache lock. */
+static void gnttab_cache_detach(struct grant_table *gt,
+                                struct gnttab_cache_entry *e)
+{
+    list_del(&e->hash);
+    if ( e->released )
+    {
+        list_del(&e->idle);
+        gt->cache_nr_idle--;
+    }
+}
+
+/*
+ * Is the grant underlying a released mapping still valid? Caller must hold
+ * rd's grant table read lock.
+ */
+static bool gnttab_cache_valid(const struct domain *ld,
+                               const struct domain *rd,
+                               const struct gnttab_cache_entry *e)
+{
+    struct grant_table *rgt = rd->grant_table;
+    const grant_entry_header_t *shah;
+    uint16_t flags;
+
+    /*
+     * Only v2 grants get cached: a v1 grant can't be revoked as long as it
+     * is pinned, and hence its revocation could never be observed here.
+     */
+    if ( rd->is_dying || rgt->gt_version != 2 ||
+         e->ref >= nr_grant_entries(rgt) )
+        return false;
+
+    shah = shared_entry_header(rgt, e->ref);
+    flags = ACCESS_ONCE(shah->flags);
+
+    return (flags & GTF_type_mask) == GTF_permit_access &&
+           ACCESS_ONCE(shah->domid) == ld->domain_id &&
+           ((e->flags & GNTMAP_readonly) || !(flags & GTF_readonly));
+}
+
+/*
+ * Really unmap (detached) released mappings of ld, with a single TLB flush,
+ * and free their entries. May be called in any context.
+ */
+static void gnttab_cache_evict(struct domain *ld,
+                               struct gnttab_cache_entry **ents,
+                               unsigned int nr)
+{
+    struct gnttab_unmap_common common[GNTTAB_CACHE_SCAN];
+    unsigned int i;
+
+    ASSERT(nr <= ARRAY_SIZE(common));
+
+    for ( i = 0; i < nr; i++ )
+    {
+        common[i] = (struct gnttab_unmap_common){
+            .host_addr = ents[i]->evict_addr,
+            .dev_bus_addr = ents[i]->dev_bus_addr,
+            .handle = ents[i]->handle,
+            .ld = ld,
+            .host_flags = ents[i]->evict_flags,
+            .mfn = INVALID_MFN,
+        };
+        xfree(ents[i]);
+        unmap_common(&common[i]);
+        perfc_incr(gnttab_cache_evict);
+    }
+
+    if ( nr )
+        gnttab_flush_unmaps(ld);
+
+    for ( i = 0; i < nr; i++ )
+        unmap_common_complete(&common[i]);
+}
+
+/*
+ * Check up to nr of the least recently released mappings for revocation of
+ * the grant (or death of the granting domain), and evict the ones found.
+ *
+ * The granting domain's grant table lock is acquired before the cache lock,
+ * hence the cache lock is dropped while looking up the granting domain, and
+ * the entry is looked up again afterwards.
+ */
+static void gnttab_cache_scan(struct domain *ld, unsigned int nr)
+{
+    struct grant_table *lgt = ld->grant_table;
+    struct gnttab_cache_entry *ents[GNTTAB_CACHE_SCAN], *e;
+    unsigned int nr_ents = 0;
+
+    while ( nr-- )
+    {
+        struct domain *rd;
+        domid_t domid;
+        grant_ref_t ref;
+
+        spin_lock(&lgt->cache_lock);
+        if ( list_empty(&lgt->cache_idle) )
+        {
+            spin_unlock(&lgt->cache_lock);
+            break;
+        }
+        e = list_first_entry(&lgt->cache_idle, struct gnttab_cache_entry,
+                             idle);
+        domid = e->domid;
+        ref = e->ref;
+        spin_unlock(&lgt->cache_lock);
+
+        rd = rcu_lock_domain_by_id(domid);
+        if ( rd )
+            grant_read_lock(rd->grant_table);
+
+        spin_lock(&lgt->cache_lock);
+
+        e = gnttab_cache_find(lgt, domid, ref);
+        if ( e && e->released )
+        {
+            if ( rd && gnttab_cache_valid(ld, rd, e) )
+                list_move_tail(&e->idle, &lgt->cache_idle);
+            else
+            {
+                gnttab_cache_detach(lgt, e);
+                ents[nr_ents++] = e;
+                perfc_incr(gnttab_cache_revoked);
+            }
+        }
+
+        spin_unlock(&lgt->cache_lock);
+
+        if ( rd )
+        {
+            grant_read_unlock(rd->grant_table);
+            rcu_unlock_domain(rd);
+        }
+
+        if ( nr_ents == ARRAY_SIZE(ents) )
+        {
+            gnttab_cache_evict(ld, ents, nr_ents);
+            nr_ents = 0;
+        }
+    }
+
+    gnttab_cache_evict(ld, ents, nr_ents);
+}
+
+/*
+ * Revocation check done on each map and unmap hypercall, of a few of the
+ * least recently released mappings.
+ */
+static void gnttab_cache_check(struct domain *ld)
+{
+    if ( read_atomic(&ld->grant_table->cache_nr_idle) )
+        gnttab_cache_scan(ld, GNTTAB_CACHE_SCAN);
+}
+
+/*
+ * Check all released mappings while there are any, for revocations to be
+ * noticed while the domain doesn't issue map or unmap hypercalls.
+ */
+static void gnttab_cache_timer_fn(void *data)
+{
+    struct domain *ld = data;
+    struct grant_table *lgt = ld->grant_table;
+
+    /* Mappings of dying domains are dropped by gnttab_release_mappings(). */
+    if ( ld->is_dying )
+        return;
+
+    gnttab_cache_scan(ld, read_atomic(&lgt->cache_nr_idle));
+
+    spin_lock(&lgt->cache_lock);
+    if ( lgt->cache_nr_idle )
+        set_timer(&lgt->cache_timer, NOW() + GNTTAB_CACHE_INTERVAL);
+    spin_unlock(&lgt->cache_lock);
+}
+
+/*
+ * Evict the released mappings of rd's grants of all other domains, rd dying,
+ * for them not to keep it a zombie until these domains issue map or unmap
+ * hypercalls.
+ */
+static void gnttab_cache_purge(const struct domain *rd)
+{
+    struct gnttab_cache_entry *ents[GNTTAB_CACHE_SCAN], *e, *tmp;
+    struct domain *ld;
+    unsigned int nr_ents;
+
+    rcu_read_lock(&domlist_read_lock);
+
+    for_each_domain ( ld )
+    {
+        struct grant_table *lgt = ld->grant_table;
+
+        if ( ld == rd || ld->is_dying || !read_atomic(&lgt->cache_nr_idle) )
+            continue;
+
+        do {
+            nr_ents = 0;
+
+            spin_lock(&lgt->cache_lock);
+            list_for_each_entry_safe ( e, tmp, &lgt->cache_idle, idle )
+            {
+                if ( e->domid != rd->domain_id )
+                    continue;
+                gnttab_cache_detach(lgt, e);
+                ents[nr_ents++] = e;
+                perfc_incr(gnttab_cache_revoked);
+                if ( nr_ents == ARRAY_SIZE(ents) )
+                    break;
+            }
+            spin_unlock(&lgt->cache_lock);
+
+            gnttab_cache_evict(ld, ents, nr_ents);
+        } while ( nr_ents == ARRAY_SIZE(ents) );
+    }
+
+    rcu_read_unlock(&domlist_read_lock);
+}
+
+/*
+ * Try to satisfy a GNTMAP_cache map request from the cache. Returns true if
+ * a released mapping of the grant at the requested address was handed back.
+ */
+static bool gnttab_cache_get(struct domain *ld, struct domain *rd,
+                             struct gnttab_map_grant_ref *op)
+{
+    struct grant_table *lgt = ld->grant_table, *rgt = rd->grant_table;
+    struct gnttab_cache_entry *e;
+    bool hit = false, revoked = false;
+
+    if ( !read_atomic(&lgt->cache_nr_idle) )
+    {
+        perfc_incr(gnttab_cache_miss);
+        return false;
+    }
+
+    grant_read_lock(rgt);
+    spin_lock(&lgt->cache_lock);
+
+    e = gnttab_cache_find(lgt, op->dom, op->ref);
+    if ( e && e->released && e->flags == op->flags &&
+         (!(e->flags & GNTMAP_host_map) || e->host_addr == op->host_addr) )
+    {
+        if ( gnttab_cache_valid(ld, rd, e) )
+        {
+            list_del(&e->idle);
+            lgt->cache_nr_idle--;
+            e->released = false;
+
+            op->dev_bus_addr = e->dev_bus_addr;
+            op->handle = e->handle;
+            op->status = GNTST_okay;
+            hit = true;
+        }
+        else
+        {
+            gnttab_cache_detach(lgt, e);
+            revoked = true;
+        }
+    }
+
+    spin_unlock(&lgt->cache_lock);
+    grant_read_unlock(rgt);
+
+    if ( revoked )
+    {
+        perfc_incr(gnttab_cache_revoked);
+        gnttab_cache_evict(ld, &e, 1);
+    }
+
+    if ( hit )
+        perfc_incr(gnttab_cache_hit);
+    else
+        perfc_incr(gnttab_cache_miss);
+
+    return hit;
+}
+
+/*
+ * Allocate an entry for a new GNTMAP_cache mapping, and the hash table if
+ * needed, before taking any grant table lock. Returns NULL if the mapping
+ * can't be cached.
+ */
+static struct gnttab_cache_entry *gnttab_cache_alloc(struct grant_table *lgt)
+{
+    struct list_head *hash = NULL;
+    unsigned int i;
+
+    if ( !opt_gnttab_max_cached )
+        return NULL;
+
+    if ( !ACCESS_ONCE(lgt->cache_hash) )
+    {
+        hash = xmalloc_array(struct list_head, GNTTAB_CACHE_HASH_SIZE);
+        if ( !hash )
+            return NULL;
+        for ( i = 0; i < GNTTAB_CACHE_HASH_SIZE; i++ )
+            INIT_LIST_HEAD(&hash[i]);
+
+        spin_lock(&lgt->cache_lock);
+        if ( !lgt->cache_hash )
+        {
+            lgt->cache_hash = hash;
+            hash = NULL;
+        }
+        spin_unlock(&lgt->cache_lock);
+
+        xfree(hash);
+    }
+
+    return xmalloc(struct gnttab_cache_entry);
+}
+
+/*
+ * Enter a new GNTMAP_cache mapping into the cache, using an entry from
+ * gnttab_cache_alloc(). Returns false if the grant already has a cached
+ * mapping, the entry then remaining the caller's. May be called with grant
+ * table locks held.
+ */
+static bool gnttab_cache_add(struct grant_table *lgt,
+                             struct gnttab_cache_entry *e,
+                             const struct gnttab_map_grant_ref *op,
+                             grant_handle_t handle, uint64_t dev_bus_addr)
+{
+    e->host_addr = op->host_addr;
+    e->dev_bus_addr = dev_bus_addr;
+    e->handle = handle;
+    e->ref = op->ref;
+    e->domid = op->dom;
+    e->flags = op->flags;
+    e->released = false;
+
+    spin_lock(&lgt->cache_lock);
+
+    if ( gnttab_cache_find(lgt, op->dom, op->ref) )
+    {
+        spin_unlock(&lgt->cache_lock);
+        return false;
+    }
+
+    list_add(&e->hash, gnttab_cache_bucket(lgt, op->dom, op->ref));
+
+    spin_unlock(&lgt->cache_lock);
+
+    return true;
+}
+
+/*
+ * Unmap of a GNTMAP_cache mapping: release it if allowed and possible,
+ * returning true. Otherwise take it out of the cache for it to be unmapped.
+ */
+static bool gnttab_cache_put(struct grant_table *lgt,
+                             const struct grant_mapping *map,
+                             const struct gnttab_unmap_common *op)
+{
+    struct gnttab_cache_entry *e, *victim = NULL;
+    uint64_t evict_addr = op->host_addr;
+    unsigned int evict_flags = ACCESS_ONCE(map->flags);
+    bool released = false, remote = true;
+
+    /*
+     * Releasing is done by the owner of the mapping only, in its context,
+     * evicting possibly not.
+     */
+    if ( op->cache_release && (evict_flags & GNTMAP_host_map) )
+    {
+        ASSERT(op->ld == current->domain);
+        remote = grant_host_mapping_remote(&evict_addr, &evict_flags);
+    }
+
+    spin_lock(&lgt->cache_lock);
+
+    e = gnttab_cache_find(lgt, map->domid, map->ref);
+    if ( !e || e->handle != op->handle )
+    {
+        spin_unlock(&lgt->cache_lock);
+        return false;
+    }
+
+    if ( op->cache_release && remote && !e->released &&
+         op->host_addr == e->host_addr &&
+         op->dev_bus_addr == e->dev_bus_addr )
+    {
+        e->evict_addr = evict_addr;
+        e->evict_flags = evict_flags;
+        e->released = true;
+        list_add_tail(&e->idle, &lgt->cache_idle);
+        if ( ++lgt->cache_nr_idle > opt_gnttab_max_cached )
+        {
+            victim = list_first_entry(&lgt->cache_idle,
+                                      struct gnttab_cache_entry, idle);
+            gnttab_cache_detach(lgt, victim);
+        }
+        if ( lgt->cache_nr_idle == 1 )
+            set_timer(&lgt->cache_timer, NOW() + GNTTAB_CACHE_INTERVAL);
+        released = true;
+        perfc_incr(gnttab_cache_release);
+    }
+    else
+    {
+        gnttab_cache_detach(lgt, e);
+        victim = e;
+    }
+
+    spin_unlock(&lgt->cache_lock);
+
+    if ( released )
+    {
+        if ( victim )
+            gnttab_cache_evict(op->ld, &victim, 1);
+    }
+    else
+        xfree(victim);
+
+    return released;
+}
+
+static void gnttab_cache_destroy(struct grant_table *gt)
+{
+    struct gnttab_cache_entry *e, *tmp;
+    unsigned int i;
+
+    if ( !gt->cache_hash )
+        return;
+
+    for ( i = 0; i < GNTTAB_CACHE_HASH_SIZE; i++ )
+        list_for_each_entry_safe ( e, tmp, &gt->cache_hash[i], hash )
+            xfree(e);
+
+    XFREE(gt->cache_hash);
+}
+
 static void
 map_grant_ref(
     struct gnttab_map_grant_ref *op)
@@ -957,6 +1548,7 @@ map_grant_ref(
     grant_entry_header_t *shah;
     uint16_t *status;
     bool_t need_iommu;
+    struct gnttab_cache_entry *cache_ent = NULL;
 
     led = current;
     ld = led->domain;
@@ -992,6 +1584,12 @@ map_grant_ref(
         return;
     }
 
+    if ( (op->flags & GNTMAP_cache) && gnttab_cache_get(ld, rd, op) )
+    {
+        rcu_unlock_domain(rd);
+        return;
+    }
+
     lgt = ld->grant_table;
     handle = get_maptrack_handle(lgt);
     if ( unlikely(handle == INVALID_MAPTRACK_HANDLE) )
@@ -1071,6 +1669,10 @@ map_grant_ref(
 
     cache_flags = (shah->flags & (GTF_PAT | GTF_PWT | GTF_PCD) );
 
+    /* See gnttab_cache_valid(). */
+    if ( evaluate_nospec(rgt->gt_version == 1) )
+        op->flags &= ~GNTMAP_cache;
+
     active_entry_release(act);
     grant_read_unlock(rgt);
 
@@ -1171,6 +1773,9 @@ map_grant_ref(
         goto undo_out;
     }
 
+    if ( op->flags & GNTMAP_cache )
+        cache_ent = gnttab_cache_alloc(lgt);
+
     need_iommu = gnttab_need_iommu_mapping(ld);
     if ( need_iommu )
     {
@@ -1205,6 +1810,15 @@ map_grant_ref(
 
     TRACE_1D(TRC_MEM_PAGE_GRANT_MAP, op->dom);
 
+    /* Tell the caller (by clearing the flag) if the mapping isn't cached. */
+    if ( cache_ent &&
+         gnttab_cache_add(lgt, cache_ent, op, handle,
+                          (op->flags & GNTMAP_device_map) ?
+                          mfn_to_maddr(mfn) : 0) )
+        cache_ent = NULL;
+    else
+        op->flags &= ~GNTMAP_cache;
+
     /*
      * All maptrack entry users check mt->flags first before using the
      * other fields so just ensure the flags field is stored last.
@@ -1222,6 +1836,8 @@ map_grant_ref(
     if ( need_iommu )
         double_gt_unlock(lgt, rgt);
 
+    xfree(cache_ent);
+
     op->dev_bus_addr = mfn_to_maddr(mfn);
     op->handle       = handle;
     op->status       = GNTST_okay;
@@ -1230,9 +1846,11 @@ map_grant_ref(
     return;
 
  undo_out:
+    xfree(cache_ent);
+
     if ( host_map_created )
     {
-        replace_grant_host_mapping(op->host_addr, mfn, 0, op->flags);
+        replace_grant_host_mapping(ld, op->host_addr, mfn, 0, op->flags);
         gnttab_flush_tlb(ld);
     }
 
@@ -1281,6 +1899,8 @@ gnttab_map_grant_ref(
     int i;
     struct gnttab_map_grant_ref op;
 
+    gnttab_cache_check(current->domain);
+
     for ( i = 0; i < count; i++ )
     {
         if ( i && hypercall_preempt_check() )
@@ -1312,7 +1932,7 @@ unmap_common(
     unsigned int flags;
     bool put_handle = false;
 
-    ld = current->domain;
+    ld = op->ld;
     lgt = ld->grant_table;
 
     if ( unlikely(op->handle >= lgt->maptrack_limit) )
@@ -1326,7 +1946,8 @@ unmap_common(
     smp_rmb();
     map = &maptrack_entry(lgt, op->handle);
 
-    if ( unlikely(!read_atomic(&map->flags)) )
+    flags = read_atomic(&map->flags);
+    if ( unlikely(!flags) )
     {
         gdprintk(XENLOG_INFO, "Zero flags for d%d handle %#x\n",
                  lgt->domain->domain_id, op->handle);
@@ -1334,6 +1955,12 @@ unmap_common(
         return;
     }
 
+    if ( (flags & GNTMAP_cache) && gnttab_cache_put(lgt, map, op) )
+    {
+        op->status = GNTST_okay;
+        return;
+    }
+
     dom = map->domid;
     if ( unlikely((rd = rcu_lock_domain_by_id(dom)) == NULL) )
     {
@@ -1411,9 +2038,9 @@ unmap_common(
 
     if ( op->host_addr && (flags & GNTMAP_host_map) )
     {
-        if ( (rc = replace_grant_host_mapping(op->host_addr,
+        if ( (rc = replace_grant_host_mapping(ld, op->host_addr,
                                               op->mfn, op->new_addr,
-                                              flags)) < 0 )
+                                              flags | op->host_flags)) < 0 )
             goto act_release_out;
 
         map->flags &= ~GNTMAP_host_map;
@@ -1485,7 +2112,7 @@ unmap_common_complete(struct gnttab_unmap_common *op)
         return;
     }
 
-    ld = current->domain;
+    ld = op->ld;
 
     rcu_lock_domain(rd);
     rgt = rd->grant_table;
@@ -1552,6 +2179,152 @@ unmap_common_complete(struct gnttab_unmap_common *op)
     rcu_unlock_domain(rd);
 }
 
+/*
+ * Flush the TLBs of a domain after unmapping grants, and complete all
+ * deferred unmaps done before the flush started. Unmaps record the flush
+ * generation after having removed their mappings, so any unmap recording a
+ * generation older than the one of this flush is covered by it. Unmaps are
+ * taken off the pending ones in batches, to be completed without holding
+ * the flush lock. Ones done after the flush started get another timeout.
+ */
+static void gnttab_flush_unmaps(struct domain *ld)
+{
+    struct grant_table *lgt = ld->grant_table;
+    struct gnttab_unmap_common done[GNTTAB_DEFERRED_BATCH];
+    unsigned int gen, i, n;
+
+    spin_lock(&lgt->flush_lock);
+    gen = ++lgt->flush_gen;
+    spin_unlock(&lgt->flush_lock);
+
+    if ( !paging_mode_external(ld) )
+    {
+        flush_tlb_mask(ld->dirty_cpumask);
+        perfc_incr(gnttab_unmap_flush);
+    }
+
+    if ( !read_atomic(&lgt->flush_nr_pending) )
+        return;
+
+    do {
+        spin_lock(&lgt->flush_lock);
+
+        for ( n = 0; n < min_t(unsigned int, lgt->flush_nr_pending,
+                                ARRAY_SIZE(done)); n++ )
+            if ( (int)(gen - lgt->flush_pending[n].flush_gen) <= 0 )
+                break;
+
+        memcpy(done, lgt->flush_pending, n * sizeof(*done));
+        lgt->flush_nr_pending -= n;
+        memmove(lgt->flush_pending, lgt->flush_pending + n,
+                lgt->flush_nr_pending * sizeof(*lgt->flush_pending));
+
+        if ( n < ARRAY_SIZE(done) && lgt->flush_nr_pending )
+            set_timer(&lgt->flush_timer, NOW() + GNTTAB_DEFERRED_TIMEOUT);
+
+        spin_unlock(&lgt->flush_lock);
+
+        for ( i = 0; i < n; i++ )
+        {
+            unmap_common_complete(&done[i]);
+            put_domain(done[i].rd);
+        }
+    } while ( n == ARRAY_SIZE(done) );
+}
+
+static void gnttab_flush_timer_fn(void *data)
+{
+    struct domain *d = data;
+
+    perfc_incr(gnttab_unmap_flush_timer);
+    gnttab_flush_unmaps(d);
+}
+
+/*
+ * Deferred flush mode: queue a done unmap for completion by a later flush.
+ * Returns false if it has to be completed right away, after a flush.
+ */
+static bool gnttab_defer_unmap(struct gnttab_unmap_common *op)
+{
+    struct grant_table *lgt = op->ld->grant_table;
+    struct gnttab_unmap_common *pending = NULL;
+    bool full;
+
+    if ( !lgt->flush_pending )
+    {
+        pending = xmalloc_array(struct gnttab_unmap_common,
+                                GNTTAB_DEFERRED_MAX);
+        if ( !pending )
+            return false;
+    }
+
+    if ( !get_domain(op->rd) )
+    {
+        xfree(pending);
+        return false;
+    }
+
+    spin_lock(&lgt->flush_lock);
+
+    if ( !lgt->flush_pending )
+    {
+        lgt->flush_pending = pending;
+        pending = NULL;
+    }
+
+    if ( lgt->flush_nr_pending == GNTTAB_DEFERRED_MAX )
+    {
+        spin_unlock(&lgt->flush_lock);
+        put_domain(op->rd);
+        xfree(pending);
+        return false;
+    }
+
+    op->flush_gen = lgt->flush_gen;
+    lgt->flush_pending[lgt->flush_nr_pending++] = *op;
+    if ( lgt->flush_nr_pending == 1 )
+        set_timer(&lgt->flush_timer, NOW() + GNTTAB_DEFERRED_TIMEOUT);
+    full = lgt->flush_nr_pending == GNTTAB_DEFERRED_MAX;
+
+    spin_unlock(&lgt->flush_lock);
+
+    xfree(pending);
+
+    perfc_incr(gnttab_unmap_deferred);
+
+    if ( full )
+    {
+        perfc_incr(gnttab_unmap_flush_full);
+        gnttab_flush_unmaps(op->ld);
+    }
+
+    return true;
+}
+
+/* Complete a batch of unmaps, flushing TLBs unless all can be deferred. */
+static void gnttab_unmap_batch_complete(struct gnttab_unmap_common *common,
+                                        unsigned int nr)
+{
+    struct domain *ld = current->domain;
+    unsigned int i, n = 0;
+
+    if ( opt_gnttab_deferred_flush && !paging_mode_external(ld) )
+    {
+        for ( i = 0; i < nr; i++ )
+            if ( common[i].done && !gnttab_defer_unmap(&common[i]) )
+                common[n++] = common[i];
+        if ( !n )
+            return;
+    }
+    else
+        n = nr;
+
+    gnttab_flush_unmaps(ld);
+
+    for ( i = 0; i < n; i++ )
+        unmap_common_complete(&common[i]);
+}
+
 static void
 unmap_grant_ref(
     struct gnttab_unmap_grant_ref *op,
@@ -1560,6 +2333,9 @@ unmap_grant_ref(
     common->host_addr = op->host_addr;
     common->dev_bus_addr = op->dev_bus_addr;
     common->handle = op->handle;
+    common->ld = current->domain;
+    common->cache_release = true;
+    common->host_flags = 0;
 
     /* Intialise these in case common contains old state */
     common->done = 0;
@@ -1580,6 +2356,8 @@ gnttab_unmap_grant_ref(
     struct gnttab_unmap_grant_ref op;
     struct gnttab_unmap_common common[GNTTAB_UNMAP_BATCH_SIZE];
 
+    gnttab_cache_check(current->domain);
+
     while ( count != 0 )
     {
         c = min(count, (unsigned int)GNTTAB_UNMAP_BATCH_SIZE);
@@ -1596,10 +2374,7 @@ gnttab_unmap_grant_ref(
             guest_handle_add_offset(uop, 1);
         }
 
-        gnttab_flush_tlb(current->domain);
-
-        for ( i = 0; i < partial_done; i++ )
-            unmap_common_complete(&common[i]);
+        gnttab_unmap_batch_complete(common, partial_done);
 
         count -= c;
         done += c;
@@ -1611,10 +2386,7 @@ gnttab_unmap_grant_ref(
     return 0;
 
 fault:
-    gnttab_flush_tlb(current->domain);
-
-    for ( i = 0; i < partial_done; i++ )
-        unmap_common_complete(&common[i]);
+    gnttab_unmap_batch_complete(common, partial_done);
     return -EFAULT;
 }
 
@@ -1626,6 +2398,9 @@ unmap_and_replace(
     common->host_addr = op->host_addr;
     common->new_addr = op->new_addr;
     common->handle = op->handle;
+    common->ld = current->domain;
+    common->cache_release = false;
+    common->host_flags = 0;
 
     /* Intialise these in case common contains old state */
     common->done = 0;
@@ -1661,7 +2436,7 @@ gnttab_unmap_and_replace(
             guest_handle_add_offset(uop, 1);
         }
 
-        gnttab_flush_tlb(current->domain);
+        gnttab_flush_unmaps(current->domain);
 
         for ( i = 0; i < partial_done; i++ )
             unmap_common_complete(&common[i]);
@@ -1676,7 +2451,7 @@ gnttab_unmap_and_replace(
     return 0;
 
 fault:
-    gnttab_flush_tlb(current->domain);
+    gnttab_flush_unmaps(current->domain);
 
     for ( i = 0; i < partial_done; i++ )
         unmap_common_complete(&common[i]);
@@ -1891,6 +2666,11 @@ int grant_table_init(struct domain *d, int max_grant_frames,
     /* Simple stuff. */
     percpu_rwlock_resource_init(&gt->lock, grant_rwlock);
     spin_lock_init(&gt->maptrack_lock);
+    spin_lock_init(&gt->cache_lock);
+    INIT_LIST_HEAD(&gt->cache_idle);
+    init_timer(&gt->cache_timer, gnttab_cache_timer_fn, d, 0);
+    spin_lock_init(&gt->flush_lock);
+    init_timer(&gt->flush_timer, gnttab_flush_timer_fn, d, 0);
 
     gt->gt_version = 1;
     gt->max_grant_frames = max_grant_frames;
@@ -2927,8 +3707,14 @@ static int gnttab_copy_buf(const struct gnttab_copy *op,
     /* Make sure the above checks are not bypassed speculatively */
     block_speculation();
 
-    memcpy(dest->virt + op->dest.offset, src->virt + op->source.offset,
-           op->len);
+    if ( (op->flags & GNTCOPY_nontemporal) && op->len == PAGE_SIZE )
+    {
+        copy_page(dest->virt, src->virt);
+        perfc_incr(gnttab_copy_nontemporal);
+    }
+    else
+        memcpy(dest->virt + op->dest.offset, src->virt + op->source.offset,
+               op->len);
     gnttab_mark_dirty(dest->domain, dest->mfn);
     rc = GNTST_okay;
  out:
@@ -3009,6 +3795,9 @@ static long gnttab_copy(
             break;
         }
 
+        /* Only GNTTABOP_copy_v2 supports non-temporal copies. */
+        op.flags &= ~GNTCOPY_nontemporal;
+
         rc = gnttab_copy_one(&op, &dest, &src);
         if ( rc > 0 )
         {
@@ -3038,6 +3827,226 @@ static long gnttab_copy(
     return rc;
 }
 
+static bool gnttab_copy_v2_next_seg(
+    XEN_GUEST_HANDLE_PARAM(gnttab_copy_seg_t) segs, unsigned int *idx,
+    unsigned int end, struct gnttab_copy_seg *seg, uint32_t *pos,
+    bool *fault)
+{
+    if ( *idx == end )
+        return false;
+
+    if ( unlikely(__copy_from_guest_offset(seg, segs, *idx, 1)) )
+    {
+        *fault = true;
+        return false;
+    }
+
+    ++*idx;
+    *pos = seg->offset;
+
+    return true;
+}
+
+/*
+ * Copy a GNTTABOP_copy_v2 buffer by splitting it up into single page copies,
+ * handled by gnttab_copy_one(), which keeps the domains locked and the
+ * buffers mapped as long as consecutive copies use them. The first resume
+ * bytes were copied before the hypercall got preempted, and are skipped. A
+ * positive return value asks for a continuation, op->copied then telling
+ * where to resume.
+ */
+static int gnttab_copy_v2_one(struct gnttab_copy_v2 *op,
+                              XEN_GUEST_HANDLE_PARAM(gnttab_copy_seg_t) segs,
+                              struct gnttab_copy_buf *dest,
+                              struct gnttab_copy_buf *src, uint32_t resume,
+                              bool *fault)
+{
+    struct gnttab_copy_seg sseg, dseg;
+    struct gnttab_copy cop = {
+        .source.domid = op->source_domid,
+        .dest.domid = op->dest_domid,
+        .flags = op->flags,
+    };
+    unsigned int i, si = 0, di = op->nr_source_segs;
+    unsigned int send = op->nr_source_segs, dend = send + op->nr_dest_segs;
+    unsigned long slen = 0, dlen = 0;
+    uint32_t spos = 0, dpos = 0, len, total;
+    int rc = GNTST_okay;
+
+    op->copied = 0;
+
+    /* Check the segment lists to match. */
+    for ( i = 0; i < dend; i++ )
+    {
+        if ( unlikely(__copy_from_guest_offset(&sseg, segs, i, 1)) )
+        {
+            *fault = true;
+            return GNTST_general_error;
+        }
+        if ( i < send )
+            slen += sseg.len;
+        else
+            dlen += sseg.len;
+    }
+    if ( slen != dlen || slen > GNTCOPY_V2_MAX_LEN )
+        PIN_FAIL(out, GNTST_bad_copy_arg,
+                 "copy_v2 length mismatch: %lu != %lu\n", slen, dlen);
+
+    for ( total = slen, slen = dlen = 0; op->copied < total; )
+    {
+        /*
+         * Re-reading the segments might return different data, so the
+         * checks above must not be relied upon.
+         */
+        if ( !slen )
+        {
+            if ( !gnttab_copy_v2_next_seg(segs, &si, send, &sseg, &spos,
+                                          fault) )
+                break;
+            slen = sseg.len;
+            continue;
+        }
+        if ( !dlen )
+        {
+            if ( !gnttab_copy_v2_next_seg(segs, &di, dend, &dseg, &dpos,
+                                          fault) )
+                break;
+            dlen = dseg.len;
+            continue;
+        }
+
+        len = min_t(unsigned long, total - op->copied, min(slen, dlen));
+        len = min_t(uint32_t, len, PAGE_SIZE - (spos & ~PAGE_MASK));
+        len = min_t(uint32_t, len, PAGE_SIZE - (dpos & ~PAGE_MASK));
+
+        if ( op->copied < resume )
+            len = min(len, resume - op->copied);
+        else
+        {
+            if ( op->copied > resume && hypercall_preempt_check() )
+            {
+                rc = 1;
+                goto out;
+            }
+
+            if ( op->flags & GNTCOPY_source_gref )
+                cop.source.u.ref = sseg.u.ref + (spos >> PAGE_SHIFT);
+            else
+                cop.source.u.gmfn = sseg.u.gfn + (spos >> PAGE_SHIFT);
+            cop.source.offset = spos & ~PAGE_MASK;
+            if ( op->flags & GNTCOPY_dest_gref )
+                cop.dest.u.ref = dseg.u.ref + (dpos >> PAGE_SHIFT);
+            else
+                cop.dest.u.gmfn = dseg.u.gfn + (dpos >> PAGE_SHIFT);
+            cop.dest.offset = dpos & ~PAGE_MASK;
+            cop.len = len;
+
+            rc = gnttab_copy_one(&cop, dest, src);
+            if ( rc != GNTST_okay )
+                goto out;
+        }
+
+        spos += len;
+        slen -= len;
+        dpos += len;
+        dlen -= len;
+        op->copied += len;
+    }
+
+    if ( op->copied != total )
+        rc = *fault ? GNTST_general_error : GNTST_bad_copy_arg;
+
+ out:
+    return rc;
+}
+
+/*
+ * Same return value convention as gnttab_copy(). *resume holds the number of
+ * bytes of the first operation copied before a preemption, shifted into the
+ * continuation argument bits of the command, both on entry and on return.
+ */
+static long gnttab_copy_v2(
+    XEN_GUEST_HANDLE_PARAM(gnttab_copy_v2_t) uop, unsigned int *resume,
+    unsigned int count)
+{
+    unsigned int i, n;
+    struct gnttab_copy_v2 op;
+    struct gnttab_copy_buf src = {};
+    struct gnttab_copy_buf dest = {};
+    XEN_GUEST_HANDLE_PARAM(gnttab_copy_seg_t) segs;
+    bool fault = false;
+    long rc = 0;
+
+    BUILD_BUG_ON(sizeof(struct gnttab_copy_v2) !=
+                 sizeof(struct gnttab_copy_seg));
+    BUILD_BUG_ON(GNTCOPY_V2_MAX_LEN >
+                 (UINT_MAX >> GNTTABOP_CONTINUATION_ARG_SHIFT));
+
+    for ( i = 0; i < count; i += n )
+    {
+        if ( i && hypercall_preempt_check() )
+        {
+            rc = count - i;
+            break;
+        }
+
+        if ( unlikely(__copy_from_guest(&op, uop, 1)) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+
+        n = 1 + op.nr_source_segs + op.nr_dest_segs;
+        if ( n > count - i )
+        {
+            rc = -EINVAL;
+            break;
+        }
+
+        segs = guest_handle_cast(guest_handle_cast(uop, void),
+                                 gnttab_copy_seg_t);
+        guest_handle_add_offset(segs, 1);
+
+        perfc_incr(gnttab_copy_v2);
+        rc = gnttab_copy_v2_one(&op, segs, &dest, &src,
+                                *resume >> GNTTABOP_CONTINUATION_ARG_SHIFT,
+                                &fault);
+        *resume = 0;
+        if ( rc > 0 )
+        {
+            *resume = op.copied << GNTTABOP_CONTINUATION_ARG_SHIFT;
+            rc = count - i;
+            break;
+        }
+        if ( fault )
+        {
+            rc = -EFAULT;
+            break;
+        }
+        if ( rc != GNTST_okay )
+        {
+            gnttab_copy_release_buf(&src);
+            gnttab_copy_release_buf(&dest);
+        }
+
+        op.status = rc;
+        rc = 0;
+        if ( unlikely(__copy_field_to_guest(uop, &op, status)) ||
+             unlikely(__copy_field_to_guest(uop, &op, copied)) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+        guest_handle_add_offset(uop, n);
+    }
+
+    gnttab_copy_release_buf(&src);
+    gnttab_copy_release_buf(&dest);
+    gnttab_copy_unlock_domains(&src, &dest);
+
+    return rc;
+}
+
 static long
 gnttab_set_version(XEN_GUEST_HANDLE_PARAM(gnttab_set_version_t) uop)
 {
@@ -3506,7 +4515,8 @@ do_grant_table_op(
     if ( (int)count < 0 )
         return -EINVAL;
 
-    if ( (cmd &= GNTTABOP_CMD_MASK) != GNTTABOP_cache_flush && opaque_in )
+    if ( (cmd &= GNTTABOP_CMD_MASK) != GNTTABOP_cache_flush &&
+         cmd != GNTTABOP_copy_v2 && opaque_in )
         return -EINVAL;
 
     rc = -EFAULT;
@@ -3599,6 +4609,24 @@ do_grant_table_op(
         break;
     }
 
+    case GNTTABOP_copy_v2:
+    {
+        XEN_GUEST_HANDLE_PARAM(gnttab_copy_v2_t) copy =
+            guest_handle_cast(uop, gnttab_copy_v2_t);
+
+        if ( unlikely(!guest_handle_okay(copy, count)) )
+            goto out;
+        rc = gnttab_copy_v2(copy, &opaque_in, count);
+        if ( rc > 0 )
+        {
+            rc = count - rc;
+            guest_handle_add_offset(copy, rc);
+            uop = guest_handle_cast(copy, void);
+        }
+        opaque_out = opaque_in;
+        break;
+    }
+
     case GNTTABOP_query_size:
         rc = gnttab_query_size(
             guest_handle_cast(uop, gnttab_query_size_t), count);
@@ -3689,6 +4717,12 @@ gnttab_release_mappings(
 
     BUG_ON(!d->is_dying);
 
+    /* Drop other domains' released cached mappings of d's grants. */
+    gnttab_cache_purge(d);
+
+    /* Complete unmaps still waiting for a TLB flush. */
+    gnttab_flush_unmaps(d);
+
     for ( handle = 0; handle < gt->maptrack_limit; handle++ )
     {
         unsigned int clear_flags = 0;
@@ -3842,6 +4876,13 @@ grant_table_destroy(
 
     gnttab_destroy_arch(t);
 
+    kill_timer(&t->flush_timer);
+    ASSERT(!t->flush_nr_pending);
+    xfree(t->flush_pending);
+
+    kill_timer(&t->cache_timer);
+    gnttab_cache_destroy(t);
+
     for ( i = 0; i < nr_grant_frames(t); i++ )
         free_xenheap_page(t->shared_raw[i]);
     xfree(t->shared_raw);
@@ -3869,6 +4910,39 @@ void grant_table_init_vcpu(struct vcpu *v)
     v->maptrack_tail = MAPTRACK_TAIL;
 }
 
+/* Undo gnttab_get_read_frame(). */
+void gnttab_put_read_frame(struct domain *d, grant_ref_t ref, mfn_t mfn)
+{
+    release_grant_for_copy(d, ref, true);
+    put_page(mfn_to_page(mfn));
+}
+
+/*
+ * Pin the frame that domain d has granted to domain domid with ref, for Xen
+ * to read [offset, offset + len) of it on domid's behalf, as a grant copy
+ * would.  d can't revoke the grant until gnttab_put_read_frame() is called.
+ */
+int gnttab_get_read_frame(struct domain *d, grant_ref_t ref, domid_t domid,
+                          unsigned int offset, unsigned int len, mfn_t *mfn)
+{
+    struct page_info *page;
+    uint16_t page_off, length;
+    int rc;
+
+    rc = acquire_grant_for_copy(d, ref, domid, true, mfn, &page, &page_off,
+                                &length, opt_transitive_grants);
+    if ( rc != GNTST_okay )
+        return rc == GNTST_bad_gntref ? -ENOENT : -EACCES;
+
+    if ( offset < page_off || len > length || offset - page_off > length - len )
+    {
+        gnttab_put_read_frame(d, ref, *mfn);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
 #ifdef CONFIG_MEM_SHARING
 int mem_sharing_gref_to_gfn(struct grant_table *gt, grant_ref_t ref,
                             gfn_t *gfn, uint16_t *status)
@@ -4053,7 +5127,8 @@ static void gnttab_usage_print(struct domain *rd)
     int first = 1;
     grant_ref_t ref;
     struct grant_table *gt = rd->grant_table;
-    unsigned int nr_ents;
+    unsigned int nr_ents, i;
+    unsigned long steals = 0;
 
     printk("      -------- active --------       -------- shared --------\n");
     printk("[ref] localdom mfn      pin          localdom gmfn     flags\n");
@@ -4065,6 +5140,16 @@ static void gnttab_usage_print(struct domain *rd)
            rd->domain_id, gt->gt_version,
            nr_grant_frames(gt), gt->max_grant_frames,
            nr_maptrack_frames(gt), gt->max_maptrack_frames);
+    for ( i = 0; i <= MAPTRACK_STEAL_BUCKETS; i++ )
+        steals += gt->maptrack_steals[i];
+    if ( steals )
+        printk("  maptrack steals by vCPUs probed: 1:%lu 2:%lu 3-4:%lu "
+               "5-8:%lu 9-16:%lu 17-32:%lu 33+:%lu failed:%lu\n",
+               gt->maptrack_steals[0], gt->maptrack_steals[1],
+               gt->maptrack_steals[2], gt->maptrack_steals[3],
+               gt->maptrack_steals[4], gt->maptrack_steals[5],
+               gt->maptrack_steals[6],
+               gt->maptrack_steals[MAPTRACK_STEAL_BUCKETS]);
 
     nr_ents = nr_grant_entries(gt);
     for ( ref = 0; ref != nr_ents; ref++ )
@@ -7,6 +7,7 @@
 #include <xen/init.h>
 #include <xen/lib.h>
 #include <xen/errno.h>
+#include <xen/grant_table.h>
 #include <xen/version.h>
 #include <xen/sched.h>
 #include <xen/paging.h>
@@ -470,6 +471,10 @@ DO(xen_version)(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
                     (1U << XENFEAT_auto_translated_physmap);
             if ( is_hardware_domain(d) )
                 fi.submap |= 1U << XENFEAT_dom0;
+            if ( opt_gnttab_max_cached )
+                fi.submap |= 1U << XENFEAT_gnttab_map_cache;
+            if ( IS_ENABLED(CONFIG_GRANT_TABLE) )
+                fi.submap |= 1U << XENFEAT_gnttab_copy_v2;
 #ifdef CONFIG_ARM
             fi.submap |= (1U << XENFEAT_ARM_SMCCC_supported);
 #endif
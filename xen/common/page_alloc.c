@@ -121,6 +121,7 @@
  */
 
 #include <xen/init.h>
+#include <xen/cpu.h>
 #include <xen/types.h>
 #include <xen/lib.h>
 #include <xen/sched.h>
@@ -132,6 +133,7 @@
 #include <xen/keyhandler.h>
 #include <xen/perfc.h>
 #include <xen/pfn.h>
+#include <xen/vmap.h>
 #include <xen/numa.h>
 #include <xen/nodemask.h>
 #include <xen/event.h>
@@ -443,7 +445,7 @@ mfn_t __init alloc_boot_pages(unsigned long nr_pfns, unsigned long pfn_align)
 
 
 
-static DEFINE_SPINLOCK(heap_lock);
+static DEFINE_QSPINLOCK(heap_lock);
 
 #ifdef CONFIG_COLORING
 /*************************
@@ -729,6 +731,23 @@ static long total_avail_pages;
 
 static long outstanding_claims; /* total outstanding claims by all domains */
 
+static unsigned long pcp_cached_pages(void);
+static unsigned long pcp_drain_cpu(unsigned int cpu);
+static unsigned long pcp_drain_all(void);
+static bool pcp_cached_enough(unsigned int zone_hi, unsigned long request);
+
+/*
+ * Within this long of all caches having been drained on allocation failure,
+ * the local cache is tried first.
+ */
+#define HEAP_DRAIN_INTERVAL MILLISECS(10)
+static s_time_t heap_drain_next;
+
+/* Pages held in the superpage pools. */
+static unsigned long sp_pool_pages;
+static unsigned long sp_pool_drain_all(void);
+static bool sp_pool_idle(void);
+
 unsigned long domain_adjust_tot_pages(struct domain *d, long pages)
 {
     long dom_before, dom_after, dom_claimed, sys_before, sys_after;
@@ -808,6 +827,23 @@ int domain_set_outstanding_pages(struct domain *d, unsigned long pages)
      * then the claim must take tot_pages into account
      */
     claim = pages - d->tot_pages;
+
+    /*
+     * Pages held in the per-CPU caches and superpage pools don't count as
+     * available.  Give them back to the heap if that makes the claim fit.
+     */
+    if ( claim > avail_pages &&
+         claim <= avail_pages + pcp_cached_pages() +
+                  read_atomic(&sp_pool_pages) )
+    {
+        spin_unlock(&heap_lock);
+        pcp_drain_all();
+        sp_pool_drain_all();
+        spin_lock(&heap_lock);
+
+        avail_pages = total_avail_pages - outstanding_claims;
+    }
+
     if ( claim > avail_pages )
         goto out;
 
@@ -1183,60 +1219,21 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
     }
 }
 
-/* Allocate 2^@order contiguous pages. */
-static struct page_info *alloc_heap_pages(
-    unsigned int zone_lo, unsigned int zone_hi,
-    unsigned int order, unsigned int memflags,
-    struct domain *d)
-{
-    nodeid_t node;
-    unsigned int i, buddy_order, zone, first_dirty;
+/*
+ * Carve 2^@order pages out of the free buddy @pg, as returned by
+ * get_free_buddy(), and mark them in use.  Called with heap_lock held.
+ */
+static struct page_info *take_heap_pages(
+    struct page_info *pg, unsigned int order, unsigned int memflags,
+    unsigned int *pfirst_dirty, bool *need_tlbflush,
+    uint32_t *tlbflush_timestamp)
+{
+    nodeid_t node = phys_to_nid(page_to_maddr(pg));
+    unsigned int i, zone = page_to_zone(pg), buddy_order = PFN_ORDER(pg);
+    unsigned int first_dirty = pg->u.free.first_dirty;
     unsigned long request = 1UL << order;
-    struct page_info *pg;
-    bool need_tlbflush = false;
-    uint32_t tlbflush_timestamp = 0;
-    unsigned int dirty_cnt = 0;
-
-    /* Make sure there are enough bits in memflags for nodeID. */
-    BUILD_BUG_ON((_MEMF_bits - _MEMF_node) < (8 * sizeof(nodeid_t)));
-
-    ASSERT(zone_lo <= zone_hi);
-    ASSERT(zone_hi < NR_ZONES);
-
-    if ( unlikely(order > MAX_ORDER) )
-        return NULL;
-
-    spin_lock(&heap_lock);
-
-    /*
-     * Claimed memory is considered unavailable unless the request
-     * is made by a domain with sufficient unclaimed pages.
-     */
-    if ( (outstanding_claims + request > total_avail_pages) &&
-          ((memflags & MEMF_no_refcount) ||
-           !d || d->outstanding_pages < request) )
-    {
-        spin_unlock(&heap_lock);
-        return NULL;
-    }
-
-    pg = get_free_buddy(zone_lo, zone_hi, order, memflags, d);
-    /* Try getting a dirty buddy if we couldn't get a clean one. */
-    if ( !pg && !(memflags & MEMF_no_scrub) )
-        pg = get_free_buddy(zone_lo, zone_hi, order,
-                            memflags | MEMF_no_scrub, d);
-    if ( !pg )
-    {
-        /* No suitable memory blocks. Fail the request. */
-        spin_unlock(&heap_lock);
-        return NULL;
-    }
-
-    node = phys_to_nid(page_to_maddr(pg));
-    zone = page_to_zone(pg);
-    buddy_order = PFN_ORDER(pg);
 
-    first_dirty = pg->u.free.first_dirty;
+    ASSERT(spin_is_locked(&heap_lock));
 
     /* We may have to halve the chunk a number of times. */
     while ( buddy_order != order )
@@ -1262,11 +1259,6 @@ static struct page_info *alloc_heap_pages(
     total_avail_pages -= request;
     ASSERT(total_avail_pages >= 0);
 
-    check_low_mem_virq();
-
-    if ( d != NULL )
-        d->last_alloc_node = node;
-
     for ( i = 0; i < (1 << order); i++ )
     {
         /* Reference count must continuously be zero for free pages. */
@@ -1287,19 +1279,80 @@ static struct page_info *alloc_heap_pages(
         pg[i].count_info = PGC_state_inuse | (pg[i].count_info & PGC_need_scrub);
 
         if ( !(memflags & MEMF_no_tlbflush) )
-            accumulate_tlbflush(&need_tlbflush, &pg[i],
-                                &tlbflush_timestamp);
+            accumulate_tlbflush(need_tlbflush, &pg[i], tlbflush_timestamp);
 
         /* Initialise fields which have other uses for free pages. */
         pg[i].u.inuse.type_info = 0;
         page_set_owner(&pg[i], NULL);
+    }
 
-        /* Ensure cache and RAM are consistent for platforms where the
-         * guest can control its own visibility of/through the cache.
-         */
+    *pfirst_dirty = first_dirty;
+
+    return pg;
+}
+
+/* Allocate 2^@order contiguous pages. */
+static struct page_info *alloc_heap_pages(
+    unsigned int zone_lo, unsigned int zone_hi,
+    unsigned int order, unsigned int memflags,
+    struct domain *d)
+{
+    nodeid_t node;
+    unsigned int i, first_dirty;
+    unsigned long request = 1UL << order;
+    struct page_info *pg;
+    bool need_tlbflush = false, drained_local = false, drained_all = false;
+    bool drain_local = false, drain_all = false;
+    uint32_t tlbflush_timestamp = 0;
+    unsigned int dirty_cnt = 0;
+
+    /* Make sure there are enough bits in memflags for nodeID. */
+    BUILD_BUG_ON((_MEMF_bits - _MEMF_node) < (8 * sizeof(nodeid_t)));
+
+    ASSERT(zone_lo <= zone_hi);
+    ASSERT(zone_hi < NR_ZONES);
+
+    if ( unlikely(order > MAX_ORDER) )
+        return NULL;
+
+ retry:
+    spin_lock(&heap_lock);
+
+    /*
+     * Claimed memory is considered unavailable unless the request
+     * is made by a domain with sufficient unclaimed pages.
+     */
+    if ( (outstanding_claims + request > total_avail_pages) &&
+          ((memflags & MEMF_no_refcount) ||
+           !d || d->outstanding_pages < request) )
+        goto fail;
+
+    pg = get_free_buddy(zone_lo, zone_hi, order, memflags, d);
+    /* Try getting a dirty buddy if we couldn't get a clean one. */
+    if ( !pg && !(memflags & MEMF_no_scrub) )
+        pg = get_free_buddy(zone_lo, zone_hi, order,
+                            memflags | MEMF_no_scrub, d);
+    if ( !pg )
+    {
+        /* No suitable memory blocks. Fail the request. */
+        goto fail;
+    }
+
+    node = phys_to_nid(page_to_maddr(pg));
+    pg = take_heap_pages(pg, order, memflags, &first_dirty,
+                         &need_tlbflush, &tlbflush_timestamp);
+
+    check_low_mem_virq();
+
+    if ( d != NULL )
+        d->last_alloc_node = node;
+
+    /* Ensure cache and RAM are consistent for platforms where the
+     * guest can control its own visibility of/through the cache.
+     */
+    for ( i = 0; i < (1 << order); i++ )
         flush_page_to_ram(mfn_x(page_to_mfn(&pg[i])),
                           !(memflags & MEMF_no_icache_flush));
-    }
 
     spin_unlock(&heap_lock);
 
@@ -1335,6 +1388,49 @@ static struct page_info *alloc_heap_pages(
         filtered_flush_tlb_mask(tlbflush_timestamp);
 
     return pg;
+
+ fail:
+    /*
+     * Pages held in the per-CPU caches and superpage pools are invisible to
+     * the buddy allocator.  Return them to the heap and have another go
+     * before failing, if there are enough of them in the zones asked for.
+     * Not on the above-DMA attempt of alloc_domheap_pages(), which falls
+     * back to all zones.  Shortly after all caches were drained, the local
+     * one alone is likely to do, sparing the others' locks.
+     */
+    if ( !drained_all &&
+         (zone_lo <= MEMZONE_XEN + 1 || (memflags & MEMF_no_dma)) &&
+         pcp_cached_enough(zone_hi, request) )
+    {
+        if ( !drained_local && NOW() < heap_drain_next )
+            drain_local = true;
+        else
+        {
+            drain_all = true;
+            heap_drain_next = NOW() + HEAP_DRAIN_INTERVAL;
+        }
+    }
+
+    spin_unlock(&heap_lock);
+
+    if ( drain_local )
+    {
+        drain_local = false;
+        drained_local = true;
+        if ( pcp_drain_cpu(smp_processor_id()) )
+            goto retry;
+        drain_all = true;
+    }
+
+    if ( drain_all )
+    {
+        drain_all = false;
+        drained_all = true;
+        if ( pcp_drain_all() + sp_pool_drain_all() )
+            goto retry;
+    }
+
+    return NULL;
 }
 
 /* Remove any offlined page in the buddy pointed to by head. */
@@ -1500,6 +1596,66 @@ static unsigned int node_to_scrub(bool get_node)
     return closest;
 }
 
+/*
+ * Pages are cleared with the arch backend preferred for the CPU, normally
+ * one which bypasses the caches, or the one named by "scrub-method=".
+ */
+static char __initdata opt_scrub_method[16];
+string_param("scrub-method", opt_scrub_method);
+
+static const struct scrub_backend *__read_mostly scrub_backend;
+
+/* Pages cleared by each CPU, and the time spent on them. */
+struct scrub_stats {
+    unsigned long pages;
+    s_time_t time;
+};
+static DEFINE_PER_CPU(struct scrub_stats, scrub_stats);
+
+static void __init scrub_backend_init(void)
+{
+    unsigned int i;
+
+    for ( i = 0; i < arch_nr_scrub_backends; i++ )
+    {
+        const struct scrub_backend *b = &arch_scrub_backends[i];
+
+        if ( b->usable && !b->usable() )
+            continue;
+
+        if ( !scrub_backend )
+            scrub_backend = b;
+        if ( !strcmp(b->name, opt_scrub_method) )
+        {
+            scrub_backend = b;
+            break;
+        }
+    }
+
+    BUG_ON(!scrub_backend);
+
+    if ( *opt_scrub_method && strcmp(scrub_backend->name, opt_scrub_method) )
+        printk(XENLOG_WARNING "scrub-method=%s not available\n",
+               opt_scrub_method);
+
+#ifndef NDEBUG
+    printk("Scrubbing pages with memset (debug build, %s selected)\n",
+           scrub_backend->name);
+#else
+    printk("Scrubbing pages with %s\n", scrub_backend->name);
+#endif
+}
+
+/* Name of what scrub_one_page() actually clears pages with. */
+static const char *scrub_method_name(void)
+{
+#ifndef NDEBUG
+    return "memset";
+#else
+    return scrub_backend ? scrub_backend->name : "-";
+#endif
+}
+
 struct scrub_wait_state {
     struct page_info *pg;
     unsigned int first_dirty;
@@ -1534,7 +1690,7 @@ bool scrub_free_pages(void)
 
     node = node_to_scrub(true);
     if ( node == NUMA_NO_NODE )
-        return false;
+        return sp_pool_idle();
 
     spin_lock(&heap_lock);
 
@@ -1581,206 +1737,1009 @@ bool scrub_free_pages(void)
                     {
                         /* Someone wants this chunk. Drop everything. */
 
-                        pg->u.free.first_dirty = (i == (1U << order) - 1) ?
-                            INVALID_DIRTY_IDX : i + 1;
-                        smp_wmb();
-                        pg->u.free.scrub_state = BUDDY_NOT_SCRUBBING;
+                        pg->u.free.first_dirty = (i == (1U << order) - 1) ?
+                            INVALID_DIRTY_IDX : i + 1;
+                        smp_wmb();
+                        pg->u.free.scrub_state = BUDDY_NOT_SCRUBBING;
+
+                        spin_lock(&heap_lock);
+                        node_need_scrub[node] -= dirty_cnt;
+                        spin_unlock(&heap_lock);
+                        goto out_nolock;
+                    }
+
+                    /*
+                     * Scrub a few (8) pages before becoming eligible for
+                     * preemption. But also count non-scrubbing loop iterations
+                     * so that we don't get stuck here with an almost clean
+                     * heap.
+                     */
+                    if ( cnt > 800 && softirq_pending(cpu) )
+                    {
+                        preempt = true;
+                        break;
+                    }
+                }
+
+                st.pg = pg;
+                /*
+                 * get_free_buddy() grabs a buddy with first_dirty set to
+                 * INVALID_DIRTY_IDX so we can't set pg's first_dirty here.
+                 * It will be set either below or in the lock callback (in
+                 * scrub_continue()).
+                 */
+                st.first_dirty = (i >= (1U << order) - 1) ?
+                    INVALID_DIRTY_IDX : i + 1;
+                st.drop = false;
+                spin_lock_cb(&heap_lock, scrub_continue, &st);
+
+                node_need_scrub[node] -= dirty_cnt;
+
+                if ( st.drop )
+                    goto out;
+
+                if ( i >= (1U << order) - 1 )
+                {
+                    page_list_del(pg, &heap(node, zone, order));
+                    page_list_add_scrub(pg, node, zone, order, INVALID_DIRTY_IDX);
+                }
+                else
+                    pg->u.free.first_dirty = i + 1;
+
+                pg->u.free.scrub_state = BUDDY_NOT_SCRUBBING;
+
+                if ( preempt || (node_need_scrub[node] == 0) )
+                    goto out;
+            }
+        } while ( order-- != 0 );
+    }
+
+ out:
+    spin_unlock(&heap_lock);
+
+ out_nolock:
+    node_clear(node, node_scrubbing);
+    return node_to_scrub(false) != NUMA_NO_NODE;
+}
+
+/* Free 2^@order set of pages.  Called with heap_lock held. */
+static void free_heap_pages_locked(
+    struct page_info *pg, unsigned int order, bool need_scrub)
+{
+    unsigned long mask;
+    mfn_t mfn = page_to_mfn(pg);
+    unsigned int i, node = phys_to_nid(page_to_maddr(pg)), tainted = 0;
+    unsigned int zone = page_to_zone(pg);
+
+    ASSERT(order <= MAX_ORDER);
+    ASSERT(node >= 0);
+    ASSERT(spin_is_locked(&heap_lock));
+
+    for ( i = 0; i < (1 << order); i++ )
+    {
+        /*
+         * Cannot assume that count_info == 0, as there are some corner cases
+         * where it isn't the case and yet it isn't a bug:
+         *  1. page_get_owner() is NULL
+         *  2. page_get_owner() is a domain that was never accessible by
+         *     its domid (e.g., failed to fully construct the domain).
+         *  3. page was never addressable by the guest (e.g., it's an
+         *     auto-translate-physmap guest and the page was never included
+         *     in its pseudophysical address space).
+         * In all the above cases there can be no guest mappings of this page.
+         */
+        switch ( pg[i].count_info & PGC_state )
+        {
+        case PGC_state_inuse:
+            BUG_ON(pg[i].count_info & PGC_broken);
+            pg[i].count_info = PGC_state_free;
+            break;
+
+        case PGC_state_offlining:
+            pg[i].count_info = (pg[i].count_info & PGC_broken) |
+                               PGC_state_offlined;
+            tainted = 1;
+            break;
+
+        default:
+            printk(XENLOG_ERR
+                   "pg[%u] MFN %"PRI_mfn" c=%#lx o=%u v=%#lx t=%#x\n",
+                   i, mfn_x(page_to_mfn(pg + i)),
+                   pg[i].count_info, pg[i].v.free.order,
+                   pg[i].u.free.val, pg[i].tlbflush_timestamp);
+            BUG();
+        }
+
+        /* If a page has no owner it will need no safety TLB flush. */
+        pg[i].u.free.need_tlbflush = (page_get_owner(&pg[i]) != NULL);
+        if ( pg[i].u.free.need_tlbflush )
+            page_set_tlbflush_timestamp(&pg[i]);
+
+        /* This page is not a guest frame any more. */
+        page_set_owner(&pg[i], NULL); /* set_gpfn_from_mfn snoops pg owner */
+        set_gpfn_from_mfn(mfn_x(mfn) + i, INVALID_M2P_ENTRY);
+
+        if ( need_scrub )
+        {
+            pg[i].count_info |= PGC_need_scrub;
+            poison_one_page(&pg[i]);
+        }
+    }
+
+    avail[node][zone] += 1 << order;
+    total_avail_pages += 1 << order;
+    if ( need_scrub )
+    {
+        node_need_scrub[node] += 1 << order;
+        pg->u.free.first_dirty = 0;
+    }
+    else
+        pg->u.free.first_dirty = INVALID_DIRTY_IDX;
+
+    /* Merge chunks as far as possible. */
+    while ( order < MAX_ORDER )
+    {
+        mask = 1UL << order;
+
+        if ( (mfn_x(page_to_mfn(pg)) & mask) )
+        {
+            struct page_info *predecessor = pg - mask;
+
+            /* Merge with predecessor block? */
+            if ( !mfn_valid(page_to_mfn(predecessor)) ||
+                 !page_state_is(predecessor, free) ||
+                 (PFN_ORDER(predecessor) != order) ||
+                 (phys_to_nid(page_to_maddr(predecessor)) != node) )
+                break;
+
+            check_and_stop_scrub(predecessor);
+
+            page_list_del(predecessor, &heap(node, zone, order));
+
+            /* Update predecessor's first_dirty if necessary. */
+            if ( predecessor->u.free.first_dirty == INVALID_DIRTY_IDX &&
+                 pg->u.free.first_dirty != INVALID_DIRTY_IDX )
+                predecessor->u.free.first_dirty = (1U << order) +
+                                                  pg->u.free.first_dirty;
+
+            pg = predecessor;
+        }
+        else
+        {
+            struct page_info *successor = pg + mask;
+
+            /* Merge with successor block? */
+            if ( !mfn_valid(page_to_mfn(successor)) ||
+                 !page_state_is(successor, free) ||
+                 (PFN_ORDER(successor) != order) ||
+                 (phys_to_nid(page_to_maddr(successor)) != node) )
+                break;
+
+            check_and_stop_scrub(successor);
+
+            /* Update pg's first_dirty if necessary. */
+            if ( pg->u.free.first_dirty == INVALID_DIRTY_IDX &&
+                 successor->u.free.first_dirty != INVALID_DIRTY_IDX )
+                pg->u.free.first_dirty = (1U << order) +
+                                         successor->u.free.first_dirty;
+
+            page_list_del(successor, &heap(node, zone, order));
+        }
+
+        order++;
+    }
+
+    page_list_add_scrub(pg, node, zone, order, pg->u.free.first_dirty);
+
+    if ( tainted )
+        reserve_offlined_page(pg);
+}
+
+/* Free 2^@order set of pages. */
+static void free_heap_pages(
+    struct page_info *pg, unsigned int order, bool need_scrub)
+{
+    spin_lock(&heap_lock);
+    free_heap_pages_locked(pg, order, need_scrub);
+    spin_unlock(&heap_lock);
+}
+
+/*************************
+ * PER-CPU PAGE CACHES
+ *
+ * Order-0 pages and order-9 chunks are kept in small per-pCPU, per-node
+ * stacks in front of the buddy allocator, so that the bulk of domheap
+ * allocations and frees (populate_physmap, relinquish_memory) don't need
+ * heap_lock.  The stacks are refilled from, and drained to, the buddy lists
+ * in batches, under a single acquisition of heap_lock.
+ *
+ * Cached chunks are in use as far as the buddy allocator is concerned: they
+ * are neither accounted in avail[] nor merged with their neighbours.  Their
+ * count_info is PGC_state_inuse, without owner or references, so that
+ * offline_page() may turn them offlining at any time; such a chunk is handed
+ * to free_heap_pages() rather than being allocated.  Single pages may be
+ * cached dirty (PGC_need_scrub) and are then scrubbed on allocation, like
+ * get_free_buddy() does for them.  Dirty order-9 chunks bypass the caches so
+ * the idle loop gets to scrub them.
+ *
+ * A pCPU only ever touches its own caches, except to drain them when memory
+ * runs low, pages are offlined or the pCPU goes away.  The per-cache lock
+ * therefore is uncontended, and nests outside heap_lock.
+ */
+
+#define PCP_ORDER_LARGE  9
+#define NR_PCP_LISTS     2
+
+static const unsigned int pcp_order[NR_PCP_LISTS] = { 0, PCP_ORDER_LARGE };
+
+/* High watermarks per list, in chunks.  Zero disables a list. */
+static unsigned int __initdata opt_pcp_pages = 512;
+integer_param("pcp-pages", opt_pcp_pages);
+static unsigned int __initdata opt_pcp_superpages = 4;
+integer_param("pcp-superpages", opt_pcp_superpages);
+
+static unsigned int __read_mostly pcp_high[NR_PCP_LISTS];
+static unsigned int __read_mostly pcp_batch[NR_PCP_LISTS];
+
+/* Lowest zone cached, keeping clear of the DMA pool. */
+static unsigned int __read_mostly pcp_zone_lo;
+
+struct pcp_list {
+    struct page_list_head chunks;
+    unsigned int count;
+};
+
+struct pcp_cache {
+    spinlock_t lock;
+    unsigned long pages;                  /* Total cached, in pages. */
+    struct pcp_list lists[MAX_NUMNODES][NR_PCP_LISTS];
+};
+
+/* Allocated when a pCPU first comes up, and never freed. */
+static struct pcp_cache *pcp_caches[NR_CPUS];
+
+static unsigned int pcp_index(unsigned int order)
+{
+    unsigned int i;
+
+    for ( i = 0; i < NR_PCP_LISTS; i++ )
+        if ( pcp_order[i] == order )
+            return pcp_high[i] ? i : NR_PCP_LISTS;
+
+    return NR_PCP_LISTS;
+}
+
+/* Pick the node get_free_buddy() would start searching from. */
+static nodeid_t pcp_node(const struct domain *d, unsigned int memflags)
+{
+    nodeid_t node = MEMF_get_node(memflags);
+
+    if ( node == NUMA_NO_NODE )
+    {
+        if ( d && nodes_intersects(node_online_map, d->node_affinity) )
+        {
+            nodemask_t nodemask;
+
+            nodes_and(nodemask, node_online_map, d->node_affinity);
+            node = cycle_node(d->last_alloc_node, nodemask);
+        }
+
+        if ( node >= MAX_NUMNODES )
+            node = cpu_to_node(smp_processor_id());
+    }
+
+    return node;
+}
+
+/* Move a batch of chunks from the buddy lists of @node into @pcp. */
+static void pcp_refill(struct pcp_cache *pcp, nodeid_t node, unsigned int idx)
+{
+    struct pcp_list *list = &pcp->lists[node][idx];
+    unsigned int i, n, order = pcp_order[idx], first_dirty, dirty_cnt = 0;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+    struct page_info *pg;
+
+    ASSERT(spin_is_locked(&pcp->lock));
+
+    spin_lock(&heap_lock);
+
+    for ( n = 0; n < pcp_batch[idx]; n++ )
+    {
+        /* Cached pages are unavailable, so claimed memory mustn't be used. */
+        if ( outstanding_claims + (1L << order) > total_avail_pages )
+            break;
+
+        /* Larger orders only come clean from get_free_buddy(). */
+        pg = get_free_buddy(pcp_zone_lo, NR_ZONES - 1, order,
+                            MEMF_node(node) | MEMF_exact_node, NULL);
+        if ( !pg )
+            break;
+
+        pg = take_heap_pages(pg, order, 0, &first_dirty,
+                             &need_tlbflush, &tlbflush_timestamp);
+
+        /*
+         * Resetting type_info also cleared u.free.need_tlbflush, the flush
+         * is done below for the whole batch.
+         */
+        if ( first_dirty != INVALID_DIRTY_IDX )
+        {
+            for ( i = 0; i < (1U << order); i++ )
+                if ( test_bit(_PGC_need_scrub, &pg[i].count_info) )
+                    dirty_cnt++;
+            page_list_add_tail(pg, &list->chunks);
+        }
+        else
+            page_list_add(pg, &list->chunks);
+
+        list->count++;
+        pcp->pages += 1UL << order;
+    }
+
+    if ( n )
+    {
+        node_need_scrub[node] -= dirty_cnt;
+        check_low_mem_virq();
+    }
+
+    spin_unlock(&heap_lock);
+
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    if ( n )
+        perfc_incr(pcp_refill);
+}
+
+/* Return chunks from the cold end of a list to the buddy allocator. */
+static unsigned long pcp_drain(struct pcp_cache *pcp, nodeid_t node,
+                               unsigned int idx, unsigned int keep)
+{
+    struct pcp_list *list = &pcp->lists[node][idx];
+    unsigned int i, order = pcp_order[idx];
+    unsigned long drained = 0;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+    struct page_info *pg;
+    PAGE_LIST_HEAD(chunks);
+
+    ASSERT(spin_is_locked(&pcp->lock));
+
+    while ( list->count > keep )
+    {
+        pg = page_list_last(&list->chunks);
+        page_list_del(pg, &list->chunks);
+        list->count--;
+
+        for ( i = 0; i < (1U << order); i++ )
+            accumulate_tlbflush(&need_tlbflush, &pg[i], &tlbflush_timestamp);
+
+        page_list_add_tail(pg, &chunks);
+        drained += 1UL << order;
+    }
+
+    if ( !drained )
+        return 0;
+
+    pcp->pages -= drained;
+
+    /* The buddy allocator doesn't track flushes still owed by these pages. */
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    spin_lock(&heap_lock);
+    while ( (pg = page_list_remove_head(&chunks)) )
+        free_heap_pages_locked(pg, order,
+                               test_bit(_PGC_need_scrub, &pg->count_info));
+    spin_unlock(&heap_lock);
+
+    perfc_incr(pcp_drain);
+
+    return drained;
+}
+
+static unsigned long pcp_drain_cpu(unsigned int cpu)
+{
+    struct pcp_cache *pcp = pcp_caches[cpu];
+    unsigned long drained = 0;
+    unsigned int node, idx;
+
+    if ( !pcp || !read_atomic(&pcp->pages) )
+        return 0;
+
+    spin_lock(&pcp->lock);
+    for ( node = 0; node < MAX_NUMNODES; node++ )
+        for ( idx = 0; idx < NR_PCP_LISTS; idx++ )
+            drained += pcp_drain(pcp, node, idx, 0);
+    spin_unlock(&pcp->lock);
+
+    return drained;
+}
+
+/* Empty all caches.  Returns the number of pages given back to the heap. */
+static unsigned long pcp_drain_all(void)
+{
+    unsigned int cpu;
+    unsigned long drained = 0;
+
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+        drained += pcp_drain_cpu(cpu);
+
+    return drained;
+}
+
+static unsigned long pcp_cached_pages(void)
+{
+    unsigned int cpu;
+    unsigned long pages = 0;
+
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+        if ( pcp_caches[cpu] )
+            pages += read_atomic(&pcp_caches[cpu]->pages);
+
+    return pages;
+}
+
+/* Whether the caches and pools hold @request pages of zones up to @zone_hi. */
+static bool pcp_cached_enough(unsigned int zone_hi, unsigned long request)
+{
+    return zone_hi >= pcp_zone_lo &&
+           pcp_cached_pages() + read_atomic(&sp_pool_pages) >= request;
+}
+
+/*
+ * Allocate 2^@order pages from the local cache.  Only requests which may be
+ * satisfied from any zone above the DMA pool are eligible.
+ */
+static struct page_info *pcp_alloc(struct domain *d, unsigned int zone_hi,
+                                   unsigned int order, unsigned int memflags)
+{
+    struct pcp_cache *pcp = pcp_caches[smp_processor_id()];
+    unsigned int i, idx = pcp_index(order);
+    bool need_tlbflush = false, offlining = false;
+    uint32_t tlbflush_timestamp = 0;
+    struct pcp_list *list;
+    struct page_info *pg;
+    nodeid_t node;
+
+    if ( !pcp || idx >= NR_PCP_LISTS || zone_hi != NR_ZONES - 1 )
+        return NULL;
+
+    node = pcp_node(d, memflags);
+    if ( node >= MAX_NUMNODES || !avail[node] )
+        return NULL;
+
+    list = &pcp->lists[node][idx];
+
+    spin_lock(&pcp->lock);
+
+    if ( !list->count )
+        pcp_refill(pcp, node, idx);
+
+    if ( (pg = page_list_remove_head(&list->chunks)) != NULL )
+    {
+        list->count--;
+        pcp->pages -= 1UL << order;
+    }
+
+    spin_unlock(&pcp->lock);
+
+    if ( !pg )
+        return NULL;
+
+    for ( i = 0; i < (1U << order); i++ )
+    {
+        accumulate_tlbflush(&need_tlbflush, &pg[i], &tlbflush_timestamp);
+        if ( !page_state_is(&pg[i], inuse) )
+            offlining = true;
+    }
+
+    if ( unlikely(offlining) )
+    {
+        if ( need_tlbflush )
+            filtered_flush_tlb_mask(tlbflush_timestamp);
+        free_heap_pages(pg, order, test_bit(_PGC_need_scrub, &pg->count_info));
+        return NULL;
+    }
+
+    for ( i = 0; i < (1U << order); i++ )
+    {
+        if ( test_bit(_PGC_need_scrub, &pg[i].count_info) )
+        {
+            if ( !(memflags & MEMF_no_scrub) )
+                scrub_one_page(&pg[i]);
+            clear_bit(_PGC_need_scrub, &pg[i].count_info);
+        }
+        else if ( !(memflags & MEMF_no_scrub) )
+            check_one_page(&pg[i]);
+
+        pg[i].u.inuse.type_info = 0;
+
+        flush_page_to_ram(mfn_x(page_to_mfn(&pg[i])),
+                          !(memflags & MEMF_no_icache_flush));
+    }
+
+    if ( d != NULL )
+        d->last_alloc_node = node;
+
+    if ( need_tlbflush && !(memflags & MEMF_no_tlbflush) )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    perfc_incr(pcp_alloc);
+
+    return pg;
+}
+
+/*
+ * Put 2^@order pages freed by their owner into the local cache.  Returns
+ * false if they have to go to free_heap_pages() instead.
+ */
+static bool pcp_free(struct page_info *pg, unsigned int order, bool need_scrub)
+{
+    struct pcp_cache *pcp = pcp_caches[smp_processor_id()];
+    unsigned int i, idx = pcp_index(order);
+    struct pcp_list *list;
+    nodeid_t node;
+
+    if ( !pcp || idx >= NR_PCP_LISTS || (order && need_scrub) ||
+         page_to_zone(pg) < pcp_zone_lo )
+        return false;
+
+    for ( i = 0; i < (1U << order); i++ )
+        if ( (pg[i].count_info & (PGC_state | PGC_broken)) != PGC_state_inuse )
+            return false;
+
+    for ( i = 0; i < (1U << order); i++ )
+    {
+        unsigned long x, y = pg[i].count_info;
+
+        /* Races with mark_page_offline(), which doesn't hold our lock. */
+        do {
+            x = y;
+        } while ( (y = cmpxchg(&pg[i].count_info, x,
+                               (x & (PGC_state | PGC_broken)) |
+                               (need_scrub ? PGC_need_scrub : 0))) != x );
+
+        /* If a page has no owner it will need no safety TLB flush. */
+        pg[i].u.free.need_tlbflush = (page_get_owner(&pg[i]) != NULL);
+        if ( pg[i].u.free.need_tlbflush )
+            page_set_tlbflush_timestamp(&pg[i]);
+
+        /* This page is not a guest frame any more. */
+        page_set_owner(&pg[i], NULL);
+        set_gpfn_from_mfn(mfn_x(page_to_mfn(&pg[i])), INVALID_M2P_ENTRY);
+
+        if ( need_scrub )
+            poison_one_page(&pg[i]);
+    }
+
+    node = phys_to_nid(page_to_maddr(pg));
+    list = &pcp->lists[node][idx];
+
+    spin_lock(&pcp->lock);
+
+    /* Clean pages are handed out first, dirty ones drained first. */
+    if ( need_scrub )
+        page_list_add_tail(pg, &list->chunks);
+    else
+        page_list_add(pg, &list->chunks);
+    list->count++;
+    pcp->pages += 1UL << order;
+
+    if ( list->count > pcp_high[idx] )
+        pcp_drain(pcp, node, idx, pcp_high[idx] - pcp_batch[idx]);
+
+    spin_unlock(&pcp->lock);
+
+    perfc_incr(pcp_free);
+
+    return true;
+}
+
+static void pcp_cache_init(unsigned int cpu)
+{
+    struct pcp_cache *pcp;
+    unsigned int node, idx;
+
+    if ( pcp_caches[cpu] )
+        return;
+
+    /* Not fatal: the pCPU then goes straight to the heap. */
+    if ( (pcp = xzalloc(struct pcp_cache)) == NULL )
+        return;
+
+    spin_lock_init(&pcp->lock);
+    for ( node = 0; node < MAX_NUMNODES; node++ )
+        for ( idx = 0; idx < NR_PCP_LISTS; idx++ )
+            INIT_PAGE_LIST_HEAD(&pcp->lists[node][idx].chunks);
+
+    smp_wmb();
+    pcp_caches[cpu] = pcp;
+}
+
+static int cpu_pcp_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+
+    switch ( action )
+    {
+    case CPU_UP_PREPARE:
+        pcp_cache_init(cpu);
+        break;
+
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        pcp_drain_cpu(cpu);
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block cpu_pcp_nfb = {
+    .notifier_call = cpu_pcp_callback
+};
+
+static int __init pcp_init(void)
+{
+    unsigned int idx;
+
+    pcp_high[0] = opt_pcp_pages;
+    pcp_high[1] = opt_pcp_superpages;
+    if ( !pcp_high[0] && !pcp_high[1] )
+        return 0;
+
+    for ( idx = 0; idx < NR_PCP_LISTS; idx++ )
+        pcp_batch[idx] = max(pcp_high[idx] / 4, 1U);
+
+    pcp_zone_lo = dma_bitsize ? bits_to_zone(dma_bitsize) + 1
+                              : MEMZONE_XEN + 1;
+
+    pcp_cache_init(smp_processor_id());
+    register_cpu_notifier(&cpu_pcp_nfb);
+
+    return 0;
+}
+presmp_initcall(pcp_init);
+
+/*************************
+ * SUPERPAGE POOLS
+ *
+ * Each node keeps a few scrubbed 1GiB and 2MiB chunks aside, so that large
+ * extents (e.g. from populate_physmap()) neither find them broken up by
+ * smaller allocations nor have to wait for them to be scrubbed.  Pools are
+ * topped up from the idle loop once there is nothing left to scrub, without
+ * ever splitting a 1GiB chunk to make 2MiB ones, and give their chunks back
+ * when memory runs low.
+ *
+ * Guest memory can't be moved, so the only compaction possible is to let
+ * the buddy allocator merge what's free: if a node has the free memory but
+ * no chunk of the size wanted, the per-CPU caches of its pages are drained.
+ * Refilling then backs off, for twice as long each time it fails again, and
+ * doesn't drain anything when the node lacks the free memory anyway.
+ *
+ * Like per-CPU cached chunks, pooled ones are in use as far as the buddy
+ * allocator is concerned, and may turn offlining.  Pools and sp_pool_pages
+ * are protected by sp_pool_lock, which nests outside heap_lock.
+ */
+
+#define SP_ORDER_1G      (30 - PAGE_SHIFT)
+#define SP_ORDER_2M      (21 - PAGE_SHIFT)
+#define NR_SP_POOLS      2
+
+static const unsigned int sp_pool_order[NR_SP_POOLS] = {
+    SP_ORDER_1G, SP_ORDER_2M
+};
+
+/* Target number of chunks per node.  Zero disables a pool. */
+static unsigned int __initdata opt_sp_pool_1g = 1;
+integer_param("superpage-pool-1g", opt_sp_pool_1g);
+static unsigned int __initdata opt_sp_pool_2m = 16;
+integer_param("superpage-pool-2m", opt_sp_pool_2m);
+
+static unsigned int __read_mostly sp_pool_target[NR_SP_POOLS];
+static unsigned int __read_mostly sp_zone_lo;
+
+struct sp_pool {
+    struct page_list_head chunks;
+    unsigned int count;
+};
+
+static DEFINE_SPINLOCK(sp_pool_lock);
+static struct sp_pool sp_pools[MAX_NUMNODES][NR_SP_POOLS];
+static s_time_t sp_pool_retry[MAX_NUMNODES];
+static unsigned int sp_pool_backoff[MAX_NUMNODES];
+
+/* Refilling backs off for SECONDS(1) << sp_pool_backoff[], up to 64s. */
+#define SP_POOL_BACKOFF_MAX 6
+
+static unsigned int sp_pool_index(unsigned int order)
+{
+    unsigned int i;
+
+    for ( i = 0; i < NR_SP_POOLS; i++ )
+        if ( sp_pool_order[i] == order )
+            return sp_pool_target[i] ? i : NR_SP_POOLS;
+
+    return NR_SP_POOLS;
+}
+
+/*
+ * Whether @node has the free memory to pool a chunk of @order, leaving at
+ * least as much outside the pool.
+ */
+static bool sp_pool_fits(nodeid_t node, unsigned int order)
+{
+    unsigned int zone = NR_ZONES;
+    unsigned long node_free = 0;
+
+    ASSERT(spin_is_locked(&heap_lock));
+
+    while ( zone-- > sp_zone_lo )
+        node_free += avail[node][zone];
+
+    /* Pooled pages are unavailable, so claimed memory mustn't be used. */
+    return node_free >= (2UL << order) &&
+           outstanding_claims + (1L << order) <= total_avail_pages;
+}
+
+/*
+ * Move one clean chunk of @node into its pool.  Returns whether there was
+ * one to take.
+ */
+static bool sp_pool_refill(nodeid_t node, unsigned int idx)
+{
+    struct sp_pool *pool = &sp_pools[node][idx];
+    unsigned int order = sp_pool_order[idx], zone, j, first_dirty;
+    unsigned int order_hi = idx ? SP_ORDER_1G - 1 : MAX_ORDER;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+    struct page_info *pg = NULL;
+
+    ASSERT(spin_is_locked(&sp_pool_lock));
+
+    spin_lock(&heap_lock);
+
+    if ( !sp_pool_fits(node, order) )
+        goto out;
+
+    /* Only clean chunks, which are kept at the head of the lists. */
+    for ( zone = NR_ZONES - 1; !pg && zone >= sp_zone_lo; zone-- )
+        for ( j = order; j <= order_hi; j++ )
+        {
+            pg = page_list_first(&heap(node, zone, j));
+            if ( pg && pg->u.free.first_dirty == INVALID_DIRTY_IDX )
+            {
+                page_list_del(pg, &heap(node, zone, j));
+                break;
+            }
+            pg = NULL;
+        }
+
+    if ( !pg )
+        goto out;
+
+    pg = take_heap_pages(pg, order, 0, &first_dirty,
+                         &need_tlbflush, &tlbflush_timestamp);
+    ASSERT(first_dirty == INVALID_DIRTY_IDX);
+
+    page_list_add_tail(pg, &pool->chunks);
+    pool->count++;
+    sp_pool_pages += 1UL << order;
+
+    check_low_mem_virq();
+
+ out:
+    spin_unlock(&heap_lock);
+
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    if ( pg )
+        perfc_incr(sp_pool_refill);
+
+    return pg;
+}
+
+/* Give @node's pages held in the per-CPU caches back to the buddy lists. */
+static unsigned long sp_pool_compact(nodeid_t node)
+{
+    unsigned long drained = 0;
+    unsigned int cpu, idx;
+
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+    {
+        struct pcp_cache *pcp = pcp_caches[cpu];
+
+        if ( !pcp || !read_atomic(&pcp->pages) )
+            continue;
+
+        spin_lock(&pcp->lock);
+        for ( idx = 0; idx < NR_PCP_LISTS; idx++ )
+            drained += pcp_drain(pcp, node, idx, 0);
+        spin_unlock(&pcp->lock);
+    }
+
+    perfc_incr(sp_pool_compact);
+
+    return drained;
+}
+
+/*
+ * Is any pool of node below its target?  Done without holding the lock, for
+ * idle CPUs not to contend on it while the pools are full.
+ */
+static bool sp_pool_wanted(nodeid_t node)
+{
+    unsigned int idx;
+
+    for ( idx = 0; idx < NR_SP_POOLS; idx++ )
+        if ( read_atomic(&sp_pools[node][idx].count) < sp_pool_target[idx] )
+            return true;
 
-                        spin_lock(&heap_lock);
-                        node_need_scrub[node] -= dirty_cnt;
-                        spin_unlock(&heap_lock);
-                        goto out_nolock;
-                    }
+    return false;
+}
 
-                    /*
-                     * Scrub a few (8) pages before becoming eligible for
-                     * preemption. But also count non-scrubbing loop iterations
-                     * so that we don't get stuck here with an almost clean
-                     * heap.
-                     */
-                    if ( cnt > 800 && softirq_pending(cpu) )
-                    {
-                        preempt = true;
-                        break;
-                    }
-                }
+/*
+ * Top up the pools of the local node by one chunk.  Called from the idle
+ * loop once there is nothing to scrub; returns whether any work was done.
+ */
+static bool sp_pool_idle(void)
+{
+    nodeid_t node = cpu_to_node(smp_processor_id());
+    unsigned int idx, order = 0;
+    bool wanted = false, progress = false, fits;
 
-                st.pg = pg;
-                /*
-                 * get_free_buddy() grabs a buddy with first_dirty set to
-                 * INVALID_DIRTY_IDX so we can't set pg's first_dirty here.
-                 * It will be set either below or in the lock callback (in
-                 * scrub_continue()).
-                 */
-                st.first_dirty = (i >= (1U << order) - 1) ?
-                    INVALID_DIRTY_IDX : i + 1;
-                st.drop = false;
-                spin_lock_cb(&heap_lock, scrub_continue, &st);
+    if ( node >= MAX_NUMNODES || !avail[node] ||
+         NOW() < sp_pool_retry[node] || !sp_pool_wanted(node) ||
+         !spin_trylock(&sp_pool_lock) )
+        return false;
 
-                node_need_scrub[node] -= dirty_cnt;
+    for ( idx = 0; idx < NR_SP_POOLS && !progress; idx++ )
+    {
+        if ( sp_pools[node][idx].count >= sp_pool_target[idx] )
+            continue;
 
-                if ( st.drop )
-                    goto out;
+        wanted = true;
+        order = sp_pool_order[idx];
+        progress = sp_pool_refill(node, idx);
+    }
 
-                if ( i >= (1U << order) - 1 )
-                {
-                    page_list_del(pg, &heap(node, zone, order));
-                    page_list_add_scrub(pg, node, zone, order, INVALID_DIRTY_IDX);
-                }
-                else
-                    pg->u.free.first_dirty = i + 1;
+    if ( wanted && !progress )
+    {
+        /* Compaction can't help if even the smallest chunk wanted won't fit. */
+        spin_lock(&heap_lock);
+        fits = sp_pool_fits(node, order);
+        spin_unlock(&heap_lock);
 
-                pg->u.free.scrub_state = BUDDY_NOT_SCRUBBING;
+        if ( fits )
+            sp_pool_compact(node);
 
-                if ( preempt || (node_need_scrub[node] == 0) )
-                    goto out;
-            }
-        } while ( order-- != 0 );
+        sp_pool_retry[node] = NOW() + (SECONDS(1) << sp_pool_backoff[node]);
+        if ( sp_pool_backoff[node] < SP_POOL_BACKOFF_MAX )
+            sp_pool_backoff[node]++;
     }
+    else
+        sp_pool_backoff[node] = 0;
 
- out:
-    spin_unlock(&heap_lock);
+    spin_unlock(&sp_pool_lock);
 
- out_nolock:
-    node_clear(node, node_scrubbing);
-    return node_to_scrub(false) != NUMA_NO_NODE;
+    return progress;
 }
 
-/* Free 2^@order set of pages. */
-static void free_heap_pages(
-    struct page_info *pg, unsigned int order, bool need_scrub)
+/* Empty all pools.  Returns the number of pages given back to the heap. */
+static unsigned long sp_pool_drain_all(void)
 {
-    unsigned long mask;
-    mfn_t mfn = page_to_mfn(pg);
-    unsigned int i, node = phys_to_nid(page_to_maddr(pg)), tainted = 0;
-    unsigned int zone = page_to_zone(pg);
+    unsigned long drained = 0;
+    unsigned int node, idx;
+    struct page_info *pg;
 
-    ASSERT(order <= MAX_ORDER);
-    ASSERT(node >= 0);
+    if ( !read_atomic(&sp_pool_pages) )
+        return 0;
 
+    spin_lock(&sp_pool_lock);
     spin_lock(&heap_lock);
 
-    for ( i = 0; i < (1 << order); i++ )
-    {
-        /*
-         * Cannot assume that count_info == 0, as there are some corner cases
-         * where it isn't the case and yet it isn't a bug:
-         *  1. page_get_owner() is NULL
-         *  2. page_get_owner() is a domain that was never accessible by
-         *     its domid (e.g., failed to fully construct the domain).
-         *  3. page was never addressable by the guest (e.g., it's an
-         *     auto-translate-physmap guest and the page was never included
-         *     in its pseudophysical address space).
-         * In all the above cases there can be no guest mappings of this page.
-         */
-        switch ( pg[i].count_info & PGC_state )
+    for ( node = 0; node < MAX_NUMNODES; node++ )
+        for ( idx = 0; idx < NR_SP_POOLS; idx++ )
         {
-        case PGC_state_inuse:
-            BUG_ON(pg[i].count_info & PGC_broken);
-            pg[i].count_info = PGC_state_free;
-            break;
+            struct sp_pool *pool = &sp_pools[node][idx];
 
-        case PGC_state_offlining:
-            pg[i].count_info = (pg[i].count_info & PGC_broken) |
-                               PGC_state_offlined;
-            tainted = 1;
-            break;
-
-        default:
-            printk(XENLOG_ERR
-                   "pg[%u] MFN %"PRI_mfn" c=%#lx o=%u v=%#lx t=%#x\n",
-                   i, mfn_x(page_to_mfn(pg + i)),
-                   pg[i].count_info, pg[i].v.free.order,
-                   pg[i].u.free.val, pg[i].tlbflush_timestamp);
-            BUG();
+            while ( (pg = page_list_remove_head(&pool->chunks)) != NULL )
+            {
+                pool->count--;
+                drained += 1UL << sp_pool_order[idx];
+                free_heap_pages_locked(pg, sp_pool_order[idx], false);
+            }
         }
 
-        /* If a page has no owner it will need no safety TLB flush. */
-        pg[i].u.free.need_tlbflush = (page_get_owner(&pg[i]) != NULL);
-        if ( pg[i].u.free.need_tlbflush )
-            page_set_tlbflush_timestamp(&pg[i]);
+    sp_pool_pages -= drained;
 
-        /* This page is not a guest frame any more. */
-        page_set_owner(&pg[i], NULL); /* set_gpfn_from_mfn snoops pg owner */
-        set_gpfn_from_mfn(mfn_x(mfn) + i, INVALID_M2P_ENTRY);
+    spin_unlock(&heap_lock);
+    spin_unlock(&sp_pool_lock);
 
-        if ( need_scrub )
-        {
-            pg[i].count_info |= PGC_need_scrub;
-            poison_one_page(&pg[i]);
-        }
-    }
+    return drained;
+}
 
-    avail[node][zone] += 1 << order;
-    total_avail_pages += 1 << order;
-    if ( need_scrub )
+/* Allocate a 1GiB or 2MiB chunk from the pool of the preferred node. */
+static struct page_info *sp_pool_alloc(struct domain *d, unsigned int zone_hi,
+                                       unsigned int order,
+                                       unsigned int memflags)
+{
+    unsigned int i, idx = sp_pool_index(order);
+    bool offlining = false;
+    struct page_info *pg;
+    nodeid_t node;
+
+    if ( idx >= NR_SP_POOLS || zone_hi != NR_ZONES - 1 )
+        return NULL;
+
+    node = pcp_node(d, memflags);
+    if ( node >= MAX_NUMNODES || !read_atomic(&sp_pools[node][idx].count) )
+        return NULL;
+
+    spin_lock(&sp_pool_lock);
+
+    if ( (pg = page_list_remove_head(&sp_pools[node][idx].chunks)) != NULL )
     {
-        node_need_scrub[node] += 1 << order;
-        pg->u.free.first_dirty = 0;
+        sp_pools[node][idx].count--;
+        sp_pool_pages -= 1UL << order;
     }
-    else
-        pg->u.free.first_dirty = INVALID_DIRTY_IDX;
 
-    /* Merge chunks as far as possible. */
-    while ( order < MAX_ORDER )
-    {
-        mask = 1UL << order;
+    spin_unlock(&sp_pool_lock);
 
-        if ( (mfn_x(page_to_mfn(pg)) & mask) )
-        {
-            struct page_info *predecessor = pg - mask;
+    if ( !pg )
+        return NULL;
 
-            /* Merge with predecessor block? */
-            if ( !mfn_valid(page_to_mfn(predecessor)) ||
-                 !page_state_is(predecessor, free) ||
-                 (PFN_ORDER(predecessor) != order) ||
-                 (phys_to_nid(page_to_maddr(predecessor)) != node) )
-                break;
+    for ( i = 0; i < (1U << order); i++ )
+        if ( !page_state_is(&pg[i], inuse) )
+            offlining = true;
 
-            check_and_stop_scrub(predecessor);
+    if ( unlikely(offlining) )
+    {
+        free_heap_pages(pg, order, false);
+        return NULL;
+    }
 
-            page_list_del(predecessor, &heap(node, zone, order));
+    /* Pooled chunks were scrubbed, and flushed when taken off the heap. */
+    for ( i = 0; i < (1U << order); i++ )
+    {
+        if ( !(memflags & MEMF_no_scrub) )
+            check_one_page(&pg[i]);
 
-            /* Update predecessor's first_dirty if necessary. */
-            if ( predecessor->u.free.first_dirty == INVALID_DIRTY_IDX &&
-                 pg->u.free.first_dirty != INVALID_DIRTY_IDX )
-                predecessor->u.free.first_dirty = (1U << order) +
-                                                  pg->u.free.first_dirty;
+        pg[i].u.inuse.type_info = 0;
 
-            pg = predecessor;
-        }
-        else
-        {
-            struct page_info *successor = pg + mask;
+        flush_page_to_ram(mfn_x(page_to_mfn(&pg[i])),
+                          !(memflags & MEMF_no_icache_flush));
+    }
 
-            /* Merge with successor block? */
-            if ( !mfn_valid(page_to_mfn(successor)) ||
-                 !page_state_is(successor, free) ||
-                 (PFN_ORDER(successor) != order) ||
-                 (phys_to_nid(page_to_maddr(successor)) != node) )
-                break;
+    if ( d != NULL )
+        d->last_alloc_node = node;
 
-            check_and_stop_scrub(successor);
+    perfc_incr(sp_pool_alloc);
 
-            /* Update pg's first_dirty if necessary. */
-            if ( pg->u.free.first_dirty == INVALID_DIRTY_IDX &&
-                 successor->u.free.first_dirty != INVALID_DIRTY_IDX )
-                pg->u.free.first_dirty = (1U << order) +
-                                         successor->u.free.first_dirty;
+    return pg;
+}
 
-            page_list_del(successor, &heap(node, zone, order));
-        }
+static int __init sp_pool_init(void)
+{
+    unsigned int node, idx;
 
-        order++;
-    }
+    sp_pool_target[0] = opt_sp_pool_1g;
+    sp_pool_target[1] = opt_sp_pool_2m;
 
-    page_list_add_scrub(pg, node, zone, order, pg->u.free.first_dirty);
+    for ( node = 0; node < MAX_NUMNODES; node++ )
+        for ( idx = 0; idx < NR_SP_POOLS; idx++ )
+            INIT_PAGE_LIST_HEAD(&sp_pools[node][idx].chunks);
 
-    if ( tainted )
-        reserve_offlined_page(pg);
+    sp_zone_lo = dma_bitsize ? bits_to_zone(dma_bitsize) + 1
+                             : MEMZONE_XEN + 1;
 
-    spin_unlock(&heap_lock);
+    return 0;
 }
+presmp_initcall(sp_pool_init);
 
 
 /*
@@ -1888,6 +2847,13 @@ int offline_page(mfn_t mfn, int broken, uint32_t *status)
         return 0;
     }
 
+    /*
+     * A free page may sit in a per-CPU cache or superpage pool, put it back
+     * on the heap.
+     */
+    pcp_drain_all();
+    sp_pool_drain_all();
+
     spin_lock(&heap_lock);
 
     old_info = mark_page_offline(pg, broken);
@@ -2380,6 +3346,8 @@ void __init heap_init_late(void)
      */
     setup_low_mem_virq();
 
+    scrub_backend_init();
+
     switch ( opt_bootscrub )
     {
     default:
@@ -2621,9 +3589,13 @@ struct page_info *alloc_domheap_pages(
         return NULL;
     }
 
+    pg = pcp_alloc(d, zone_hi, order, memflags);
+    if ( !pg )
+        pg = sp_pool_alloc(d, zone_hi, order, memflags);
+
     if ( !dma_bitsize )
         memflags &= ~MEMF_no_dma;
-    else if ( (dma_zone = bits_to_zone(dma_bitsize)) < zone_hi )
+    else if ( !pg && (dma_zone = bits_to_zone(dma_bitsize)) < zone_hi )
         pg = alloc_heap_pages(dma_zone + 1, zone_hi, order, memflags, d);
 
     if ( (pg == NULL) &&
@@ -2714,13 +3686,45 @@ void free_domheap_pages(struct page_info *pg, unsigned int order)
 
         if ( is_page_colored(pg) )
             free_col_heap_page(pg);
-        else
+        else if ( !pcp_free(pg, order, scrub) )
             free_heap_pages(pg, order, scrub);}
 
     if ( drop_dom_ref )
         put_domain(d);
 }
 
+/*
+ * Free a batch of single pages taken off a dying domain's page list, with
+ * no references left and the domain's accounting already adjusted.  The
+ * pages are scrubbed here, outside of heap_lock, and then handed back to the
+ * buddy allocator under a single acquisition of the lock.  Their owner is
+ * left in place, so TLB flush avoidance works exactly as for single frees.
+ */
+void free_domheap_page_list(struct page_list_head *list)
+{
+    struct page_info *pg, *tmp;
+
+    ASSERT(!in_irq());
+
+    page_list_for_each_safe ( pg, tmp, list )
+    {
+        if ( unlikely(is_page_colored(pg)) )
+        {
+            page_list_del(pg, list);
+            scrub_one_page(pg);
+            free_col_heap_page(pg);
+        }
+        else if ( likely(page_state_is(pg, inuse)) )
+            scrub_one_page(pg);
+    }
+
+    spin_lock(&heap_lock);
+    while ( (pg = page_list_remove_head(list)) != NULL )
+        /* Pages being offlined weren't scrubbed above. */
+        free_heap_pages_locked(pg, 0, !page_state_is(pg, inuse));
+    spin_unlock(&heap_lock);
+}
+
 unsigned long avail_domheap_pages_region(
     unsigned int node, unsigned int min_width, unsigned int max_width)
 {
@@ -2739,7 +3743,8 @@ unsigned long avail_domheap_pages(void)
 {
     return avail_heap_pages(MEMZONE_XEN + 1,
                             NR_ZONES - 1,
-                            -1);
+                            -1) + pcp_cached_pages() +
+           read_atomic(&sp_pool_pages);
 }
 
 unsigned long avail_node_heap_pages(unsigned int nodeid)
@@ -2773,6 +3778,10 @@ static void pagealloc_info(unsigned char key)
     }
 
     printk("    Dom heap: %lukB free\n", total << (PAGE_SHIFT-10));
+
+#ifdef VMAP_VIRT_START
+    vm_dump_info();
+#endif
 }
 
 static __init int pagealloc_keyhandler_init(void)
@@ -2785,17 +3794,56 @@ __initcall(pagealloc_keyhandler_init);
 
 void scrub_one_page(struct page_info *pg)
 {
+    struct scrub_stats *stats;
+    s_time_t start;
+    void *va;
+
     if ( unlikely(pg->count_info & PGC_broken) )
         return;
 
+    start = NOW();
+    va = __map_domain_page(pg);
+
 #ifndef NDEBUG
     /* Avoid callers relying on allocations returning zeroed pages. */
-    unmap_domain_page(memset(__map_domain_page(pg),
-                             SCRUB_BYTE_PATTERN, PAGE_SIZE));
+    memset(va, SCRUB_BYTE_PATTERN, PAGE_SIZE);
 #else
-    /* For a production build, clear_page() is the fastest way to scrub. */
-    clear_domain_page(_mfn(page_to_mfn(pg)));
+    /* Early scrubbing may happen before a backend has been picked. */
+    if ( likely(scrub_backend) )
+        scrub_backend->clear(va);
+    else
+        clear_page(va);
 #endif
+
+    unmap_domain_page(va);
+
+    stats = &this_cpu(scrub_stats);
+    stats->pages++;
+    stats->time += NOW() - start;
+}
+
+static void dump_scrub_stats(void)
+{
+    unsigned long pages = 0, kib, us;
+    s_time_t time = 0;
+    unsigned int cpu;
+
+    for_each_online_cpu ( cpu )
+    {
+        const struct scrub_stats *stats = &per_cpu(scrub_stats, cpu);
+
+        pages += stats->pages;
+        time += stats->time;
+    }
+
+    kib = pages << (PAGE_SHIFT - 10);
+    us = time / MICROSECS(1);
+
+    printk("Scrubbed %lu pages with %s in %lums",
+           pages, scrub_method_name(), us / 1000);
+    if ( us )
+        printk(": %lu MiB/s", (kib * 1000000 / us) >> 10);
+    printk("\n");
 }
 
 static void dump_heap(unsigned char key)
@@ -2821,6 +3869,31 @@ static void dump_heap(unsigned char key)
             continue;
         printk("Node %d has %lu unscrubbed pages\n", i, node_need_scrub[i]);
     }
+
+    for ( i = 0; i < MAX_NUMNODES; i++ )
+    {
+        unsigned long pages = 0;
+        unsigned int cpu;
+
+        for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+        {
+            const struct pcp_cache *pcp = pcp_caches[cpu];
+
+            if ( !pcp )
+                continue;
+            for ( j = 0; j < NR_PCP_LISTS; j++ )
+                pages += (unsigned long)pcp->lists[i][j].count << pcp_order[j];
+        }
+
+        if ( pages )
+            printk("Node %d has %lu pages in per-CPU caches\n", i, pages);
+
+        if ( sp_pools[i][0].count || sp_pools[i][1].count )
+            printk("Node %d has %u 1GiB and %u 2MiB chunks pooled\n",
+                   i, sp_pools[i][0].count, sp_pools[i][1].count);
+    }
+
+    dump_scrub_stats();
 }
 
 static __init int register_heap_trigger(void)
@@ -44,6 +44,8 @@
 #include <xen/softirq.h>
 #include <xen/cpu.h>
 #include <xen/stop_machine.h>
+#include <xen/keyhandler.h>
+#include <xen/tasklet.h>
 
 /* Global control variables for rcupdate callback mechanism. */
 static struct rcu_ctrlblk {
@@ -55,6 +57,10 @@ static struct rcu_ctrlblk {
     cpumask_t   cpumask; /* CPUs that need to switch in order ... */
     cpumask_t   idle_cpumask; /* ... unless they are already idle */
     /* for current batch to proceed.        */
+
+    atomic_t    expedite;     /* Requests for expedited grace periods */
+    bool        gp_expedited; /* Current batch is being expedited */
+    s_time_t    gp_start;     /* When the current batch started */
 } __cacheline_aligned rcu_ctrlblk = {
     .cur = -300,
     .completed = -300,
@@ -84,6 +90,7 @@ struct rcu_data {
     int cpu;
     struct rcu_head barrier;
     long            last_rs_qlen;     /* qlen during the last resched */
+    bool            offload;          /* Callbacks invoked elsewhere */
 
     /* 3) idle CPUs handling */
     struct timer idle_timer;
@@ -140,6 +147,80 @@ static int qhimark = 10000;
 static int qlowmark = 100;
 static int rsinterval = 1000;
 
+/*
+ * Expedited grace periods.
+ *
+ * Running softirqs is a quiescent state, but normally a CPU only reports
+ * one the second time it processes RCU_SOFTIRQ in a grace period (the first
+ * time it just notices that the grace period started), and CPUs which have
+ * nothing to do for RCU only get there when they happen to process some
+ * other softirq.  An expedited grace period IPIs all CPUs it waits for, and
+ * has them report their quiescent state right away.  rcu_barrier() always
+ * expedites; "rcu-expedited" does so for all grace periods, at the price of
+ * an IPI to every non-idle CPU for each of them.
+ */
+static bool __read_mostly opt_rcu_expedited;
+boolean_param("rcu-expedited", opt_rcu_expedited);
+
+/* Grace period latency statistics, protected by rcu_ctrlblk.lock. */
+static struct rcu_gp_stats {
+    unsigned long count;
+    s_time_t total, max;
+} rcu_gp_stats[2];                    /* Normal, expedited */
+
+/*
+ * Callback offloading.
+ *
+ * Completed callbacks of the CPUs in "rcu-offload" are not invoked there,
+ * but queued for a softirq tasklet on one of the other (housekeeping) CPUs,
+ * so that e.g. CPUs dedicated to real-time guests only take part in the
+ * grace period machinery.  Callbacks of any one CPU are still invoked in
+ * the order they were queued, which rcu_barrier() relies upon.
+ */
+static cpumask_t __read_mostly rcu_offload_mask;
+
+static struct rcu_offload {
+    spinlock_t lock;
+    struct rcu_head *list, **tail;
+    long qlen;
+    unsigned int cpu;                 /* Housekeeping CPU last used */
+    struct tasklet tasklet;
+} rcu_offload = {
+    .lock = SPIN_LOCK_UNLOCKED,
+    .tail = &rcu_offload.list,
+};
+
+static int __init parse_rcu_offload(const char *s)
+{
+    unsigned long first, last;
+    const char *ss;
+
+    cpumask_clear(&rcu_offload_mask);
+
+    do {
+        first = last = simple_strtoul(s, &ss, 0);
+        if ( ss == s )
+            return -EINVAL;
+        if ( *ss == '-' )
+        {
+            s = ss + 1;
+            last = simple_strtoul(s, &ss, 0);
+            if ( ss == s || last < first )
+                return -EINVAL;
+        }
+        if ( last >= NR_CPUS )
+            return -EINVAL;
+
+        for ( ; first <= last; first++ )
+            cpumask_set_cpu(first, &rcu_offload_mask);
+
+        s = ss + 1;
+    } while ( *ss == ',' );
+
+    return *ss ? -EINVAL : 0;
+}
+custom_param("rcu-offload", parse_rcu_offload);
+
 struct rcu_barrier_data {
     struct rcu_head head;
     atomic_t *cpu_count;
@@ -177,10 +258,40 @@ static int rcu_barrier_action(void *_cpu_count)
     return 0;
 }
 
+static bool rcu_expedited(struct rcu_ctrlblk *rcp)
+{
+    return opt_rcu_expedited || atomic_read(&rcp->expedite);
+}
+
+/* Expedite the current grace period (if any) and all following ones. */
+static void rcu_expedite_begin(struct rcu_ctrlblk *rcp)
+{
+    atomic_inc(&rcp->expedite);
+
+    spin_lock(&rcp->lock);
+    if ( rcp->cur != rcp->completed && !rcp->gp_expedited )
+    {
+        rcp->gp_expedited = true;
+        cpumask_raise_softirq(&rcp->cpumask, RCU_SOFTIRQ);
+    }
+    spin_unlock(&rcp->lock);
+}
+
+static void rcu_expedite_end(struct rcu_ctrlblk *rcp)
+{
+    atomic_dec(&rcp->expedite);
+}
+
 int rcu_barrier(void)
 {
     atomic_t cpu_count = ATOMIC_INIT(0);
-    return stop_machine_run(rcu_barrier_action, &cpu_count, NR_CPUS);
+    int rc;
+
+    rcu_expedite_begin(&rcu_ctrlblk);
+    rc = stop_machine_run(rcu_barrier_action, &cpu_count, NR_CPUS);
+    rcu_expedite_end(&rcu_ctrlblk);
+
+    return rc;
 }
 
 /* Is batch a before batch b ? */
@@ -261,6 +372,97 @@ static void rcu_do_batch(struct rcu_data *rdp)
         raise_softirq(RCU_SOFTIRQ);
 }
 
+/* Next online CPU after @cpu not offloading its callbacks, if any. */
+static unsigned int rcu_housekeeping_cpu(unsigned int cpu)
+{
+    unsigned int i;
+
+    for ( i = 0; i < nr_cpu_ids; i++ )
+    {
+        cpu = cpumask_cycle(cpu, &cpu_online_map);
+        if ( !cpumask_test_cpu(cpu, &rcu_offload_mask) )
+            return cpu;
+    }
+
+    return nr_cpu_ids;
+}
+
+/*
+ * Hand the completed callbacks over to a housekeeping CPU.  Returns false if
+ * there is none, for them to be invoked locally instead.
+ */
+static bool rcu_offload_batch(struct rcu_data *rdp)
+{
+    struct rcu_head *head;
+    unsigned int cpu;
+    bool kick;
+    long count = 0;
+
+    spin_lock(&rcu_offload.lock);
+
+    cpu = rcu_housekeeping_cpu(rcu_offload.cpu);
+    if ( cpu >= nr_cpu_ids )
+    {
+        spin_unlock(&rcu_offload.lock);
+        return false;
+    }
+
+    for ( head = rdp->donelist; head; head = head->next )
+        count++;
+
+    kick = !rcu_offload.list;
+    *rcu_offload.tail = rdp->donelist;
+    rcu_offload.tail = rdp->donetail;
+    rcu_offload.qlen += count;
+    if ( kick )
+        rcu_offload.cpu = cpu;
+
+    spin_unlock(&rcu_offload.lock);
+
+    rdp->donelist = NULL;
+    rdp->donetail = &rdp->donelist;
+    rdp->qlen -= count;
+    if (rdp->blimit == INT_MAX && rdp->qlen <= qlowmark)
+        rdp->blimit = blimit;
+
+    perfc_add(rcu_offload_cbs, count);
+
+    /* The tasklet reschedules itself while the list isn't empty. */
+    if ( kick )
+        tasklet_schedule_on_cpu(&rcu_offload.tasklet, cpu);
+
+    return true;
+}
+
+/* Invoke offloaded callbacks, in batches of (at most) qhimark. */
+static void rcu_offload_action(unsigned long unused)
+{
+    struct rcu_head *list, *head, **tail;
+    long count = 0;
+
+    spin_lock(&rcu_offload.lock);
+
+    list = rcu_offload.list;
+    for ( tail = &rcu_offload.list; *tail && count < qhimark; count++ )
+        tail = &(*tail)->next;
+    rcu_offload.list = *tail;
+    if ( !rcu_offload.list )
+        rcu_offload.tail = &rcu_offload.list;
+    *tail = NULL;
+    rcu_offload.qlen -= count;
+
+    spin_unlock(&rcu_offload.lock);
+
+    while ( (head = list) != NULL )
+    {
+        list = head->next;
+        head->func(head);
+    }
+
+    if ( ACCESS_ONCE(rcu_offload.list) )
+        tasklet_schedule(&rcu_offload.tasklet);
+}
+
 /*
  * Grace period handling:
  * The grace period handling consists out of two steps:
@@ -306,9 +508,28 @@ static void rcu_start_batch(struct rcu_ctrlblk *rcp)
         */
         smp_mb();
         cpumask_andnot(&rcp->cpumask, &cpu_online_map, &rcp->idle_cpumask);
+
+        rcp->gp_start = NOW();
+        rcp->gp_expedited = rcu_expedited(rcp);
+        if ( rcp->gp_expedited )
+        {
+            perfc_incr(rcu_expedited_gp);
+            cpumask_raise_softirq(&rcp->cpumask, RCU_SOFTIRQ);
+        }
     }
 }
 
+static void rcu_gp_account(struct rcu_ctrlblk *rcp)
+{
+    struct rcu_gp_stats *stats = &rcu_gp_stats[rcp->gp_expedited];
+    s_time_t delta = NOW() - rcp->gp_start;
+
+    stats->count++;
+    stats->total += delta;
+    if ( delta > stats->max )
+        stats->max = delta;
+}
+
 /*
  * cpu went through a quiescent state since the beginning of the grace period.
  * Clear it from the cpu mask and complete the grace period if it was the last
@@ -319,6 +540,7 @@ static void cpu_quiet(int cpu, struct rcu_ctrlblk *rcp)
     cpumask_clear_cpu(cpu, &rcp->cpumask);
     if (cpumask_empty(&rcp->cpumask)) {
         /* batch completed ! */
+        rcu_gp_account(rcp);
         rcp->completed = rcp->cur;
         rcu_start_batch(rcp);
     }
@@ -336,7 +558,14 @@ static void rcu_check_quiescent_state(struct rcu_ctrlblk *rcp,
         /* start new grace period: */
         rdp->qs_pending = 1;
         rdp->quiescbatch = rcp->cur;
-        return;
+
+        /*
+         * We are in a quiescent state right now, unless called from within
+         * a read-side critical section through process_pending_softirqs().
+         * Report it without waiting for the next invocation, if expediting.
+         */
+        if (!rcp->gp_expedited || preempt_count())
+            return;
     }
 
     /* Grace period already completed for this cpu?
@@ -403,7 +632,7 @@ static void __rcu_process_callbacks(struct rcu_ctrlblk *rcp,
         local_irq_enable();
     }
     rcu_check_quiescent_state(rcp, rdp);
-    if (rdp->donelist)
+    if (rdp->donelist && !(rdp->offload && rcu_offload_batch(rdp)))
         rcu_do_batch(rdp);
 }
 
@@ -563,6 +792,7 @@ static void rcu_init_percpu_data(int cpu, struct rcu_ctrlblk *rcp,
     rdp->qs_pending = 0;
     rdp->cpu = cpu;
     rdp->blimit = blimit;
+    rdp->offload = cpumask_test_cpu(cpu, &rcu_offload_mask);
     init_timer(&rdp->idle_timer, rcu_idle_timer_handler, rdp, cpu);
 }
 
@@ -592,6 +822,49 @@ static struct notifier_block cpu_nfb = {
     .notifier_call = cpu_callback
 };
 
+static void dump_gp_stats(const char *name, const struct rcu_gp_stats *stats)
+{
+    printk("  %-9s grace periods: %lu, avg %"PRI_stime"us, max %"PRI_stime
+           "us\n", name, stats->count,
+           stats->count ? stats->total / stats->count / MICROSECS(1) : 0,
+           stats->max / MICROSECS(1));
+}
+
+static void rcu_dump_state(unsigned char key)
+{
+    struct rcu_ctrlblk *rcp = &rcu_ctrlblk;
+    struct rcu_gp_stats stats[ARRAY_SIZE(rcu_gp_stats)];
+    unsigned int cpu;
+    long cur, completed, offloaded;
+
+    spin_lock(&rcp->lock);
+    cur = rcp->cur;
+    completed = rcp->completed;
+    memcpy(stats, rcu_gp_stats, sizeof(stats));
+    printk("RCU: batch %ld, completed %ld, waiting for CPUs {%*pbl}\n",
+           cur, completed, CPUMASK_PR(&rcp->cpumask));
+    spin_unlock(&rcp->lock);
+
+    dump_gp_stats("normal", &stats[0]);
+    dump_gp_stats("expedited", &stats[1]);
+
+    spin_lock(&rcu_offload.lock);
+    offloaded = rcu_offload.qlen;
+    spin_unlock(&rcu_offload.lock);
+
+    if ( !cpumask_empty(&rcu_offload_mask) )
+        printk("  offloading CPUs {%*pbl}, %ld callbacks queued\n",
+               CPUMASK_PR(&rcu_offload_mask), offloaded);
+
+    for_each_online_cpu ( cpu )
+    {
+        const struct rcu_data *rdp = &per_cpu(rcu_data, cpu);
+
+        if ( rdp->qlen )
+            printk("  CPU%u: %ld callbacks queued\n", cpu, rdp->qlen);
+    }
+}
+
 void __init rcu_init(void)
 {
     void *cpu = (void *)(long)smp_processor_id();
@@ -611,9 +884,11 @@ void __init rcu_init(void)
     idle_timer_period = MILLISECS(idle_timer_period_ms);
 
     cpumask_clear(&rcu_ctrlblk.idle_cpumask);
+    softirq_tasklet_init(&rcu_offload.tasklet, rcu_offload_action, 0);
     cpu_callback(&cpu_nfb, CPU_UP_PREPARE, cpu);
     register_cpu_notifier(&cpu_nfb);
     open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
+    register_keyhandler('U', rcu_dump_state, "dump RCU state", 1);
 }
 
 /*
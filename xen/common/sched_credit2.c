@@ -20,6 +20,7 @@
 #include <xen/perfc.h>
 #include <xen/sched-if.h>
 #include <xen/softirq.h>
+#include <xen/guest_access.h>
 #include <asm/div64.h>
 #include <xen/errno.h>
 #include <xen/trace.h>
@@ -388,6 +389,19 @@ static int __read_mostly opt_underload_balance_tolerance = 0;
 integer_param("credit2_balance_under", opt_underload_balance_tolerance);
 static int __read_mostly opt_overload_balance_tolerance = -3;
 integer_param("credit2_balance_over", opt_overload_balance_tolerance);
+
+/*
+ * Load balancing is tried at most once every balance interval, per runqueue.
+ * The interval is adaptive: it is reset to the minimum each time balancing
+ * moves something, and it doubles (up to the maximum) each time it does not.
+ * Furthermore, only up to opt_balance_candidates units of each runqueue are
+ * considered in a balancing attempt, so that its cost does not grow with
+ * the number of units in the runqueues.
+ */
+#define CSCHED2_BALANCE_INTERVAL_MIN MILLISECS(1)
+#define CSCHED2_BALANCE_INTERVAL_MAX MILLISECS(32)
+static unsigned int __read_mostly opt_balance_candidates = 32;
+integer_param("credit2_balance_candidates", opt_balance_candidates);
 /*
  * Domains subject to a cap receive a replenishment of their runtime budget
  * once every opt_cap_period interval. Default is 10 ms. The amount of budget
@@ -482,6 +496,17 @@ struct csched2_runqueue_data {
     struct list_head svc;      /* List of all units assigned to the runqueue */
     unsigned int max_weight;   /* Max weight of the units in this runqueue   */
     unsigned int pick_bias;    /* Last picked pcpu. Start from it next time  */
+
+    s_time_t next_balance;     /* Don't try balancing before this time       */
+    s_time_t balance_interval; /* Current (adaptive) balancing interval      */
+    struct {
+        unsigned long checks;  /* Calls to balance_load()                    */
+        unsigned long skipped; /* Calls before the balance interval expired  */
+        unsigned long attempts;/* Calls finding a big enough load imbalance  */
+        unsigned long candidates; /* Units considered for migration          */
+        unsigned long pushes;  /* Units pushed to another runqueue           */
+        unsigned long pulls;   /* Units pulled from another runqueue         */
+    } balance_stats;
 };
 
 /*
@@ -811,9 +836,12 @@ static void activate_runqueue(struct csched2_private *prv, int rqi)
 
     rqd->max_weight = 1;
     rqd->id = rqi;
+    rqd->next_balance = 0;
+    rqd->balance_interval = CSCHED2_BALANCE_INTERVAL_MIN;
+    memset(&rqd->balance_stats, 0, sizeof(rqd->balance_stats));
     INIT_LIST_HEAD(&rqd->svc);
     INIT_LIST_HEAD(&rqd->runq);
-    spin_lock_init(&rqd->lock);
+    spin_lock_init_queued(&rqd->lock);
 
     __cpumask_set_cpu(rqi, &prv->active_queues);
 }
@@ -2553,12 +2581,30 @@ static bool unit_is_migrateable(struct csched2_unit *svc,
            cpumask_intersects(cpumask_scratch_cpu(cpu), &rqd->active);
 }
 
+/*
+ * Adapt the balancing interval of a runqueue to the outcome of the last
+ * balancing attempt: balance often while there are things to move, back
+ * off while there aren't.
+ */
+static void balance_interval_update(struct csched2_runqueue_data *rqd,
+                                    bool migrated, s_time_t now)
+{
+    if ( migrated )
+        rqd->balance_interval = CSCHED2_BALANCE_INTERVAL_MIN;
+    else
+        rqd->balance_interval = min(rqd->balance_interval * 2,
+                                    CSCHED2_BALANCE_INTERVAL_MAX);
+
+    rqd->next_balance = now + rqd->balance_interval;
+}
+
 static void balance_load(const struct scheduler *ops, int cpu, s_time_t now)
 {
     struct csched2_private *prv = csched2_priv(ops);
     int i, max_delta_rqi;
-    struct list_head *push_iter, *pull_iter;
-    bool inner_load_updated = 0;
+    struct list_head *push_iter, *pull_iter, *push_last = NULL;
+    unsigned int nr_push = 0, nr_pull;
+    bool inner_load_updated = 0, migrated = false;
 
     balance_state_t st = { .best_push_svc = NULL, .best_pull_svc = NULL };
 
@@ -2572,6 +2618,13 @@ static void balance_load(const struct scheduler *ops, int cpu, s_time_t now)
     ASSERT(spin_is_locked(get_sched_res(cpu)->schedule_lock));
     st.lrqd = c2rqd(ops, cpu);
 
+    st.lrqd->balance_stats.checks++;
+    if ( now < st.lrqd->next_balance )
+    {
+        st.lrqd->balance_stats.skipped++;
+        return;
+    }
+
     update_runq_load(ops, st.lrqd, 0, now);
 
 retry:
@@ -2683,9 +2736,10 @@ retry:
     }
 
     SCHED_STAT_CRANK(acct_load_balance);
+    st.lrqd->balance_stats.attempts++;
 
     /* Look for "swap" which gives the best load average
-     * FIXME: O(n^2)! */
+     * FIXME: O(n^2)! (but n is bounded by opt_balance_candidates) */
 
     /* Reuse load delta (as we're trying to minimize it) */
     list_for_each( push_iter, &st.lrqd->svc )
@@ -2697,6 +2751,11 @@ retry:
         if ( !unit_is_migrateable(push_svc, st.orqd) )
             continue;
 
+        if ( nr_push++ == opt_balance_candidates )
+            break;
+        push_last = push_iter;
+
+        nr_pull = 0;
         list_for_each( pull_iter, &st.orqd->svc )
         {
             struct csched2_unit * pull_svc = list_entry(pull_iter, struct csched2_unit, rqd_elem);
@@ -2707,6 +2766,9 @@ retry:
             if ( !unit_is_migrateable(pull_svc, st.lrqd) )
                 continue;
 
+            if ( nr_pull++ == opt_balance_candidates )
+                break;
+
             consider(&st, push_svc, pull_svc);
         }
 
@@ -2716,6 +2778,7 @@ retry:
         consider(&st, push_svc, NULL);
     }
 
+    nr_pull = 0;
     list_for_each( pull_iter, &st.orqd->svc )
     {
         struct csched2_unit * pull_svc = list_entry(pull_iter, struct csched2_unit, rqd_elem);
@@ -2723,20 +2786,41 @@ retry:
         if ( !unit_is_migrateable(pull_svc, st.lrqd) )
             continue;
 
+        if ( nr_pull++ == opt_balance_candidates )
+            break;
+
         /* Consider pull only */
         consider(&st, NULL, pull_svc);
     }
 
+    st.lrqd->balance_stats.candidates += min(nr_push, opt_balance_candidates) +
+                                         min(nr_pull, opt_balance_candidates);
+
+    /*
+     * If we did not look at all our units, rotate the list, so that the
+     * next attempt starts from the ones we have not considered this time.
+     */
+    if ( nr_push > opt_balance_candidates )
+        list_move(&st.lrqd->svc, push_last);
+
     /* OK, now we have some candidates; do the moving */
     if ( st.best_push_svc )
+    {
         migrate(ops, st.best_push_svc, st.orqd, now);
+        st.lrqd->balance_stats.pushes++;
+        migrated = true;
+    }
     if ( st.best_pull_svc )
+    {
         migrate(ops, st.best_pull_svc, st.lrqd, now);
+        st.lrqd->balance_stats.pulls++;
+        migrated = true;
+    }
 
  out_up:
     spin_unlock(&st.orqd->lock);
  out:
-    return;
+    balance_interval_update(st.lrqd, migrated, now);
 }
 
 static void
@@ -3018,6 +3102,63 @@ csched2_aff_cntl(const struct scheduler *ops, struct sched_unit *unit,
         __clear_bit(__CSFLAG_pinned, &svc->flags);
 }
 
+static int csched2_get_stats(struct csched2_private *prv,
+                             struct xen_sysctl_credit2_stats *stats)
+{
+    struct xen_sysctl_credit2_runqueue_stats rs;
+    unsigned int i, n = 0;
+    unsigned long flags;
+
+    for_each_cpu ( i, &prv->active_queues )
+    {
+        struct csched2_runqueue_data *rqd = prv->rqd + i;
+
+        /* Just count the runqueues, if there's no buffer. */
+        if ( guest_handle_is_null(stats->runqueues) )
+        {
+            n++;
+            continue;
+        }
+
+        if ( n >= stats->nr_runqueues )
+            break;
+
+        read_lock_irqsave(&prv->lock, flags);
+        spin_lock(&rqd->lock);
+
+        if ( rqd->id < 0 )
+        {
+            spin_unlock(&rqd->lock);
+            read_unlock_irqrestore(&prv->lock, flags);
+            continue;
+        }
+
+        rs.id = rqd->id;
+        rs.nr_cpus = rqd->nr_cpus;
+        rs.avgload = rqd->avgload;
+        rs.b_avgload = rqd->b_avgload;
+        rs.balance_interval = rqd->balance_interval;
+        rs.balance_checks = rqd->balance_stats.checks;
+        rs.balance_skipped = rqd->balance_stats.skipped;
+        rs.balance_attempts = rqd->balance_stats.attempts;
+        rs.candidates = rqd->balance_stats.candidates;
+        rs.migrations_push = rqd->balance_stats.pushes;
+        rs.migrations_pull = rqd->balance_stats.pulls;
+
+        spin_unlock(&rqd->lock);
+        read_unlock_irqrestore(&prv->lock, flags);
+
+        if ( copy_to_guest_offset(stats->runqueues, n, &rs, 1) )
+            return -EFAULT;
+        n++;
+    }
+
+    stats->nr_runqueues = n;
+    stats->load_precision_shift = prv->load_precision_shift;
+
+    return 0;
+}
+
 static int csched2_sys_cntl(const struct scheduler *ops,
                             struct xen_sysctl_scheduler_op *sc)
 {
@@ -3045,6 +3186,9 @@ static int csched2_sys_cntl(const struct scheduler *ops,
     case XEN_SYSCTL_SCHEDOP_getinfo:
         params->ratelimit_us = prv->ratelimit_us;
         break;
+
+    case XEN_SYSCTL_SCHEDOP_getstats:
+        return csched2_get_stats(prv, &sc->u.sched_credit2_stats);
     }
 
     return 0;
@@ -3718,6 +3862,16 @@ csched2_dump(const struct scheduler *ops)
                CPUMASK_PR(&prv->rqd[i].idle),
                CPUMASK_PR(&prv->rqd[i].tickled),
                CPUMASK_PR(&prv->rqd[i].smt_idle));
+
+        printk("\tbalance: interval=%"PRI_stime"us checks=%lu skipped=%lu"
+               " attempts=%lu candidates=%lu pushes=%lu pulls=%lu\n",
+               prv->rqd[i].balance_interval / MICROSECS(1),
+               prv->rqd[i].balance_stats.checks,
+               prv->rqd[i].balance_stats.skipped,
+               prv->rqd[i].balance_stats.attempts,
+               prv->rqd[i].balance_stats.candidates,
+               prv->rqd[i].balance_stats.pushes,
+               prv->rqd[i].balance_stats.pulls);
     }
 
     printk("Domain info:\n");
@@ -4001,6 +4155,13 @@ csched2_global_init(void)
         opt_load_window_shift = LOADAVG_WINDOW_SHIFT;
     }
 
+    if ( opt_balance_candidates == 0 )
+    {
+        printk("WARNING: %s: opt_balance_candidates can't be 0, resetting\n",
+               __func__);
+        opt_balance_candidates = 32;
+    }
+
     if ( CSCHED2_BDGT_REPL_PERIOD < CSCHED2_MIN_TIMER )
     {
         printk("WARNING: %s: opt_cap_period %u too small, resetting\n",
@@ -4023,12 +4184,14 @@ csched2_init(struct scheduler *ops)
            XENLOG_INFO " load_window_shift: %d\n"
            XENLOG_INFO " underload_balance_tolerance: %d\n"
            XENLOG_INFO " overload_balance_tolerance: %d\n"
+           XENLOG_INFO " balance_candidates: %u\n"
            XENLOG_INFO " runqueues arrangement: %s\n"
            XENLOG_INFO " cap enforcement granularity: %dms\n",
            opt_load_precision_shift,
            opt_load_window_shift,
            opt_underload_balance_tolerance,
            opt_overload_balance_tolerance,
+           opt_balance_candidates,
            opt_runqueue_str[opt_runqueue],
            opt_cap_period);
 
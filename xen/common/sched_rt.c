@@ -669,7 +669,7 @@ rt_init(struct scheduler *ops)
     if ( prv == NULL )
         goto err;
 
-    spin_lock_init(&prv->lock);
+    spin_lock_init_queued(&prv->lock);
     INIT_LIST_HEAD(&prv->sdom);
     INIT_LIST_HEAD(&prv->runq);
     INIT_LIST_HEAD(&prv->depletedq);
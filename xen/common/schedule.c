@@ -61,6 +61,13 @@ boolean_param("sched_smt_power_savings", sched_smt_power_savings);
 int sched_ratelimit_us = SCHED_DEFAULT_RATELIMIT_US;
 integer_param("sched_ratelimit_us", sched_ratelimit_us);
 
+/*
+ * Wake up vcpus on a remote cpu via a lock-free per-cpu list, instead of
+ * taking the (remote) scheduler lock of the vcpu's unit.
+ */
+static bool __read_mostly opt_sched_wake_list;
+boolean_param("sched-wake-list", opt_sched_wake_list);
+
 /* Number of vcpus per struct sched_unit. */
 bool __read_mostly sched_disable_smt_switching;
 cpumask_t sched_res_mask;
@@ -85,6 +92,24 @@ DEFINE_PER_CPU(cpumask_t, cpumask_scratch);
 /* How many urgent vcpus. */
 DEFINE_PER_CPU(atomic_t, sched_urgent_count);
 
+/* Vcpus to be woken up by this cpu, linked via vcpu->wake_next. */
+static DEFINE_PER_CPU(struct vcpu *, sched_wake_list);
+
+/*
+ * Cost of the synchronized context switch with sched-gran > 1: time spent by
+ * each cpu waiting for its siblings before taking the scheduling decision
+ * (rendezvous in) and before leaving context_switch() (rendezvous out).
+ * Only updated by the local cpu, so no locking is needed.
+ */
+struct sched_rdv_stats {
+    unsigned long cnt;
+    s_time_t      in_time;
+    s_time_t      in_max;
+    s_time_t      out_time;
+    s_time_t      out_max;
+};
+static DEFINE_PER_CPU(struct sched_rdv_stats, sched_rdv_stats);
+
 extern const struct scheduler *__start_schedulers_array[], *__end_schedulers_array[];
 #define NUM_SCHEDULERS (__end_schedulers_array - __start_schedulers_array)
 #define schedulers __start_schedulers_array
@@ -257,6 +282,72 @@ static inline void vcpu_urgent_count_update(struct vcpu *v)
     }
 }
 
+/*
+ * Per-vcpu scheduling latency statistics, updated at each runstate change
+ * (with the schedule lock held) and returned by XEN_SYSCTL_sched_latency.
+ */
+struct sched_vcpu_latency {
+    xen_sysctl_sched_lat_hist_t lat[XEN_SYSCTL_SCHED_LAT_NR];
+    uint64_t steal[XEN_SYSCTL_SCHED_STEAL_NR];
+    /* Runnable because of a wakeup (as opposed to a preemption)? */
+    bool woken;
+    /* Offline because down (i.e. not accounted as steal time)? */
+    bool down;
+};
+
+/* Cause of the time spent in the current runstate being stolen, or -1. */
+static int sched_latency_steal_cause(const struct vcpu *v)
+{
+    const struct sched_vcpu_latency *lat = v->sched_latency;
+
+    switch ( v->runstate.state )
+    {
+    case RUNSTATE_runnable:
+        return lat->woken ? XEN_SYSCTL_SCHED_STEAL_wake
+                          : XEN_SYSCTL_SCHED_STEAL_preempt;
+
+    case RUNSTATE_offline:
+        if ( !lat->down )
+            return XEN_SYSCTL_SCHED_STEAL_offline;
+        break;
+    }
+
+    return -1;
+}
+
+static void sched_latency_sample(xen_sysctl_sched_lat_hist_t *hist,
+                                 s_time_t t)
+{
+    unsigned int b = fls64(t >> 10);
+
+    hist->bucket[min(b, XEN_SYSCTL_SCHED_LAT_BUCKETS - 1U)]++;
+    hist->count++;
+    hist->total += t;
+    if ( t > hist->max )
+        hist->max = t;
+}
+
+static void sched_latency_account(struct vcpu *v, int new_state,
+                                  s_time_t delta)
+{
+    struct sched_vcpu_latency *lat = v->sched_latency;
+    int cause = sched_latency_steal_cause(v);
+
+    if ( cause >= 0 )
+        lat->steal[cause] += delta;
+
+    if ( v->runstate.state == RUNSTATE_runnable &&
+         new_state == RUNSTATE_running )
+        sched_latency_sample(&lat->lat[lat->woken ? XEN_SYSCTL_SCHED_LAT_wake
+                                                  : XEN_SYSCTL_SCHED_LAT_preempt],
+                             delta);
+
+    if ( new_state == RUNSTATE_runnable )
+        lat->woken = v->runstate.state != RUNSTATE_running;
+    else if ( new_state == RUNSTATE_offline )
+        lat->down = test_bit(_VPF_down, &v->pause_flags);
+}
+
 static inline void vcpu_runstate_change(
     struct vcpu *v, int new_state, s_time_t new_entry_time)
 {
@@ -278,6 +369,10 @@ static inline void vcpu_runstate_change(
     }
 
     delta = new_entry_time - v->runstate.state_entry_time;
+
+    if ( v->sched_latency )
+        sched_latency_account(v, new_state, max(delta, (s_time_t)0));
+
     if ( delta > 0 )
     {
         v->runstate.time[v->runstate.state] += delta;
@@ -320,6 +415,63 @@ void vcpu_runstate_get(struct vcpu *v, struct vcpu_runstate_info *runstate)
     rcu_read_unlock(&sched_res_rculock);
 }
 
+int sched_latency_get(struct xen_sysctl_sched_latency *op)
+{
+    struct domain *d;
+    struct vcpu *v;
+    unsigned int nr = 0;
+    int ret;
+
+    if ( op->pad )
+        return -EINVAL;
+
+    d = rcu_lock_domain_by_id(op->domid);
+    if ( d == NULL )
+        return -ESRCH;
+
+    ret = xsm_getdomaininfo(XSM_HOOK, d);
+    if ( ret )
+        goto out;
+
+    for_each_vcpu ( d, v )
+    {
+        struct xen_sysctl_sched_vcpu_latency info = { .vcpu = v->vcpu_id };
+        spinlock_t *lock;
+        s_time_t delta;
+        int cause;
+
+        if ( nr++ >= op->nr_vcpus )
+            continue;
+
+        rcu_read_lock(&sched_res_rculock);
+        lock = unit_schedule_lock_irq(v->sched_unit);
+
+        memcpy(info.lat, v->sched_latency->lat, sizeof(info.lat));
+        memcpy(info.steal, v->sched_latency->steal, sizeof(info.steal));
+        /* Account for the time stolen so far in the current runstate. */
+        cause = sched_latency_steal_cause(v);
+        delta = NOW() - v->runstate.state_entry_time;
+        if ( cause >= 0 && delta > 0 )
+            info.steal[cause] += delta;
+
+        unit_schedule_unlock_irq(lock, v->sched_unit);
+        rcu_read_unlock(&sched_res_rculock);
+
+        if ( copy_to_guest_offset(op->vcpus, nr - 1, &info, 1) )
+        {
+            ret = -EFAULT;
+            goto out;
+        }
+    }
+
+    op->nr_vcpus = nr;
+
+ out:
+    rcu_unlock_domain(d);
+
+    return ret;
+}
+
 uint64_t get_cpu_idle_time(unsigned int cpu)
 {
     struct vcpu_runstate_info state = { 0 };
@@ -525,8 +677,15 @@ int sched_init_vcpu(struct vcpu *v)
     struct sched_unit *unit;
     unsigned int processor;
 
+    if ( !is_idle_domain(d) &&
+         (v->sched_latency = xzalloc(struct sched_vcpu_latency)) == NULL )
+        return 1;
+
     if ( (unit = sched_alloc_unit(v)) == NULL )
+    {
+        XFREE(v->sched_latency);
         return 1;
+    }
 
     if ( is_idle_domain(d) )
         processor = v->vcpu_id;
@@ -556,6 +715,7 @@ int sched_init_vcpu(struct vcpu *v)
     {
         sched_free_unit(unit, v);
         rcu_read_unlock(&sched_res_rculock);
+        XFREE(v->sched_latency);
         return 1;
     }
 
@@ -601,6 +761,21 @@ static void sched_move_irqs(const struct sched_unit *unit)
         vcpu_move_irqs(v);
 }
 
+/*
+ * Moving a domain to another cpupool is done in stages, in order to keep
+ * the time its vcpus can't run short:
+ * - all new scheduler data is allocated and the timers are moved to cpus of
+ *   the new cpupool while the domain keeps running,
+ * - all vcpus are paused, with the sleep requests being issued for all of
+ *   them before waiting for any to be descheduled,
+ * - the units are switched to the new scheduler, and the vcpus are unpaused
+ *   only once all of them have been switched: a running vcpu could otherwise
+ *   call into the new scheduler for a sibling still having the old
+ *   scheduler's private data (e.g. via VCPUOP_down/VCPUOP_up),
+ * - the old scheduler data is freed after all vcpus are running again.
+ * The time from pausing the first vcpu to unpausing the last one is recorded
+ * in the target cpupool.
+ */
 int sched_move_domain(struct domain *d, struct cpupool *c)
 {
     struct vcpu *v;
@@ -608,10 +783,10 @@ int sched_move_domain(struct domain *d, struct cpupool *c)
     unsigned int new_p, unit_idx;
     void **unit_priv;
     void *domdata;
-    void *unitdata;
     struct scheduler *old_ops;
     void *old_domdata;
     unsigned int gran = cpupool_get_granularity(c);
+    s_time_t pause_start, pause_time;
     int ret = 0;
 
     for_each_vcpu ( d, v )
@@ -653,7 +828,22 @@ int sched_move_domain(struct domain *d, struct cpupool *c)
         unit_idx++;
     }
 
-    domain_pause(d);
+    /* Timers can fire anywhere, move them before pausing anything. */
+    new_p = cpumask_first(c->cpu_valid);
+    for_each_vcpu ( d, v )
+    {
+        migrate_timer(&v->periodic_timer, new_p);
+        migrate_timer(&v->singleshot_timer, new_p);
+        migrate_timer(&v->poll_timer, new_p);
+        new_p = cpumask_cycle(new_p, c->cpu_valid);
+    }
+
+    pause_start = NOW();
+
+    for_each_vcpu ( d, v )
+        vcpu_pause_nosync(v);
+    for_each_vcpu ( d, v )
+        vcpu_sleep_sync(v);
 
     old_ops = dom_scheduler(d);
     old_domdata = d->sched_priv;
@@ -672,16 +862,10 @@ int sched_move_domain(struct domain *d, struct cpupool *c)
     {
         spinlock_t *lock;
         unsigned int unit_p = new_p;
-
-        unitdata = unit->priv;
+        void *unitdata = unit->priv;
 
         for_each_sched_unit_vcpu ( unit, v )
-        {
-            migrate_timer(&v->periodic_timer, new_p);
-            migrate_timer(&v->singleshot_timer, new_p);
-            migrate_timer(&v->poll_timer, new_p);
             new_p = cpumask_cycle(new_p, c->cpu_valid);
-        }
 
         lock = unit_schedule_lock_irq(unit);
 
@@ -701,19 +885,30 @@ int sched_move_domain(struct domain *d, struct cpupool *c)
 
         sched_insert_unit(c->sched, unit);
 
-        sched_free_udata(old_ops, unitdata);
+        /* Keep the old data for freeing it once all vcpus are running. */
+        unit_priv[unit_idx] = unitdata;
 
         unit_idx++;
     }
 
+    for_each_vcpu ( d, v )
+        vcpu_unpause(v);
+
+    pause_time = NOW() - pause_start;
+
     domain_update_node_affinity(d);
 
-    domain_unpause(d);
+    while ( unit_idx-- )
+        sched_free_udata(old_ops, unit_priv[unit_idx]);
 
     sched_free_domdata(old_ops, old_domdata);
 
     xfree(unit_priv);
 
+    c->n_moves++;
+    c->move_pause_last = pause_time;
+    c->move_pause_max = max(c->move_pause_max, pause_time);
+
 out:
     rcu_read_unlock(&sched_res_rculock);
 
@@ -729,6 +924,7 @@ void sched_destroy_vcpu(struct vcpu *v)
     kill_timer(&v->poll_timer);
     if ( test_and_clear_bool(v->is_urgent) )
         atomic_dec(&per_cpu(sched_urgent_count, v->processor));
+    XFREE(v->sched_latency);
     /*
      * Vcpus are being destroyed top-down. So being the first vcpu of an unit
      * is the same as being the only one.
@@ -844,16 +1040,16 @@ void vcpu_sleep_sync(struct vcpu *v)
     sync_vcpu_execstate(v);
 }
 
-void vcpu_wake(struct vcpu *v)
+static void sched_vcpu_wake(struct vcpu *v)
 {
     unsigned long flags;
     spinlock_t *lock;
-    struct sched_unit *unit = v->sched_unit;
-
-    TRACE_2D(TRC_SCHED_WAKE, v->domain->domain_id, v->vcpu_id);
+    struct sched_unit *unit;
 
     rcu_read_lock(&sched_res_rculock);
 
+    unit = v->sched_unit;
+
     lock = unit_schedule_lock_irqsave(unit, &flags);
 
     if ( likely(vcpu_runnable(v)) )
@@ -883,6 +1079,93 @@ void vcpu_wake(struct vcpu *v)
     rcu_read_unlock(&sched_res_rculock);
 }
 
+/*
+ * Queue a wakeup of v on the wake list of the cpu v is assigned to, instead
+ * of taking the scheduler lock of v's unit, which normally is the lock of a
+ * remote runqueue. The target cpu will process its wake list when running
+ * schedule(), with the remote lock being its own one then.
+ * A vcpu is put on a list only once: further wakeups while it is on the list
+ * are merged, as the wakeup is performed based on the state of the vcpu at
+ * the time the list is processed.
+ * The list holds a reference to the domain of each vcpu on it, which is
+ * making sure the vcpu can't go away before the wakeup has been done.
+ * Returns false if the wakeup has to be done directly by the caller.
+ */
+static bool sched_wake_queue(struct vcpu *v)
+{
+    unsigned int cpu = read_atomic(&v->processor);
+    struct vcpu **list, *old, *prev;
+
+    if ( !opt_sched_wake_list || cpu == smp_processor_id() ||
+         !cpu_online(cpu) )
+        return false;
+
+    if ( test_and_set_bool(v->wake_pending) )
+    {
+        perfc_incr(sched_wake_coalesced);
+        return true;
+    }
+
+    if ( !get_domain(v->domain) )
+    {
+        v->wake_pending = false;
+        return false;
+    }
+
+    list = &per_cpu(sched_wake_list, cpu);
+    old = ACCESS_ONCE(*list);
+    do {
+        prev = old;
+        v->wake_next = prev;
+    } while ( (old = cmpxchg(list, prev, v)) != prev );
+
+    perfc_incr(sched_wake_queued);
+
+    /* If the list was empty the target cpu might not look at it soon. */
+    if ( !prev )
+        cpu_raise_softirq(cpu, SCHEDULE_SOFTIRQ);
+
+    return true;
+}
+
+/*
+ * Process the wake list of a cpu. Normally called by the cpu owning the list,
+ * but any cpu can do it (e.g. when the owner went offline).
+ */
+static void sched_wake_list_drain(unsigned int cpu)
+{
+    struct vcpu *v, *next;
+
+    if ( !ACCESS_ONCE(per_cpu(sched_wake_list, cpu)) )
+        return;
+
+    for ( v = xchg(&per_cpu(sched_wake_list, cpu), NULL); v; v = next )
+    {
+        struct domain *d = v->domain;
+
+        next = v->wake_next;
+
+        /*
+         * Clear the pending flag before looking at the vcpu state, so any
+         * wakeup racing with us will be queued again instead of being lost.
+         */
+        v->wake_pending = false;
+        smp_mb();
+
+        sched_vcpu_wake(v);
+        perfc_incr(sched_wake_drained);
+
+        put_domain(d);
+    }
+}
+
+void vcpu_wake(struct vcpu *v)
+{
+    TRACE_2D(TRC_SCHED_WAKE, v->domain->domain_id, v->vcpu_id);
+
+    sched_vcpu_wake(v);
+}
+
 void vcpu_unblock(struct vcpu *v)
 {
     if ( !test_and_clear_bit(_VPF_blocked, &v->pause_flags) )
@@ -901,7 +1184,14 @@ void vcpu_unblock(struct vcpu *v)
             clear_bit(_VPF_blocked, &v->pause_flags);
     }
 
-    vcpu_wake(v);
+    /*
+     * Only wakeups of blocked vcpus (mostly event delivery) are queued, other
+     * callers of vcpu_wake() (e.g. unpausing) keep doing the wakeup directly.
+     */
+    TRACE_2D(TRC_SCHED_WAKE, v->domain->domain_id, v->vcpu_id);
+
+    if ( !sched_wake_queue(v) )
+        sched_vcpu_wake(v);
 }
 
 /*
@@ -1835,7 +2125,8 @@ long sched_adjust_global(struct xen_sysctl_scheduler_op *op)
         return rc;
 
     if ( (op->cmd != XEN_SYSCTL_SCHEDOP_putinfo) &&
-         (op->cmd != XEN_SYSCTL_SCHEDOP_getinfo) )
+         (op->cmd != XEN_SYSCTL_SCHEDOP_getinfo) &&
+         (op->cmd != XEN_SYSCTL_SCHEDOP_getstats) )
         return -EINVAL;
 
     pool = cpupool_get_by_id(op->cpupool_id);
@@ -2087,8 +2378,18 @@ void sched_context_switched(struct vcpu *vprev, struct vcpu *vnext)
             atomic_set(&next->rendezvous_out_cnt, 0);
         }
         else
+        {
+            struct sched_rdv_stats *stats = &this_cpu(sched_rdv_stats);
+            s_time_t start = NOW(), delta;
+
             while ( atomic_read(&next->rendezvous_out_cnt) )
                 cpu_relax();
+
+            delta = NOW() - start;
+            stats->out_time += delta;
+            if ( delta > stats->out_max )
+                stats->out_max = delta;
+        }
     }
     else
     {
@@ -2203,6 +2504,17 @@ static struct vcpu *sched_force_context_switch(struct vcpu *vprev,
     return v;
 }
 
+static void sched_rdv_account_in(s_time_t now)
+{
+    struct sched_rdv_stats *stats = &this_cpu(sched_rdv_stats);
+    s_time_t delta = NOW() - now;
+
+    stats->cnt++;
+    stats->in_time += delta;
+    if ( delta > stats->in_max )
+        stats->in_max = delta;
+}
+
 /*
  * Rendezvous before taking a scheduling decision.
  * Called with schedule lock held, so all accesses to the rendezvous counter
@@ -2223,6 +2535,8 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
 
     if ( !--prev->rendezvous_in_cnt )
     {
+        sched_rdv_account_in(now);
+
         next = do_schedule(prev, now, cpu);
         atomic_set(&next->rendezvous_out_cnt, gran + 1);
         return next;
@@ -2288,6 +2602,8 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
         }
     }
 
+    sched_rdv_account_in(now);
+
     return prev->next_task;
 }
 
@@ -2369,6 +2685,8 @@ static void schedule(void)
 
     SCHED_STAT_CRANK(sched_run);
 
+    sched_wake_list_drain(cpu);
+
     rcu_read_lock(&sched_res_rculock);
 
     sr = get_sched_res(cpu);
@@ -2477,7 +2795,7 @@ static int cpu_schedule_up(unsigned int cpu)
     set_sched_res(cpu, sr);
 
     sr->scheduler = &sched_idle_ops;
-    spin_lock_init(&sr->_lock);
+    spin_lock_init_queued(&sr->_lock);
     sr->schedule_lock = &sched_free_cpu_lock;
     init_timer(&sr->s_timer, s_timer_fn, NULL, cpu);
     atomic_set(&per_cpu(sched_urgent_count, cpu), 0);
@@ -2598,6 +2916,8 @@ static int cpu_schedule_callback(
         rcu_read_unlock(&domlist_read_lock);
         break;
     case CPU_DEAD:
+        /* Perform the wakeups the dead cpu was not able to do any longer. */
+        sched_wake_list_drain(cpu);
         if ( system_state == SYS_STATE_suspend )
             break;
         sched_rm_cpu(cpu);
@@ -3043,6 +3363,39 @@ void scheduler_free(struct scheduler *sched)
     xfree(sched);
 }
 
+static void sched_dump_rendezvous(const cpumask_t *cpus)
+{
+    unsigned int cpu, sibling;
+
+    printk("Rendezvous info (times in ns):\n");
+    for_each_cpu ( cpu, cpus )
+    {
+        const struct sched_resource *sr = get_sched_res(cpu);
+        struct sched_rdv_stats sum = { };
+
+        if ( sr->master_cpu != cpu || sr->granularity == 1 )
+            continue;
+
+        for_each_cpu ( sibling, sr->cpus )
+        {
+            const struct sched_rdv_stats *stats =
+                &per_cpu(sched_rdv_stats, sibling);
+
+            sum.cnt += stats->cnt;
+            sum.in_time += stats->in_time;
+            sum.in_max = max(sum.in_max, stats->in_max);
+            sum.out_time += stats->out_time;
+            sum.out_max = max(sum.out_max, stats->out_max);
+        }
+
+        printk("  resource %u (cpus=%*pbl): count=%lu in: avg=%"PRI_stime
+               " max=%"PRI_stime" out: avg=%"PRI_stime" max=%"PRI_stime"\n",
+               cpu, CPUMASK_PR(sr->cpus), sum.cnt,
+               sum.cnt ? sum.in_time / sum.cnt : 0, sum.in_max,
+               sum.cnt ? sum.out_time / sum.cnt : 0, sum.out_max);
+    }
+}
+
 void schedule_dump(struct cpupool *c)
 {
     unsigned int      i;
@@ -3073,6 +3426,9 @@ void schedule_dump(struct cpupool *c)
             sched_dump_cpu_state(sched, i);
     }
 
+    if ( c != NULL && cpupool_get_granularity(c) > 1 )
+        sched_dump_rendezvous(cpus);
+
     rcu_read_unlock(&sched_res_rculock);
 }
 
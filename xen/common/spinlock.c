@@ -1,10 +1,17 @@
 #include <xen/lib.h>
+#include <xen/cpu.h>
+#include <xen/init.h>
 #include <xen/irq.h>
+#include <xen/mm.h>
+#include <xen/numa.h>
 #include <xen/smp.h>
+#include <xen/symbols.h>
 #include <xen/time.h>
 #include <xen/spinlock.h>
 #include <xen/guest_access.h>
+#include <xen/percpu.h>
 #include <xen/preempt.h>
+#include <xen/xmalloc.h>
 #include <public/sysctl.h>
 #include <asm/processor.h>
 #include <asm/atomic.h>
@@ -138,6 +145,253 @@ void spin_debug_disable(void)
 
 #endif
 
+#ifdef CONFIG_LOCK_SAMPLE
+
+/*
+ * Sampling lock contention profiler.
+ *
+ * While enabled, every lock_sample_period-th spin_lock() on each CPU is
+ * sampled: the time it waited for the lock and the time the lock was then
+ * held are accounted to the lock, in a hash table keyed by its address,
+ * together with the call site of its longest hold.  Holds of at least
+ * lock_sample_threshold are also logged, in a ring of the most recent ones.
+ *
+ * While disabled, the cost is a check of lock_sample_active when acquiring
+ * and releasing locks.  Only spin_lock() and its variants are sampled, not
+ * trylocks or barriers.
+ */
+#define LOCK_SAMPLE_LOCKS   512
+#define LOCK_SAMPLE_PROBES  16
+#define LOCK_SAMPLE_RING    64
+#define LOCK_SAMPLE_DEPTH   4               /* Sampled locks held per CPU */
+
+static bool __read_mostly lock_sample_active;
+static unsigned int __read_mostly lock_sample_period;
+static unsigned int __read_mostly lock_sample_gen;
+static s_time_t __read_mostly lock_sample_threshold = MICROSECS(100);
+
+static unsigned int __initdata opt_lock_sample;
+integer_param("lock-sample", opt_lock_sample);
+static unsigned int __initdata opt_lock_sample_threshold = 100;
+integer_param("lock-sample-threshold", opt_lock_sample_threshold);
+
+struct lock_sample_lock {
+    unsigned long addr;
+    unsigned long hold_max_site;
+    unsigned long wait_max, hold_max;
+    uint64_t sampled, contended;
+    uint64_t wait_total, hold_total;
+    uint32_t wait_hist[XEN_SYSCTL_LOCKSAMPLE_BUCKETS];
+};
+
+struct lock_sample_hold {
+    const spinlock_t *lock;
+    const void *site;
+    unsigned long wait, hold;
+    s_time_t when;
+    unsigned int cpu;
+};
+
+static struct lock_sample_lock *__read_mostly lock_sample_locks;
+static struct lock_sample_hold *__read_mostly lock_sample_ring;
+static unsigned int lock_sample_ring_next;
+
+struct lock_sample {
+    const spinlock_t *lock;
+    const void *site;
+    s_time_t acquired;
+    unsigned long wait;
+    bool contended;
+};
+
+struct lock_sample_cpu {
+    unsigned int countdown;
+    unsigned int gen;
+    unsigned int nr;
+    struct lock_sample held[LOCK_SAMPLE_DEPTH];
+};
+
+static DEFINE_PER_CPU(struct lock_sample_cpu, lock_sample_cpu);
+
+/*
+ * The helpers are kept out of line, as they are only called while sampling
+ * is active, to not bloat the lock and unlock paths.
+ */
+
+/* Whether to sample the acquisition about to be made. */
+static bool noinline lock_sample_begin(void)
+{
+    struct lock_sample_cpu *c = &this_cpu(lock_sample_cpu);
+    unsigned int gen = ACCESS_ONCE(lock_sample_gen);
+
+    if ( unlikely(c->gen != gen) )
+    {
+        /* (Re-)enabled: forget about locks sampled before. */
+        c->gen = gen;
+        c->nr = 0;
+        c->countdown = 0;
+    }
+
+    if ( c->countdown )
+    {
+        c->countdown--;
+        return false;
+    }
+
+    c->countdown = lock_sample_period - 1;
+
+    return true;
+}
+
+static void noinline lock_sample_got(const spinlock_t *lock,
+                                     const void *site, s_time_t start,
+                                     bool contended)
+{
+    struct lock_sample_cpu *c = &this_cpu(lock_sample_cpu);
+    s_time_t now = NOW();
+    unsigned long flags;
+
+    /* Locks may be taken in IRQ context, too. */
+    local_irq_save(flags);
+    if ( c->nr < LOCK_SAMPLE_DEPTH )
+    {
+        struct lock_sample *ls = &c->held[c->nr++];
+
+        ls->lock = lock;
+        ls->site = site;
+        ls->acquired = now;
+        ls->wait = now - start;
+        ls->contended = contended;
+    }
+    local_irq_restore(flags);
+}
+
+/* Take @lock off the sampled locks held, if it is one. */
+static bool noinline lock_sample_put(const spinlock_t *lock,
+                                     struct lock_sample *ls)
+{
+    struct lock_sample_cpu *c = &this_cpu(lock_sample_cpu);
+    unsigned long flags;
+    unsigned int i;
+    bool found = false;
+
+    if ( !c->nr || c->gen != ACCESS_ONCE(lock_sample_gen) )
+        return false;
+
+    local_irq_save(flags);
+    for ( i = c->nr; i--; )
+        if ( c->held[i].lock == lock )
+        {
+            *ls = c->held[i];
+            c->held[i] = c->held[--c->nr];
+            found = true;
+            break;
+        }
+    local_irq_restore(flags);
+
+    if ( found )
+        ls->acquired = NOW() - ls->acquired;
+
+    return found;
+}
+
+static struct lock_sample_lock *lock_sample_lookup(unsigned long addr)
+{
+    unsigned int i, h = (addr >> 3) ^ (addr >> 12);
+
+    for ( i = 0; i < LOCK_SAMPLE_PROBES; i++ )
+    {
+        struct lock_sample_lock *l =
+            &lock_sample_locks[(h + i) & (LOCK_SAMPLE_LOCKS - 1)];
+        unsigned long cur = ACCESS_ONCE(l->addr);
+
+        if ( !cur )
+            cur = cmpxchg(&l->addr, 0UL, addr) ?: addr;
+        if ( cur == addr )
+            return l;
+    }
+
+    return NULL;
+}
+
+static bool lock_sample_max(unsigned long *max, unsigned long val)
+{
+    unsigned long old = ACCESS_ONCE(*max), prev;
+
+    while ( val > old )
+    {
+        if ( (prev = cmpxchg(max, old, val)) == old )
+            return true;
+        old = prev;
+    }
+
+    return false;
+}
+
+/* Account a sampled hold, after the lock was released. */
+static void noinline lock_sample_account(const struct lock_sample *ls)
+{
+    struct lock_sample_lock *l = lock_sample_lookup((unsigned long)ls->lock);
+    unsigned long hold = ls->acquired;
+    unsigned int b = 0;
+
+    if ( l )
+    {
+        while ( b < XEN_SYSCTL_LOCKSAMPLE_BUCKETS - 1 &&
+                ls->wait >= (128UL << b) )
+            b++;
+
+        arch_fetch_and_add(&l->sampled, 1);
+        if ( ls->contended )
+            arch_fetch_and_add(&l->contended, 1);
+        (void)arch_fetch_and_add(&l->wait_hist[b], 1);
+        arch_fetch_and_add(&l->wait_total, ls->wait);
+        arch_fetch_and_add(&l->hold_total, hold);
+        lock_sample_max(&l->wait_max, ls->wait);
+        if ( lock_sample_max(&l->hold_max, hold) )
+            write_atomic(&l->hold_max_site, (unsigned long)ls->site);
+    }
+
+    if ( hold >= lock_sample_threshold )
+    {
+        struct lock_sample_hold *h = &lock_sample_ring[
+            arch_fetch_and_add(&lock_sample_ring_next, 1) % LOCK_SAMPLE_RING];
+
+        h->lock = ls->lock;
+        h->site = ls->site;
+        h->wait = ls->wait;
+        h->hold = hold;
+        h->when = NOW();
+        h->cpu = smp_processor_id();
+    }
+}
+
+#define LOCK_SAMPLE_VAR                                                      \
+    bool sampled = unlikely(lock_sample_active) && lock_sample_begin();      \
+    s_time_t sample_start = sampled ? NOW() : 0;                             \
+    bool contended = false
+#define LOCK_SAMPLE_BLOCK   contended = true
+#define LOCK_SAMPLE_GOT                                                      \
+    if ( sampled )                                                           \
+        lock_sample_got(lock, site, sample_start, contended)
+#define LOCK_SAMPLE_REL_VAR                                                  \
+    struct lock_sample ls;                                                   \
+    bool sampled = unlikely(lock_sample_active) && lock_sample_put(lock, &ls)
+#define LOCK_SAMPLE_REL                                                      \
+    if ( sampled )                                                           \
+        lock_sample_account(&ls)
+
+#else
+
+/* Still a declaration, as LOCK_PROFILE_VAR may follow it. */
+#define LOCK_SAMPLE_VAR     bool __maybe_unused sampled
+#define LOCK_SAMPLE_BLOCK
+#define LOCK_SAMPLE_GOT
+#define LOCK_SAMPLE_REL_VAR
+#define LOCK_SAMPLE_REL
+
+#endif
+
 static always_inline spinlock_tickets_t observe_lock(spinlock_tickets_t *t)
 {
     spinlock_tickets_t v;
@@ -153,37 +407,278 @@ static always_inline u16 observe_head(spinlock_tickets_t *t)
     return read_atomic(&t->head);
 }
 
-void inline _spin_lock_cb(spinlock_t *lock, void (*cb)(void *), void *data)
+#ifdef CONFIG_QUEUED_SPINLOCKS
+
+/*
+ * Queued (MCS) locks.
+ *
+ * The lock's word holds a locked byte, a count of releases (for
+ * spin_barrier()) and the tail of the queue of waiters, i.e. the CPU and the
+ * nesting level of the last waiter's queue node.  A CPU finding the lock taken
+ * appends its node to the queue and spins on the node, which only its
+ * predecessor writes to.  At the head of the queue, it spins on the lock's
+ * word until the holder releases the lock, takes it and passes the head of
+ * the queue on to its successor.  Only one waiter thus polls the lock's cache
+ * line, and the queue nodes are allocated on their CPU's NUMA node for the
+ * others to spin locally.  Waiters also get the lock in FIFO order, like with
+ * ticket locks.
+ *
+ * There are several nodes per CPU, as locks may be taken from IRQ (or NMI)
+ * context while already waiting for one.  Should they run out, or not be
+ * allocated yet, waiters spin on the lock's word instead.
+ */
+#define SPIN_QNODES         4
+#define SPIN_QIDX_BITS      2
+
+struct spin_qnode {
+    struct spin_qnode *next;
+    bool locked;                            /* Now at the head of the queue */
+    unsigned int count;                     /* Nodes in use, in node 0 only */
+} __cacheline_aligned;
+
+/*
+ * Allocated when a CPU first comes up, and never freed.  Not per-CPU data,
+ * which may be freed and set up afresh across CPUs going offline.
+ */
+static struct spin_qnode *__read_mostly spin_qnodes[NR_CPUS];
+
+#define spin_queued(l) ((l)->mode.queued)
+
+static always_inline u16 qtail_encode(unsigned int cpu, unsigned int idx)
 {
-    spinlock_tickets_t tickets = SPINLOCK_TICKET_INC;
-    LOCK_PROFILE_VAR;
+    return ((cpu + 1) << SPIN_QIDX_BITS) | idx;
+}
 
-    check_lock(&lock->debug);
-    tickets.head_tail = arch_fetch_and_add(&lock->tickets.head_tail,
-                                           tickets.head_tail);
-    while ( tickets.tail != observe_head(&lock->tickets) )
+static always_inline struct spin_qnode *qtail_node(u16 tail)
+{
+    return &spin_qnodes[(tail >> SPIN_QIDX_BITS) - 1]
+        [tail & ((1u << SPIN_QIDX_BITS) - 1)];
+}
+
+static always_inline bool queued_trylock(spinlock_tickets_t *t)
+{
+    spinlock_tickets_t old = observe_lock(t), new = old;
+
+    /* Don't jump the queue. */
+    if ( old.locked || old.qtail )
+        return false;
+
+    new.locked = 1;
+
+    return cmpxchg(&t->head_tail, old.head_tail,
+                   new.head_tail) == old.head_tail;
+}
+
+static void noinline queued_lock_slow(spinlock_t *lock,
+                                      void (*cb)(void *), void *data)
+{
+    spinlock_tickets_t *t = &lock->tickets, old, new;
+    struct spin_qnode *nodes = spin_qnodes[smp_processor_id()], *node, *next;
+    unsigned int idx;
+    u16 tail;
+
+    if ( unlikely(!nodes) || unlikely(nodes->count >= SPIN_QNODES) )
+    {
+        while ( !queued_trylock(t) )
+        {
+            if ( unlikely(cb) )
+                cb(data);
+            arch_lock_relax();
+        }
+        return;
+    }
+
+    idx = nodes->count++;
+    barrier();
+    node = &nodes[idx];
+    node->next = NULL;
+    node->locked = false;
+    tail = qtail_encode(smp_processor_id(), idx);
+
+    /* Join the queue, unless the lock got released meanwhile. */
+    for ( ; ; )
+    {
+        old = observe_lock(t);
+        new = old;
+        if ( !old.locked && !old.qtail )
+            new.locked = 1;
+        else
+            new.qtail = tail;
+        if ( cmpxchg(&t->head_tail, old.head_tail,
+                     new.head_tail) == old.head_tail )
+            break;
+    }
+
+    if ( new.qtail != tail )
+        goto out;
+
+    if ( old.qtail )
+    {
+        ACCESS_ONCE(qtail_node(old.qtail)->next) = node;
+        while ( !read_atomic(&node->locked) )
+        {
+            if ( unlikely(cb) )
+                cb(data);
+            arch_lock_relax();
+        }
+    }
+
+    /* At the head of the queue: wait for the holder to release the lock. */
+    for ( ; ; )
     {
-        LOCK_PROFILE_BLOCK;
+        old = observe_lock(t);
+        if ( !old.locked )
+        {
+            new = old;
+            new.locked = 1;
+            /* Empty the queue if we're the only one in it. */
+            if ( old.qtail == tail )
+                new.qtail = 0;
+            if ( cmpxchg(&t->head_tail, old.head_tail,
+                         new.head_tail) == old.head_tail )
+                break;
+            continue;
+        }
         if ( unlikely(cb) )
             cb(data);
         arch_lock_relax();
     }
+
+    if ( new.qtail )
+    {
+        /* Our successor may not have linked itself to our node yet. */
+        while ( !(next = ACCESS_ONCE(node->next)) )
+            cpu_relax();
+        write_atomic(&next->locked, true);
+        arch_lock_signal();
+    }
+
+ out:
+    barrier();
+    nodes->count--;
+}
+
+static always_inline void queued_unlock(spinlock_tickets_t *t)
+{
+    /* Only the holder writes these, others cmpxchg() the whole word. */
+    write_atomic(&t->released, t->released + 1);
+    write_atomic(&t->locked, 0);
+}
+
+/* Whether the holder of a lock at the time of @sample still holds it. */
+static always_inline bool queued_held(spinlock_tickets_t *t,
+                                      spinlock_tickets_t sample)
+{
+    spinlock_tickets_t v = observe_lock(t);
+
+    return v.locked && v.released == sample.released;
+}
+
+static int cpu_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+    nodeid_t node = cpu_to_node(cpu);
+    struct spin_qnode *nodes;
+
+    BUILD_BUG_ON(SPIN_QNODES > (1u << SPIN_QIDX_BITS));
+    BUILD_BUG_ON(SPIN_QNODES * sizeof(*nodes) > PAGE_SIZE);
+    BUILD_BUG_ON((NR_CPUS << SPIN_QIDX_BITS) > 0xffff);
+
+    /* If nodes can't be allocated, the CPU spins on locks' words instead. */
+    if ( action == CPU_UP_PREPARE && !spin_qnodes[cpu] )
+    {
+        nodes = alloc_xenheap_pages(0, node != NUMA_NO_NODE ? MEMF_node(node)
+                                                            : 0);
+        if ( nodes )
+        {
+            clear_page(nodes);
+            spin_qnodes[cpu] = nodes;
+        }
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block cpu_nfb = {
+    .notifier_call = cpu_callback
+};
+
+static int __init spin_qnodes_init(void)
+{
+    void *cpu = (void *)(long)smp_processor_id();
+
+    cpu_callback(&cpu_nfb, CPU_UP_PREPARE, cpu);
+    register_cpu_notifier(&cpu_nfb);
+
+    return 0;
+}
+presmp_initcall(spin_qnodes_init);
+
+#else /* !CONFIG_QUEUED_SPINLOCKS */
+
+#define spin_queued(l)              false
+#define queued_trylock(t)           false
+#define queued_lock_slow(l, c, d)   ((void)0)
+#define queued_unlock(t)            ((void)0)
+#define queued_held(t, s)           false
+
+#endif
+
+/* @site is the caller of the spin_lock() variant, for lock sampling. */
+static always_inline void spin_lock_common(spinlock_t *lock,
+                                           void (*cb)(void *), void *data,
+                                           const void *site)
+{
+    spinlock_tickets_t tickets = SPINLOCK_TICKET_INC;
+    LOCK_SAMPLE_VAR;
+    LOCK_PROFILE_VAR;
+
+    check_lock(&lock->debug);
+    if ( spin_queued(lock) )
+    {
+        if ( unlikely(!queued_trylock(&lock->tickets)) )
+        {
+            LOCK_PROFILE_BLOCK;
+            LOCK_SAMPLE_BLOCK;
+            queued_lock_slow(lock, cb, data);
+        }
+    }
+    else
+    {
+        tickets.head_tail = arch_fetch_and_add(&lock->tickets.head_tail,
+                                               tickets.head_tail);
+        while ( tickets.tail != observe_head(&lock->tickets) )
+        {
+            LOCK_PROFILE_BLOCK;
+            LOCK_SAMPLE_BLOCK;
+            if ( unlikely(cb) )
+                cb(data);
+            arch_lock_relax();
+        }
+    }
     got_lock(&lock->debug);
     LOCK_PROFILE_GOT;
+    LOCK_SAMPLE_GOT;
     preempt_disable();
     arch_lock_acquire_barrier();
 }
 
+void _spin_lock_cb(spinlock_t *lock, void (*cb)(void *), void *data)
+{
+    spin_lock_common(lock, cb, data, __builtin_return_address(0));
+}
+
 void _spin_lock(spinlock_t *lock)
 {
-     _spin_lock_cb(lock, NULL, NULL);
+    spin_lock_common(lock, NULL, NULL, __builtin_return_address(0));
 }
 
 void _spin_lock_irq(spinlock_t *lock)
 {
     ASSERT(local_irq_is_enabled());
     local_irq_disable();
-    _spin_lock(lock);
+    spin_lock_common(lock, NULL, NULL, __builtin_return_address(0));
 }
 
 unsigned long _spin_lock_irqsave(spinlock_t *lock)
@@ -191,18 +686,24 @@ unsigned long _spin_lock_irqsave(spinlock_t *lock)
     unsigned long flags;
 
     local_irq_save(flags);
-    _spin_lock(lock);
+    spin_lock_common(lock, NULL, NULL, __builtin_return_address(0));
     return flags;
 }
 
 void _spin_unlock(spinlock_t *lock)
 {
+    LOCK_SAMPLE_REL_VAR;
+
     arch_lock_release_barrier();
     preempt_enable();
     LOCK_PROFILE_REL;
     rel_lock(&lock->debug);
-    add_sized(&lock->tickets.head, 1);
+    if ( spin_queued(lock) )
+        queued_unlock(&lock->tickets);
+    else
+        add_sized(&lock->tickets.head, 1);
     arch_lock_signal();
+    LOCK_SAMPLE_REL;
 }
 
 void _spin_unlock_irq(spinlock_t *lock)
@@ -226,9 +727,11 @@ int _spin_is_locked(spinlock_t *lock)
      * "false" here, making this function suitable only for use in
      * ASSERT()s and alike.
      */
-    return lock->recurse_cpu == SPINLOCK_NO_CPU
-           ? lock->tickets.head != lock->tickets.tail
-           : lock->recurse_cpu == smp_processor_id();
+    if ( lock->recurse_cpu != SPINLOCK_NO_CPU )
+        return lock->recurse_cpu == smp_processor_id();
+
+    return spin_queued(lock) ? lock->tickets.locked
+                             : lock->tickets.head != lock->tickets.tail;
 }
 
 int _spin_trylock(spinlock_t *lock)
@@ -236,14 +739,22 @@ int _spin_trylock(spinlock_t *lock)
     spinlock_tickets_t old, new;
 
     check_lock(&lock->debug);
-    old = observe_lock(&lock->tickets);
-    if ( old.head != old.tail )
-        return 0;
-    new = old;
-    new.tail++;
-    if ( cmpxchg(&lock->tickets.head_tail,
-                 old.head_tail, new.head_tail) != old.head_tail )
-        return 0;
+    if ( spin_queued(lock) )
+    {
+        if ( !queued_trylock(&lock->tickets) )
+            return 0;
+    }
+    else
+    {
+        old = observe_lock(&lock->tickets);
+        if ( old.head != old.tail )
+            return 0;
+        new = old;
+        new.tail++;
+        if ( cmpxchg(&lock->tickets.head_tail,
+                     old.head_tail, new.head_tail) != old.head_tail )
+            return 0;
+    }
     got_lock(&lock->debug);
 #ifdef CONFIG_DEBUG_LOCK_PROFILE
     if (lock->profile)
@@ -267,9 +778,10 @@ void _spin_barrier(spinlock_t *lock)
     check_barrier(&lock->debug);
     smp_mb();
     sample = observe_lock(&lock->tickets);
-    if ( sample.head != sample.tail )
+    if ( spin_queued(lock) ? sample.locked : sample.head != sample.tail )
     {
-        while ( observe_head(&lock->tickets) == sample.head )
+        while ( spin_queued(lock) ? queued_held(&lock->tickets, sample)
+                                  : observe_head(&lock->tickets) == sample.head )
             arch_lock_relax();
 #ifdef CONFIG_DEBUG_LOCK_PROFILE
         if ( lock->profile )
@@ -312,7 +824,7 @@ void _spin_lock_recursive(spinlock_t *lock)
 
     if ( likely(lock->recurse_cpu != cpu) )
     {
-        _spin_lock(lock);
+        spin_lock_common(lock, NULL, NULL, __builtin_return_address(0));
         lock->recurse_cpu = cpu;
     }
 
@@ -516,3 +1028,177 @@ static int __init lock_prof_init(void)
 __initcall(lock_prof_init);
 
 #endif /* CONFIG_DEBUG_LOCK_PROFILE */
+
+#ifdef CONFIG_LOCK_SAMPLE
+
+static int lock_sample_enable(unsigned int period, s_time_t threshold)
+{
+    if ( !period )
+    {
+        write_atomic(&lock_sample_active, false);
+        return 0;
+    }
+
+    if ( !lock_sample_locks )
+    {
+        struct lock_sample_lock *locks =
+            xzalloc_array(struct lock_sample_lock, LOCK_SAMPLE_LOCKS);
+        struct lock_sample_hold *ring =
+            xzalloc_array(struct lock_sample_hold, LOCK_SAMPLE_RING);
+
+        if ( !locks || !ring )
+        {
+            xfree(locks);
+            xfree(ring);
+            return -ENOMEM;
+        }
+
+        lock_sample_ring = ring;
+        smp_wmb();
+        lock_sample_locks = locks;
+    }
+
+    lock_sample_period = period;
+    lock_sample_threshold = threshold;
+    /* Have CPUs forget about locks sampled with earlier settings. */
+    write_atomic(&lock_sample_gen, lock_sample_gen + 1);
+    smp_wmb();
+    write_atomic(&lock_sample_active, true);
+
+    return 0;
+}
+
+static int lock_sample_copy_locks(struct xen_sysctl_locksample_op *op)
+{
+    unsigned int i, b, n = 0;
+
+    for ( i = 0; lock_sample_locks && i < LOCK_SAMPLE_LOCKS; i++ )
+    {
+        struct lock_sample_lock *l = &lock_sample_locks[i];
+        struct xen_sysctl_locksample_lock info = {};
+        char namebuf[KSYM_NAME_LEN + 1];
+        unsigned long size, offset;
+        const char *name;
+
+        if ( !(info.addr = read_atomic(&l->addr)) )
+            continue;
+
+        if ( n < op->max_elem )
+        {
+            info.hold_max_site = read_atomic(&l->hold_max_site);
+            name = symbols_lookup(info.hold_max_site, &size, &offset, namebuf);
+            if ( name )
+                snprintf(info.hold_max_site_name,
+                         sizeof(info.hold_max_site_name), "%s+%#lx",
+                         name, offset);
+            info.sampled = read_atomic(&l->sampled);
+            info.contended = read_atomic(&l->contended);
+            info.wait_total = read_atomic(&l->wait_total);
+            info.wait_max = read_atomic(&l->wait_max);
+            info.hold_total = read_atomic(&l->hold_total);
+            info.hold_max = read_atomic(&l->hold_max);
+            for ( b = 0; b < XEN_SYSCTL_LOCKSAMPLE_BUCKETS; b++ )
+                info.wait_hist[b] = read_atomic(&l->wait_hist[b]);
+
+            if ( copy_to_guest_offset(op->locks, n, &info, 1) )
+                return -EFAULT;
+        }
+        n++;
+    }
+
+    op->nr_elem = n;
+
+    return 0;
+}
+
+static int lock_sample_copy_holds(struct xen_sysctl_locksample_op *op)
+{
+    unsigned int i, n = 0, next = read_atomic(&lock_sample_ring_next);
+
+    next = min_t(unsigned int, next, LOCK_SAMPLE_RING);
+
+    for ( i = 0; lock_sample_ring && i < next; i++ )
+    {
+        const struct lock_sample_hold *h = &lock_sample_ring[i];
+        struct xen_sysctl_locksample_hold info = {
+            .lock = (unsigned long)h->lock,
+            .site = (unsigned long)h->site,
+            .wait = h->wait,
+            .hold = h->hold,
+            .when = h->when,
+            .cpu = h->cpu,
+        };
+        char namebuf[KSYM_NAME_LEN + 1];
+        unsigned long size, offset;
+        const char *name;
+
+        if ( n < op->max_elem )
+        {
+            name = symbols_lookup(info.site, &size, &offset, namebuf);
+            if ( name )
+                snprintf(info.site_name, sizeof(info.site_name), "%s+%#lx",
+                         name, offset);
+
+            if ( copy_to_guest_offset(op->holds, n, &info, 1) )
+                return -EFAULT;
+        }
+        n++;
+    }
+
+    op->nr_elem = n;
+
+    return 0;
+}
+
+/* Dom0 control of lock sampling */
+int lock_sample_control(struct xen_sysctl_locksample_op *op)
+{
+    int rc = 0;
+
+    switch ( op->cmd )
+    {
+    case XEN_SYSCTL_LOCKSAMPLE_enable:
+        rc = lock_sample_enable(op->period, op->threshold);
+        break;
+
+    case XEN_SYSCTL_LOCKSAMPLE_reset:
+        /* Holds being accounted meanwhile may end up in cleared slots. */
+        if ( lock_sample_locks )
+        {
+            memset(lock_sample_locks, 0,
+                   LOCK_SAMPLE_LOCKS * sizeof(*lock_sample_locks));
+            write_atomic(&lock_sample_ring_next, 0);
+        }
+        break;
+
+    case XEN_SYSCTL_LOCKSAMPLE_locks:
+        rc = lock_sample_copy_locks(op);
+        break;
+
+    case XEN_SYSCTL_LOCKSAMPLE_holds:
+        rc = lock_sample_copy_holds(op);
+        break;
+
+    default:
+        rc = -EINVAL;
+        break;
+    }
+
+    op->period = lock_sample_active ? lock_sample_period : 0;
+    op->threshold = lock_sample_threshold;
+
+    return rc;
+}
+
+static int __init lock_sample_init(void)
+{
+    if ( opt_lock_sample &&
+         lock_sample_enable(opt_lock_sample,
+                            MICROSECS(opt_lock_sample_threshold)) )
+        printk(XENLOG_WARNING "Could not enable lock sampling\n");
+
+    return 0;
+}
+__initcall(lock_sample_init);
+
+#endif /* CONFIG_LOCK_SAMPLE */
@@ -123,6 +123,11 @@ long do_sysctl(XEN_GUEST_HANDLE_PARAM(xen_sysctl_t) u_sysctl)
     case XEN_SYSCTL_lockprof_op:
         ret = spinlock_profile_control(&op->u.lockprof_op);
         break;
+#endif
+#ifdef CONFIG_LOCK_SAMPLE
+    case XEN_SYSCTL_locksample_op:
+        ret = lock_sample_control(&op->u.locksample_op);
+        break;
 #endif
     case XEN_SYSCTL_debug_keys:
     {
@@ -467,6 +472,14 @@ long do_sysctl(XEN_GUEST_HANDLE_PARAM(xen_sysctl_t) u_sysctl)
             copyback = 1;
         break;
 
+    case XEN_SYSCTL_sched_latency:
+        ret = sched_latency_get(&op->u.sched_latency);
+        break;
+
+    case XEN_SYSCTL_xmalloc_op:
+        ret = xmalloc_stats_control(&op->u.xmalloc_op);
+        break;
+
     case XEN_SYSCTL_set_parameter:
     {
 #define XEN_SET_PARAMETER_MAX_SIZE 1023
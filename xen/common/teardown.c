@@ -0,0 +1,297 @@
+/******************************************************************************
+ * teardown.c
+ *
+ * Parallel freeing of a dying domain's memory.
+ *
+ * Once a domain's Xen pages have been relinquished, most of its remaining
+ * memory is typically referenced by nothing but its allocation reference.
+ * Such pages can be taken off the domain's page list in batches and handed
+ * back to the heap without any of the per-page type handling which
+ * relinquish_memory() has to do.  For large domains this work is shared by
+ * a number of worker tasklets on other CPUs of the domain's cpupool,
+ * alongside the (preemptible) destroy hypercall itself.  Pages are scrubbed
+ * by whoever frees them, so they are immediately available for the next
+ * domain, and are returned to the heap one batch per acquisition of the
+ * heap lock.
+ *
+ * Anything which can't be freed this way (pages with extra references or
+ * types, e.g. PV page tables or granted pages) is left on the page list for
+ * the serial relinquish_memory() pass which follows.
+ */
+
+#include <xen/event.h>
+#include <xen/init.h>
+#include <xen/lib.h>
+#include <xen/mm.h>
+#include <xen/perfc.h>
+#include <xen/sched.h>
+#include <xen/sched-if.h>
+#include <xen/domain.h>
+#include <xen/tasklet.h>
+#include <xen/xmalloc.h>
+#include <public/domctl.h>
+
+/* Pages taken off the page list per acquisition of page_alloc_lock. */
+#define TEARDOWN_BATCH     512
+
+/* Domains smaller than this (1GiB) aren't worth waking up other CPUs for. */
+#define TEARDOWN_MIN_PAGES (1UL << (30 - PAGE_SHIFT))
+
+static unsigned int __read_mostly opt_teardown_workers = 4;
+integer_param("teardown-workers", opt_teardown_workers);
+
+struct domain_teardown;
+
+struct teardown_worker {
+    struct tasklet tasklet;
+    struct domain_teardown *t;
+};
+
+struct domain_teardown {
+    struct domain *d;
+    unsigned long total;        /* tot_pages when teardown started */
+    unsigned long freed;        /* pages freed so far, updated atomically */
+    /* The following fields are protected by d->page_alloc_lock. */
+    unsigned long scan_left;    /* page list entries still to be looked at */
+    unsigned int active;        /* workers still running */
+    unsigned int nr_workers;
+    struct teardown_worker workers[];
+};
+
+/*
+ * Take ownership of @pg if nothing but its allocation reference is left,
+ * by dropping that reference and PGC_allocated in one go.  From then on
+ * nobody else can obtain a reference.
+ */
+static bool teardown_claim(struct page_info *pg)
+{
+    unsigned long x, y = pg->count_info;
+
+    /* A type reference is always accompanied by a general one. */
+    if ( pg->u.inuse.type_info & PGT_count_mask )
+        return false;
+
+    do {
+        x = y;
+        if ( (x & (PGC_allocated | PGC_count_mask)) != (PGC_allocated | 1) )
+            return false;
+    } while ( (y = cmpxchg(&pg->count_info, x,
+                           x & ~(PGC_allocated | PGC_count_mask))) != x );
+
+    return true;
+}
+
+/*
+ * Free up to one batch of pages from the head of the domain's page list.
+ * Returns whether there is more of the list left to look at.
+ */
+static bool teardown_batch(struct domain_teardown *t)
+{
+    struct domain *d = t->d;
+    struct page_info *pg, *tmp;
+    PAGE_LIST_HEAD(batch);
+    unsigned int i, n = 0;
+    bool drop_dom_ref = false, more;
+
+    spin_lock(&d->page_alloc_lock);
+
+    for ( i = 0; i < TEARDOWN_BATCH && t->scan_left; i++ )
+    {
+        pg = page_list_remove_head(&d->page_list);
+        if ( !pg )
+        {
+            t->scan_left = 0;
+            break;
+        }
+        t->scan_left--;
+
+        if ( teardown_claim(pg) )
+        {
+            page_list_add_tail(pg, &batch);
+            n++;
+        }
+        else
+            /* Left for relinquish_memory(), or the holder of the last ref. */
+            page_list_add_tail(pg, &d->page_list);
+    }
+
+    if ( n )
+        drop_dom_ref = !domain_adjust_tot_pages(d, -(long)n);
+
+    more = t->scan_left;
+
+    spin_unlock(&d->page_alloc_lock);
+
+    if ( !n )
+        return more;
+
+    page_list_for_each_safe ( pg, tmp, &batch )
+    {
+        if ( likely(!cleanup_page_mappings(pg)) )
+            continue;
+
+        /* As in put_page(), a page we can't clean up must not be reused. */
+        page_list_del(pg, &batch);
+        gdprintk(XENLOG_WARNING, "Leaking mfn %" PRI_mfn "\n",
+                 mfn_x(page_to_mfn(pg)));
+        n--;
+    }
+
+    free_domheap_page_list(&batch);
+
+    arch_fetch_and_add(&t->freed, n);
+    perfc_incr(teardown_batches);
+    perfc_add(teardown_pages, n);
+
+    if ( drop_dom_ref )
+        put_domain(d);
+
+    return more;
+}
+
+static void teardown_worker_fn(unsigned long data)
+{
+    struct teardown_worker *w = (void *)data;
+    struct domain_teardown *t = w->t;
+
+    /* Give the pCPU back to the scheduler between batches. */
+    if ( teardown_batch(t) )
+    {
+        tasklet_schedule_on_cpu(&w->tasklet, smp_processor_id());
+        return;
+    }
+
+    spin_lock(&t->d->page_alloc_lock);
+    t->active--;
+    spin_unlock(&t->d->page_alloc_lock);
+}
+
+static struct domain_teardown *teardown_start(struct domain *d)
+{
+    struct domain_teardown *t;
+    const cpumask_t *cpus = cpupool_domain_master_cpumask(d);
+    unsigned int i, cpu = smp_processor_id(), nr = 0;
+    bool parallel = opt_teardown_workers && !d->max_colors &&
+                    d->tot_pages >= TEARDOWN_MIN_PAGES;
+
+    if ( parallel )
+        nr = min_t(unsigned int, opt_teardown_workers,
+                   cpumask_weight(cpus) - cpumask_test_cpu(cpu, cpus));
+
+    t = xzalloc_flex_struct(struct domain_teardown, workers, nr);
+    if ( !t )
+        return NULL;
+
+    t->d = d;
+    t->nr_workers = nr;
+
+    spin_lock(&d->page_alloc_lock);
+    t->total = d->tot_pages;
+    t->scan_left = parallel ? d->tot_pages : 0;
+    t->active = nr;
+    spin_unlock(&d->page_alloc_lock);
+
+    for ( i = 0; i < nr; i++ )
+    {
+        struct teardown_worker *w = &t->workers[i];
+
+        w->t = t;
+        tasklet_init(&w->tasklet, teardown_worker_fn, (unsigned long)w);
+        cpu = cpumask_cycle(cpu, cpus);
+        tasklet_schedule_on_cpu(&w->tasklet, cpu);
+    }
+
+    /* Publish only once fully set up, for domain_teardown_progress(). */
+    smp_wmb();
+    d->teardown = t;
+
+    return t;
+}
+
+/*
+ * Called from domain_relinquish_resources() after the domain's Xen pages
+ * have been dealt with.  Returns -ERESTART while work remains.
+ */
+int domain_teardown_memory(struct domain *d)
+{
+    struct domain_teardown *t = d->teardown;
+    unsigned int active;
+
+    ASSERT(d->is_dying);
+
+    /* Without the bookkeeping, leave everything to relinquish_memory(). */
+    if ( !t && !(t = teardown_start(d)) )
+        return 0;
+
+    while ( teardown_batch(t) )
+        if ( hypercall_preempt_check() )
+            return -ERESTART;
+
+    spin_lock(&d->page_alloc_lock);
+    active = t->active;
+    spin_unlock(&d->page_alloc_lock);
+
+    /* Workers may still be freeing their last batch. */
+    return active ? -ERESTART : 0;
+}
+
+void domain_teardown_progress(struct domain *d,
+                              struct xen_domctl_teardown_progress *p)
+{
+    const struct domain_teardown *t = ACCESS_ONCE(d->teardown);
+
+    smp_rmb();
+
+    switch ( d->is_dying )
+    {
+    case DOMDYING_alive:
+        p->state = XEN_DOMCTL_TEARDOWN_none;
+        break;
+    case DOMDYING_dying:
+        p->state = XEN_DOMCTL_TEARDOWN_running;
+        break;
+    case DOMDYING_dead:
+        p->state = XEN_DOMCTL_TEARDOWN_done;
+        break;
+    }
+
+    p->remaining_pages = d->tot_pages;
+    p->total_pages = p->remaining_pages;
+    p->freed_pages = 0;
+    p->workers = 0;
+
+    if ( t )
+    {
+        p->total_pages = t->total;
+        p->freed_pages = ACCESS_ONCE(t->freed);
+
+        spin_lock(&d->page_alloc_lock);
+        p->workers = t->active;
+        spin_unlock(&d->page_alloc_lock);
+    }
+}
+
+void domain_teardown_free(struct domain *d)
+{
+    struct domain_teardown *t = d->teardown;
+    unsigned int i;
+
+    if ( !t )
+        return;
+
+    for ( i = 0; i < t->nr_workers; i++ )
+        tasklet_kill(&t->workers[i].tasklet);
+
+    d->teardown = NULL;
+    xfree(t);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -1,12 +1,18 @@
 #ifdef VMAP_VIRT_START
 #include <xen/bitmap.h>
 #include <xen/cache.h>
+#include <xen/cpu.h>
 #include <xen/init.h>
 #include <xen/mm.h>
+#include <xen/percpu.h>
+#include <xen/perfc.h>
 #include <xen/pfn.h>
+#include <xen/smp.h>
 #include <xen/spinlock.h>
+#include <xen/time.h>
 #include <xen/types.h>
 #include <xen/vmap.h>
+#include <xen/xmalloc.h>
 #include <asm/page.h>
 
 static DEFINE_SPINLOCK(vm_lock);
@@ -19,6 +25,64 @@ static unsigned int __read_mostly vm_end[VMAP_REGION_NR];
 /* lowest known clear bit in the bitmap */
 static unsigned int vm_low[VMAP_REGION_NR];
 
+/*
+ * Per-pCPU caches
+ *
+ * Single page allocations from the default region (vmap() of one frame,
+ * map_domain_page_global(), ...) make up the bulk of vm_alloc() calls.  Each
+ * pCPU keeps a small stack of such slots, which remain allocated in the
+ * bitmap while cached, and refills it a batch at a time under a single
+ * acquisition of vm_lock.
+ *
+ * vfree() unmaps lazily, as in Linux: it clears the PTEs without flushing
+ * the TLBs, and queues the range along with its pages on the local pCPU.
+ * Once enough ranges or pages are queued, one flush covers the lot, after
+ * which the ranges may be reused and the pages go back to the heap.  As the
+ * pages remain Xen's until then, stale TLB entries can't do any harm; their
+ * amount is bounded by vmap-lazy-pages, which can also turn lazy unmapping
+ * off.  vunmap() flushes right away though: the caller keeps the pages, and
+ * may free them or change their cacheability (e.g. guest pages mapped by
+ * map_domain_page_global()).
+ *
+ * A pCPU only ever touches its own cache, except to drain it when the
+ * address space runs out or the pCPU goes away.  The per-cache lock
+ * therefore is uncontended, and nests outside vm_lock.
+ */
+#define VM_CACHE_NR     32
+#define VM_CACHE_BATCH  (VM_CACHE_NR / 2)
+#define VM_LAZY_NR      64
+
+/* Pages a pCPU may leave unflushed.  Zero flushes on every vfree(). */
+static unsigned int __read_mostly opt_vmap_lazy_pages = 512;
+integer_param("vmap-lazy-pages", opt_vmap_lazy_pages);
+
+struct vm_lazy {
+    unsigned int bit, nr;
+    enum vmap_region type;
+};
+
+struct vm_cache {
+    spinlock_t lock;
+    unsigned int nr;                      /* Free slots cached. */
+    unsigned int slots[VM_CACHE_NR];
+    unsigned int lazy_nr, lazy_pages;     /* Ranges awaiting a flush. */
+    struct vm_lazy lazy[VM_LAZY_NR];
+    struct page_list_head lazy_free;      /* Their vfree()d pages. */
+};
+
+/* Allocated when a pCPU first comes up, and never freed. */
+static struct vm_cache *vm_caches[NR_CPUS];
+
+struct vm_stats {
+    unsigned long allocs;                 /* vm_alloc() calls... */
+    unsigned long cached;                 /* ... satisfied from the cache. */
+    s_time_t time, max;                   /* Time spent in vm_alloc(). */
+    unsigned long lazy;                   /* Ranges unmapped lazily... */
+    unsigned long flushes;                /* ... and flushes covering them. */
+};
+
+static DEFINE_PER_CPU(struct vm_stats, vm_stats);
+
 void __init vm_init_type(enum vmap_region type, void *start, void *end)
 {
     unsigned int i, nr;
@@ -45,50 +109,84 @@ void __init vm_init_type(enum vmap_region type, void *start, void *end)
     populate_pt_range(va, vm_low[type] - nr);
 }
 
-void *vm_alloc(unsigned int nr, unsigned int align,
-               enum vmap_region t)
+/* Find room for @nr pages in @t's bitmap, or return vm_top[t]. */
+static unsigned int vm_find(unsigned int nr, unsigned int align,
+                            enum vmap_region t)
 {
     unsigned int start, bit;
 
-    if ( !align )
-        align = 1;
-    else if ( align & (align - 1) )
-        align &= -align;
+    ASSERT(spin_is_locked(&vm_lock));
+    ASSERT(vm_low[t] == vm_top[t] || !test_bit(vm_low[t], vm_bitmap(t)));
 
-    ASSERT((t >= VMAP_DEFAULT) && (t < VMAP_REGION_NR));
-    if ( !vm_base[t] )
-        return NULL;
+    for ( start = vm_low[t]; start < vm_top[t]; )
+    {
+        bit = find_next_bit(vm_bitmap(t), vm_top[t], start + 1);
+        if ( bit > vm_top[t] )
+            bit = vm_top[t];
+        /*
+         * Note that this skips the first bit, making the
+         * corresponding page a guard one.
+         */
+        start = (start + align) & ~(align - 1);
+        if ( bit < vm_top[t] )
+        {
+            if ( start + nr < bit )
+                break;
+            start = find_next_zero_bit(vm_bitmap(t), vm_top[t], bit + 1);
+        }
+        else
+        {
+            if ( start + nr <= bit )
+                break;
+            start = bit;
+        }
+    }
+
+    return min(start, vm_top[t]);
+}
+
+static void vm_mark(unsigned int start, unsigned int nr, enum vmap_region t)
+{
+    unsigned int bit;
+
+    ASSERT(spin_is_locked(&vm_lock));
+
+    for ( bit = start; bit < start + nr; ++bit )
+        __set_bit(bit, vm_bitmap(t));
+    if ( bit < vm_top[t] )
+        ASSERT(!test_bit(bit, vm_bitmap(t)));
+    else
+        ASSERT(bit == vm_top[t]);
+    if ( start <= vm_low[t] + 2 )
+        vm_low[t] = bit;
+}
+
+static void vm_release(unsigned int bit, enum vmap_region type)
+{
+    ASSERT(spin_is_locked(&vm_lock));
+
+    if ( bit < vm_low[type] )
+    {
+        vm_low[type] = bit - 1;
+        while ( !test_bit(vm_low[type] - 1, vm_bitmap(type)) )
+            --vm_low[type];
+    }
+    while ( __test_and_clear_bit(bit, vm_bitmap(type)) )
+        if ( ++bit == vm_top[type] )
+            break;
+}
+
+static void *vm_alloc_bitmap(unsigned int nr, unsigned int align,
+                             enum vmap_region t)
+{
+    unsigned int start;
 
     spin_lock(&vm_lock);
     for ( ; ; )
     {
         struct page_info *pg;
 
-        ASSERT(vm_low[t] == vm_top[t] || !test_bit(vm_low[t], vm_bitmap(t)));
-        for ( start = vm_low[t]; start < vm_top[t]; )
-        {
-            bit = find_next_bit(vm_bitmap(t), vm_top[t], start + 1);
-            if ( bit > vm_top[t] )
-                bit = vm_top[t];
-            /*
-             * Note that this skips the first bit, making the
-             * corresponding page a guard one.
-             */
-            start = (start + align) & ~(align - 1);
-            if ( bit < vm_top[t] )
-            {
-                if ( start + nr < bit )
-                    break;
-                start = find_next_zero_bit(vm_bitmap(t), vm_top[t], bit + 1);
-            }
-            else
-            {
-                if ( start + nr <= bit )
-                    break;
-                start = bit;
-            }
-        }
-
+        start = vm_find(nr, align, t);
         if ( start < vm_top[t] )
             break;
 
@@ -126,19 +224,184 @@ void *vm_alloc(unsigned int nr, unsigned int align,
         }
     }
 
-    for ( bit = start; bit < start + nr; ++bit )
-        __set_bit(bit, vm_bitmap(t));
-    if ( bit < vm_top[t] )
-        ASSERT(!test_bit(bit, vm_bitmap(t)));
-    else
-        ASSERT(bit == vm_top[t]);
-    if ( start <= vm_low[t] + 2 )
-        vm_low[t] = bit;
+    vm_mark(start, nr, t);
     spin_unlock(&vm_lock);
 
     return vm_base[t] + start * PAGE_SIZE;
 }
 
+static void vm_free_pages(struct page_list_head *list)
+{
+    struct page_info *pg;
+
+    while ( (pg = page_list_remove_head(list)) != NULL )
+        free_domheap_page(pg);
+}
+
+/*
+ * Flush the TLBs for @c's lazily unmapped ranges, and release them.  Pages
+ * which were waiting for this are moved to @free, for the caller to free
+ * once it has dropped the lock.
+ */
+static void vm_purge(struct vm_cache *c, struct page_list_head *free)
+{
+    unsigned long start = ~0UL, end = 0;
+    unsigned int i;
+
+    ASSERT(spin_is_locked(&c->lock));
+
+    if ( !c->lazy_nr )
+        return;
+
+    for ( i = 0; i < c->lazy_nr; i++ )
+    {
+        const struct vm_lazy *l = &c->lazy[i];
+        unsigned long va = (unsigned long)vm_base[l->type] +
+                           l->bit * PAGE_SIZE;
+
+        start = min(start, va);
+        end = max(end, va + l->nr * PAGE_SIZE);
+    }
+
+    arch_vmap_flush(start, end);
+
+    this_cpu(vm_stats).flushes++;
+    perfc_incr(vmap_lazy_purge);
+    perfc_add(vmap_flush_avoided, c->lazy_nr - 1);
+
+    spin_lock(&vm_lock);
+    for ( i = 0; i < c->lazy_nr; i++ )
+    {
+        const struct vm_lazy *l = &c->lazy[i];
+
+        if ( l->nr == 1 && l->type == VMAP_DEFAULT && c->nr < VM_CACHE_NR )
+            c->slots[c->nr++] = l->bit;
+        else
+            vm_release(l->bit, l->type);
+    }
+    spin_unlock(&vm_lock);
+
+    c->lazy_nr = 0;
+    c->lazy_pages = 0;
+    page_list_splice(&c->lazy_free, free);
+    INIT_PAGE_LIST_HEAD(&c->lazy_free);
+}
+
+static unsigned int vm_drain_cpu(unsigned int cpu)
+{
+    struct vm_cache *c = vm_caches[cpu];
+    PAGE_LIST_HEAD(free);
+    unsigned int drained;
+
+    if ( !c )
+        return 0;
+
+    spin_lock(&c->lock);
+
+    drained = c->lazy_nr;
+    vm_purge(c, &free);
+
+    drained += c->nr;
+    spin_lock(&vm_lock);
+    while ( c->nr )
+        vm_release(c->slots[--c->nr], VMAP_DEFAULT);
+    spin_unlock(&vm_lock);
+
+    spin_unlock(&c->lock);
+
+    vm_free_pages(&free);
+
+    return drained;
+}
+
+static unsigned int vm_drain_all(void)
+{
+    unsigned int cpu, drained = 0;
+
+    for_each_online_cpu ( cpu )
+        drained += vm_drain_cpu(cpu);
+
+    return drained;
+}
+
+static void *vm_cache_alloc(void)
+{
+    struct vm_cache *c = vm_caches[smp_processor_id()];
+    enum vmap_region t = VMAP_DEFAULT;
+    unsigned int bit = 0;
+
+    if ( !c )
+        return NULL;
+
+    spin_lock(&c->lock);
+
+    if ( !c->nr )
+    {
+        spin_lock(&vm_lock);
+        while ( c->nr < VM_CACHE_BATCH )
+        {
+            unsigned int start = vm_find(1, 1, t);
+
+            if ( start >= vm_top[t] )
+                break;
+            vm_mark(start, 1, t);
+            c->slots[c->nr++] = start;
+        }
+        spin_unlock(&vm_lock);
+
+        perfc_incr(vmap_cache_refill);
+    }
+
+    if ( c->nr )
+        bit = c->slots[--c->nr];
+
+    spin_unlock(&c->lock);
+
+    if ( !bit )
+        return NULL;
+
+    this_cpu(vm_stats).cached++;
+    perfc_incr(vmap_cache_alloc);
+
+    return vm_base[t] + bit * PAGE_SIZE;
+}
+
+void *vm_alloc(unsigned int nr, unsigned int align,
+               enum vmap_region t)
+{
+    struct vm_stats *stats;
+    s_time_t start = NOW();
+    void *va = NULL;
+
+    if ( !align )
+        align = 1;
+    else if ( align & (align - 1) )
+        align &= -align;
+
+    ASSERT((t >= VMAP_DEFAULT) && (t < VMAP_REGION_NR));
+    if ( !vm_base[t] )
+        return NULL;
+
+    if ( nr == 1 && align == 1 && t == VMAP_DEFAULT )
+        va = vm_cache_alloc();
+
+    if ( !va )
+        va = vm_alloc_bitmap(nr, align, t);
+
+    /* Other pCPUs may be sitting on what's left of the address space. */
+    if ( !va && local_irq_is_enabled() && vm_drain_all() )
+        va = vm_alloc_bitmap(nr, align, t);
+
+    stats = &this_cpu(vm_stats);
+    stats->allocs++;
+    start = NOW() - start;
+    stats->time += start;
+    if ( start > stats->max )
+        stats->max = start;
+
+    return va;
+}
+
 static unsigned int vm_index(const void *va, enum vmap_region type)
 {
     unsigned long addr = (unsigned long)va & ~(PAGE_SIZE - 1);
@@ -169,10 +432,30 @@ static unsigned int vm_size(const void *va, enum vmap_region type)
     return min(end, vm_top[type]) - start;
 }
 
-static void vm_free(const void *va)
+static void vm_unmap_range(unsigned long addr, unsigned int pages,
+                           unsigned int flags)
+{
+#ifndef _PAGE_NONE
+    if ( !(flags & MAP_NO_FLUSH) )
+        destroy_xen_mappings(addr, addr + PAGE_SIZE * pages);
+    else /* Without _PAGE_PRESENT, this removes the mappings too. */
+        map_pages_to_xen(addr, INVALID_MFN, pages, flags);
+#else /* Avoid tearing down intermediate page tables. */
+    map_pages_to_xen(addr, INVALID_MFN, pages, _PAGE_NONE | flags);
+#endif
+}
+
+/*
+ * Unmap @va, and free the pages on @free (if any) once no TLB can refer to
+ * them anymore.  Only the unmapping of such pages is done lazily.
+ */
+static void vm_unmap(const void *va, struct page_list_head *free)
 {
     enum vmap_region type = VMAP_DEFAULT;
-    unsigned int bit = vm_index(va, type);
+    unsigned int bit = vm_index(va, type), pages;
+    struct vm_cache *c = vm_caches[smp_processor_id()];
+    struct vm_lazy *l;
+    PAGE_LIST_HEAD(done);
 
     if ( !bit )
     {
@@ -183,20 +466,48 @@ static void vm_free(const void *va)
     if ( !bit )
     {
         WARN_ON(va != NULL);
+        if ( free )
+            vm_free_pages(free);
         return;
     }
 
-    spin_lock(&vm_lock);
-    if ( bit < vm_low[type] )
+    pages = vm_size(va, type);
+
+    /* Flushing takes IPIs on x86, which can't be sent with IRQs off. */
+    if ( !free || !c || !opt_vmap_lazy_pages || !local_irq_is_enabled() )
     {
-        vm_low[type] = bit - 1;
-        while ( !test_bit(vm_low[type] - 1, vm_bitmap(type)) )
-            --vm_low[type];
+        vm_unmap_range((unsigned long)va, pages, 0);
+
+        spin_lock(&vm_lock);
+        vm_release(bit, type);
+        spin_unlock(&vm_lock);
+
+        if ( free )
+            vm_free_pages(free);
+        return;
     }
-    while ( __test_and_clear_bit(bit, vm_bitmap(type)) )
-        if ( ++bit == vm_top[type] )
-            break;
-    spin_unlock(&vm_lock);
+
+    vm_unmap_range((unsigned long)va, pages, MAP_NO_FLUSH);
+
+    spin_lock(&c->lock);
+
+    l = &c->lazy[c->lazy_nr++];
+    l->bit = bit;
+    l->nr = pages;
+    l->type = type;
+    c->lazy_pages += pages;
+    if ( free )
+        page_list_splice(free, &c->lazy_free);
+
+    if ( c->lazy_nr == VM_LAZY_NR || c->lazy_pages >= opt_vmap_lazy_pages )
+        vm_purge(c, &done);
+
+    spin_unlock(&c->lock);
+
+    this_cpu(vm_stats).lazy++;
+    perfc_incr(vmap_lazy_unmap);
+
+    vm_free_pages(&done);
 }
 
 void *__vmap(const mfn_t *mfn, unsigned int granularity,
@@ -225,18 +536,7 @@ void *vmap(const mfn_t *mfn, unsigned int nr)
 
 void vunmap(const void *va)
 {
-    unsigned long addr = (unsigned long)va;
-    unsigned int pages = vm_size(va, VMAP_DEFAULT);
-
-    if ( !pages )
-        pages = vm_size(va, VMAP_XEN);
-
-#ifndef _PAGE_NONE
-    destroy_xen_mappings(addr, addr + PAGE_SIZE * pages);
-#else /* Avoid tearing down intermediate page tables. */
-    map_pages_to_xen(addr, INVALID_MFN, pages, _PAGE_NONE);
-#endif
-    vm_free(va);
+    vm_unmap(va, NULL);
 }
 
 static void *vmalloc_type(size_t size, enum vmap_region type)
@@ -302,7 +602,6 @@ void *vzalloc(size_t size)
 void vfree(void *va)
 {
     unsigned int i, pages;
-    struct page_info *pg;
     PAGE_LIST_HEAD(pg_list);
     enum vmap_region type = VMAP_DEFAULT;
 
@@ -324,9 +623,84 @@ void vfree(void *va)
         ASSERT(page);
         page_list_add(page, &pg_list);
     }
-    vunmap(va);
 
-    while ( (pg = page_list_remove_head(&pg_list)) != NULL )
-        free_domheap_page(pg);
+    /* The pages are freed once no stale TLB entry can reach them. */
+    vm_unmap(va, &pg_list);
+}
+
+void vm_dump_info(void)
+{
+    unsigned long allocs = 0, cached = 0, lazy = 0, flushes = 0;
+    s_time_t time = 0, worst = 0;
+    unsigned int cpu;
+
+    for_each_online_cpu ( cpu )
+    {
+        const struct vm_stats *stats = &per_cpu(vm_stats, cpu);
+
+        allocs += stats->allocs;
+        cached += stats->cached;
+        time += stats->time;
+        worst = max(worst, stats->max);
+        lazy += stats->lazy;
+        flushes += stats->flushes;
+    }
+
+    printk("    vmap: %lu allocations (%lu cached), avg %"PRI_stime"ns, "
+           "max %"PRI_stime"ns\n",
+           allocs, cached, allocs ? time / (s_time_t)allocs : 0, worst);
+    printk("    vmap: %lu lazy unmaps, %lu flushes (%lu avoided)\n",
+           lazy, flushes, lazy - flushes);
+}
+
+static void vm_cache_init(unsigned int cpu)
+{
+    struct vm_cache *c;
+
+    if ( vm_caches[cpu] )
+        return;
+
+    /* Not fatal: the pCPU then goes straight to the bitmap. */
+    if ( (c = xzalloc(struct vm_cache)) == NULL )
+        return;
+
+    spin_lock_init(&c->lock);
+    INIT_PAGE_LIST_HEAD(&c->lazy_free);
+
+    smp_wmb();
+    vm_caches[cpu] = c;
+}
+
+static int cpu_vmap_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+
+    switch ( action )
+    {
+    case CPU_UP_PREPARE:
+        vm_cache_init(cpu);
+        break;
+
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        vm_drain_cpu(cpu);
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block cpu_vmap_nfb = {
+    .notifier_call = cpu_vmap_callback
+};
+
+static int __init vm_cache_setup(void)
+{
+    vm_cache_init(smp_processor_id());
+    register_cpu_notifier(&cpu_vmap_nfb);
+
+    return 0;
 }
+presmp_initcall(vm_cache_setup);
 #endif
@@ -23,9 +23,16 @@
  * Adapted for Xen by Dan Magenheimer (dan.magenheimer@oracle.com)
  */
 
+#include <xen/cpu.h>
+#include <xen/guest_access.h>
+#include <xen/init.h>
 #include <xen/irq.h>
 #include <xen/mm.h>
+#include <xen/perfc.h>
 #include <xen/pfn.h>
+#include <xen/symbols.h>
+#include <xen/time.h>
+#include <public/sysctl.h>
 #include <asm/time.h>
 
 #define MAX_POOL_NAME_LEN       16
@@ -82,6 +89,11 @@ struct bhdr {
      *  bit 1: previous block is free, if set
      */
     u32 size;
+#if BITS_PER_LONG == 64
+#define XMEM_SITE_TAGS
+    /* Call site of a used block (index + 1), taking up padding otherwise. */
+    u32 site;
+#endif
     /* Free blocks in individual freelists are linked */
     union {
         struct free_ptr free_ptr;
@@ -429,6 +441,9 @@ void *xmem_pool_alloc(unsigned long size, struct xmem_pool *pool)
     }
 
     pool->used_size += (b->size & BLOCK_SIZE_MASK) + BHDR_OVERHEAD;
+#ifdef XMEM_SITE_TAGS
+    b->site = 0;
+#endif
 
     spin_unlock(&pool->lock);
     return (void *)b->ptr.buffer;
@@ -545,6 +560,559 @@ static void tlsf_init(void)
     BUG_ON(!xenpool);
 }
 
+/*
+ * Per-CPU object caches.
+ *
+ * Requests of up to XMEM_CACHE_MAX bytes without extra alignment are rounded
+ * up to one of a few size classes, and served from per-CPU magazines of free
+ * blocks, as in Bonwick's slab allocator: a CPU allocates from and frees to
+ * its loaded magazine, swaps it with its previous one when that is empty
+ * (respectively full), and only otherwise exchanges a magazine with the size
+ * class's depot.  Neither the pool lock nor the TLSF bitmaps are touched for
+ * the objects going round this way, and the depot lock only once per
+ * XMEM_MAG_SIZE of them.
+ *
+ * Cached objects remain allocated blocks as far as the pool is concerned.
+ * Magazines which the depot didn't need over a reap interval are drained
+ * back to the pool, and all of them when the pool can't grow.  A CPU going
+ * offline hands its magazines to the depots.
+ */
+#define XMEM_NR_CLASSES     10
+#define XMEM_CACHE_MAX      512
+#define XMEM_MAG_SIZE       15
+#define XMEM_REAP_INTERVAL  SECONDS(10)
+
+static const unsigned int xmem_class_size[XMEM_NR_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512
+};
+
+/* Poisoning relies on blocks going back to the pool. */
+static bool __read_mostly opt_xmalloc_cache =
+    !IS_ENABLED(CONFIG_XMEM_POOL_POISON);
+boolean_param("xmalloc-cache", opt_xmalloc_cache);
+
+struct xmem_magazine {
+    struct xmem_magazine *next;
+    unsigned int nr;
+    void *obj[XMEM_MAG_SIZE];
+};
+
+struct xmem_depot {
+    spinlock_t lock;
+    struct xmem_magazine *full, *empty;   /* Non-empty ones count as full. */
+    unsigned int nr_full, nr_empty;
+    /* Fewest magazines on either list since the last reap, i.e. unused. */
+    unsigned int min_full, min_empty;
+    unsigned int cached;                  /* Objects in full magazines. */
+    s_time_t last_reap;
+};
+
+struct xmem_cpu_cache {
+    struct xmem_magazine *loaded[XMEM_NR_CLASSES];
+    struct xmem_magazine *prev[XMEM_NR_CLASSES];
+    unsigned int cached[XMEM_NR_CLASSES];
+    unsigned long allocs[XMEM_NR_CLASSES];    /* Allocations... */
+    unsigned long hits[XMEM_NR_CLASSES];      /* ... from the magazines. */
+    unsigned long frees[XMEM_NR_CLASSES];
+};
+
+static struct xmem_depot xmem_depots[XMEM_NR_CLASSES];
+
+/* Allocated when a CPU first comes up, and never freed. */
+static struct xmem_cpu_cache *xmem_caches[NR_CPUS];
+
+/* Smallest class to serve @size bytes from. */
+static unsigned int xmem_class(unsigned long size)
+{
+    unsigned int cls = 0;
+
+    while ( xmem_class_size[cls] < size )
+        cls++;
+
+    return cls;
+}
+
+/* Largest class a block of @size bytes can serve, or XMEM_NR_CLASSES. */
+static unsigned int xmem_block_class(unsigned long size)
+{
+    unsigned int cls = XMEM_NR_CLASSES - 1;
+
+    /* Allow for blocks left unsplit by xmem_pool_alloc(). */
+    if ( size < xmem_class_size[0] ||
+         size > XMEM_CACHE_MAX + sizeof(struct bhdr) )
+        return XMEM_NR_CLASSES;
+
+    while ( xmem_class_size[cls] > size )
+        cls--;
+
+    return cls;
+}
+
+static void xmem_magazine_free(struct xmem_magazine *m)
+{
+    while ( m->nr )
+        xmem_pool_free(m->obj[--m->nr], xenpool);
+    xmem_pool_free(m, xenpool);
+}
+
+/*
+ * Return magazines which went unused since the last reap (or all of them)
+ * to the pool.  Returns whether any objects were freed.
+ */
+static bool xmem_depot_reap(unsigned int cls, bool all)
+{
+    struct xmem_depot *d = &xmem_depots[cls];
+    struct xmem_magazine *list = NULL, *m;
+    unsigned int nr_full, nr_empty;
+    bool freed = false;
+
+    spin_lock(&d->lock);
+
+    nr_full = all ? d->nr_full : d->min_full;
+    nr_empty = all ? d->nr_empty : d->min_empty;
+    d->nr_full -= nr_full;
+    d->nr_empty -= nr_empty;
+
+    perfc_add(xmalloc_reap, nr_full + nr_empty);
+
+    for ( ; nr_full; nr_full-- )
+    {
+        m = d->full;
+        d->full = m->next;
+        d->cached -= m->nr;
+        m->next = list;
+        list = m;
+        freed = true;
+    }
+    for ( ; nr_empty; nr_empty-- )
+    {
+        m = d->empty;
+        d->empty = m->next;
+        m->next = list;
+        list = m;
+    }
+
+    d->min_full = d->nr_full;
+    d->min_empty = d->nr_empty;
+    d->last_reap = NOW();
+
+    spin_unlock(&d->lock);
+
+    while ( (m = list) != NULL )
+    {
+        list = m->next;
+        xmem_magazine_free(m);
+    }
+
+    return freed;
+}
+
+static void xmem_depot_maybe_reap(unsigned int cls)
+{
+    if ( NOW() - ACCESS_ONCE(xmem_depots[cls].last_reap) > XMEM_REAP_INTERVAL )
+        xmem_depot_reap(cls, false);
+}
+
+/* Take a full magazine from the depot, or an empty one. */
+static struct xmem_magazine *xmem_depot_get(unsigned int cls, bool full)
+{
+    struct xmem_depot *d = &xmem_depots[cls];
+    struct xmem_magazine *m;
+
+    spin_lock(&d->lock);
+    if ( full && (m = d->full) != NULL )
+    {
+        d->full = m->next;
+        d->cached -= m->nr;
+        d->min_full = min(d->min_full, --d->nr_full);
+    }
+    else if ( !full && (m = d->empty) != NULL )
+    {
+        d->empty = m->next;
+        d->min_empty = min(d->min_empty, --d->nr_empty);
+    }
+    spin_unlock(&d->lock);
+
+    if ( m )
+        perfc_incr(xmalloc_depot);
+
+    xmem_depot_maybe_reap(cls);
+
+    return m;
+}
+
+static void xmem_depot_put(unsigned int cls, struct xmem_magazine *m)
+{
+    struct xmem_depot *d = &xmem_depots[cls];
+
+    spin_lock(&d->lock);
+    if ( m->nr )
+    {
+        m->next = d->full;
+        d->full = m;
+        d->nr_full++;
+        d->cached += m->nr;
+    }
+    else
+    {
+        m->next = d->empty;
+        d->empty = m;
+        d->nr_empty++;
+    }
+    spin_unlock(&d->lock);
+}
+
+static void *xmem_cache_alloc(unsigned int cls)
+{
+    struct xmem_cpu_cache *c = xmem_caches[smp_processor_id()];
+    struct xmem_magazine *m;
+
+    if ( !c )
+        return NULL;
+
+    c->allocs[cls]++;
+
+    m = c->loaded[cls];
+    if ( !m || !m->nr )
+    {
+        if ( c->prev[cls] && c->prev[cls]->nr )
+        {
+            c->loaded[cls] = c->prev[cls];
+            c->prev[cls] = m;
+        }
+        else if ( (m = xmem_depot_get(cls, true)) != NULL )
+        {
+            c->cached[cls] += m->nr;
+            if ( c->prev[cls] )
+                xmem_depot_put(cls, c->prev[cls]);
+            c->prev[cls] = c->loaded[cls];
+            c->loaded[cls] = m;
+        }
+        else
+            return NULL;
+
+        m = c->loaded[cls];
+    }
+
+    c->hits[cls]++;
+    c->cached[cls]--;
+
+    return m->obj[--m->nr];
+}
+
+static bool xmem_cache_free(void *p, unsigned int cls)
+{
+    struct xmem_cpu_cache *c = xmem_caches[smp_processor_id()];
+    struct xmem_magazine *m;
+
+    if ( !c )
+        return false;
+
+    c->frees[cls]++;
+
+    m = c->loaded[cls];
+    if ( !m || m->nr == XMEM_MAG_SIZE )
+    {
+        if ( c->prev[cls] && c->prev[cls]->nr < XMEM_MAG_SIZE )
+        {
+            c->loaded[cls] = c->prev[cls];
+            c->prev[cls] = m;
+        }
+        else
+        {
+            m = xmem_depot_get(cls, false);
+            if ( !m )
+            {
+                /* Straight from the pool, so as not to recurse. */
+                m = xmem_pool_alloc(sizeof(*m), xenpool);
+                if ( !m )
+                    return false;
+                m->nr = 0;
+            }
+            if ( c->prev[cls] )
+            {
+                c->cached[cls] -= c->prev[cls]->nr;
+                xmem_depot_put(cls, c->prev[cls]);
+            }
+            c->prev[cls] = c->loaded[cls];
+            c->loaded[cls] = m;
+        }
+
+        m = c->loaded[cls];
+    }
+
+    m->obj[m->nr++] = p;
+    c->cached[cls]++;
+
+    return true;
+}
+
+/* Drain all depots, e.g. for the pool to be able to grow again. */
+static bool xmem_cache_drain(void)
+{
+    unsigned int cls;
+    bool freed = false;
+
+    if ( !opt_xmalloc_cache )
+        return false;
+
+    for ( cls = 0; cls < XMEM_NR_CLASSES; cls++ )
+        freed |= xmem_depot_reap(cls, true);
+
+    return freed;
+}
+
+static void xmem_cache_cpu_drain(unsigned int cpu)
+{
+    struct xmem_cpu_cache *c = xmem_caches[cpu];
+    unsigned int cls;
+
+    if ( !c )
+        return;
+
+    for ( cls = 0; cls < XMEM_NR_CLASSES; cls++ )
+    {
+        if ( c->loaded[cls] )
+            xmem_depot_put(cls, c->loaded[cls]);
+        if ( c->prev[cls] )
+            xmem_depot_put(cls, c->prev[cls]);
+        c->loaded[cls] = c->prev[cls] = NULL;
+        c->cached[cls] = 0;
+    }
+}
+
+static void xmem_cache_cpu_init(unsigned int cpu)
+{
+    struct xmem_cpu_cache *c;
+
+    if ( xmem_caches[cpu] )
+        return;
+
+    /* Not fatal: the CPU then goes straight to the pool. */
+    if ( (c = xzalloc(struct xmem_cpu_cache)) == NULL )
+        return;
+
+    smp_wmb();
+    xmem_caches[cpu] = c;
+}
+
+static int cpu_xmem_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+
+    switch ( action )
+    {
+    case CPU_UP_PREPARE:
+        xmem_cache_cpu_init(cpu);
+        break;
+
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        xmem_cache_cpu_drain(cpu);
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block cpu_xmem_nfb = {
+    .notifier_call = cpu_xmem_callback
+};
+
+/*
+ * Call site statistics.
+ *
+ * With "xmalloc-sites", allocations are accounted to their caller's return
+ * address, in a fixed size hash table.  On 64-bit builds, blocks from the
+ * pool are tagged with their site, so that what is still live can be
+ * tracked too.  Whole page allocations only count towards the totals.
+ */
+#define XMEM_NR_SITES       1024
+#define XMEM_SITE_PROBES    16
+
+static bool __initdata opt_xmalloc_sites;
+boolean_param("xmalloc-sites", opt_xmalloc_sites);
+
+struct xmem_site {
+    unsigned long addr;
+    unsigned long allocs, bytes;
+    unsigned long live, live_bytes;
+};
+
+static struct xmem_site *__read_mostly xmem_sites;
+
+static struct xmem_site *xmem_site(const void *site)
+{
+    unsigned long addr = (unsigned long)site, cur;
+    unsigned int i, h = (addr ^ (addr >> 12)) >> 2;
+
+    for ( i = 0; i < XMEM_SITE_PROBES; i++ )
+    {
+        struct xmem_site *s = &xmem_sites[(h + i) & (XMEM_NR_SITES - 1)];
+
+        cur = ACCESS_ONCE(s->addr);
+        if ( !cur )
+            cur = cmpxchg(&s->addr, 0UL, addr) ?: addr;
+        if ( cur == addr )
+            return s;
+    }
+
+    return NULL;
+}
+
+/* Account an allocation of @size bytes, at @p if from the pool. */
+static void xmem_site_alloc(const void *site, void *p, unsigned long size)
+{
+    struct xmem_site *s;
+
+    if ( !xmem_sites || (s = xmem_site(site)) == NULL )
+        return;
+
+    arch_fetch_and_add(&s->allocs, 1);
+    arch_fetch_and_add(&s->bytes, size);
+
+#ifdef XMEM_SITE_TAGS
+    if ( p )
+    {
+        struct bhdr *b = p - BHDR_OVERHEAD;
+
+        b->site = s - xmem_sites + 1;
+        arch_fetch_and_add(&s->live, 1);
+        arch_fetch_and_add(&s->live_bytes, b->size & BLOCK_SIZE_MASK);
+    }
+#endif
+}
+
+static void xmem_site_free(struct bhdr *b)
+{
+#ifdef XMEM_SITE_TAGS
+    struct xmem_site *s;
+
+    if ( !b->site )
+        return;
+
+    s = &xmem_sites[b->site - 1];
+    b->site = 0;
+    arch_fetch_and_add(&s->live, -1UL);
+    arch_fetch_and_add(&s->live_bytes, -(b->size & BLOCK_SIZE_MASK));
+#endif
+}
+
+static int __init xmem_cache_init(void)
+{
+    unsigned int cls;
+
+    if ( opt_xmalloc_sites )
+        xmem_sites = xzalloc_array(struct xmem_site, XMEM_NR_SITES);
+
+    if ( !opt_xmalloc_cache )
+        return 0;
+
+    for ( cls = 0; cls < XMEM_NR_CLASSES; cls++ )
+        spin_lock_init(&xmem_depots[cls].lock);
+
+    xmem_cache_cpu_init(smp_processor_id());
+    register_cpu_notifier(&cpu_xmem_nfb);
+
+    return 0;
+}
+presmp_initcall(xmem_cache_init);
+
+static int xmalloc_class_stats(struct xen_sysctl_xmalloc_op *op)
+{
+    unsigned int cls, cpu;
+
+    for ( cls = 0; cls < XMEM_NR_CLASSES; cls++ )
+    {
+        struct xen_sysctl_xmalloc_class info = {
+            .size = xmem_class_size[cls],
+            .cached = read_atomic(&xmem_depots[cls].cached),
+        };
+
+        for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+        {
+            struct xmem_cpu_cache *c = xmem_caches[cpu];
+
+            if ( !c )
+                continue;
+
+            info.cached += read_atomic(&c->cached[cls]);
+            info.allocs += read_atomic(&c->allocs[cls]);
+            info.hits += read_atomic(&c->hits[cls]);
+            info.frees += read_atomic(&c->frees[cls]);
+        }
+
+        if ( cls < op->max_elem &&
+             copy_to_guest_offset(op->classes, cls, &info, 1) )
+            return -EFAULT;
+    }
+
+    op->nr_elem = XMEM_NR_CLASSES;
+
+    return 0;
+}
+
+static int xmalloc_site_stats(struct xen_sysctl_xmalloc_op *op)
+{
+    unsigned int i, n = 0;
+
+    if ( !xmem_sites )
+        return -EOPNOTSUPP;
+
+    for ( i = 0; i < XMEM_NR_SITES; i++ )
+    {
+        struct xmem_site *s = &xmem_sites[i];
+        struct xen_sysctl_xmalloc_site info = {};
+        char namebuf[KSYM_NAME_LEN + 1];
+        unsigned long size, offset;
+        const char *name;
+
+        if ( !(info.addr = read_atomic(&s->addr)) )
+            continue;
+
+        if ( n < op->max_elem )
+        {
+            name = symbols_lookup(info.addr, &size, &offset, namebuf);
+            if ( name )
+                snprintf(info.name, sizeof(info.name), "%s+%#lx",
+                         name, offset);
+            info.allocs = read_atomic(&s->allocs);
+            info.bytes = read_atomic(&s->bytes);
+            info.live = read_atomic(&s->live);
+            info.live_bytes = read_atomic(&s->live_bytes);
+
+            if ( copy_to_guest_offset(op->sites, n, &info, 1) )
+                return -EFAULT;
+        }
+        n++;
+    }
+
+    op->nr_elem = n;
+
+    return 0;
+}
+
+int xmalloc_stats_control(struct xen_sysctl_xmalloc_op *op)
+{
+    if ( op->pad )
+        return -EINVAL;
+
+    op->pool_used = xenpool ? xmem_pool_get_used_size(xenpool) : 0;
+    op->pool_total = xenpool ? xmem_pool_get_total_size(xenpool) : 0;
+
+    switch ( op->cmd )
+    {
+    case XEN_SYSCTL_XMALLOC_classes:
+        return xmalloc_class_stats(op);
+
+    case XEN_SYSCTL_XMALLOC_sites:
+        return xmalloc_site_stats(op);
+    }
+
+    return -EINVAL;
+}
+
 /*
  * xmalloc()
  */
@@ -580,7 +1148,23 @@ static void *add_padding(void *p, unsigned long align)
     return p;
 }
 
-void *_xmalloc(unsigned long size, unsigned long align)
+/* Allocate @size bytes from the pool, through the caches if @cacheable. */
+static void *xmem_block_alloc(unsigned long size, bool cacheable)
+{
+    unsigned int cls;
+    void *p;
+
+    if ( !cacheable || size > XMEM_CACHE_MAX )
+        return xmem_pool_alloc(size, xenpool);
+
+    cls = xmem_class(size);
+    p = xmem_cache_alloc(cls);
+
+    return p ?: xmem_pool_alloc(xmem_class_size[cls], xenpool);
+}
+
+static void *xmalloc_at(unsigned long size, unsigned long align,
+                        const void *site)
 {
     void *p = NULL;
 
@@ -598,9 +1182,21 @@ void *_xmalloc(unsigned long size, unsigned long align)
         tlsf_init();
 
     if ( size < PAGE_SIZE )
-        p = xmem_pool_alloc(size, xenpool);
+    {
+        p = xmem_block_alloc(size, align == MEM_ALIGN);
+        if ( p == NULL && xmem_cache_drain() )
+            p = xmem_block_alloc(size, align == MEM_ALIGN);
+    }
     if ( p == NULL )
-        return xmalloc_whole_pages(size - align + MEM_ALIGN, align);
+    {
+        size -= align - MEM_ALIGN;
+        p = xmalloc_whole_pages(size, align);
+        if ( p )
+            xmem_site_alloc(site, NULL, size);
+        return p;
+    }
+
+    xmem_site_alloc(site, p, size - (align - MEM_ALIGN));
 
     /* Add alignment padding. */
     p = add_padding(p, align);
@@ -609,9 +1205,14 @@ void *_xmalloc(unsigned long size, unsigned long align)
     return p;
 }
 
+void *_xmalloc(unsigned long size, unsigned long align)
+{
+    return xmalloc_at(size, align, __builtin_return_address(0));
+}
+
 void *_xzalloc(unsigned long size, unsigned long align)
 {
-    void *p = _xmalloc(size, align);
+    void *p = xmalloc_at(size, align, __builtin_return_address(0));
 
     return p ? memset(p, 0, size) : p;
 }
@@ -628,7 +1229,7 @@ void *_xrealloc(void *ptr, unsigned long size, unsigned long align)
     }
 
     if ( ptr == NULL || ptr == ZERO_BLOCK_PTR )
-        return _xmalloc(size, align);
+        return xmalloc_at(size, align, __builtin_return_address(0));
 
     ASSERT(!(align & (align - 1)));
     if ( align < MEM_ALIGN )
@@ -667,7 +1268,7 @@ void *_xrealloc(void *ptr, unsigned long size, unsigned long align)
         }
     }
 
-    p = _xmalloc(size, align);
+    p = xmalloc_at(size, align, __builtin_return_address(0));
     if ( p )
     {
         memcpy(p, ptr, min(curr_size, size));
@@ -679,6 +1280,9 @@ void *_xrealloc(void *ptr, unsigned long size, unsigned long align)
 
 void xfree(void *p)
 {
+    struct bhdr *b;
+    unsigned int cls;
+
     if ( p == NULL || p == ZERO_BLOCK_PTR )
         return;
 
@@ -705,5 +1309,12 @@ void xfree(void *p)
     /* Strip alignment padding. */
     p = strip_padding(p);
 
+    b = p - BHDR_OVERHEAD;
+    xmem_site_free(b);
+
+    cls = xmem_block_class(b->size & BLOCK_SIZE_MASK);
+    if ( cls < XMEM_NR_CLASSES && xmem_cache_free(p, cls) )
+        return;
+
     xmem_pool_free(p, xenpool);
 }
@@ -42,6 +42,12 @@ TLB_HELPER(flush_all_guests_tlb, alle1is);
 /* Flush all hypervisor mappings from the TLB of the local processor. */
 TLB_HELPER(flush_xen_tlb_local, alle2);
 
+/*
+ * Flush all hypervisor mappings from the TLB of all processors in the
+ * inner-shareable domain.
+ */
+TLB_HELPER(flush_xen_tlb, alle2is);
+
 /* Flush TLB of local processor for address va. */
 static inline void  __flush_xen_tlb_one_local(vaddr_t va)
 {
@@ -87,6 +87,7 @@ static inline uint64_t gva_to_ipa_par(vaddr_t va, unsigned int flags)
 }
 
 extern void clear_page(void *to);
+extern void clear_page_stnp(void *to);
 
 #endif /* __ASSEMBLY__ */
 
@@ -60,6 +60,7 @@ struct arch_domain
         RELMEM_not_started,
         RELMEM_tee,
         RELMEM_xen,
+        RELMEM_teardown,
         RELMEM_page,
         RELMEM_mapping,
         RELMEM_done,
@@ -32,8 +32,11 @@ static inline void gnttab_mark_dirty(struct domain *d, mfn_t mfn)
 int create_grant_host_mapping(unsigned long gpaddr, mfn_t mfn,
                               unsigned int flags, unsigned int cache_flags);
 #define gnttab_host_mapping_get_page_type(ro, ld, rd) (0)
-int replace_grant_host_mapping(unsigned long gpaddr, mfn_t mfn,
-                               unsigned long new_gpaddr, unsigned int flags);
+int replace_grant_host_mapping(struct domain *d, unsigned long gpaddr,
+                               mfn_t mfn, unsigned long new_gpaddr,
+                               unsigned int flags);
+/* Guest physical addresses don't depend on the context. */
+#define grant_host_mapping_remote(addr, flags) (true)
 #define gnttab_release_host_mappings(domain) 1
 
 /*
@@ -362,6 +362,12 @@ static inline void put_page_and_type(struct page_info *page)
 
 void clear_and_clean_page(struct page_info *page);
 
+/* Arm keeps no mappings that need undoing when a page is freed. */
+static inline int cleanup_page_mappings(struct page_info *page)
+{
+    return 0;
+}
+
 static inline
 int arch_acquire_resource(struct domain *d, unsigned int type, unsigned int id,
                           unsigned long frame, unsigned int nr_frames,
@@ -90,6 +90,8 @@
 
 #define _PAGE_PRESENT    (1U << 5)
 #define _PAGE_POPULATE   (1U << 6)
+/* Leave flushing the TLBs to the caller. */
+#define MAP_NO_FLUSH     (1U << 7)
 
 /*
  * _PAGE_DEVICE and _PAGE_NORMAL are convenience defines. They are not
@@ -72,6 +72,8 @@
 /* MPIDR Multiprocessor Affinity Register */
 #define _MPIDR_UP           (30)
 #define MPIDR_UP            (_AC(1,U) << _MPIDR_UP)
+#define _MPIDR_MT           (24)
+#define MPIDR_MT            (_AC(1,U) << _MPIDR_MT)
 #define _MPIDR_SMP          (31)
 #define MPIDR_SMP           (_AC(1,U) << _MPIDR_SMP)
 #define MPIDR_AFF0_SHIFT    (0)
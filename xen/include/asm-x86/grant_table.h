@@ -26,13 +26,31 @@ static inline int create_grant_host_mapping(uint64_t addr, mfn_t frame,
     return create_grant_pv_mapping(addr, frame, flags, cache_flags);
 }
 
-static inline int replace_grant_host_mapping(uint64_t addr, mfn_t frame,
-                                             uint64_t new_addr,
+static inline int replace_grant_host_mapping(struct domain *d, uint64_t addr,
+                                             mfn_t frame, uint64_t new_addr,
                                              unsigned int flags)
 {
-    if ( paging_mode_external(current->domain) )
-        return replace_grant_p2m_mapping(addr, frame, new_addr, flags);
-    return replace_grant_pv_mapping(addr, frame, new_addr, flags);
+    if ( paging_mode_external(d) )
+        return replace_grant_p2m_mapping(d, addr, frame, new_addr, flags);
+    return replace_grant_pv_mapping(d, addr, frame, new_addr, flags);
+}
+
+/*
+ * Make the address of a host mapping of the current domain one which
+ * replace_grant_host_mapping() accepts in any context: PV linear addresses
+ * are turned into the machine address of their L1e.
+ */
+static inline bool grant_host_mapping_remote(uint64_t *addr,
+                                             unsigned int *flags)
+{
+    if ( paging_mode_external(current->domain) ||
+         (*flags & GNTMAP_contains_pte) )
+        return true;
+
+    *addr = pv_grant_mapping_pte(*addr);
+    *flags |= GNTMAP_contains_pte;
+
+    return *addr;
 }
 
 #define gnttab_init_arch(gt) 0
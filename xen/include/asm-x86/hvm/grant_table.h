@@ -26,7 +26,7 @@
 int create_grant_p2m_mapping(uint64_t addr, mfn_t frame,
                              unsigned int flags,
                              unsigned int cache_flags);
-int replace_grant_p2m_mapping(uint64_t addr, mfn_t frame,
+int replace_grant_p2m_mapping(struct domain *d, uint64_t addr, mfn_t frame,
                               uint64_t new_addr, unsigned int flags);
 
 #else
@@ -40,8 +40,9 @@ static inline int create_grant_p2m_mapping(uint64_t addr, mfn_t frame,
     return GNTST_general_error;
 }
 
-static inline int replace_grant_p2m_mapping(uint64_t addr, mfn_t frame,
-                                            uint64_t new_addr, unsigned int flags)
+static inline int replace_grant_p2m_mapping(struct domain *d, uint64_t addr,
+                                            mfn_t frame, uint64_t new_addr,
+                                            unsigned int flags)
 {
     return GNTST_general_error;
 }
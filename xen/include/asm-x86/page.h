@@ -226,6 +226,7 @@ typedef struct { u64 pfn; } pagetable_t;
 #define pagetable_null()        pagetable_from_pfn(0)
 
 void clear_page_sse2(void *);
+void clear_page_clzero(void *);
 void copy_page_sse2(void *, const void *);
 
 #define clear_page(_p)      clear_page_sse2(_p)
@@ -342,6 +343,7 @@ void efi_update_l4_pgtable(unsigned int l4idx, l4_pgentry_t);
 #define __PAGE_HYPERVISOR_UC      (__PAGE_HYPERVISOR | _PAGE_PCD | _PAGE_PWT)
 
 #define MAP_SMALL_PAGES _PAGE_AVAIL0 /* don't use superpages mappings */
+#define MAP_NO_FLUSH    _PAGE_AVAIL1 /* caller flushes TLBs for L1 changes */
 
 #ifndef __ASSEMBLY__
 
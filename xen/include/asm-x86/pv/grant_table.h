@@ -25,8 +25,9 @@
 
 int create_grant_pv_mapping(uint64_t addr, mfn_t frame,
                             unsigned int flags, unsigned int cache_flags);
-int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
+int replace_grant_pv_mapping(struct domain *d, uint64_t addr, mfn_t frame,
                              uint64_t new_addr, unsigned int flags);
+uint64_t pv_grant_mapping_pte(uint64_t linear);
 
 #else
 
@@ -39,12 +40,18 @@ static inline int create_grant_pv_mapping(uint64_t addr, mfn_t frame,
     return GNTST_general_error;
 }
 
-static inline int replace_grant_pv_mapping(uint64_t addr, mfn_t frame,
-                                           uint64_t new_addr, unsigned int flags)
+static inline int replace_grant_pv_mapping(struct domain *d, uint64_t addr,
+                                           mfn_t frame, uint64_t new_addr,
+                                           unsigned int flags)
 {
     return GNTST_general_error;
 }
 
+static inline uint64_t pv_grant_mapping_pte(uint64_t linear)
+{
+    return 0;
+}
+
 #endif
 
 #endif /* __X86_PV_GRANT_TABLE_H__ */
@@ -0,0 +1,8 @@
+#ifndef _COMPAT_ARCH_X86_32_H
+#define _COMPAT_ARCH_X86_32_H
+#include <xen/compat.h>
+#pragma pack(4)
+#include "arch-x86/xen.h"
+#pragma pack(4)
+#pragma pack()
+#endif /* _COMPAT_ARCH_X86_32_H */
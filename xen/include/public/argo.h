@@ -58,6 +58,19 @@ typedef struct xen_argo_iov
     uint32_t pad;
 } xen_argo_iov_t;
 
+/*
+ * XEN_ARGO_MAX_SEND_BATCH : maximum number of messages accepted in a single
+ * sendv_batch.
+ */
+#define XEN_ARGO_MAX_SEND_BATCH  32U
+
+/*
+ * XEN_ARGO_MAX_GRANT_SEGS : maximum number of segments accepted in a single
+ * sendv_grants.
+ * As with XEN_ARGO_MAXIOV, this sizes an array on the hypervisor stack.
+ */
+#define XEN_ARGO_MAX_GRANT_SEGS  16U
+
 typedef struct xen_argo_addr
 {
     xen_argo_port_t aport;
@@ -119,6 +132,30 @@ typedef struct xen_argo_unregister_ring
 /* Too many domains waiting for available space signals for this ring */
 #define XEN_ARGO_RING_EBUSY             (1U << 5)
 
+typedef struct xen_argo_send_ent
+{
+    struct xen_argo_send_addr addr;
+    /* Index of the first iov of this message in the batch's iov array. */
+    uint32_t iov_idx;
+    uint32_t niov;
+    uint32_t message_type;
+    /* OUT: number of bytes sent, or a negative errno value. */
+    int32_t status;
+} xen_argo_send_ent_t;
+
+/*
+ * A segment of a message sent by reference: len bytes at offset within the
+ * 4K page that the sender has granted to the receiver with grant reference
+ * gref.
+ */
+typedef struct xen_argo_grant_seg
+{
+    uint32_t gref;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t pad;
+} xen_argo_grant_seg_t;
+
 typedef struct xen_argo_ring_data_ent
 {
     struct xen_argo_addr ring;
@@ -252,4 +289,55 @@ struct xen_argo_ring_message_header
  */
 #define XEN_ARGO_OP_notify              4
 
+/*
+ * XEN_ARGO_OP_sendv_batch
+ *
+ * Send several messages, possibly to different rings, in one operation.
+ *
+ * Each entry of the first argument describes one message as for
+ * XEN_ARGO_OP_sendv: its addresses, its message type, and the range
+ * [iov_idx, iov_idx + niov) of the iov array in the second argument that
+ * holds its data.  The messages are sent in order and Xen sets the status
+ * field of each entry to the number of bytes sent, or to the error that
+ * XEN_ARGO_OP_sendv would have returned.  A full ring does not stop the
+ * batch: that entry's status is -EAGAIN and a notification is queued.
+ *
+ * Consecutive entries to the same destination domain share a single
+ * signal, so callers should group messages by destination.
+ *
+ * Returns the number of messages sent.
+ *
+ * arg1: XEN_GUEST_HANDLE(xen_argo_send_ent_t) messages
+ * arg2: XEN_GUEST_HANDLE(xen_argo_iov_t) iovs
+ * arg3: unsigned long number of messages (<= XEN_ARGO_MAX_SEND_BATCH)
+ * arg4: unsigned long number of iovs
+ */
+#define XEN_ARGO_OP_sendv_batch         5
+
+/*
+ * XEN_ARGO_OP_sendv_grants
+ *
+ * Send a message whose data is named by grant references rather than by
+ * guest virtual addresses.
+ *
+ * The sender grants the pages holding the data to the destination domain
+ * and passes a list of segments naming them.  Xen pins each grant as a
+ * grant copy on behalf of the destination domain would, and copies the
+ * segments, in order, straight from the granted pages into the destination
+ * ring.  The receiver gets an ordinary message, as if sent with
+ * XEN_ARGO_OP_sendv, and the sender may revoke its grants once the
+ * operation has returned.
+ *
+ * Each segment must lie within the granted part of its page.  Ring matching
+ * and -EAGAIN handling are as for XEN_ARGO_OP_sendv.
+ *
+ * Returns the total length of the segments.
+ *
+ * arg1: XEN_GUEST_HANDLE(xen_argo_send_addr_t) source and dest addresses
+ * arg2: XEN_GUEST_HANDLE(xen_argo_grant_seg_t) segments
+ * arg3: unsigned long number of segments (<= XEN_ARGO_MAX_GRANT_SEGS)
+ * arg4: unsigned long message type (32-bit value)
+ */
+#define XEN_ARGO_OP_sendv_grants        6
+
 #endif
@@ -1133,6 +1133,27 @@ struct xen_domctl_vuart_op {
                                  */
 };
 
+/*
+ * XEN_DOMCTL_get_teardown_progress
+ *
+ * Report how far the freeing of a dying domain's memory has got, so that a
+ * toolstack can plan reuse of that memory while the destroy is still in
+ * progress.  total_pages is the domain's allocation when its memory started
+ * being freed; remaining_pages what it still holds.  freed_pages counts what
+ * was freed (and scrubbed) in parallel by @workers helper CPUs, the rest
+ * being freed by the destroying CPU and scrubbed later.
+ */
+struct xen_domctl_teardown_progress {
+#define XEN_DOMCTL_TEARDOWN_none    0   /* domain isn't dying */
+#define XEN_DOMCTL_TEARDOWN_running 1   /* memory is being freed */
+#define XEN_DOMCTL_TEARDOWN_done    2   /* all memory has been freed */
+    uint32_t state;                     /* OUT - XEN_DOMCTL_TEARDOWN_* */
+    uint32_t workers;                   /* OUT - helper CPUs still active */
+    uint64_aligned_t total_pages;       /* OUT */
+    uint64_aligned_t freed_pages;       /* OUT */
+    uint64_aligned_t remaining_pages;   /* OUT */
+};
+
 struct xen_domctl {
     uint32_t cmd;
 #define XEN_DOMCTL_createdomain                   1
@@ -1214,6 +1235,7 @@ struct xen_domctl {
 #define XEN_DOMCTL_vuart_op                      81
 #define XEN_DOMCTL_get_cpu_policy                82
 #define XEN_DOMCTL_set_cpu_policy                83
+#define XEN_DOMCTL_get_teardown_progress         84
 #define XEN_DOMCTL_gdbsx_guestmemio            1000
 #define XEN_DOMCTL_gdbsx_pausevcpu             1001
 #define XEN_DOMCTL_gdbsx_unpausevcpu           1002
@@ -1274,6 +1296,7 @@ struct xen_domctl {
         struct xen_domctl_monitor_op        monitor_op;
         struct xen_domctl_psr_alloc         psr_alloc;
         struct xen_domctl_vuart_op          vuart_op;
+        struct xen_domctl_teardown_progress teardown_progress;
         uint8_t                             pad[128];
     } u;
 };
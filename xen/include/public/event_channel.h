@@ -74,6 +74,8 @@
 #define EVTCHNOP_init_control    11
 #define EVTCHNOP_expand_array    12
 #define EVTCHNOP_set_priority    13
+#define EVTCHNOP_send_batch      14
+#define EVTCHNOP_set_coalesce    15
 /* ` } */
 
 typedef uint32_t evtchn_port_t;
@@ -312,6 +314,50 @@ struct evtchn_set_priority {
 };
 typedef struct evtchn_set_priority evtchn_set_priority_t;
 
+/*
+ * EVTCHNOP_send_batch: Send an event to the remote end of each of the
+ * <nr_ports> local ports following this structure, in order.
+ * NOTES:
+ *  1. Each port is handled as by EVTCHNOP_send.  Processing stops at the
+ *     first port which fails; <nr_sent> reports how many ports were sent
+ *     to before that.
+ *  2. The target vCPUs are notified once the whole batch has been
+ *     processed, allowing Xen to send at most one interrupt to each
+ *     physical CPU.
+ *  3. <nr_ports> must not exceed EVTCHN_SEND_BATCH_MAX.
+ */
+#define EVTCHN_SEND_BATCH_MAX 1024
+struct evtchn_send_batch {
+    /* IN parameters. */
+    uint32_t nr_ports;
+    /* OUT parameters. */
+    uint32_t nr_sent;
+    /* IN parameters. */
+    evtchn_port_t ports[XEN_FLEX_ARRAY_DIM];
+};
+typedef struct evtchn_send_batch evtchn_send_batch_t;
+DEFINE_XEN_GUEST_HANDLE(evtchn_send_batch_t);
+
+/*
+ * EVTCHNOP_set_coalesce: Hold back events sent to the local port <port>,
+ * raising a single one once <max_events> have been sent, or <interval_us>
+ * microseconds after the first one held back, whichever comes first.
+ * NOTES:
+ *  1. An <interval_us> of 0 turns coalescing off; events held back are
+ *     raised.
+ *  2. A <max_events> of 0 puts no limit on the number of events held back.
+ *  3. <interval_us> must not exceed EVTCHN_COALESCE_MAX_INTERVAL_US.
+ *  4. The policy is dropped when the port is closed.
+ */
+#define EVTCHN_COALESCE_MAX_INTERVAL_US 10000
+struct evtchn_set_coalesce {
+    /* IN parameters. */
+    evtchn_port_t port;
+    uint32_t max_events;
+    uint32_t interval_us;
+};
+typedef struct evtchn_set_coalesce evtchn_set_coalesce_t;
+
 /*
  * ` enum neg_errnoval
  * ` HYPERVISOR_event_channel_op_compat(struct evtchn_op *op)
@@ -114,6 +114,12 @@
  */
 #define XENFEAT_linux_rsdp_unrestricted   15
 
+/* GNTTABOP_map_grant_ref supports GNTMAP_cache. */
+#define XENFEAT_gnttab_map_cache          16
+
+/* GNTTABOP_copy_v2 is available. */
+#define XENFEAT_gnttab_copy_v2            17
+
 #define XENFEAT_NR_SUBMAPS 1
 
 #endif /* __XEN_PUBLIC_FEATURES_H__ */
@@ -312,6 +312,7 @@ typedef uint16_t grant_status_t;
 #define GNTTABOP_get_version          10
 #define GNTTABOP_swap_grant_ref	      11
 #define GNTTABOP_cache_flush	      12
+#define GNTTABOP_copy_v2              13
 #endif /* __XEN_INTERFACE_VERSION__ */
 /* ` } */
 
@@ -596,6 +597,60 @@ struct gnttab_cache_flush {
 typedef struct gnttab_cache_flush gnttab_cache_flush_t;
 DEFINE_XEN_GUEST_HANDLE(gnttab_cache_flush_t);
 
+/*
+ * GNTTABOP_copy_v2: Hypervisor based copy of multi-segment buffers (only if
+ * XENFEAT_gnttab_copy_v2 is set).
+ *
+ * Like GNTTABOP_copy, but every operation copies a buffer described by a list
+ * of source segments into one described by a list of destination segments.
+ * A segment covers <len> bytes starting at <offset> into the frame given by
+ * <u>, continuing into the following frames (i.e. grant references <ref>,
+ * <ref> + 1, ... or frames <gfn>, <gfn> + 1, ...) as needed.  The total
+ * length of both lists has to be the same, and may not exceed
+ * GNTCOPY_V2_MAX_LEN.  The domains and buffers involved stay locked and
+ * mapped across segments and consecutive operations as long as possible.
+ *
+ * The hypercall argument is an array of <count> 16-byte elements, each
+ * operation being a struct gnttab_copy_v2 immediately followed by its
+ * <nr_source_segs> source and <nr_dest_segs> destination segments.  The
+ * number of bytes copied is returned in <copied>, also in case of an error.
+ * An operation may get preempted part way, and is then resumed where it
+ * stopped.
+ *
+ * GNTCOPY_nontemporal hints that the copied data won't be used by the CPU
+ * soon, allowing Xen to bypass the caches for full page copies.
+ */
+#define _GNTCOPY_nontemporal      (2)
+#define GNTCOPY_nontemporal       (1<<_GNTCOPY_nontemporal)
+
+#define GNTCOPY_V2_MAX_LEN        0x40000
+
+struct gnttab_copy_seg {
+    union {
+        grant_ref_t ref;
+        uint64_t    gfn;
+    } u;
+    uint32_t      len;
+    uint16_t      offset;
+    uint16_t      pad;
+};
+typedef struct gnttab_copy_seg gnttab_copy_seg_t;
+DEFINE_XEN_GUEST_HANDLE(gnttab_copy_seg_t);
+
+struct gnttab_copy_v2 {
+    /* IN parameters. */
+    domid_t       source_domid;
+    domid_t       dest_domid;
+    uint16_t      nr_source_segs;
+    uint16_t      nr_dest_segs;
+    uint16_t      flags;          /* GNTCOPY_* */
+    /* OUT parameters. */
+    int16_t       status;
+    uint32_t      copied;
+};
+typedef struct gnttab_copy_v2 gnttab_copy_v2_t;
+DEFINE_XEN_GUEST_HANDLE(gnttab_copy_v2_t);
+
 #endif /* __XEN_INTERFACE_VERSION__ */
 
 /*
@@ -629,6 +684,27 @@ DEFINE_XEN_GUEST_HANDLE(gnttab_cache_flush_t);
 #define _GNTMAP_can_fail        (5)
 #define GNTMAP_can_fail         (1<<_GNTMAP_can_fail)
 
+ /*
+  * GNTMAP_cache subflag (only if XENFEAT_gnttab_map_cache is set):
+  *  0 => Normal mapping.
+  *  1 => Cached mapping. GNTTABOP_unmap_grant_ref (with <host_addr> and
+  *       <dev_bus_addr> as returned by the map operation) only releases the
+  *       mapping, which stays in place. The next map of the same grant with
+  *       identical flags and <host_addr> returns the same handle and
+  *       <dev_bus_addr>, unless the granting domain revoked the grant (by
+  *       resetting the type of its entry) or died in the meantime. Unmapping
+  *       an already released mapping really unmaps it, as is done by Xen for
+  *       released mappings of revoked grants. Only grants of domains using
+  *       grant table version 2 are cached, as version 1 grants can't be
+  *       revoked while mapped. Released mappings of revoked grants are
+  *       also unmapped by Xen while the mapping domain is idle, within about
+  *       a second, and those of a dying domain's grants as it dies. The flag
+  *       is cleared on return if the mapping could not be cached; it is then
+  *       a normal one.
+  */
+#define _GNTMAP_cache           (6)
+#define GNTMAP_cache            (1<<_GNTMAP_cache)
+
 /*
  * Bits to be placed in guest kernel available PTE bits (architecture
  * dependent; only supported when XENFEAT_gnttab_map_avail_bits is set).
@@ -651,10 +651,43 @@ struct xen_sysctl_credit2_schedule {
     unsigned ratelimit_us;
 };
 
+/*
+ * Load balancing statistics of a Credit2 runqueue. Loads are fixed point
+ * values, with load_precision_shift (see below) fractional bits.
+ */
+struct xen_sysctl_credit2_runqueue_stats {
+    uint32_t id;                        /* Runqueue id                       */
+    uint32_t nr_cpus;                   /* Number of cpus in the runqueue    */
+    uint64_aligned_t avgload;           /* Decaying average load             */
+    uint64_aligned_t b_avgload;         /* ... as modified by balancing      */
+    uint64_aligned_t balance_interval;  /* Current balance interval (ns)     */
+    uint64_aligned_t balance_checks;    /* Times balancing was considered    */
+    uint64_aligned_t balance_skipped;   /* ... skipped (interval not over)   */
+    uint64_aligned_t balance_attempts;  /* ... finding a large enough delta  */
+    uint64_aligned_t candidates;        /* Units considered for migration    */
+    uint64_aligned_t migrations_push;   /* Units pushed to other runqueues   */
+    uint64_aligned_t migrations_pull;   /* Units pulled from other runqueues */
+};
+typedef struct xen_sysctl_credit2_runqueue_stats xen_sysctl_credit2_runqueue_stats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_credit2_runqueue_stats_t);
+
+struct xen_sysctl_credit2_stats {
+    /*
+     * IN: number of elements in runqueues (can be 0, with a NULL handle).
+     * OUT: number of elements filled in, or with a NULL handle, number of
+     *      active runqueues.
+     */
+    uint32_t nr_runqueues;
+    uint32_t load_precision_shift;      /* OUT */
+    XEN_GUEST_HANDLE_64(xen_sysctl_credit2_runqueue_stats_t) runqueues;
+};
+
 /* XEN_SYSCTL_scheduler_op */
 /* Set or get info? */
 #define XEN_SYSCTL_SCHEDOP_putinfo 0
 #define XEN_SYSCTL_SCHEDOP_getinfo 1
+/* Get statistics (so far Credit2 only). */
+#define XEN_SYSCTL_SCHEDOP_getstats 2
 struct xen_sysctl_scheduler_op {
     uint32_t cpupool_id; /* Cpupool whose scheduler is to be targetted. */
     uint32_t sched_id;   /* XEN_SCHEDULER_* (domctl.h) */
@@ -665,6 +698,7 @@ struct xen_sysctl_scheduler_op {
         } sched_arinc653;
         struct xen_sysctl_credit_schedule sched_credit;
         struct xen_sysctl_credit2_schedule sched_credit2;
+        struct xen_sysctl_credit2_stats sched_credit2_stats;
     } u;
 };
 
@@ -1033,6 +1067,162 @@ typedef struct xen_sysctl_cpu_policy xen_sysctl_cpu_policy_t;
 DEFINE_XEN_GUEST_HANDLE(xen_sysctl_cpu_policy_t);
 #endif
 
+/*
+ * XEN_SYSCTL_sched_latency
+ *
+ * Return the scheduling latency statistics of the vcpus of a domain. They
+ * are collected by the scheduler at each runstate change, for all vcpus and
+ * independent of the scheduler in use.
+ *
+ * Samples are put in histograms with power of 2 buckets: bucket 0 counts
+ * samples shorter than 1024ns, bucket i (0 < i < LAST) samples in the range
+ * [2^(9+i), 2^(10+i)) ns and the last bucket all samples from 2^(9+LAST) ns
+ * onwards.
+ */
+#define XEN_SYSCTL_SCHED_LAT_BUCKETS 22
+struct xen_sysctl_sched_lat_hist {
+    uint64_aligned_t count;                 /* Number of samples. */
+    uint64_aligned_t total;                 /* Sum of all samples (ns). */
+    uint64_aligned_t max;                   /* Longest sample (ns). */
+    uint32_t bucket[XEN_SYSCTL_SCHED_LAT_BUCKETS];
+};
+typedef struct xen_sysctl_sched_lat_hist xen_sysctl_sched_lat_hist_t;
+
+struct xen_sysctl_sched_vcpu_latency {
+    uint32_t vcpu;                          /* OUT: vcpu id. */
+    uint32_t pad;
+/* Runnable after being blocked or offline, until running. */
+#define XEN_SYSCTL_SCHED_LAT_wake      0
+/* Runnable after having been descheduled while running, until running. */
+#define XEN_SYSCTL_SCHED_LAT_preempt   1
+#define XEN_SYSCTL_SCHED_LAT_NR        2
+    xen_sysctl_sched_lat_hist_t lat[XEN_SYSCTL_SCHED_LAT_NR];
+/*
+ * Steal time (ns) by cause: time runnable after a wakeup or a preemption
+ * (whether or not followed by running) and time offline, e.g. because of
+ * the domain being paused. Time spent down (VCPUOP_down, not yet brought
+ * up) is not accounted.
+ */
+#define XEN_SYSCTL_SCHED_STEAL_wake    0
+#define XEN_SYSCTL_SCHED_STEAL_preempt 1
+#define XEN_SYSCTL_SCHED_STEAL_offline 2
+#define XEN_SYSCTL_SCHED_STEAL_NR      3
+    uint64_aligned_t steal[XEN_SYSCTL_SCHED_STEAL_NR];
+};
+typedef struct xen_sysctl_sched_vcpu_latency xen_sysctl_sched_vcpu_latency_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_sched_vcpu_latency_t);
+
+struct xen_sysctl_sched_latency {
+    domid_t domid;                          /* IN */
+    uint16_t pad;                           /* IN: MUST be zero. */
+    /*
+     * IN: number of elements in vcpus (can be 0, with a NULL handle).
+     * OUT: number of vcpus of the domain.
+     */
+    uint32_t nr_vcpus;
+    XEN_GUEST_HANDLE_64(xen_sysctl_sched_vcpu_latency_t) vcpus; /* OUT */
+};
+
+/*
+ * XEN_SYSCTL_xmalloc_op
+ *
+ * Return statistics of the hypervisor's xmalloc() heap: per size class of
+ * its per-CPU object caches, or per allocating call site (the latter only
+ * when booted with "xmalloc-sites").  Live counts of call sites are only
+ * maintained for sub-page allocations, and only on 64-bit hypervisors.
+ */
+#define XEN_SYSCTL_XMALLOC_classes     1
+#define XEN_SYSCTL_XMALLOC_sites       2
+
+struct xen_sysctl_xmalloc_class {
+    uint32_t size;                          /* Object size (bytes). */
+    uint32_t cached;                        /* Free objects held cached. */
+    uint64_aligned_t allocs;                /* Allocations of this class... */
+    uint64_aligned_t hits;                  /* ... served from the caches. */
+    uint64_aligned_t frees;
+};
+typedef struct xen_sysctl_xmalloc_class xen_sysctl_xmalloc_class_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_xmalloc_class_t);
+
+struct xen_sysctl_xmalloc_site {
+    char name[64];                          /* Symbol and offset, if known. */
+    uint64_aligned_t addr;                  /* Return address. */
+    uint64_aligned_t allocs;                /* Allocations made... */
+    uint64_aligned_t bytes;                 /* ... and their total size. */
+    uint64_aligned_t live;                  /* Allocations not yet freed... */
+    uint64_aligned_t live_bytes;            /* ... and their block size. */
+};
+typedef struct xen_sysctl_xmalloc_site xen_sysctl_xmalloc_site_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_xmalloc_site_t);
+
+struct xen_sysctl_xmalloc_op {
+    uint32_t cmd;                           /* IN: XEN_SYSCTL_XMALLOC_* */
+    /* IN: number of elements in the array for cmd (can be 0). */
+    uint32_t max_elem;
+    uint32_t nr_elem;                       /* OUT: number available. */
+    uint32_t pad;                           /* IN: MUST be zero. */
+    uint64_aligned_t pool_used;             /* OUT: bytes handed out. */
+    uint64_aligned_t pool_total;            /* OUT: bytes in the pool. */
+    XEN_GUEST_HANDLE_64(xen_sysctl_xmalloc_class_t) classes; /* OUT */
+    XEN_GUEST_HANDLE_64(xen_sysctl_xmalloc_site_t) sites;    /* OUT */
+};
+
+/*
+ * XEN_SYSCTL_locksample_op
+ *
+ * Control of, and results from, the sampling lock contention profiler.
+ * While enabled, one in every @period spin_lock() operations on each CPU is
+ * sampled, with the time waited for and the time holding the lock accounted
+ * to the lock.  Holds of at least @threshold ns are also logged, in a ring
+ * of the most recent ones.
+ *
+ * Wait times are put in histograms with power of 2 buckets: bucket 0 counts
+ * samples shorter than 128ns, bucket i (0 < i < LAST) samples in the range
+ * [2^(6+i), 2^(7+i)) ns and the last bucket all samples from 2^(6+LAST) ns
+ * onwards.
+ */
+#define XEN_SYSCTL_LOCKSAMPLE_enable   1    /* Set period (0: off), threshold */
+#define XEN_SYSCTL_LOCKSAMPLE_reset    2    /* Clear all results */
+#define XEN_SYSCTL_LOCKSAMPLE_locks    3    /* Get per-lock statistics */
+#define XEN_SYSCTL_LOCKSAMPLE_holds    4    /* Get long holds logged */
+
+#define XEN_SYSCTL_LOCKSAMPLE_BUCKETS 16
+struct xen_sysctl_locksample_lock {
+    uint64_aligned_t addr;                  /* Address of the lock. */
+    uint64_aligned_t hold_max_site;         /* Caller taking the lock for */
+    char hold_max_site_name[64];            /* its longest hold. */
+    uint64_aligned_t sampled;               /* Acquisitions sampled... */
+    uint64_aligned_t contended;             /* ... which had to wait. */
+    uint64_aligned_t wait_total, wait_max;  /* ns */
+    uint64_aligned_t hold_total, hold_max;  /* ns */
+    uint32_t wait_hist[XEN_SYSCTL_LOCKSAMPLE_BUCKETS];
+};
+typedef struct xen_sysctl_locksample_lock xen_sysctl_locksample_lock_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_locksample_lock_t);
+
+struct xen_sysctl_locksample_hold {
+    uint64_aligned_t lock;                  /* Address of the lock. */
+    uint64_aligned_t site;                  /* Caller taking the lock. */
+    char site_name[64];
+    uint64_aligned_t wait, hold;            /* ns */
+    uint64_aligned_t when;                  /* System time of the release. */
+    uint32_t cpu;
+    uint32_t pad;
+};
+typedef struct xen_sysctl_locksample_hold xen_sysctl_locksample_hold_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_locksample_hold_t);
+
+struct xen_sysctl_locksample_op {
+    uint32_t cmd;                           /* IN: XEN_SYSCTL_LOCKSAMPLE_* */
+    uint32_t period;                        /* IN (enable)/OUT */
+    uint64_aligned_t threshold;             /* IN (enable)/OUT: ns */
+    /* IN: number of elements in the array for cmd (can be 0). */
+    uint32_t max_elem;
+    uint32_t nr_elem;                       /* OUT: number available. */
+    XEN_GUEST_HANDLE_64(xen_sysctl_locksample_lock_t) locks; /* OUT */
+    XEN_GUEST_HANDLE_64(xen_sysctl_locksample_hold_t) holds; /* OUT */
+};
+
 struct xen_sysctl {
     uint32_t cmd;
 #define XEN_SYSCTL_readconsole                    1
@@ -1063,6 +1253,9 @@ struct xen_sysctl {
 #define XEN_SYSCTL_livepatch_op                  27
 #define XEN_SYSCTL_set_parameter                 28
 #define XEN_SYSCTL_get_cpu_policy                29
+#define XEN_SYSCTL_sched_latency                 30
+#define XEN_SYSCTL_xmalloc_op                    31
+#define XEN_SYSCTL_locksample_op                 32
     uint32_t interface_version; /* XEN_SYSCTL_INTERFACE_VERSION */
     union {
         struct xen_sysctl_readconsole       readconsole;
@@ -1091,6 +1284,9 @@ struct xen_sysctl {
         struct xen_sysctl_cpu_featureset    cpu_featureset;
         struct xen_sysctl_livepatch_op      livepatch;
         struct xen_sysctl_set_parameter     set_parameter;
+        struct xen_sysctl_sched_latency     sched_latency;
+        struct xen_sysctl_xmalloc_op        xmalloc_op;
+        struct xen_sysctl_locksample_op     locksample_op;
 #if defined(__i386__) || defined(__x86_64__)
         struct xen_sysctl_cpu_policy        cpu_policy;
 #endif
@@ -0,0 +1,14 @@
+#define XEN_COMPILE_DATE	"Sun Oct 18 17:50:25 UTC 2026"
+#define XEN_COMPILE_TIME	"17:50:25"
+#define XEN_COMPILE_BY		""
+#define XEN_COMPILE_DOMAIN	""
+#define XEN_COMPILE_HOST	"vm"
+#define XEN_COMPILER		"gcc (Debian 12.2.0-14+deb12u1) 12.2.0"
+
+#define XEN_VERSION		4
+#define XEN_SUBVERSION		13
+#define XEN_EXTRAVERSION	".0"
+
+#define XEN_CHANGESET		"Sun Oct 18 17:43:58 2026 +0000 git:f78c20f-dirty"
+#define XEN_BANNER		\
+"\040\130\145\156\040\064\056\061\063\056\060\012"
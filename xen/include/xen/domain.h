@@ -128,4 +128,11 @@ struct vnuma_info {
 
 void vnuma_destroy(struct vnuma_info *vnuma);
 
+/* Parallel freeing of a dying domain's memory (common/teardown.c). */
+struct xen_domctl_teardown_progress;
+int domain_teardown_memory(struct domain *d);
+void domain_teardown_progress(struct domain *d,
+                              struct xen_domctl_teardown_progress *p);
+void domain_teardown_free(struct domain *d);
+
 #endif /* __XEN_DOMAIN_H__ */
@@ -68,6 +68,9 @@ int evtchn_close(struct domain *d1, int port1, bool guest);
 /* Free an event channel. */
 void evtchn_free(struct domain *d, struct evtchn *chn);
 
+/* Hold back an event as per the port's coalescing policy? */
+bool evtchn_coalesce_event(struct evtchn *chn);
+
 /* Allocate a specific event channel port. */
 int evtchn_allocate_port(struct domain *d, unsigned int port);
 
@@ -179,6 +182,8 @@ static inline void evtchn_port_set_pending(struct domain *d,
                                            unsigned int vcpu_id,
                                            struct evtchn *evtchn)
 {
+    if ( unlikely(evtchn->coalesce) && evtchn_coalesce_event(evtchn) )
+        return;
     d->evtchn_port_ops->set_pending(d->vcpu[vcpu_id], evtchn);
 }
 
@@ -14,6 +14,7 @@ struct evtchn_fifo_queue {
     uint32_t tail;
     uint8_t priority;
     spinlock_t lock;
+    struct evtchn *staged; /* events waiting to be linked */
 };
 
 struct evtchn_fifo_vcpu {
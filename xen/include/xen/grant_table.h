@@ -33,6 +33,7 @@
 struct grant_table;
 
 extern unsigned int opt_max_grant_frames;
+extern unsigned int opt_gnttab_max_cached;
 
 /* Create/destroy per-domain grant table context. */
 int grant_table_init(struct domain *d, int max_grant_frames,
@@ -51,6 +52,10 @@ void
 gnttab_release_mappings(
     struct domain *d);
 
+int gnttab_get_read_frame(struct domain *d, grant_ref_t ref, domid_t domid,
+                          unsigned int offset, unsigned int len, mfn_t *mfn);
+void gnttab_put_read_frame(struct domain *d, grant_ref_t ref, mfn_t mfn);
+
 int mem_sharing_gref_to_gfn(struct grant_table *gt, grant_ref_t ref,
                             gfn_t *gfn, uint16_t *status);
 
@@ -64,6 +69,7 @@ int gnttab_get_status_frame(struct domain *d, unsigned long idx,
 #else
 
 #define opt_max_grant_frames 0
+#define opt_gnttab_max_cached 0
 
 static inline int grant_table_init(struct domain *d,
                                    int max_grant_frames,
@@ -80,6 +86,16 @@ static inline void grant_table_warn_active_grants(struct domain *d) {}
 
 static inline void gnttab_release_mappings(struct domain *d) {}
 
+static inline int gnttab_get_read_frame(struct domain *d, grant_ref_t ref,
+                                        domid_t domid, unsigned int offset,
+                                        unsigned int len, mfn_t *mfn)
+{
+    return -EOPNOTSUPP;
+}
+
+static inline void gnttab_put_read_frame(struct domain *d, grant_ref_t ref,
+                                         mfn_t mfn) {}
+
 static inline int mem_sharing_gref_to_gfn(struct grant_table *gt,
                                           grant_ref_t ref,
                                           gfn_t *gfn, uint16_t *status)
@@ -589,6 +589,16 @@ static inline unsigned int get_order_from_pages(unsigned long nr_pages)
 
 void scrub_one_page(struct page_info *);
 
+/* Ways of clearing a mapped page, listed by arch code most preferred first. */
+struct scrub_backend {
+    const char *name;
+    bool (*usable)(void);           /* NULL if always usable */
+    void (*clear)(void *va);
+};
+extern const struct scrub_backend arch_scrub_backends[];
+extern const unsigned int arch_nr_scrub_backends;
+void free_domheap_page_list(struct page_list_head *list);
+
 #ifndef arch_free_heap_page
 #define arch_free_heap_page(d, pg)                      \
     page_list_del(pg, is_xen_heap_page(pg) ?            \
@@ -13,6 +13,8 @@ PERFCOUNTER(irqs,                   "#interrupts")
 PERFCOUNTER(ipis,                   "#IPIs")
 
 PERFCOUNTER(rcu_idle_timer,         "RCU: idle_timer")
+PERFCOUNTER(rcu_expedited_gp,       "RCU: expedited grace periods")
+PERFCOUNTER(rcu_offload_cbs,        "RCU: offloaded callbacks")
 
 /* Generic scheduler counters (applicable to all schedulers) */
 PERFCOUNTER(sched_irq,              "sched: timer")
@@ -35,6 +37,9 @@ PERFCOUNTER(tickled_idle_cpu,       "sched: tickled_idle_cpu")
 PERFCOUNTER(tickled_idle_cpu_excl,  "sched: tickled_idle_cpu_exclusive")
 PERFCOUNTER(tickled_busy_cpu,       "sched: tickled_busy_cpu")
 PERFCOUNTER(unit_check,             "sched: unit_check")
+PERFCOUNTER(sched_wake_queued,      "sched: remote wakes queued")
+PERFCOUNTER(sched_wake_coalesced,   "sched: remote wakes coalesced")
+PERFCOUNTER(sched_wake_drained,     "sched: remote wakes processed")
 
 /* credit specific counters */
 PERFCOUNTER(delay_ms,               "csched: delay")
@@ -80,4 +85,44 @@ PERFCOUNTER(tickled_cpu_overridden, "csched2: tickled_cpu_overridden")
 
 PERFCOUNTER(need_flush_tlb_flush,   "PG_need_flush tlb flushes")
 
+/* per-CPU page caches */
+PERFCOUNTER(pcp_alloc,              "pcp: allocations from cache")
+PERFCOUNTER(pcp_free,               "pcp: frees to cache")
+PERFCOUNTER(pcp_refill,             "pcp: batches refilled from heap")
+PERFCOUNTER(pcp_drain,              "pcp: batches drained to heap")
+
+PERFCOUNTER(sp_pool_alloc,          "superpage pool: allocations")
+PERFCOUNTER(sp_pool_refill,         "superpage pool: chunks refilled")
+PERFCOUNTER(sp_pool_compact,        "superpage pool: compactions")
+
+PERFCOUNTER(vmap_cache_alloc,       "vmap: allocations from cache")
+PERFCOUNTER(vmap_cache_refill,      "vmap: cache refills")
+PERFCOUNTER(vmap_lazy_unmap,        "vmap: lazy unmaps")
+PERFCOUNTER(vmap_lazy_purge,        "vmap: lazy purges")
+PERFCOUNTER(vmap_flush_avoided,     "vmap: TLB flushes avoided")
+PERFCOUNTER(xmalloc_depot,          "xmalloc: depot magazine exchanges")
+PERFCOUNTER(xmalloc_reap,           "xmalloc: magazines reaped")
+
+PERFCOUNTER(teardown_batches,       "teardown: batches freed")
+PERFCOUNTER(teardown_pages,         "teardown: pages freed")
+
+/* grant table mapping cache */
+PERFCOUNTER(gnttab_cache_hit,       "gnttab: cache hits")
+PERFCOUNTER(gnttab_cache_miss,      "gnttab: cache misses")
+PERFCOUNTER(gnttab_cache_release,   "gnttab: cached mappings released")
+PERFCOUNTER(gnttab_cache_revoked,   "gnttab: cached mappings revoked")
+PERFCOUNTER(gnttab_cache_evict,     "gnttab: cached mappings evicted")
+
+/* grant table unmap TLB flushing */
+PERFCOUNTER(gnttab_unmap_flush,     "gnttab: unmap TLB flushes")
+PERFCOUNTER(gnttab_unmap_deferred,  "gnttab: unmaps with deferred flush")
+PERFCOUNTER(gnttab_unmap_flush_full,"gnttab: deferred flushes (full)")
+PERFCOUNTER(gnttab_unmap_flush_timer,"gnttab: deferred flushes (timer)")
+
+PERFCOUNTER(gnttab_maptrack_grow,   "gnttab: maptrack frames added")
+PERFCOUNTER(gnttab_maptrack_steal,  "gnttab: maptrack entry steals")
+
+PERFCOUNTER(gnttab_copy_v2,         "gnttab: copy_v2 operations")
+PERFCOUNTER(gnttab_copy_nontemporal,"gnttab: non-temporal page copies")
+
 /*#endif*/ /* __XEN_PERFC_DEFN_H__ */
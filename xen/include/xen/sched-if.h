@@ -543,6 +543,10 @@ struct cpupool
     struct scheduler *sched;
     atomic_t         refcnt;
     enum sched_gran  gran;
+    /* Domains moved in, and how long their vcpus were paused for it. */
+    unsigned int     n_moves;
+    s_time_t         move_pause_last;
+    s_time_t         move_pause_max;
 };
 
 static inline cpumask_t *cpupool_domain_master_cpumask(const struct domain *d)
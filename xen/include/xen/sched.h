@@ -114,6 +114,8 @@ struct evtchn
     u8 priority;
     u8 last_priority;
     u16 last_vcpu_id;
+    struct evtchn *fifo_next; /* next event staged for FIFO queue linking */
+    struct evtchn_coalesce *coalesce; /* EVTCHNOP_set_coalesce policy */
 #ifdef CONFIG_XSM
     union {
 #ifdef XSM_NEED_GENERIC_EVTCHN_SSID
@@ -174,6 +176,8 @@ struct vcpu
         XEN_GUEST_HANDLE(vcpu_runstate_info_compat_t) compat;
     } runstate_guest; /* guest address */
 #endif
+    /* Scheduling latency statistics (see vcpu_runstate_change()). */
+    struct sched_vcpu_latency *sched_latency;
     unsigned int     new_state;
 
     /* Has the FPU been initialised? */
@@ -188,6 +192,9 @@ struct vcpu
     bool             is_urgent;
     /* VCPU must context_switch without scheduling unit. */
     bool             force_context_switch;
+    /* VCPU is on a remote cpu's wake list (see vcpu_wake()). */
+    bool             wake_pending;
+    struct vcpu     *wake_next;
 
 #ifdef VCPU_TRAP_LAST
 #define VCPU_TRAP_NONE    0
@@ -535,6 +542,9 @@ struct domain
     /* Argo interdomain communication support */
     struct argo_domain *argo;
 #endif
+
+    /* Parallel memory teardown state, set up by domain_kill(). */
+    struct domain_teardown *teardown;
 };
 
 /* Protect updates/reads (resp.) of domain_list and domain_hash. */
@@ -934,6 +944,7 @@ int vcpu_set_soft_affinity(struct vcpu *v, const cpumask_t *affinity);
 void restore_vcpu_affinity(struct domain *d);
 
 void vcpu_runstate_get(struct vcpu *v, struct vcpu_runstate_info *runstate);
+int sched_latency_get(struct xen_sysctl_sched_latency *op);
 uint64_t get_cpu_idle_time(unsigned int cpu);
 void sched_guest_idle(void (*idle) (void), unsigned int cpu);
 void scheduler_enable(void);
@@ -30,6 +30,22 @@ union lock_debug { };
 #define spin_debug_disable() ((void)0)
 #endif
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+struct lock_mode {
+    bool queued;
+};
+#define _LOCK_MODE(q) { q }
+#ifdef CONFIG_QUEUED_SPINLOCKS_ALL
+#define SPINLOCK_QUEUED_DEFAULT true
+#else
+#define SPINLOCK_QUEUED_DEFAULT false
+#endif
+#else
+struct lock_mode { };
+#define _LOCK_MODE(q) { }
+#define SPINLOCK_QUEUED_DEFAULT false
+#endif
+
 #ifdef CONFIG_DEBUG_LOCK_PROFILE
 
 #include <public/sysctl.h>
@@ -38,7 +54,7 @@ union lock_debug { };
     lock profiling on:
 
     Global locks which should be subject to profiling must be declared via
-    DEFINE_SPINLOCK.
+    DEFINE_SPINLOCK (or DEFINE_QSPINLOCK).
 
     For locks in structures further measures are necessary:
     - the structure definition must include a profile_head with exactly this
@@ -51,7 +67,8 @@ union lock_debug { };
 
       spin_lock_init_prof(ptr, lock);
 
-      with ptr being the main structure pointer and lock the spinlock field
+      (or spin_lock_init_prof_queued(ptr, lock)) with ptr being the main
+      structure pointer and lock the spinlock field
 
     - each structure has to be added to profiling with
 
@@ -92,24 +109,31 @@ struct lock_profile_qhead {
     static struct lock_profile * const __lock_profile_##name                  \
     __used_section(".lockprofile.data") =                                     \
     &__lock_profile_data_##name
-#define _SPIN_LOCK_UNLOCKED(x) { { 0 }, SPINLOCK_NO_CPU, 0, _LOCK_DEBUG, x }
-#define SPIN_LOCK_UNLOCKED _SPIN_LOCK_UNLOCKED(NULL)
-#define DEFINE_SPINLOCK(l)                                                    \
-    spinlock_t l = _SPIN_LOCK_UNLOCKED(NULL);                                 \
+#define _SPIN_LOCK_UNLOCKED(q, x)                                             \
+    { { 0 }, SPINLOCK_NO_CPU, 0, _LOCK_DEBUG, _LOCK_MODE(q), x }
+#define SPIN_LOCK_UNLOCKED _SPIN_LOCK_UNLOCKED(SPINLOCK_QUEUED_DEFAULT, NULL)
+#define SPIN_LOCK_UNLOCKED_QUEUED _SPIN_LOCK_UNLOCKED(true, NULL)
+#define _DEFINE_SPINLOCK(l, q)                                                \
+    spinlock_t l = _SPIN_LOCK_UNLOCKED(q, NULL);                              \
     static struct lock_profile __lock_profile_data_##l = _LOCK_PROFILE(l);    \
     _LOCK_PROFILE_PTR(l)
+#define DEFINE_SPINLOCK(l) _DEFINE_SPINLOCK(l, SPINLOCK_QUEUED_DEFAULT)
+#define DEFINE_QSPINLOCK(l) _DEFINE_SPINLOCK(l, true)
 
-#define spin_lock_init_prof(s, l)                                             \
+#define _spin_lock_init_prof(s, l, q)                                         \
     do {                                                                      \
         struct lock_profile *prof;                                            \
         prof = xzalloc(struct lock_profile);                                  \
         if (!prof) break;                                                     \
         prof->name = #l;                                                      \
         prof->lock = &(s)->l;                                                 \
-        (s)->l = (spinlock_t)_SPIN_LOCK_UNLOCKED(prof);                       \
+        (s)->l = (spinlock_t)_SPIN_LOCK_UNLOCKED(q, prof);                    \
         prof->next = (s)->profile_head.elem_q;                                \
         (s)->profile_head.elem_q = prof;                                      \
     } while(0)
+#define spin_lock_init_prof(s, l)                                             \
+    _spin_lock_init_prof(s, l, SPINLOCK_QUEUED_DEFAULT)
+#define spin_lock_init_prof_queued(s, l) _spin_lock_init_prof(s, l, true)
 
 void _lock_profile_register_struct(
     int32_t, struct lock_profile_qhead *, int32_t, char *);
@@ -128,10 +152,15 @@ extern void spinlock_profile_reset(unsigned char key);
 
 struct lock_profile_qhead { };
 
-#define SPIN_LOCK_UNLOCKED { { 0 }, SPINLOCK_NO_CPU, 0, _LOCK_DEBUG }
+#define _SPIN_LOCK_UNLOCKED(q)                                                \
+    { { 0 }, SPINLOCK_NO_CPU, 0, _LOCK_DEBUG, _LOCK_MODE(q) }
+#define SPIN_LOCK_UNLOCKED _SPIN_LOCK_UNLOCKED(SPINLOCK_QUEUED_DEFAULT)
+#define SPIN_LOCK_UNLOCKED_QUEUED _SPIN_LOCK_UNLOCKED(true)
 #define DEFINE_SPINLOCK(l) spinlock_t l = SPIN_LOCK_UNLOCKED
+#define DEFINE_QSPINLOCK(l) spinlock_t l = SPIN_LOCK_UNLOCKED_QUEUED
 
 #define spin_lock_init_prof(s, l) spin_lock_init(&((s)->l))
+#define spin_lock_init_prof_queued(s, l) spin_lock_init_queued(&((s)->l))
 #define lock_profile_register_struct(type, ptr, idx, print)
 #define lock_profile_deregister_struct(type, ptr)
 #define spinlock_profile_printall(key)
@@ -144,6 +173,12 @@ typedef union {
         u16 head;
         u16 tail;
     };
+    /* Queued locks use the same word differently. */
+    struct {
+        u8 locked;
+        u8 released;                /* Count of releases, for spin_barrier() */
+        u16 qtail;                  /* Last waiter queued, if any */
+    };
 } spinlock_tickets_t;
 
 #define SPINLOCK_TICKET_INC { .head_tail = 0x10000, }
@@ -156,6 +191,7 @@ typedef struct spinlock {
     u16 recurse_cnt:SPINLOCK_RECURSE_BITS;
 #define SPINLOCK_MAX_RECURSE   ((1u << SPINLOCK_RECURSE_BITS) - 1)
     union lock_debug debug;
+    struct lock_mode mode;
 #ifdef CONFIG_DEBUG_LOCK_PROFILE
     struct lock_profile *profile;
 #endif
@@ -164,6 +200,14 @@ typedef struct spinlock {
 
 #define spin_lock_init(l) (*(l) = (spinlock_t)SPIN_LOCK_UNLOCKED)
 
+/*
+ * Queued locks, for heavily contended locks, make waiters spin on queue nodes
+ * of their own rather than all on the lock.  With QUEUED_SPINLOCKS_ALL, all
+ * locks are queued ones, except those merely zeroed rather than initialised.
+ * Without QUEUED_SPINLOCKS, queued locks are ticket locks like the others.
+ */
+#define spin_lock_init_queued(l) (*(l) = (spinlock_t)SPIN_LOCK_UNLOCKED_QUEUED)
+
 void _spin_lock(spinlock_t *lock);
 void _spin_lock_cb(spinlock_t *lock, void (*cond)(void *), void *data);
 void _spin_lock_irq(spinlock_t *lock);
@@ -220,4 +264,9 @@ void _spin_unlock_recursive(spinlock_t *lock);
 #define spin_lock_recursive(l)        _spin_lock_recursive(l)
 #define spin_unlock_recursive(l)      _spin_unlock_recursive(l)
 
+#ifdef CONFIG_LOCK_SAMPLE
+struct xen_sysctl_locksample_op;
+int lock_sample_control(struct xen_sysctl_locksample_op *op);
+#endif
+
 #endif /* __SPINLOCK_H__ */
@@ -25,6 +25,8 @@ void *vmalloc_xen(size_t size);
 void *vzalloc(size_t size);
 void vfree(void *va);
 
+void vm_dump_info(void);
+
 void __iomem *ioremap(paddr_t, size_t);
 
 static inline void iounmap(void __iomem *va)
@@ -35,6 +37,8 @@ static inline void iounmap(void __iomem *va)
 }
 
 void *arch_vmap_virt_end(void);
+/* Flush all pCPUs' TLBs of (stale) vmap() entries within [start, end). */
+void arch_vmap_flush(unsigned long start, unsigned long end);
 static inline void vm_init(void)
 {
     vm_init_type(VMAP_DEFAULT, (void *)VMAP_VIRT_START, arch_vmap_virt_end());
@@ -156,4 +156,12 @@ unsigned long xmem_pool_get_used_size(struct xmem_pool *pool);
  */
 unsigned long xmem_pool_get_total_size(struct xmem_pool *pool);
 
+struct xen_sysctl_xmalloc_op;
+
+/**
+ * xmalloc_stats_control - XEN_SYSCTL_xmalloc_op handler
+ * @op: size class or call site statistics request
+ */
+int xmalloc_stats_control(struct xen_sysctl_xmalloc_op *op);
+
 #endif /* __XMALLOC_H__ */
@@ -554,6 +554,7 @@ static int flask_sysctl_scheduler_op(int op)
         return domain_has_xen(current->domain, XEN__SETSCHEDULER);
 
     case XEN_SYSCTL_SCHEDOP_getinfo:
+    case XEN_SYSCTL_SCHEDOP_getstats:
         return domain_has_xen(current->domain, XEN__GETSCHEDULER);
 
     default:
@@ -744,6 +745,9 @@ static int flask_domctl(struct domain *d, int cmd)
     case XEN_DOMCTL_get_cpu_policy:
         return current_has_perm(d, SECCLASS_DOMAIN2, DOMAIN2__GET_CPU_POLICY);
 
+    case XEN_DOMCTL_get_teardown_progress:
+        return current_has_perm(d, SECCLASS_DOMAIN, DOMAIN__GETDOMAININFO);
+
     default:
         return avc_unknown_permission("domctl", cmd);
     }
@@ -758,6 +762,7 @@ static int flask_sysctl(int cmd)
     case XEN_SYSCTL_getdomaininfolist:
     case XEN_SYSCTL_page_offline_op:
     case XEN_SYSCTL_scheduler_op:
+    case XEN_SYSCTL_sched_latency:
 #ifdef CONFIG_X86
     case XEN_SYSCTL_cpu_hotplug:
 #endif
@@ -779,6 +784,7 @@ static int flask_sysctl(int cmd)
         return domain_has_xen(current->domain, XEN__GETCPUINFO);
 
     case XEN_SYSCTL_availheap:
+    case XEN_SYSCTL_xmalloc_op:
         return domain_has_xen(current->domain, XEN__HEAP);
 
     case XEN_SYSCTL_get_pmstat:
@@ -788,6 +794,7 @@ static int flask_sysctl(int cmd)
         return domain_has_xen(current->domain, XEN__PM_OP);
 
     case XEN_SYSCTL_lockprof_op:
+    case XEN_SYSCTL_locksample_op:
         return domain_has_xen(current->domain, XEN__LOCKPROF);
 
     case XEN_SYSCTL_cpupool_op: